@@ -26,12 +26,14 @@
 #include <cstdio>
 #include <cstring>
 #include <memory>
+#include <random>
 #include <string>
 #include <stdexcept>
 
 #include <aipstack/misc/Function.h>
 #include <aipstack/structure/index/AvlTreeIndex.h>
 #include <aipstack/structure/index/MruListIndex.h>
+#include <aipstack/structure/index/HashTableIndex.h>
 #include <aipstack/structure/minimum/LinkedHeap.h>
 #include <aipstack/platform/PlatformFacade.h>
 #include <aipstack/platform/HostedPlatformImpl.h>
@@ -68,6 +70,7 @@ constexpr AIpStack::MacAddr DeviceMacAddr =
 // Index data structure to use for various things.
 using IndexService = AIpStack::AvlTreeIndexService; // AVL tree
 //using IndexService = AIpStack::MruListIndexService; // Linked list
+//using IndexService = AIpStack::HashTableIndexService<>; // Hash table
 
 // IP layer (IpStack) configuration
 using MyIpStackService = AIpStack::IpStackService<
@@ -93,6 +96,7 @@ using ProtocolServicesList = AIpStack::MakeTypeList<
     // TCP configuration
     AIpStack::IpTcpProtoService<
         AIpStack::IpTcpProtoOptions::NumTcpPcbs::Is<2048>,
+        AIpStack::IpTcpProtoOptions::NumTimeWaitRecords::Is<2048>,
         AIpStack::IpTcpProtoOptions::PcbIndexService::Is<IndexService>
     >,
     // UDP configuration
@@ -214,6 +218,12 @@ int main (int argc, char *argv[])
     // resources of its own.
     Platform platform{PlatformRef{&platform_impl}};
     
+    // Set a random seed for hash tables, in case HashTableIndexService is used.
+    std::random_device random_device;
+    AIpStack::SetHashTableIndexSeed(
+        (std::uint64_t(random_device()) << 32) | random_device(),
+        (std::uint64_t(random_device()) << 32) | random_device());
+    
     // Construct the IP stack.
     auto stack = std::make_unique<MyIpStack>(platform);
     
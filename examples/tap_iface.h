@@ -25,6 +25,7 @@
 #ifndef AIPSTACK_TAP_IFACE_H
 #define AIPSTACK_TAP_IFACE_H
 
+#include <cstddef>
 #include <string>
 
 #include <aipstack/misc/Function.h>
@@ -41,6 +42,9 @@ namespace AIpStackExamples {
 
 template<typename StackArg, typename TheEthIpIfaceService>
 class TapIface {
+    // Maximum number of frames received from the TAP device at once.
+    static constexpr std::size_t RxBurstSize = 16;
+
     using Platform = AIpStack::PlatformFacade<AIpStack::HostedPlatformImpl>;
 
     AIPSTACK_MAKE_INSTANCE(TheEthIpIface, (TheEthIpIfaceService::template Compose<
@@ -51,13 +55,18 @@ public:
               std::string const &device_id, AIpStack::MacAddr const &mac_addr)
     :
         m_tap_device(platform.ref().platformImpl()->getEventLoop(), device_id,
-            AIPSTACK_BIND_MEMBER_TN(&TapIface::frameReceived, this)),
+            AIPSTACK_BIND_MEMBER_TN(&TapIface::frameReceived, this),
+            AIPSTACK_BIND_MEMBER_TN(&TapIface::burstEnded, this),
+            RxBurstSize),
         m_mac_addr(mac_addr),
         m_eth_iface(platform, stack, AIpStack::EthIfaceDriverParams{
             /*eth_mtu=*/ m_tap_device.getMtu(),
             /*mac_addr=*/ &m_mac_addr,
             AIPSTACK_BIND_MEMBER_TN(&TapIface::driverSendFrame, this),
-            AIPSTACK_BIND_MEMBER_TN(&TapIface::driverGetEthState, this)
+            AIPSTACK_BIND_MEMBER_TN(&TapIface::driverGetEthState, this),
+            /*rx_chksum_verify=*/ AIpStack::IpChksumFlags(),
+            /*tx_chksum_offload=*/ AIpStack::IpChksumFlags(),
+            /*rx_burst_end=*/ true
         })
     {}
 
@@ -71,6 +80,13 @@ private:
         return m_eth_iface.recvFrame(frame);
     }
     
+    void burstEnded ()
+    {
+        return m_eth_iface.recvBurstEnd();
+    }
+    
+    // The TX queue of EthIpIface (TxQueueSize) is not used, since a TAP device
+    // takes one frame per write and queuing would only add a copy.
     AIpStack::IpErr driverSendFrame (AIpStack::IpBufRef frame)
     {
         return m_tap_device.sendFrame(frame);
@@ -44,12 +44,14 @@
 #include <aipstack/structure/Accessor.h>
 #include <aipstack/infra/Struct.h>
 #include <aipstack/infra/Buf.h>
+#include <aipstack/infra/BufUtils.h>
 #include <aipstack/infra/SendRetry.h>
 #include <aipstack/infra/TxAllocHelper.h>
 #include <aipstack/infra/Err.h>
 #include <aipstack/infra/Options.h>
 #include <aipstack/infra/ObserverNotification.h>
 #include <aipstack/infra/Instance.h>
+#include <aipstack/infra/PacketBufPool.h>
 #include <aipstack/proto/EthernetProto.h>
 #include <aipstack/proto/ArpProto.h>
 #include <aipstack/ip/IpAddr.h>
@@ -128,6 +130,91 @@ struct EthIfaceDriverParams {
      * @return Driver-provided-state (currently just the link-up flag).
      */
     Function<EthIfaceState()> get_eth_state = nullptr;
+
+    /**
+     * Checksums which the driver may report as already verified for received frames.
+     * 
+     * This is passed on as @ref IpIfaceDriverParams::rx_chksum_verify; see the
+     * `rx_verified` parameter of @ref EthIpIface::recvFrame.
+     */
+    IpChksumFlags rx_chksum_verify = IpChksumFlags();
+
+    /**
+     * Checksums which the driver computes for sent frames with IPv4 payload.
+     * 
+     * This is passed on as @ref IpIfaceDriverParams::tx_chksum_offload, which
+     * documents the requirements for the driver.
+     */
+    IpChksumFlags tx_chksum_offload = IpChksumFlags();
+
+    /**
+     * Whether the driver reports the ends of bursts of received frames.
+     * 
+     * This is passed on as @ref IpIfaceDriverParams::rx_burst_end; if true, the
+     * driver must call @ref EthIpIface::recvBurstEnd after delivering each batch of
+     * frames using @ref EthIpIface::recvFrame.
+     */
+    bool rx_burst_end = false;
+
+    /**
+     * Packet buffer pool which the driver receives frames into, or null.
+     * 
+     * This is passed on as @ref IpIfaceDriverParams::rx_pool. Frames passed to @ref
+     * EthIpIface::recvFrame may be stored in buffers of this pool, so that protocol
+     * handlers can retain received packets without copying them.
+     */
+    IpPacketBufPool *rx_pool = nullptr;
+
+    /**
+     * Memory for the deferred transmit queue, or null to send frames immediately.
+     * 
+     * This is only used if @ref EthIpIfaceOptions::TxQueueSize is greater than zero.
+     * If it is not null, it must point to at least @ref EthIpIface::txQueueBufferSize
+     * bytes which remain valid for the lifetime of the @ref EthIpIface. Frames which
+     * are to be sent are then copied into this queue and only passed to the driver
+     * when @ref EthIpIface::flushTxQueue is called or when the queue is full.
+     * 
+     * Each frame is copied into the queue because the buffers of the frame are only
+     * valid during the send call, so the queue pays off when the driver can send a
+     * batch of frames at a lower cost than the frames one by one (see @ref
+     * send_frames).
+     * 
+     * A queued frame is reported as sent successfully. If the driver later fails to
+     * send it, the error cannot be reported to the sender and the frame is dropped,
+     * as if it was lost on the link. The exception is a flush which is done because
+     * the queue is full: if it fails, the frame being sent is not queued and the
+     * error is returned for it (e.g. @ref IpErr::OutputBufferFull), so that the
+     * sender can retry later.
+     */
+    char *tx_queue_buffer = nullptr;
+
+    /**
+     * Driver function to request that the transmit queue be flushed.
+     * 
+     * @note This function must be provided if @ref tx_queue_buffer is used.
+     * 
+     * This is called when a frame is added to the empty transmit queue. The driver
+     * must arrange for @ref EthIpIface::flushTxQueue to be called soon, typically at
+     * the end of the current event loop iteration (e.g. using @ref
+     * EventLoopFlushHook). It may be called again before the queue is flushed.
+     */
+    Function<void()> request_tx_flush = nullptr;
+
+    /**
+     * Driver function to send a batch of Ethernet frames (optional).
+     * 
+     * If provided, this is used by @ref EthIpIface::flushTxQueue to pass all queued
+     * frames to the driver at once (e.g. using a single system call), instead of
+     * calling @ref send_frame for each frame. The same requirements as for @ref
+     * send_frame apply to each frame. Frames which cannot be sent are dropped.
+     * 
+     * @param frames Pointer to the array of frames to send.
+     * @param num_frames Number of frames to send (at least one).
+     * @return Success if all frames were sent, otherwise the error for the first
+     *         frame which could not be sent.
+     */
+    Function<IpErr(IpBufRef const *frames, std::size_t num_frames)> send_frames =
+        nullptr;
 };
 
 /**
@@ -171,7 +258,8 @@ class EthIpIface final :
     ,private EthHwIface
 #endif
 {
-    AIPSTACK_USE_VALS(Arg::Params, (NumArpEntries, ArpProtectCount, HeaderBeforeEth))
+    AIPSTACK_USE_VALS(Arg::Params, (NumArpEntries, ArpProtectCount, HeaderBeforeEth,
+                                    TxQueueSize))
     AIPSTACK_USE_TYPES(Arg::Params, (TimersStructureService))
     AIPSTACK_USE_TYPES(Arg, (PlatformImpl, StackArg))
     
@@ -186,6 +274,11 @@ class EthIpIface final :
     static_assert(ArpProtectCount >= 0);
     static_assert(ArpProtectCount <= NumArpEntries);
     
+    static_assert(TxQueueSize >= 0);
+    
+    // Size of the transmit queue arrays (at least one to avoid zero-size arrays).
+    inline static constexpr std::size_t TxQueueArraySize = MaxValue(1, TxQueueSize);
+    
     inline static constexpr int ArpNonProtectCount = NumArpEntries - ArpProtectCount;
     
     // Get an unsigned integer type sufficient for ARP entry indexes and null value.
@@ -310,14 +403,20 @@ public:
             /*hw_type=*/ IpHwType::Ethernet,
             /*hw_iface=*/ static_cast<EthHwIface *>(this),
             AIPSTACK_BIND_MEMBER_TN(&EthIpIface::driverSendIp4Packet, this),
-            AIPSTACK_BIND_MEMBER_TN(&EthIpIface::driverGetState, this)
+            AIPSTACK_BIND_MEMBER_TN(&EthIpIface::driverGetState, this),
+            /*rx_chksum_verify=*/ params.rx_chksum_verify,
+            /*tx_chksum_offload=*/ params.tx_chksum_offload,
+            /*rx_burst_end=*/ params.rx_burst_end,
+            /*rx_pool=*/ params.rx_pool
         }),
-        m_timer(platform_, AIPSTACK_BIND_MEMBER_TN(&EthIpIface::timerHandler, this))
+        m_timer(platform_, AIPSTACK_BIND_MEMBER_TN(&EthIpIface::timerHandler, this)),
+        m_tx_queue_count(0)
     {
         AIPSTACK_ASSERT(params.eth_mtu >= EthHeader::Size);
         AIPSTACK_ASSERT(params.mac_addr != nullptr);
         AIPSTACK_ASSERT(params.send_frame);
         AIPSTACK_ASSERT(params.get_eth_state);
+        AIPSTACK_ASSERT(params.tx_queue_buffer == nullptr || params.request_tx_flush);
         
         // Initialize ARP entries...
         for (auto &e : m_arp_entries) {
@@ -344,6 +443,19 @@ public:
      */
     ~EthIpIface () = default;
 
+    /**
+     * Return the size of the memory needed for the deferred transmit queue.
+     * 
+     * See @ref EthIfaceDriverParams::tx_queue_buffer.
+     * 
+     * @param eth_mtu The @ref EthIfaceDriverParams::eth_mtu of the interface.
+     * @return Required size of @ref EthIfaceDriverParams::tx_queue_buffer in bytes.
+     */
+    inline static constexpr std::size_t txQueueBufferSize (std::size_t eth_mtu)
+    {
+        return std::size_t(TxQueueSize) * (HeaderBeforeEth + eth_mtu);
+    }
+
     /**
      * Get the @ref IpIface representing this network interface.
      * 
@@ -363,8 +475,12 @@ public:
      * 
      * @param frame Received frame, presumably starting with the Ethernet header. The
      *              referenced buffers will only be read from within this function call.
+     * @param rx_verified Checksums of the IPv4 packet in this frame which have already
+     *        been verified by the driver; it must be a subset of @ref
+     *        EthIfaceDriverParams::rx_chksum_verify. See @ref
+     *        IpDriverIface::recvIp4Packet.
      */
-    void recvFrame (IpBufRef frame)
+    void recvFrame (IpBufRef frame, IpChksumFlags rx_verified = IpChksumFlags())
     {
         // Check that we have an Ethernet header.
         if (AIPSTACK_UNLIKELY(!frame.hasHeader(EthHeader::Size))) {
@@ -382,13 +498,68 @@ public:
         
         // Handle based on the EtherType.
         if (AIPSTACK_LIKELY(ethtype == EthType::Ipv4)) {
-            m_driver_iface.recvIp4Packet(pkt);
+            m_driver_iface.recvIp4Packet(pkt, rx_verified);
         }
         else if (ethtype == EthType::Arp) {
             recvArpPacket(pkt);
         }
     }
     
+    /**
+     * Notify that a burst of received frames has ended.
+     * 
+     * This should be called by a driver which has set @ref
+     * EthIfaceDriverParams::rx_burst_end, after it has delivered a batch of received
+     * frames using @ref recvFrame. See @ref IpDriverIface::recvBurstEnd.
+     */
+    void recvBurstEnd ()
+    {
+        m_driver_iface.recvBurstEnd();
+    }
+    
+    /**
+     * Pass all frames in the deferred transmit queue to the driver.
+     * 
+     * This should be called by the driver soon after @ref
+     * EthIfaceDriverParams::request_tx_flush has been called; calling it at other
+     * times is harmless. The frames are passed using @ref
+     * EthIfaceDriverParams::send_frames if provided, otherwise using @ref
+     * EthIfaceDriverParams::send_frame for each frame.
+     * 
+     * The queue is empty afterwards; frames which the driver failed to send are
+     * dropped (see @ref EthIfaceDriverParams::tx_queue_buffer).
+     * 
+     * @note The driver must not cause frames to be sent through this interface from
+     * within the driver functions called by this function.
+     * 
+     * @return Success if all frames were sent (or the queue was empty), otherwise
+     *         the first error reported by the driver.
+     */
+    IpErr flushTxQueue ()
+    {
+        std::size_t count = m_tx_queue_count;
+        if (count == 0) {
+            return IpErr::Success;
+        }
+        
+        IpErr err = IpErr::Success;
+        if (m_params.send_frames) {
+            err = m_params.send_frames(m_tx_queue_frames, count);
+        } else {
+            for (std::size_t i = 0; i < count; i++) {
+                IpErr frame_err = m_params.send_frame(m_tx_queue_frames[i]);
+                if (err == IpErr::Success) {
+                    err = frame_err;
+                }
+            }
+        }
+        
+        AIPSTACK_ASSERT(m_tx_queue_count == count);
+        m_tx_queue_count = 0;
+        
+        return err;
+    }
+    
     /**
      * Notify that the driver-provided state may have changed.
      * 
@@ -430,7 +601,7 @@ private:
         eth_header.set(EthHeader::EthType(), EthType::Ipv4);
         
         // Send the frame via the lower-layer driver.
-        return m_params.send_frame(frame);
+        return send_frame(frame);
     }
     
     IpIfaceDriverState driverGetState ()
@@ -470,6 +641,42 @@ private:
     {
         return m_timer.platform();
     }
+    
+    IpErr send_frame (IpBufRef frame)
+    {
+        // Without a transmit queue, pass the frame to the driver immediately.
+        if (TxQueueSize == 0 || m_params.tx_queue_buffer == nullptr) {
+            return m_params.send_frame(frame);
+        }
+        
+        // If the queue is full, flush it now to make space. If the driver could not
+        // send everything, report the error for this frame instead of queuing it.
+        if (m_tx_queue_count == std::size_t(TxQueueSize)) {
+            IpErr flush_err = flushTxQueue();
+            if (flush_err != IpErr::Success) {
+                return flush_err;
+            }
+        }
+        
+        // Request a flush when adding the first frame.
+        if (m_tx_queue_count == 0) {
+            m_params.request_tx_flush();
+        }
+        
+        // Copy the frame into the next slot, keeping HeaderBeforeEth space before it.
+        std::size_t index = m_tx_queue_count;
+        char *slot = m_params.tx_queue_buffer +
+            index * (HeaderBeforeEth + m_params.eth_mtu);
+        
+        IpBufNode &node = m_tx_queue_nodes[index];
+        node = IpBufNode{slot, HeaderBeforeEth + frame.tot_len, nullptr};
+        ipBufTakeBytes(frame, frame.tot_len, slot + HeaderBeforeEth);
+        
+        m_tx_queue_frames[index] = IpBufRef{&node, HeaderBeforeEth, frame.tot_len};
+        m_tx_queue_count++;
+        
+        return IpErr::Success;
+    }
 
     void recvArpPacket (IpBufRef pkt)
     {
@@ -799,7 +1006,7 @@ private:
         arp_header.set(ArpIp4Header::DstProtoAddr(), dst_ipaddr);
         
         // Send the frame via the lower-layer driver.
-        return m_params.send_frame(frame_alloc.getBufRef());
+        return send_frame(frame_alloc.getBufRef());
     }
     
     // Set tne ARP entry timeout based on the entry state and attempts_left.
@@ -960,6 +1167,9 @@ private:
     TimeType m_timers_ref_time;
     EthHeader::Ref m_rx_eth_header;
     ArpEntry m_arp_entries[NumArpEntries];
+    std::size_t m_tx_queue_count;
+    IpBufNode m_tx_queue_nodes[TxQueueArraySize];
+    IpBufRef m_tx_queue_frames[TxQueueArraySize];
     
     struct ArpEntriesAccessor :
         public MemberAccessor<EthIpIface, ArpEntry[NumArpEntries],
@@ -1000,6 +1210,15 @@ struct EthIpIfaceOptions {
      */
     AIPSTACK_OPTION_DECL_VALUE(HeaderBeforeEth, std::size_t, 0)
     
+    /**
+     * Maximum number of frames in the deferred transmit queue.
+     * 
+     * If this is zero (the default), the transmit queue is not supported and
+     * @ref EthIfaceDriverParams::tx_queue_buffer is ignored. Note that even if this
+     * is nonzero, the queue is only used if the driver provides the memory for it.
+     */
+    AIPSTACK_OPTION_DECL_VALUE(TxQueueSize, int, 0)
+    
     /**
      * Data structure to use for ARP entry timers.
      * 
@@ -1035,6 +1254,7 @@ class EthIpIfaceService {
     AIPSTACK_OPTION_CONFIG_VALUE(EthIpIfaceOptions, NumArpEntries)
     AIPSTACK_OPTION_CONFIG_VALUE(EthIpIfaceOptions, ArpProtectCount)
     AIPSTACK_OPTION_CONFIG_VALUE(EthIpIfaceOptions, HeaderBeforeEth)
+    AIPSTACK_OPTION_CONFIG_VALUE(EthIpIfaceOptions, TxQueueSize)
     AIPSTACK_OPTION_CONFIG_TYPE(EthIpIfaceOptions, TimersStructureService)
     
 public:
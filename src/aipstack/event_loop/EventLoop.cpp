@@ -85,12 +85,16 @@ struct EventLoopPriv::TimerCompare {
 struct EventLoopPriv::AsyncSignalNodeAccessor : public MemberAccessor<
     AsyncSignalNode, AsyncSignalListNode, &AsyncSignalNode::m_list_node> {};
 
+struct EventLoopPriv::FlushHookNodeAccessor : public MemberAccessor<
+    FlushHookNode, FlushHookListNode, &FlushHookNode::m_list_node> {};
+
 EventLoopMembers::EventLoopMembers() :
     m_stop(false),
     m_recheck_async_signals(false),
     m_event_time(EventLoop::getTime()),
     m_num_timers(0),
-    m_num_async_signals(0)
+    m_num_async_signals(0),
+    m_num_flush_hooks(0)
     #if AIPSTACK_EVENT_LOOP_HAS_FD
     ,m_num_fd_notifiers(0)
     #endif
@@ -101,6 +105,7 @@ EventLoopMembers::EventLoopMembers() :
 {
     EventLoop::AsyncSignalList::initLonely(m_pending_async_list);
     EventLoop::AsyncSignalList::initLonely(m_dispatch_async_list);    
+    EventLoop::FlushHookList::initLonely(m_flush_hook_list);
 }
 
 EventLoop::EventLoop () :
@@ -115,6 +120,8 @@ EventLoop::~EventLoop ()
     AIPSTACK_ASSERT(m_num_async_signals == 0);
     AIPSTACK_ASSERT(AsyncSignalList::isLonely(m_pending_async_list));
     AIPSTACK_ASSERT(AsyncSignalList::isLonely(m_dispatch_async_list));
+    AIPSTACK_ASSERT(m_num_flush_hooks == 0);
+    AIPSTACK_ASSERT(FlushHookList::isLonely(m_flush_hook_list));
     #if AIPSTACK_EVENT_LOOP_HAS_FD
     AIPSTACK_ASSERT(m_num_fd_notifiers == 0);
     #endif
@@ -163,6 +170,10 @@ void EventLoop::run ()
             return;
         }
 
+        if (!dispatch_flush_hooks()) {
+            return;
+        }
+
         EventLoopTime wait_time = get_timers_wait_time();
 
         EventProvider::waitForEvents(wait_time);
@@ -280,6 +291,32 @@ bool EventLoop::dispatch_async_signals ()
     return true;
 }
 
+bool EventLoop::dispatch_flush_hooks ()
+{
+    // Dispatch hooks until none are scheduled, including any hooks scheduled by the
+    // handlers called here (note the list is circular).
+    while (true) {
+        FlushHookNode *node = FlushHookList::next(m_flush_hook_list);
+        if (node == &m_flush_hook_list) {
+            break;
+        }
+
+        EventLoopFlushHook &hook = *static_cast<EventLoopFlushHook *>(node);
+        AIPSTACK_ASSERT(&hook.m_loop == this);
+
+        FlushHookList::remove(hook);
+        FlushHookList::markRemoved(hook);
+
+        hook.m_handler();
+
+        if (AIPSTACK_UNLIKELY(m_stop)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 bool EventProviderBase::dispatchAsyncSignals ()
 {
     auto &event_loop = static_cast<EventLoop &>(*this);
@@ -622,6 +659,43 @@ void EventLoopAsyncSignal::reset ()
     }
 }
 
+EventLoopFlushHook::EventLoopFlushHook (EventLoop &loop, FlushHookHandler handler) :
+    m_loop(loop),
+    m_handler(handler)
+{
+    FlushHookList::markRemoved(*this);
+
+    m_loop.m_num_flush_hooks++;
+}
+
+EventLoopFlushHook::~EventLoopFlushHook ()
+{
+    unschedule();
+
+    AIPSTACK_ASSERT(m_loop.m_num_flush_hooks > 0);
+    m_loop.m_num_flush_hooks--;
+}
+
+bool EventLoopFlushHook::isScheduled () const
+{
+    return !FlushHookList::isRemoved(const_cast<EventLoopFlushHook &>(*this));
+}
+
+void EventLoopFlushHook::schedule ()
+{
+    if (FlushHookList::isRemoved(*this)) {
+        FlushHookList::initBefore(*this, m_loop.m_flush_hook_list);
+    }
+}
+
+void EventLoopFlushHook::unschedule ()
+{
+    if (!FlushHookList::isRemoved(*this)) {
+        FlushHookList::remove(*this);
+        FlushHookList::markRemoved(*this);
+    }
+}
+
 }
 
 #include AIPSTACK_EVENT_PROVIDER_IMPL_FILE
@@ -64,6 +64,7 @@ struct EventLoopMembers;
 class EventLoop;
 class EventLoopTimer;
 class EventLoopAsyncSignal;
+class EventLoopFlushHook;
 #if AIPSTACK_EVENT_LOOP_HAS_FD
 class EventLoopFdWatcher;
 #endif
@@ -96,6 +97,18 @@ class EventLoopPriv {
         AsyncSignalListNode m_list_node;
     };
 
+    struct FlushHookNode;
+    struct FlushHookNodeAccessor;
+
+    using FlushHookLinkModel = PointerLinkModel<FlushHookNode>;
+    using FlushHookList = CircularLinkedList<
+        FlushHookNodeAccessor, FlushHookLinkModel>;
+    using FlushHookListNode = LinkedListNode<FlushHookLinkModel>;
+
+    struct FlushHookNode {
+        FlushHookListNode m_list_node;
+    };
+
     #if AIPSTACK_EVENT_LOOP_HAS_IOCP
     struct IocpResource {
         // The overlapped must be the first field so that we can easily convert
@@ -120,8 +133,10 @@ struct EventLoopMembers {
     std::mutex m_async_signal_mutex;
     EventLoopPriv::AsyncSignalNode m_pending_async_list;
     EventLoopPriv::AsyncSignalNode m_dispatch_async_list;
+    EventLoopPriv::FlushHookNode m_flush_hook_list;
     std::size_t m_num_timers;
     std::size_t m_num_async_signals;
+    std::size_t m_num_flush_hooks;
     #if AIPSTACK_EVENT_LOOP_HAS_FD
     std::size_t m_num_fd_notifiers;
     #endif
@@ -162,6 +177,7 @@ class EventLoop :
     friend struct EventLoopMembers;
     friend class EventLoopTimer;
     friend class EventLoopAsyncSignal;
+    friend class EventLoopFlushHook;
     #if AIPSTACK_EVENT_LOOP_HAS_FD
     friend class EventLoopFdWatcher;
     friend class EventProviderFdBase;
@@ -183,6 +199,8 @@ class EventLoop :
 
     AIPSTACK_USE_TYPES(EventLoopPriv, (AsyncSignalNode, AsyncSignalList))
 
+    AIPSTACK_USE_TYPES(EventLoopPriv, (FlushHookNode, FlushHookList))
+
     #if AIPSTACK_EVENT_LOOP_HAS_IOCP
     AIPSTACK_USE_TYPES(EventLoopPriv, (IocpResource))
     #endif
@@ -203,7 +221,7 @@ public:
      * @warning The event loop must not be destructed from within the @ref run function
      * (that is from within event handlers) and not while any object exists which uses
      * this event loop (e.g. @ref EventLoopTimer, @ref EventLoopAsyncSignal, @ref
-     * EventLoopFdWatcher, @ref EventLoopIocpNotifier).
+     * EventLoopFlushHook, @ref EventLoopFdWatcher, @ref EventLoopIocpNotifier).
      * 
      * @note On Windows, destruction involves waiting for the completion of any pending
      * asynchronous I/O operations that had been abandoned by @ref EventLoopIocpNotifier
@@ -298,6 +316,8 @@ private:
 
     bool dispatch_async_signals ();
 
+    bool dispatch_flush_hooks ();
+
     #if AIPSTACK_EVENT_LOOP_HAS_IOCP
     bool handle_iocp_result (void *completion_key, OVERLAPPED *overlapped);
 
@@ -502,6 +522,82 @@ private:
     SignalEventHandler m_handler;
 };
 
+/**
+ * Invokes a callback at the end of the current event loop iteration.
+ * 
+ * A flush hook allows work generated by multiple event handlers to be collected and
+ * then processed at once, just before the event loop waits for new events. A typical
+ * use is a network driver which queues frames during the processing of a batch of
+ * events and sends them all together.
+ * 
+ * After @ref schedule is called, the @ref FlushHookHandler callback will be called
+ * once, after the event handlers for the events which are currently being dispatched
+ * have been called but before the event loop waits for more events. Callbacks of
+ * hooks scheduled from within a @ref FlushHookHandler are also called before waiting.
+ * 
+ * The @ref EventLoopFlushHook class does not throw exceptions from any of its public
+ * functions including the constructor.
+ */
+class EventLoopFlushHook :
+    private NonCopyable<EventLoopFlushHook>
+    #ifndef IN_DOXYGEN
+    ,private EventLoop::FlushHookNode
+    #endif
+{
+    friend class EventLoop;
+
+    AIPSTACK_USE_TYPES(EventLoop, (FlushHookList))
+
+public:
+    /**
+     * Type of callback function called at the end of the event loop iteration.
+     * 
+     * The callback is always called asynchronously (not from any public member function)
+     * and the hook is no longer scheduled when it is called.
+     */
+    using FlushHookHandler = Function<void()>;
+
+    /**
+     * Construct the flush hook; it is initially not scheduled.
+     * 
+     * @param loop Event loop; it must outlive the flush hook object.
+     * @param handler Callback function (must not be null).
+     */
+    EventLoopFlushHook (EventLoop &loop, FlushHookHandler handler);
+
+    /**
+     * Destruct the flush hook.
+     * 
+     * The @ref FlushHookHandler callback will not be called after destruction.
+     */
+    ~EventLoopFlushHook ();
+
+    /**
+     * Check if the flush hook is scheduled.
+     * 
+     * @return True if scheduled, false if not.
+     */
+    bool isScheduled () const;
+
+    /**
+     * Schedule the @ref FlushHookHandler to be called at the end of the current event
+     * loop iteration.
+     * 
+     * If the hook is already scheduled, this has no effect.
+     */
+    void schedule ();
+
+    /**
+     * Unschedule the flush hook so that the @ref FlushHookHandler will not be called
+     * until the next @ref schedule call.
+     */
+    void unschedule ();
+
+private:
+    EventLoop &m_loop;
+    FlushHookHandler m_handler;
+};
+
 #if AIPSTACK_EVENT_LOOP_HAS_FD || defined(IN_DOXYGEN)
 
 #ifndef IN_DOXYGEN
@@ -201,6 +201,9 @@ inline IpBufRef ipBufSkipBytes (IpBufRef buf, std::size_t skipLen)
  * 
  * This moves to subsequent buffers eagerly (see @ref ipBufProcessBytes).
  * 
+ * See @ref ipBufTakeBytesChksum (in Chksum.h) for a variant which also calculates
+ * the checksum of the copied bytes.
+ * 
  * @param buf Buffer to start with.
  * @param takeLen Number of bytes to copy out and consume. Must be less than
  *        or equal to `buf.tot_len`.
@@ -223,6 +226,9 @@ inline IpBufRef ipBufTakeBytes (IpBufRef buf, std::size_t takeLen, char *dst)
  * 
  * This moves to subsequent buffers eagerly (see @ref ipBufProcessBytes).
  * 
+ * See @ref ipBufGiveBytesChksum (in Chksum.h) for a variant which also calculates
+ * the checksum of the copied bytes.
+ * 
  * @param buf Buffer to start with.
  * @param data Reference to bytes to copy in (as @ref MemRef). `data.len` must be less
  *        than or equal to `buf.tot_len`. `data.ptr` may be null if `data.len` is zero.
@@ -248,6 +254,9 @@ inline IpBufRef ipBufGiveBytes (IpBufRef buf, MemRef data)
  * 
  * This moves to subsequent buffers eagerly (see @ref ipBufProcessBytes).
  * 
+ * See @ref ipBufGiveBufChksum (in Chksum.h) for a variant which also calculates
+ * the checksum of the copied bytes.
+ * 
  * @param buf Buffer to start with.
  * @param src Memory range to copy in. `src.tot_len` must be less than
  *        or equal to `buf.tot_len` of this memory range.
@@ -398,6 +407,52 @@ inline bool ipBufStartsWith (IpBufRef buf, MemRef prefix, IpBufRef &remBuf)
     return true;
 }
 
+/**
+ * Describe the chunks of a memory range as an array of scatter/gather elements
+ * without copying any data.
+ * 
+ * For each nonempty contiguous chunk of the memory range (in order), one element
+ * of `iov` is filled in, with `iov_base` pointing to the start of the chunk and
+ * `iov_len` being the length of the chunk. The element type is a template
+ * parameter so that this can be used with `struct iovec` (for `writev` and
+ * `sendmsg`) without making this header platform-specific.
+ * 
+ * If the memory range consists of more than `maxIov` nonempty chunks, false is
+ * returned and the elements are filled in only for the first `maxIov` chunks. The
+ * caller would typically fall back to copying the data in that case.
+ * 
+ * @tparam IovecType Type of array elements; must have members `iov_base`
+ *         (assignable from `char *`) and `iov_len` (assignable from `size_t`).
+ * @param buf Memory range to describe.
+ * @param iov Array of elements to fill in. May be null only if `maxIov` is zero.
+ * @param maxIov Number of elements available in `iov`.
+ * @param outNumIov Set to the number of elements filled in.
+ * @return True if all of the memory range is described by the elements filled in,
+ *         false if more than `maxIov` elements would be needed.
+ */
+template<typename IovecType>
+bool ipBufToIovec (IpBufRef buf, IovecType *iov, std::size_t maxIov,
+                   std::size_t &outNumIov)
+{
+    std::size_t numIov = 0;
+    bool complete = true;
+
+    ipBufProcessBytes(buf, buf.tot_len, makeTypedFunction(
+        [&](char *chunkData, std::size_t chunkLen) -> std::size_t {
+            if (numIov == maxIov) {
+                complete = false;
+                return 0;
+            }
+            iov[numIov].iov_base = chunkData;
+            iov[numIov].iov_len = chunkLen;
+            numIov++;
+            return chunkLen;
+        }));
+
+    outNumIov = numIov;
+    return complete;
+}
+
 /**
  * Return a sub-range of the buffer reference from the given offset of the given
  * length.
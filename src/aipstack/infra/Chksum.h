@@ -27,12 +27,14 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
 
 #include <aipstack/meta/BasicMetaUtils.h>
 #include <aipstack/misc/Assert.h>
 #include <aipstack/misc/Hints.h>
 #include <aipstack/misc/MinMax.h>
 #include <aipstack/misc/EnumUtils.h>
+#include <aipstack/misc/MemRef.h>
 #include <aipstack/misc/TypedFunction.h>
 #include <aipstack/infra/Buf.h>
 #include <aipstack/infra/BufUtils.h>
@@ -47,10 +49,208 @@
  * function, for which an optimized implementation can be provided.
  */
 
+#if !defined(AIPSTACK_EXTERNAL_CHKSUM) && !defined(AIPSTACK_CONFIG_NO_SIMD_CHKSUM) && \
+    (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define AIPSTACK_CHKSUM_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define AIPSTACK_CHKSUM_X86_SIMD 0
+#endif
+
 #if defined(AIPSTACK_EXTERNAL_CHKSUM)
 extern "C" std::uint16_t IpChksumInverted (char const *data, std::size_t len);
 #else
 
+namespace AIpStack {
+
+/**
+ * @addtogroup checksum
+ * @{
+ */
+
+/**
+ * Portable implementation of @ref IpChksumInverted.
+ * 
+ * This sums one 16-bit word per iteration and works on any architecture. It is used
+ * by @ref IpChksumInverted when no optimized implementation is available, and is
+ * exposed so that optimized implementations can be checked against it.
+ * 
+ * @param data Pointer to data (must not be null).
+ * @param len Number of bytes (may be zero).
+ * @return Inverted IP checksum (ones-complement sum of 16-bit words).
+ */
+inline std::uint16_t IpChksumInvertedScalar (char const *data, std::size_t len)
+{
+    char const *even_end = data + (len & std::size_t(-2));
+    std::uint32_t sum = 0;
+    
+    while (data < even_end) {
+        sum += ReadSingleField<std::uint16_t>(data);
+        data += 2;
+    }
+    
+    if ((len & 1) != 0) {
+        std::uint8_t byte = ReadSingleField<std::uint8_t>(data);
+        sum += std::uint32_t(std::uint16_t(byte) << 8);
+    }
+    
+    sum = (sum & std::uint32_t(0xFFFF)) + (sum >> 16);
+    sum = (sum & std::uint32_t(0xFFFF)) + (sum >> 16);
+    
+    return std::uint16_t(sum);
+}
+
+#if AIPSTACK_CHKSUM_X86_SIMD || defined(IN_DOXYGEN)
+
+#ifndef IN_DOXYGEN
+namespace ChksumPrivate {
+    // Each vector iteration adds at most 0xFFFF to each 32-bit lane of each of the
+    // two accumulators, so this many iterations can be done before the lanes must
+    // be folded into the 64-bit sum.
+    inline constexpr std::size_t MaxVectorItersPerFold = std::size_t(1) << 16;
+    
+    // Complete the calculation given the sum of little-endian 16-bit words of the
+    // vectorized part and the remaining tail bytes. The ones-complement sum of
+    // byte-swapped words is the byte-swapped sum (RFC 1071), so one swap at the end
+    // yields the big-endian result. The tail starts at an even offset and is added
+    // using the scalar implementation.
+    inline std::uint16_t finishSimd (
+        std::uint64_t le_sum, char const *tail, std::size_t tail_len)
+    {
+        while ((le_sum >> 16) != 0) {
+            le_sum = (le_sum & 0xFFFF) + (le_sum >> 16);
+        }
+        
+        std::uint32_t sum = std::uint16_t((le_sum >> 8) | (le_sum << 8));
+        sum += IpChksumInvertedScalar(tail, tail_len);
+        sum = (sum & std::uint32_t(0xFFFF)) + (sum >> 16);
+        
+        return std::uint16_t(sum);
+    }
+}
+#endif
+
+/**
+ * SSE2 implementation of @ref IpChksumInverted (only available on x86).
+ * 
+ * The even and odd 16-bit words of each 16-byte block are accumulated into separate
+ * vectors of 32-bit lanes, and carries are only folded after a large number of
+ * blocks. The caller must ensure that the CPU supports SSE2.
+ * 
+ * @param data Pointer to data (must not be null).
+ * @param len Number of bytes (may be zero).
+ * @return Inverted IP checksum (ones-complement sum of 16-bit words).
+ */
+__attribute__((target("sse2")))
+inline std::uint16_t IpChksumInvertedSse2 (char const *data, std::size_t len)
+{
+    constexpr std::size_t VecSize = 16;
+    
+    __m128i const low_mask = _mm_set1_epi32(0xFFFF);
+    std::uint64_t le_sum = 0;
+    
+    while (len >= VecSize) {
+        std::size_t iters = MinValue(len / VecSize, ChksumPrivate::MaxVectorItersPerFold);
+        len -= iters * VecSize;
+        
+        __m128i acc_low = _mm_setzero_si128();
+        __m128i acc_high = _mm_setzero_si128();
+        
+        for (; iters > 0; iters--) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data));
+            acc_low = _mm_add_epi32(acc_low, _mm_and_si128(v, low_mask));
+            acc_high = _mm_add_epi32(acc_high, _mm_srli_epi32(v, 16));
+            data += VecSize;
+        }
+        
+        alignas(16) std::uint32_t lanes[8];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc_low);
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes + 4), acc_high);
+        for (std::uint32_t lane : lanes) {
+            le_sum += lane;
+        }
+    }
+    
+    return ChksumPrivate::finishSimd(le_sum, data, len);
+}
+
+/**
+ * AVX2 implementation of @ref IpChksumInverted (only available on x86).
+ * 
+ * This works like @ref IpChksumInvertedSse2 but with 32-byte vectors. The caller
+ * must ensure that the CPU supports AVX2.
+ * 
+ * @param data Pointer to data (must not be null).
+ * @param len Number of bytes (may be zero).
+ * @return Inverted IP checksum (ones-complement sum of 16-bit words).
+ */
+__attribute__((target("avx2")))
+inline std::uint16_t IpChksumInvertedAvx2 (char const *data, std::size_t len)
+{
+    constexpr std::size_t VecSize = 32;
+    
+    __m256i const low_mask = _mm256_set1_epi32(0xFFFF);
+    std::uint64_t le_sum = 0;
+    
+    while (len >= VecSize) {
+        std::size_t iters = MinValue(len / VecSize, ChksumPrivate::MaxVectorItersPerFold);
+        len -= iters * VecSize;
+        
+        __m256i acc_low = _mm256_setzero_si256();
+        __m256i acc_high = _mm256_setzero_si256();
+        
+        for (; iters > 0; iters--) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data));
+            acc_low = _mm256_add_epi32(acc_low, _mm256_and_si256(v, low_mask));
+            acc_high = _mm256_add_epi32(acc_high, _mm256_srli_epi32(v, 16));
+            data += VecSize;
+        }
+        
+        alignas(32) std::uint32_t lanes[16];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc_low);
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes + 8), acc_high);
+        for (std::uint32_t lane : lanes) {
+            le_sum += lane;
+        }
+    }
+    
+    return ChksumPrivate::finishSimd(le_sum, data, len);
+}
+
+#endif
+
+/**
+ * Type of a function pointer to an implementation of @ref IpChksumInverted.
+ */
+using IpChksumFunc = std::uint16_t (*) (char const *data, std::size_t len);
+
+/**
+ * Select the best implementation of @ref IpChksumInverted for the running CPU.
+ * 
+ * On x86 this checks the CPU features (cpuid) and returns @ref IpChksumInvertedAvx2
+ * or @ref IpChksumInvertedSse2 if supported. Otherwise, or if the macro
+ * `AIPSTACK_CONFIG_NO_SIMD_CHKSUM` is defined, it returns @ref IpChksumInvertedScalar.
+ * 
+ * @return Pointer to the selected implementation.
+ */
+inline IpChksumFunc IpChksumSelectImpl ()
+{
+#if AIPSTACK_CHKSUM_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return &IpChksumInvertedAvx2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return &IpChksumInvertedSse2;
+    }
+#endif
+    return &IpChksumInvertedScalar;
+}
+
+/** @} */
+
+}
+
 /**
  * @ingroup checksum
  * Calculate the inverted IP checksum of a buffer.
@@ -65,6 +265,10 @@ extern "C" std::uint16_t IpChksumInverted (char const *data, std::size_t len);
  * If the number of bytes is odd, this is treated as if there was an extra
  * zero byte at the end.
  * 
+ * On x86 the implementation is chosen at the first call using
+ * @ref AIpStack::IpChksumSelectImpl "IpChksumSelectImpl" (SSE2 or AVX2 if supported).
+ * Elsewhere, @ref AIpStack::IpChksumInvertedScalar "IpChksumInvertedScalar" is used.
+ * 
  * If the macro `AIPSTACK_EXTERNAL_CHKSUM` is defined, then only an `extern "C"`
  * function declaration is provided by the header file Chksum.h and the implementation
  * must be provided by the application.
@@ -77,31 +281,22 @@ extern "C" std::uint16_t IpChksumInverted (char const *data, std::size_t len);
 AIPSTACK_NO_INLINE
 inline std::uint16_t IpChksumInverted (char const *data, std::size_t len)
 {
-    using namespace AIpStack;
-    
-    char const *even_end = data + (len & std::size_t(-2));
-    std::uint32_t sum = 0;
-    
-    while (data < even_end) {
-        sum += ReadSingleField<std::uint16_t>(data);
-        data += 2;
-    }
-    
-    if ((len & 1) != 0) {
-        std::uint8_t byte = ReadSingleField<std::uint8_t>(data);
-        sum += std::uint32_t(std::uint16_t(byte) << 8);
-    }
-    
-    sum = (sum & std::uint32_t(0xFFFF)) + (sum >> 16);
-    sum = (sum & std::uint32_t(0xFFFF)) + (sum >> 16);
-    
-    return std::uint16_t(sum);
+#if AIPSTACK_CHKSUM_X86_SIMD
+    static AIpStack::IpChksumFunc const impl = AIpStack::IpChksumSelectImpl();
+    return impl(data, len);
+#else
+    return AIpStack::IpChksumInvertedScalar(data, len);
+#endif
 }
 
 #endif
 
 namespace AIpStack {
 
+#ifndef IN_DOXYGEN
+class IpChksumBlockCache;
+#endif
+
 /**
  * @addtogroup checksum
  * @{
@@ -144,6 +339,15 @@ inline std::uint16_t IpChksum (char const *data, std::size_t len)
  * It is possible to export the state of the calculation by calling @ref getState and
  * later resume the calculation with a new object constructed using
  * @ref IpChksumAccumulator(State)
+ * 
+ * Data can also be added while it is being copied, using @ref ipBufTakeBytesChksum,
+ * @ref ipBufGiveBytesChksum or @ref ipBufGiveBufChksum in place of step 3, followed
+ * by @ref getChksum().
+ * 
+ * An existing checksum can be updated after some fields covered by it have changed,
+ * without summing the unchanged data again (RFC 1624). For this, an object is created
+ * using @ref fromChksum, the changed fields are updated using @ref replaceWord, and
+ * the updated checksum is obtained using @ref getChksum().
  */
 class IpChksumAccumulator {
 private:
@@ -173,6 +377,24 @@ public:
     {
     }
     
+    /**
+     * Construct an object to incrementally update an existing checksum.
+     * 
+     * Words that have changed should then be updated using @ref replaceWord, then
+     * @ref getChksum() will return the updated checksum. This implements equation 3
+     * from RFC 1624.
+     * 
+     * It is also permissible to use @ref addWord and similar functions to include
+     * additional data in the checksum.
+     * 
+     * @param chksum The existing checksum (as found in a protocol header).
+     * @return An object whose state corresponds to the existing checksum.
+     */
+    inline static IpChksumAccumulator fromChksum (std::uint16_t chksum)
+    {
+        return IpChksumAccumulator(State(std::uint16_t(~chksum)));
+    }
+    
     /**
      * Export the state of the calculation for resuming later.
      * 
@@ -216,6 +438,39 @@ public:
         addWord(WrapType<std::uint16_t>(), std::uint16_t(word));
     }
     
+    /**
+     * Replace a 16-bit word which was previously included in the checksum.
+     * 
+     * This removes the old word from the checksum and adds the new word. It is
+     * intended to be used after @ref fromChksum.
+     * 
+     * @param old_word The word which was included in the checksum.
+     * @param new_word The word which replaces it.
+     */
+    inline void replaceWord (WrapType<std::uint16_t>,
+                             std::uint16_t old_word, std::uint16_t new_word)
+    {
+        addWord(WrapType<std::uint16_t>(), std::uint16_t(~old_word));
+        addWord(WrapType<std::uint16_t>(), new_word);
+    }
+    
+    /**
+     * Replace a 32-bit word which was previously included in the checksum.
+     * 
+     * See @ref replaceWord(WrapType<std::uint16_t>, std::uint16_t, std::uint16_t).
+     * 
+     * @param old_word The word which was included in the checksum.
+     * @param new_word The word which replaces it.
+     */
+    inline void replaceWord (WrapType<std::uint32_t>,
+                             std::uint32_t old_word, std::uint32_t new_word)
+    {
+        replaceWord(WrapType<std::uint16_t>(),
+                    std::uint16_t(old_word >> 16), std::uint16_t(new_word >> 16));
+        replaceWord(WrapType<std::uint16_t>(),
+                    std::uint16_t(old_word), std::uint16_t(new_word));
+    }
+    
     /**
      * Add an even number of contiguous bytes.
      * 
@@ -280,15 +535,25 @@ private:
                ((x << 8) & std::uint32_t(0xFF00FF00));
     }
     
-    void addIpBuf (IpBufRef buf)
+    inline void addIpBuf (IpBufRef buf)
+    {
+        processIpBuf(buf, buf.tot_len, [](char *dataPtr, std::size_t dataLen) {
+            return IpChksumInverted(dataPtr, dataLen);
+        });
+    }
+    
+    // Consume bytes from buf, passing each contiguous chunk to chunkFunc which
+    // returns the inverted checksum of the chunk, and add these to the sum.
+    template<typename ChunkFunc>
+    IpBufRef processIpBuf (IpBufRef buf, std::size_t len, ChunkFunc chunkFunc)
     {
         bool swapped = false;
 
-        ipBufProcessBytes(buf, buf.tot_len, makeTypedFunction(
+        buf = ipBufProcessBytes(buf, len, makeTypedFunction(
             [&](char *dataPtr, std::size_t dataLen)
         {
             // Calculate sum of buffer.
-            std::uint16_t buf_sum = IpChksumInverted(dataPtr, dataLen);
+            std::uint16_t buf_sum = chunkFunc(dataPtr, dataLen);
             
             // Add the buffer sum to our sum.
             std::uint32_t old_sum = m_sum;
@@ -312,9 +577,145 @@ private:
         if (swapped) {
             m_sum = swapBytes(m_sum);
         }
+        
+        return buf;
+    }
+    
+    // Copy len bytes from src to dst and return the inverted checksum of the bytes.
+    // This works in blocks small enough that the checksum reads the just-written
+    // destination from the cache, so the source memory is only read once.
+    static std::uint16_t copyChunkChksum (char *dst, char const *src, std::size_t len)
+    {
+        constexpr std::size_t BlockSize = 1024;
+        static_assert(BlockSize % 2 == 0);
+        
+        std::uint32_t sum = 0;
+        while (len > 0) {
+            std::size_t block_len = MinValue(len, BlockSize);
+            std::memcpy(dst, src, block_len);
+            sum += IpChksumInverted(dst, block_len);
+            dst += block_len;
+            src += block_len;
+            len -= block_len;
+        }
+        
+        sum = (sum & TypeMax<std::uint16_t>) + (sum >> 16);
+        sum = (sum & TypeMax<std::uint16_t>) + (sum >> 16);
+        return std::uint16_t(sum);
     }
+    
+    friend IpBufRef ipBufTakeBytesChksum (
+        IpBufRef buf, std::size_t takeLen, char *dst, IpChksumAccumulator &chksum);
+    
+    friend IpBufRef ipBufGiveBytesChksum (
+        IpBufRef buf, MemRef data, IpChksumAccumulator &chksum);
+    
+    friend IpBufRef ipBufGiveBufChksum (
+        IpBufRef buf, IpBufRef src, IpChksumAccumulator &chksum);
+    
+    friend class IpChksumBlockCache;
 };
 
+/**
+ * Consume a number of bytes from the front of the memory range while copying them to
+ * the given memory location and adding them to a running checksum.
+ * 
+ * This is equivalent to @ref ipBufTakeBytes except that the copied bytes are also
+ * added to `chksum`, as if by @ref IpChksumAccumulator::getChksum(IpBufRef) but
+ * without completing the checksum. The data is read only once.
+ * 
+ * The bytes are added as if they started at an even offset in the checksummed data.
+ * If `takeLen` is odd, the only permitted further operation on `chksum` is
+ * @ref IpChksumAccumulator::getChksum().
+ * 
+ * This moves to subsequent buffers eagerly (see @ref ipBufProcessBytes).
+ * 
+ * @param buf Buffer to start with.
+ * @param takeLen Number of bytes to copy out and consume. Must be less than
+ *        or equal to `buf.tot_len`.
+ * @param dst Location to copy to. May be null only if `takeLen` is zero.
+ * @param chksum Checksum accumulator to add the bytes to.
+ * @return Updated buffer after processing.
+ */
+inline IpBufRef ipBufTakeBytesChksum (
+    IpBufRef buf, std::size_t takeLen, char *dst, IpChksumAccumulator &chksum)
+{
+    return chksum.processIpBuf(buf, takeLen, [&](char *chunkData, std::size_t chunkLen) {
+        std::uint16_t chunk_sum =
+            IpChksumAccumulator::copyChunkChksum(dst, chunkData, chunkLen);
+        dst += chunkLen;
+        return chunk_sum;
+    });
+}
+
+/**
+ * Consume a number of bytes from the front of the memory range while copying bytes
+ * from the given memory location into the consumed part of the range and adding them
+ * to a running checksum.
+ * 
+ * This is equivalent to @ref ipBufGiveBytes except that the copied bytes are also
+ * added to `chksum` (see @ref ipBufTakeBytesChksum for the considerations).
+ * 
+ * This moves to subsequent buffers eagerly (see @ref ipBufProcessBytes).
+ * 
+ * @param buf Buffer to start with.
+ * @param data Reference to bytes to copy in (as @ref MemRef). `data.len` must be less
+ *        than or equal to `buf.tot_len`. `data.ptr` may be null if `data.len` is zero.
+ * @param chksum Checksum accumulator to add the bytes to.
+ * @return Updated buffer after processing.
+ */
+inline IpBufRef ipBufGiveBytesChksum (IpBufRef buf, MemRef data, IpChksumAccumulator &chksum)
+{
+    char const *src = data.ptr;
+    return chksum.processIpBuf(buf, data.len, [&](char *chunkData, std::size_t chunkLen) {
+        std::uint16_t chunk_sum =
+            IpChksumAccumulator::copyChunkChksum(chunkData, src, chunkLen);
+        src += chunkLen;
+        return chunk_sum;
+    });
+}
+
+/**
+ * Consume a number of bytes from the front of the memory range while copying bytes
+ * from another memory range into the consumed part of the range and adding them to a
+ * running checksum.
+ * 
+ * This is equivalent to @ref ipBufGiveBuf except that the copied bytes are also
+ * added to `chksum` (see @ref ipBufTakeBytesChksum for the considerations).
+ * 
+ * This moves to subsequent buffers eagerly (see @ref ipBufProcessBytes).
+ * 
+ * @param buf Buffer to start with.
+ * @param src Memory range to copy in. `src.tot_len` must be less than
+ *        or equal to `buf.tot_len` of this memory range.
+ * @param chksum Checksum accumulator to add the bytes to.
+ * @return Updated buffer after processing.
+ */
+inline IpBufRef ipBufGiveBufChksum (IpBufRef buf, IpBufRef src, IpChksumAccumulator &chksum)
+{
+    // The destination chunks split the data at arbitrary positions, which the
+    // accumulator handles like the chunks of an IpBufRef.
+    return chksum.processIpBuf(buf, src.tot_len, [&](char *chunkData, std::size_t chunkLen) {
+        std::uint32_t chunk_sum = 0;
+        bool swapped = false;
+        src = ipBufProcessBytes(src, chunkLen, makeTypedFunction(
+            [&](char *srcData, std::size_t srcLen)
+        {
+            std::uint16_t part_sum =
+                IpChksumAccumulator::copyChunkChksum(chunkData, srcData, srcLen);
+            chunkData += srcLen;
+            chunk_sum += swapped ? std::uint16_t((part_sum >> 8) | (part_sum << 8)) : part_sum;
+            if (srcLen % 2 != 0) {
+                swapped = !swapped;
+            }
+            return srcLen;
+        }));
+        chunk_sum = (chunk_sum & TypeMax<std::uint16_t>) + (chunk_sum >> 16);
+        chunk_sum = (chunk_sum & TypeMax<std::uint16_t>) + (chunk_sum >> 16);
+        return std::uint16_t(chunk_sum);
+    });
+}
+
 /**
  * Calculate the IP checksum of a sequence of bytes described by @ref IpBufRef.
  * 
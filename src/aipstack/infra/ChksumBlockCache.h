@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2016 Ambroz Bizjak
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AIPSTACK_CHKSUM_BLOCK_CACHE_H
+#define AIPSTACK_CHKSUM_BLOCK_CACHE_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/misc/MinMax.h>
+#include <aipstack/misc/NonCopyable.h>
+#include <aipstack/infra/Buf.h>
+#include <aipstack/infra/Chksum.h>
+
+namespace AIpStack {
+
+/**
+ * @addtogroup checksum
+ * @{
+ */
+
+/**
+ * Caches partial checksums of fixed-size blocks of a circular buffer.
+ * 
+ * This is intended for buffers of outgoing data which may need to be checksummed
+ * multiple times, such as a TCP send buffer where data is retransmitted. The
+ * checksum of a block is calculated when it is first needed and reused afterwards,
+ * until the block is invalidated using @ref invalidate.
+ * 
+ * The buffer must consist of a single @ref IpBufNode whose `next` points to itself
+ * (as set up by @ref SendRingBuffer). The user is responsible for calling @ref
+ * invalidate for any range of the buffer that is written to. A block checksum is only
+ * calculated (and cached) when the entire block is contained in the data being
+ * checksummed, so it is sufficient to invalidate ranges when data is made available
+ * for checksumming (e.g. when it is added to the TCP send buffer).
+ * 
+ * The memory for cache entries is provided by the user and must hold at least
+ * @ref numEntriesForSize(buffer_size) entries.
+ */
+class IpChksumBlockCache :
+    private NonCopyable<IpChksumBlockCache>
+{
+public:
+    /**
+     * Size of blocks whose checksums are cached.
+     * 
+     * At most two partial blocks per checksummed range (the head and the tail) are
+     * summed directly, which should be small compared to the TCP MSS.
+     */
+    inline static constexpr std::size_t BlockSize = 64;
+    
+    static_assert(BlockSize % 2 == 0);
+    
+    /**
+     * Data type of cache entries.
+     */
+    using Entry = std::uint32_t;
+    
+    /**
+     * Return the number of cache entries needed for a buffer of the given size.
+     * 
+     * @param buf_size Size of the buffer in bytes.
+     * @return Number of entries needed.
+     */
+    inline static constexpr std::size_t numEntriesForSize (std::size_t buf_size)
+    {
+        return buf_size / BlockSize;
+    }
+    
+    /**
+     * Construct the cache with user-provided storage.
+     * 
+     * The cache is not usable until @ref reset is called.
+     * 
+     * @param entries Pointer to storage for entries (must not be null if
+     *        `num_entries` is nonzero).
+     * @param num_entries Number of entries available in the storage.
+     */
+    inline IpChksumBlockCache (Entry *entries, std::size_t num_entries) :
+        m_node(nullptr),
+        m_entries(entries),
+        m_num_entries(num_entries),
+        m_num_blocks(0)
+    {}
+    
+    /**
+     * Associate the cache with a circular buffer and invalidate all entries.
+     * 
+     * @param node The single node of the circular buffer. Its `next` must point to
+     *        itself and its `len` must be such that @ref numEntriesForSize(len) does
+     *        not exceed the number of entries given in the constructor.
+     */
+    void reset (IpBufNode const *node)
+    {
+        AIPSTACK_ASSERT(node != nullptr);
+        AIPSTACK_ASSERT(node->next == node);
+        AIPSTACK_ASSERT(numEntriesForSize(node->len) <= m_num_entries);
+        
+        m_node = node;
+        m_num_blocks = numEntriesForSize(node->len);
+        
+        for (std::size_t i = 0; i < m_num_blocks; i++) {
+            m_entries[i] = 0;
+        }
+    }
+    
+    /**
+     * Invalidate the cached checksums of blocks which overlap the given range.
+     * 
+     * @param offset Offset of the range in the buffer (less than the buffer size).
+     * @param len Length of the range, it may wrap around the end of the buffer.
+     */
+    void invalidate (std::size_t offset, std::size_t len)
+    {
+        AIPSTACK_ASSERT(m_node != nullptr);
+        AIPSTACK_ASSERT(offset < m_node->len);
+        
+        if (len == 0) {
+            return;
+        }
+        
+        if (len >= m_node->len) {
+            invalidateLinear(0, m_node->len);
+            return;
+        }
+        
+        std::size_t first_len = MinValue(len, std::size_t(m_node->len - offset));
+        invalidateLinear(offset, first_len);
+        if (first_len < len) {
+            invalidateLinear(0, len - first_len);
+        }
+    }
+    
+    /**
+     * Add data from the buffer using cached block checksums where possible, then
+     * complete and return the checksum.
+     * 
+     * This is equivalent to `chksum.getChksum(data)`, which it is intended to replace.
+     * 
+     * @param chksum Checksum accumulator with any header words added.
+     * @param data Data to add, which must be within the buffer associated using @ref
+     *        reset (`data.node` must be that node, if `data.tot_len` is nonzero).
+     * @return The calculated checksum.
+     */
+    std::uint16_t getChksum (IpChksumAccumulator &chksum, IpBufRef data)
+    {
+        if (data.tot_len > 0) {
+            AIPSTACK_ASSERT(data.node == m_node);
+            
+            chksum.processIpBuf(data, data.tot_len, [&](char *ptr, std::size_t len) {
+                return chunkChksum(ptr, len);
+            });
+        }
+        
+        return chksum.getChksum();
+    }
+    
+private:
+    inline static constexpr Entry ValidFlag = Entry(1) << 16;
+    
+    void invalidateLinear (std::size_t offset, std::size_t len)
+    {
+        std::size_t first_block = offset / BlockSize;
+        std::size_t end_block = MinValue(m_num_blocks, (offset + len - 1) / BlockSize + 1);
+        
+        for (std::size_t i = first_block; i < end_block; i++) {
+            m_entries[i] = 0;
+        }
+    }
+    
+    std::uint16_t blockChksum (std::size_t block)
+    {
+        Entry entry = m_entries[block];
+        if (AIPSTACK_UNLIKELY((entry & ValidFlag) == 0)) {
+            entry = ValidFlag | IpChksumInverted(m_node->ptr + block * BlockSize, BlockSize);
+            m_entries[block] = entry;
+        }
+        return std::uint16_t(entry);
+    }
+    
+    // Calculate the inverted checksum of a contiguous chunk of the buffer.
+    std::uint16_t chunkChksum (char *ptr, std::size_t len)
+    {
+        std::size_t pos = std::size_t(ptr - m_node->ptr);
+        std::size_t end = pos + len;
+        
+        // Find the first block starting within the chunk. If no block is entirely
+        // within the chunk, just sum the chunk.
+        std::size_t block = (pos + BlockSize - 1) / BlockSize;
+        std::size_t block_pos = block * BlockSize;
+        if (block_pos + BlockSize > end) {
+            return IpChksumInverted(ptr, len);
+        }
+        
+        // Blocks start at even offsets in the buffer, so their sums must be swapped
+        // if the chunk starts at an odd offset.
+        bool swap = pos % 2 != 0;
+        
+        // Sum the head before the first block.
+        std::uint64_t sum = IpChksumInverted(ptr, block_pos - pos);
+        
+        // Sum the blocks entirely within the chunk.
+        std::uint32_t blocks_sum = 0;
+        for (; block_pos + BlockSize <= end; block++, block_pos += BlockSize) {
+            blocks_sum += blockChksum(block);
+            blocks_sum = (blocks_sum & TypeMax<std::uint16_t>) + (blocks_sum >> 16);
+        }
+        
+        // Sum the tail after the last block.
+        blocks_sum += IpChksumInverted(m_node->ptr + block_pos, end - block_pos);
+        
+        blocks_sum = (blocks_sum & TypeMax<std::uint16_t>) + (blocks_sum >> 16);
+        sum += swap ? std::uint16_t((blocks_sum >> 8) | (blocks_sum << 8)) : blocks_sum;
+        
+        while ((sum >> 16) != 0) {
+            sum = (sum & TypeMax<std::uint16_t>) + (sum >> 16);
+        }
+        return std::uint16_t(sum);
+    }
+    
+private:
+    IpBufNode const *m_node;
+    Entry *m_entries;
+    std::size_t m_num_entries;
+    std::size_t m_num_blocks;
+};
+
+/** @} */
+
+}
+
+#endif
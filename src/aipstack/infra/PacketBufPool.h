@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2016 Ambroz Bizjak
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AIPSTACK_PACKET_BUF_POOL_H
+#define AIPSTACK_PACKET_BUF_POOL_H
+
+#include <cstddef>
+#include <functional>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/misc/NonCopyable.h>
+#include <aipstack/infra/Buf.h>
+
+namespace AIpStack {
+
+/**
+ * @addtogroup buffer
+ * @{
+ */
+
+#ifndef IN_DOXYGEN
+class IpPacketBufPool;
+#endif
+
+/**
+ * A reference-counted packet buffer belonging to an @ref IpPacketBufPool.
+ * 
+ * Each packet buffer has an @ref IpBufNode referencing its memory, so received
+ * packets stored in a packet buffer can be referenced using @ref IpBufRef as usual.
+ * Code which receives such an @ref IpBufRef can use @ref IpPacketBufPool::takeRef to
+ * keep the packet without copying it, as long as it knows the pool.
+ * 
+ * Objects of this type are only to be created by the user as the array of buffers
+ * passed to the @ref IpPacketBufPool constructor, and not accessed other than via
+ * the public functions.
+ */
+class IpPacketBuf :
+    private NonCopyable<IpPacketBuf>
+{
+    friend class IpPacketBufPool;
+
+public:
+    /**
+     * Default constructor; the pool initializes the buffer.
+     */
+    IpPacketBuf () = default;
+
+    /**
+     * Get the buffer node referencing the memory of this packet buffer.
+     * 
+     * The node has no next node and its length is the buffer size of the pool. It
+     * remains valid as long as a reference to the packet buffer is held.
+     * 
+     * @return Pointer to the node.
+     */
+    inline IpBufNode const * getNode () const
+    {
+        return &m_node;
+    }
+
+    /**
+     * Get an @ref IpBufRef referencing the initial part of this packet buffer.
+     * 
+     * @param len Length of the referenced data, must not exceed the buffer size.
+     * @return An @ref IpBufRef with offset 0 and the given length.
+     */
+    inline IpBufRef getBufRef (std::size_t len) const
+    {
+        AIPSTACK_ASSERT(len <= m_node.len);
+        
+        return IpBufRef{&m_node, 0, len};
+    }
+
+    /**
+     * Get the current reference count.
+     * 
+     * @return Number of references held (zero if the buffer is free).
+     */
+    inline std::size_t getRefCount () const
+    {
+        return m_refcnt;
+    }
+
+private:
+    // This must be the first member so that IpPacketBufPool::findBuf works.
+    IpBufNode m_node;
+    IpPacketBuf *m_next_free;
+    std::size_t m_refcnt;
+};
+
+/**
+ * Statistics of an @ref IpPacketBufPool as returned by @ref IpPacketBufPool::getStats.
+ */
+struct IpPacketBufPoolStats {
+    /**
+     * Total number of buffers in the pool.
+     */
+    std::size_t num_bufs;
+
+    /**
+     * Number of buffers currently free.
+     */
+    std::size_t num_free;
+
+    /**
+     * Minimum number of free buffers observed since construction or the last
+     * @ref IpPacketBufPool::resetStats.
+     */
+    std::size_t min_free;
+
+    /**
+     * Number of failed allocations since construction or the last
+     * @ref IpPacketBufPool::resetStats.
+     */
+    std::size_t alloc_failures;
+};
+
+/**
+ * Bounded pool of fixed-size, reference-counted packet buffers.
+ * 
+ * A driver can receive packets into buffers allocated from the pool (@ref alloc)
+ * and release its reference (@ref unref) after the packet has been processed.
+ * Protocol or application code which processes the packet can keep it beyond the
+ * processing call, without copying, by taking an additional reference using @ref
+ * takeRef; it then calls @ref unref when the data is no longer needed. A buffer
+ * returns to the pool when its last reference is released.
+ * 
+ * Since the pool has a fixed number of buffers, code retaining packets must take
+ * care to not starve the driver; @ref getStats can be used to monitor the pool.
+ * If @ref alloc fails, a driver would typically fall back to receiving into its
+ * own memory, in which case @ref takeRef will fail and the data must be copied.
+ * 
+ * The memory for the buffers is provided by the user.
+ */
+class IpPacketBufPool :
+    private NonCopyable<IpPacketBufPool>
+{
+    // Required by findBuf.
+    static_assert(offsetof(IpPacketBuf, m_node) == 0);
+
+public:
+    /**
+     * Construct the pool; all buffers are initially free.
+     * 
+     * @param bufs Array of `num_bufs` packet buffer objects, which must remain valid
+     *        for the lifetime of the pool.
+     * @param num_bufs Number of buffers in the pool.
+     * @param mem Memory for the buffer data, `num_bufs * buf_size` bytes, which must
+     *        remain valid for the lifetime of the pool.
+     * @param buf_size Size of each buffer in bytes.
+     */
+    IpPacketBufPool (IpPacketBuf *bufs, std::size_t num_bufs, char *mem,
+                     std::size_t buf_size)
+    :
+        m_bufs(bufs),
+        m_num_bufs(num_bufs),
+        m_buf_size(buf_size),
+        m_first_free(nullptr),
+        m_num_free(num_bufs)
+    {
+        AIPSTACK_ASSERT(bufs != nullptr || num_bufs == 0);
+        
+        for (std::size_t i = num_bufs; i > 0; i--) {
+            IpPacketBuf &buf = m_bufs[i - 1];
+            buf.m_node = IpBufNode{mem + (i - 1) * buf_size, buf_size, nullptr};
+            buf.m_refcnt = 0;
+            buf.m_next_free = m_first_free;
+            m_first_free = &buf;
+        }
+        
+        resetStats();
+    }
+
+    /**
+     * Destruct the pool.
+     * 
+     * All buffers must have been released.
+     */
+    ~IpPacketBufPool ()
+    {
+        AIPSTACK_ASSERT(m_num_free == m_num_bufs);
+    }
+
+    /**
+     * Get the size of each buffer.
+     * 
+     * @return Buffer size in bytes.
+     */
+    inline std::size_t getBufSize () const
+    {
+        return m_buf_size;
+    }
+
+    /**
+     * Allocate a buffer from the pool.
+     * 
+     * @return The allocated buffer with a reference count of one, or null if no
+     *         buffer is available.
+     */
+    IpPacketBuf * alloc ()
+    {
+        IpPacketBuf *buf = m_first_free;
+        if (buf == nullptr) {
+            m_alloc_failures++;
+            return nullptr;
+        }
+        
+        AIPSTACK_ASSERT(buf->m_refcnt == 0);
+        
+        m_first_free = buf->m_next_free;
+        m_num_free--;
+        if (m_num_free < m_min_free) {
+            m_min_free = m_num_free;
+        }
+        
+        buf->m_refcnt = 1;
+        return buf;
+    }
+
+    /**
+     * Take an additional reference to a buffer which is in use.
+     * 
+     * @param buf Buffer belonging to this pool with a nonzero reference count.
+     */
+    inline void ref (IpPacketBuf &buf)
+    {
+        AIPSTACK_ASSERT(buf.m_refcnt > 0);
+        
+        buf.m_refcnt++;
+    }
+
+    /**
+     * Release a reference to a buffer.
+     * 
+     * If this was the last reference, the buffer is returned to the pool.
+     * 
+     * @param buf Buffer belonging to this pool with a nonzero reference count.
+     */
+    void unref (IpPacketBuf &buf)
+    {
+        AIPSTACK_ASSERT(buf.m_refcnt > 0);
+        
+        buf.m_refcnt--;
+        if (buf.m_refcnt == 0) {
+            buf.m_next_free = m_first_free;
+            m_first_free = &buf;
+            m_num_free++;
+        }
+    }
+
+    /**
+     * Find the packet buffer of this pool which a buffer node belongs to.
+     * 
+     * @param node Buffer node (may be null).
+     * @return The packet buffer whose node is `node`, or null if `node` is not the
+     *         node of a packet buffer of this pool.
+     */
+    IpPacketBuf * findBuf (IpBufNode const *node) const
+    {
+        std::less<IpBufNode const *> less;
+        
+        if (m_num_bufs == 0 || less(node, &m_bufs[0].m_node) ||
+            !less(node, &m_bufs[m_num_bufs - 1].m_node + 1))
+        {
+            return nullptr;
+        }
+        
+        std::size_t byte_offset = std::size_t(
+            reinterpret_cast<char const *>(node) - reinterpret_cast<char const *>(m_bufs));
+        if (byte_offset % sizeof(IpPacketBuf) != 0) {
+            return nullptr;
+        }
+        
+        IpPacketBuf &buf = m_bufs[byte_offset / sizeof(IpPacketBuf)];
+        AIPSTACK_ASSERT(&buf.m_node == node);
+        
+        return &buf;
+    }
+
+    /**
+     * Take a reference to the packet buffer containing the data referenced by an
+     * @ref IpBufRef, so that the data can be used after the function which received
+     * it returns.
+     * 
+     * This succeeds only if all of the referenced data is within the first node of
+     * `data` and that node belongs to an allocated buffer of this pool. This is the
+     * case for unmodified received packets of a driver which received them into this
+     * pool, as well as for parts of such packets (e.g. with headers hidden). On
+     * success, the `data` remains valid until @ref unref is called for the returned
+     * buffer.
+     * 
+     * @param data Referenced data.
+     * @return The buffer with the reference count incremented, or null if the data is
+     *         not stored in a buffer of this pool (it then needs to be copied).
+     */
+    IpPacketBuf * takeRef (IpBufRef data)
+    {
+        IpPacketBuf *buf = findBuf(data.node);
+        if (buf == nullptr || buf->m_refcnt == 0 ||
+            data.offset > buf->m_node.len ||
+            data.tot_len > buf->m_node.len - data.offset)
+        {
+            return nullptr;
+        }
+        
+        buf->m_refcnt++;
+        return buf;
+    }
+
+    /**
+     * Get statistics of the pool.
+     * 
+     * @return Current statistics.
+     */
+    IpPacketBufPoolStats getStats () const
+    {
+        return IpPacketBufPoolStats{m_num_bufs, m_num_free, m_min_free, m_alloc_failures};
+    }
+
+    /**
+     * Reset the statistics which are accumulated over time (`min_free` and
+     * `alloc_failures`).
+     */
+    void resetStats ()
+    {
+        m_min_free = m_num_free;
+        m_alloc_failures = 0;
+    }
+
+private:
+    IpPacketBuf *m_bufs;
+    std::size_t m_num_bufs;
+    std::size_t m_buf_size;
+    IpPacketBuf *m_first_free;
+    std::size_t m_num_free;
+    std::size_t m_min_free;
+    std::size_t m_alloc_failures;
+};
+
+/** @} */
+
+}
+
+#endif
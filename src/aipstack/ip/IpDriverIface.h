@@ -25,6 +25,7 @@
 #ifndef AIPSTACK_IP_DRIVER_IFACE_H
 #define AIPSTACK_IP_DRIVER_IFACE_H
 
+#include <aipstack/misc/Assert.h>
 #include <aipstack/misc/NonCopyable.h>
 #include <aipstack/infra/Buf.h>
 #include <aipstack/ip/IpAddr.h>
@@ -146,9 +147,31 @@ public:
      * @param pkt Received packet, presumably starting with the IP header.
      *            The referenced buffers will only be read from within this
      *            function call.
+     * @param rx_verified Checksums of this packet which have already been verified
+     *        by the driver; they will not be verified again. This must be a subset
+     *        of @ref IpIfaceDriverParams::rx_chksum_verify.
      */
-    inline void recvIp4Packet (IpBufRef pkt) {
-        IpStack<Arg>::processRecvedIp4Packet(&iface(), pkt);
+    inline void recvIp4Packet (IpBufRef pkt, IpChksumFlags rx_verified = IpChksumFlags()) {
+        AIPSTACK_ASSERT((rx_verified & ~iface().m_params.rx_chksum_verify) == Enum0);
+        
+        IpStack<Arg>::processRecvedIp4Packet(&iface(), pkt, rx_verified);
+    }
+    
+    /**
+     * Notify that a burst of received packets has ended.
+     * 
+     * This should be called by a driver which has set @ref
+     * IpIfaceDriverParams::rx_burst_end, after it has delivered a batch of received
+     * packets using @ref recvIp4Packet (e.g. all packets read in one event loop
+     * callback). It must not be called by other drivers.
+     * 
+     * @note The driver must support various driver functions being called from
+     * within this, especially @ref IpIfaceDriverParams::send_ip4_packet.
+     */
+    inline void recvBurstEnd () {
+        AIPSTACK_ASSERT(iface().m_params.rx_burst_end);
+        
+        IpStack<Arg>::processRxBurstEnd(&iface());
     }
     
     /**
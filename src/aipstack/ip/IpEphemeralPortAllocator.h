@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2016 Ambroz Bizjak
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AIPSTACK_IP_EPHEMERAL_PORT_ALLOCATOR_H
+#define AIPSTACK_IP_EPHEMERAL_PORT_ALLOCATOR_H
+
+#include <cstdint>
+
+#include <aipstack/misc/SipHash.h>
+#include <aipstack/ip/IpAddr.h>
+
+namespace AIpStack {
+
+/**
+ * @addtogroup ip-stack
+ * @{
+ */
+
+/**
+ * Ephemeral port selection using the Double-Hash Port Selection algorithm
+ * from RFC 6056 (section 3.3.4).
+ * 
+ * The candidate ports for a connection start at an offset determined by a
+ * keyed hash of the local address, remote address and remote port, so that
+ * port numbers are not predictable by third parties. The position within
+ * that sequence is a counter from a small table selected by another hash of
+ * the same values. Consecutive allocations for the same destination
+ * therefore get consecutive ports following those already allocated, and
+ * the first candidate is usually free even when many connections to the
+ * same destination exist.
+ * 
+ * @tparam PortFirst First port in the ephemeral range (must be \>0).
+ * @tparam PortLast Last port in the ephemeral range (must be \>=PortFirst).
+ */
+template<PortNum PortFirst, PortNum PortLast>
+class IpEphemeralPortAllocator {
+    static_assert(PortFirst > 0);
+    static_assert(PortFirst <= PortLast);
+    
+    inline static constexpr std::uint32_t NumPorts = std::uint32_t(PortLast - PortFirst) + 1;
+    
+    inline static constexpr int TableSizeBits = 4;
+    
+public:
+    /**
+     * Initialize with all counters zero.
+     */
+    IpEphemeralPortAllocator () :
+        m_table{}
+    {}
+    
+    /**
+     * Select a free ephemeral port.
+     * 
+     * @param key Secret key for the hash functions.
+     * @param local_addr The local address.
+     * @param remote_addr The remote address.
+     * @param remote_port The remote port.
+     * @param is_free Function called with a candidate port returning whether
+     *        that port is available for the connection.
+     * @return The port, or 0 if all ports in the range are in use.
+     */
+    template<typename IsFree>
+    PortNum allocate (SipHashKey const &key, Ip4Addr local_addr, Ip4Addr remote_addr,
+                      PortNum remote_port, IsFree is_free)
+    {
+        // The third word distinguishes these from other hashes with the same key.
+        SipHash<1, 3> hasher(key);
+        hasher.addWord((std::uint64_t(local_addr.value()) << 32) | remote_addr.value());
+        hasher.addWord(remote_port);
+        hasher.addWord(std::uint64_t(1) << 62);
+        std::uint64_t hash = hasher.finish();
+        
+        std::uint32_t offset = std::uint32_t(hash) % NumPorts;
+        std::uint16_t &counter = m_table[hash >> (64 - TableSizeBits)];
+        
+        for (std::uint32_t i = 0; i < NumPorts; i++) {
+            PortNum port = PortNum(PortFirst + (offset + counter) % NumPorts);
+            counter = std::uint16_t((counter + 1) % NumPorts);
+            
+            if (is_free(port)) {
+                return port;
+            }
+        }
+        
+        return 0;
+    }
+    
+private:
+    std::uint16_t m_table[1 << TableSizeBits];
+};
+
+/** @} */
+
+}
+
+#endif
@@ -34,6 +34,7 @@
 #include <aipstack/structure/StructureRaiiWrapper.h>
 #include <aipstack/structure/Accessor.h>
 #include <aipstack/infra/ObserverNotification.h>
+#include <aipstack/infra/PacketBufPool.h>
 #include <aipstack/ip/IpAddr.h>
 #include <aipstack/ip/IpStackTypes.h>
 #include <aipstack/ip/IpIfaceDriverParams.h>
@@ -264,6 +265,46 @@ public:
         return m_ip_mtu;
     }
     
+    /**
+     * Return the checksums which the driver calculates for sent packets.
+     * 
+     * This function will return whatever was passed as @ref
+     * IpIfaceDriverParams::tx_chksum_offload when the interface was added.
+     * Protocol handlers may skip calculating the indicated checksums for packets
+     * known to be sent through this interface.
+     * 
+     * @return Checksums offloaded to the driver.
+     */
+    inline IpChksumFlags getTxChksumOffload () const {
+        return m_params.tx_chksum_offload;
+    }
+    
+    /**
+     * Return whether the driver reports the ends of bursts of received packets.
+     * 
+     * This function will return whatever was passed as @ref
+     * IpIfaceDriverParams::rx_burst_end when the interface was added. If this is
+     * true, protocol handlers can rely on @ref IpProtocolHandlerStub::handleRxBurstEnd
+     * being called after packets received on this interface have been processed.
+     * 
+     * @return Whether burst ends are reported.
+     */
+    inline bool reportsRxBurstEnd () const {
+        return m_params.rx_burst_end;
+    }
+    
+    /**
+     * Return the packet buffer pool which the driver receives packets into.
+     * 
+     * This function will return whatever was passed as @ref
+     * IpIfaceDriverParams::rx_pool when the interface was added.
+     * 
+     * @return The pool, or null if the driver does not use one.
+     */
+    inline IpPacketBufPool * getRxPool () const {
+        return m_params.rx_pool;
+    }
+    
     /**
      * Return the driver-provided interface state.
      * 
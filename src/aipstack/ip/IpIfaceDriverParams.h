@@ -31,6 +31,7 @@
 #include <aipstack/infra/Err.h>
 #include <aipstack/infra/Buf.h>
 #include <aipstack/infra/SendRetry.h>
+#include <aipstack/infra/PacketBufPool.h>
 #include <aipstack/ip/IpAddr.h>
 #include <aipstack/ip/IpStackTypes.h>
 #include <aipstack/ip/IpHwCommon.h>
@@ -108,6 +109,51 @@ struct IpIfaceDriverParams {
      * @return Driver-provided-state (currently just the link-up flag).
      */
     Function<IpIfaceDriverState()> get_state = nullptr;
+
+    /**
+     * Checksums which the driver may report as already verified for received packets.
+     * 
+     * This is the set of flags which the driver may pass to @ref
+     * IpDriverIface::recvIp4Packet for individual packets (this is an assert). A
+     * driver should only report a checksum as verified if the packet is known to
+     * have a correct checksum (e.g. the hardware or the host checked it).
+     */
+    IpChksumFlags rx_chksum_verify = IpChksumFlags();
+
+    /**
+     * Checksums which the driver computes for sent packets (transmit offload).
+     * 
+     * For each flag here, the driver must calculate and fill in the respective checksum
+     * of every packet passed to @ref send_ip4_packet (for UDP, a zero result must be
+     * sent as 0xFFFF). The stack may then leave the checksum field with an unspecified
+     * value instead of calculating the checksum itself. Note that the stack may still
+     * calculate the checksum in some cases, such as when the outgoing interface is not
+     * known at the time the checksum would be calculated. Transport checksums of
+     * datagrams which are sent in fragments are always calculated by the stack, so the
+     * driver must leave the transport checksum of a fragment unchanged.
+     */
+    IpChksumFlags tx_chksum_offload = IpChksumFlags();
+
+    /**
+     * Whether the driver reports the ends of bursts of received packets.
+     * 
+     * If true, the driver must call @ref IpDriverIface::recvBurstEnd after it is
+     * done delivering a batch of one or more packets using @ref
+     * IpDriverIface::recvIp4Packet, before returning to the event loop. If false,
+     * the driver must not call @ref IpDriverIface::recvBurstEnd.
+     */
+    bool rx_burst_end = false;
+
+    /**
+     * Packet buffer pool which the driver receives packets into, or null.
+     * 
+     * If not null, received packets passed to @ref IpDriverIface::recvIp4Packet may
+     * be stored in buffers of this pool (packets in other memory are also allowed).
+     * Protocol handlers may then retain such packets beyond the receive call using
+     * @ref IpPacketBufPool::takeRef instead of copying them. The pool must outlive
+     * the interface and any references taken.
+     */
+    IpPacketBufPool *rx_pool = nullptr;
 };
 
 /** @} */
@@ -107,7 +107,7 @@ class IpPathMtuCache :
     struct MtuIndexKeyFuncs;
     AIPSTACK_MAKE_INSTANCE(MtuIndex, (MtuIndexService::template Index<
         MtuIndexAccessor, MtuIndexLookupKeyArg, MtuIndexKeyFuncs, MtuLinkModel,
-        /*Duplicates=*/false>))
+        /*Duplicates=*/false, /*MaxEntries=*/NumMtuEntries>))
     
     // Linked list data structure for keeping MTU entries in Invalid or Unused,
     // states. The former kind are maintained to be before the latter kind.
@@ -180,6 +180,13 @@ private:
         {
             return mtu_entry.remote_addr;
         }
+        
+        // Provides the key to hash table indices.
+        template<typename Hasher>
+        inline static void HashKey (Ip4Addr addr, Hasher &hasher)
+        {
+            hasher.addWord(addr.value());
+        }
     };
     
 private:
@@ -617,8 +624,8 @@ struct IpPathMtuCacheOptions {
      * Data structure service for indexing PMTU cache entries by IP address.
      * 
      * This should be one of the implementations in the folder
-     * aipstack/structure/index. Specifically supported are @ref AvlTreeIndexService and
-     * @ref MruListIndexService.
+     * aipstack/structure/index. Specifically supported are @ref AvlTreeIndexService,
+     * @ref MruListIndexService and @ref HashTableIndexService.
      */
     AIPSTACK_OPTION_DECL_TYPE(MtuIndexService, void)
 };
@@ -253,6 +253,25 @@ public:
     {
     }
     
+    /**
+     * Handle the end of a burst of received packets on an interface.
+     * 
+     * This is called after the driver of an interface has delivered a batch of
+     * received packets (@ref IpDriverIface::recvBurstEnd), but only for interfaces
+     * whose driver reports burst ends (@ref IpIface::reportsRxBurstEnd). Protocol
+     * handlers may use this to defer work such as sending responses while a burst is
+     * being received, then do it at once here. For interfaces which do not report
+     * burst ends, every packet should be considered to be a separate burst.
+     * 
+     * @note Sending packets from within this function is allowed.
+     * 
+     * @param iface The interface on which the burst was received. It must not be
+     *        remembered after this function returns.
+     */
+    void handleRxBurstEnd ([[maybe_unused]] IpIface<StackArg> *iface)
+    {
+    }
+    
 private:
     IpStack<StackArg> *m_stack;
 };
@@ -449,8 +449,9 @@ public:
         chksum.addWord(WrapType<std::uint32_t>(), common.addrs.remote_addr.value());
         ip4_header.set(Ip4Header::DstAddr(), common.addrs.remote_addr);
         
-        // Set the IP header checksum.
-        ip4_header.set(Ip4Header::HeaderChksum(), chksum.getChksum());
+        // Set the IP header checksum (unless the driver calculates it).
+        ip4_header.set(Ip4Header::HeaderChksum(),
+            ip4HeaderChksumOffloaded(route_info.iface) ? 0 : chksum.getChksum());
         
         // Send the packet to the driver.
         // Fast path is no fragmentation, this permits tail call optimization.
@@ -502,17 +503,25 @@ private:
             
             auto ip4_header = Ip4Header::MakeRef(pkt.getChunkPtr());
             
-            // Write the fragment-specific IP header fields.
-            ip4_header.set(Ip4Header::TotalLen(), pkt_send_len);
             Ip4Flags flags_offset =
                 IpFlagsInSendFlags(send_flags) | Ip4Flags(fragment_offset / 8);
-            ip4_header.set(Ip4Header::FlagsOffset(), flags_offset);
-            ip4_header.set(Ip4Header::HeaderChksum(), 0);
             
-            // Calculate the IP header checksum.
-            // Not inline since fragmentation is uncommon, better save program space.
-            std::uint16_t calc_chksum = IpChksum(ip4_header.data, Ip4Header::Size);
-            ip4_header.set(Ip4Header::HeaderChksum(), calc_chksum);
+            // Update the IP header checksum of the previous fragment for the changed
+            // fields (unless the driver calculates it).
+            if (!ip4HeaderChksumOffloaded(route_info.iface)) {
+                auto chksum = IpChksumAccumulator::fromChksum(
+                    ip4_header.get(Ip4Header::HeaderChksum()));
+                chksum.replaceWord(WrapType<std::uint16_t>(),
+                    ip4_header.get(Ip4Header::TotalLen()), pkt_send_len);
+                chksum.replaceWord(WrapType<std::uint16_t>(),
+                    AsUnderlying(ip4_header.get(Ip4Header::FlagsOffset())),
+                    AsUnderlying(flags_offset));
+                ip4_header.set(Ip4Header::HeaderChksum(), chksum.getChksum());
+            }
+            
+            // Write the fragment-specific IP header fields.
+            ip4_header.set(Ip4Header::TotalLen(), pkt_send_len);
+            ip4_header.set(Ip4Header::FlagsOffset(), flags_offset);
             
             // Construct a packet with header and partial data.
             IpBufNode data_node = ipBufRefToNode(dgram);
@@ -654,8 +663,9 @@ public:
         chksum.addWord(WrapType<std::uint16_t>(), ident);
         ip4_header.set(Ip4Header::Ident(), ident);
         
-        // Set the IP header checksum.
-        ip4_header.set(Ip4Header::HeaderChksum(), chksum.getChksum());
+        // Set the IP header checksum (unless the driver calculates it).
+        ip4_header.set(Ip4Header::HeaderChksum(),
+            ip4HeaderChksumOffloaded(prep.route_info.iface) ? 0 : chksum.getChksum());
         
         // Send the packet to the driver.
         return prep.route_info.iface->m_params.send_ip4_packet(
@@ -663,6 +673,11 @@ public:
     }
 
 private:
+    inline static bool ip4HeaderChksumOffloaded (Iface *iface)
+    {
+        return (iface->getTxChksumOffload() & IpChksumFlags::Ip4Header) != Enum0;
+    }
+
     inline static IpErr checkSendIp4Allowed (
         Ip4AddrPair const &addrs, IpSendFlags send_flags, Iface *iface)
     {
@@ -933,7 +948,8 @@ public:
 #endif
     
 private:
-    static void processRecvedIp4Packet (Iface *iface, IpBufRef pkt)
+    static void processRecvedIp4Packet (Iface *iface, IpBufRef pkt,
+                                        IpChksumFlags rx_verified)
     {
         // Check base IP header length.
         if (AIPSTACK_UNLIKELY(!pkt.hasHeader(Ip4Header::Size))) {
@@ -1012,9 +1028,11 @@ private:
         Ip4Flags flags_offset = ip4_header.get(Ip4Header::FlagsOffset());
         chksum.addWord(WrapType<std::uint16_t>(), AsUnderlying(flags_offset));
         
-        // Verify IP header checksum.
-        if (AIPSTACK_UNLIKELY(chksum.getChksum() != 0)) {
-            return;
+        // Verify IP header checksum, unless the driver has already done that.
+        if ((rx_verified & IpChksumFlags::Ip4Header) == Enum0) {
+            if (AIPSTACK_UNLIKELY(chksum.getChksum() != 0)) {
+                return;
+            }
         }
         
         // Check if the more-fragments flag is set or the fragment offset is nonzero.
@@ -1042,16 +1060,29 @@ private:
             }
             // Continue processing the reassembled datagram.
             // Note, dgram was modified pointing to the reassembled data.
+            
+            // A transport checksum verified by the driver would only have been for
+            // this fragment, not for the reassembled datagram.
+            rx_verified &= ~IpChksumFlags::Transport;
         }
         
         // Create the IpRxInfoIp4 struct.
-        IpRxInfoIp4<Arg> ip_info{src_addr, dst_addr, ttl, proto, iface, header_len};
+        IpRxInfoIp4<Arg> ip_info{
+            src_addr, dst_addr, ttl, proto, iface, header_len, rx_verified};
 
         // Do the real processing now that the datagram is complete and
         // sanity checked.
         recvIp4Dgram(ip_info, dgram);
     }
     
+    static void processRxBurstEnd (Iface *iface)
+    {
+        // Let each protocol handler finish any work deferred during the burst.
+        ListFor<ProtocolHelpersList>([&] AIPSTACK_TL(Helper, {
+            Helper::get(iface->m_stack)->handleRxBurstEnd(iface);
+        }));
+    }
+    
     static void recvIp4Dgram (IpRxInfoIp4<Arg> ip_info, IpBufRef dgram)
     {
         // Pass to interface listeners. If any listener accepts the
@@ -1228,8 +1259,10 @@ private:
         // Create the Ip4DestUnreachMeta struct.
         Ip4DestUnreachMeta du_meta = {code, rest};
         
-        // Create the IpRxInfoIp4 struct.
-        IpRxInfoIp4<Arg> ip_info{src_addr, dst_addr, ttl, proto, iface, header_len};
+        // Create the IpRxInfoIp4 struct (checksums of the included datagram have not
+        // been verified by the driver).
+        IpRxInfoIp4<Arg> ip_info{
+            src_addr, dst_addr, ttl, proto, iface, header_len, IpChksumFlags()};
         
         // Get the included IP data.
         std::size_t data_len = MinValueU(icmp_data.tot_len, total_len) - header_len;
@@ -182,6 +182,30 @@ struct IpIfaceDriverState {
     bool link_up = true;
 };
 
+/**
+ * Identifies checksums which may be handled by interface drivers (checksum offload).
+ * 
+ * This is used for the driver-declared capabilities @ref
+ * IpIfaceDriverParams::rx_chksum_verify and @ref IpIfaceDriverParams::tx_chksum_offload,
+ * and for the per-packet information @ref IpRxInfoIp4::chksum_verified.
+ * 
+ * Operators provided by @ref AIPSTACK_ENUM_BITFIELD are available.
+ */
+enum class IpChksumFlags : std::uint8_t {
+    /**
+     * The IPv4 header checksum.
+     */
+    Ip4Header = std::uint8_t(1) << 0,
+
+    /**
+     * The transport-layer (TCP or UDP) checksum.
+     */
+    Transport = std::uint8_t(1) << 1,
+};
+#ifndef IN_DOXYGEN
+AIPSTACK_ENUM_BITFIELD(IpChksumFlags)
+#endif
+
 /**
  * Contains definitions of flags as accepted by @ref AIpStack::IpStack::sendIp4Dgram
  * "IpStack::sendIp4Dgram" and @ref AIpStack::IpStack::prepareSendIp4Dgram
@@ -386,6 +410,15 @@ struct IpRxInfoIp4 {
      * The length of the IPv4 header in bytes.
      */
     std::uint8_t header_len;
+
+    /**
+     * Checksums which have already been verified by the interface driver.
+     * 
+     * This is what the driver passed to @ref IpDriverIface::recvIp4Packet, except
+     * that @ref IpChksumFlags::Transport is cleared for reassembled datagrams.
+     * Protocol handlers skip verification of the checksums indicated here.
+     */
+    IpChksumFlags chksum_verified;
 };
 
 /**
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2016 Ambroz Bizjak
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AIPSTACK_SIP_HASH_H
+#define AIPSTACK_SIP_HASH_H
+
+#include <cstdint>
+
+namespace AIpStack {
+
+/**
+ * @addtogroup misc
+ * @{
+ */
+
+/**
+ * Secret key for @ref SipHash.
+ */
+struct SipHashKey {
+    std::uint64_t k0;
+    std::uint64_t k1;
+};
+
+/**
+ * Incremental SipHash keyed hash function restricted to messages consisting
+ * of whole 64-bit words.
+ * 
+ * Words are processed as if they were encoded in little-endian byte order,
+ * so the result equals the reference SipHash of the corresponding byte
+ * string.
+ * 
+ * @tparam CRounds Number of compression rounds per word (2 for SipHash-2-4).
+ * @tparam DRounds Number of finalization rounds (4 for SipHash-2-4).
+ */
+template<int CRounds, int DRounds>
+class SipHash {
+public:
+    /**
+     * Start hashing a message with the given key.
+     * 
+     * @param key The secret key.
+     */
+    inline SipHash (SipHashKey const &key) :
+        m_v0(key.k0 ^ 0x736f6d6570736575u),
+        m_v1(key.k1 ^ 0x646f72616e646f6du),
+        m_v2(key.k0 ^ 0x6c7967656e657261u),
+        m_v3(key.k1 ^ 0x7465646279746573u),
+        m_num_words(0)
+    {}
+    
+    /**
+     * Add a word to the message.
+     * 
+     * @param m The word.
+     */
+    inline void addWord (std::uint64_t m)
+    {
+        compress(m);
+        m_num_words++;
+    }
+    
+    /**
+     * Finish hashing and return the hash.
+     * 
+     * The object must not be used afterward.
+     * 
+     * @return The 64-bit hash of the message.
+     */
+    inline std::uint64_t finish ()
+    {
+        compress(std::uint64_t(std::uint8_t(8 * m_num_words)) << 56);
+        
+        m_v2 ^= 0xff;
+        for (int i = 0; i < DRounds; i++) {
+            round();
+        }
+        
+        return m_v0 ^ m_v1 ^ m_v2 ^ m_v3;
+    }
+    
+private:
+    inline static std::uint64_t rotl (std::uint64_t x, int b)
+    {
+        return (x << b) | (x >> (64 - b));
+    }
+    
+    inline void round ()
+    {
+        m_v0 += m_v1; m_v1 = rotl(m_v1, 13); m_v1 ^= m_v0; m_v0 = rotl(m_v0, 32);
+        m_v2 += m_v3; m_v3 = rotl(m_v3, 16); m_v3 ^= m_v2;
+        m_v0 += m_v3; m_v3 = rotl(m_v3, 21); m_v3 ^= m_v0;
+        m_v2 += m_v1; m_v1 = rotl(m_v1, 17); m_v1 ^= m_v2; m_v2 = rotl(m_v2, 32);
+    }
+    
+    inline void compress (std::uint64_t m)
+    {
+        m_v3 ^= m;
+        for (int i = 0; i < CRounds; i++) {
+            round();
+        }
+        m_v0 ^= m;
+    }
+    
+private:
+    std::uint64_t m_v0;
+    std::uint64_t m_v1;
+    std::uint64_t m_v2;
+    std::uint64_t m_v3;
+    std::uint32_t m_num_words;
+};
+
+/** @} */
+
+}
+
+#endif
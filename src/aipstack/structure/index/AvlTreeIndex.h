@@ -25,6 +25,7 @@
 #ifndef AIPSTACK_AVL_TREE_INDEX_H
 #define AIPSTACK_AVL_TREE_INDEX_H
 
+#include <cstddef>
 #include <type_traits>
 #include <functional>
 
@@ -230,7 +231,8 @@ class AvlTreeIndexService {
 public:
     #ifndef IN_DOXYGEN
     template<typename HookAccessor_, typename LookupKeyArg_,
-              typename KeyFuncs_, typename LinkModel_, bool Duplicates_>
+              typename KeyFuncs_, typename LinkModel_, bool Duplicates_,
+              std::size_t MaxEntries_ = 0>
     struct Index {
         using HookAccessor = HookAccessor_;
         using LookupKeyArg = LookupKeyArg_;
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2016 Ambroz Bizjak
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AIPSTACK_HASH_TABLE_INDEX_H
+#define AIPSTACK_HASH_TABLE_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include <aipstack/misc/Use.h>
+#include <aipstack/misc/Assert.h>
+#include <aipstack/misc/SipHash.h>
+#include <aipstack/infra/Options.h>
+#include <aipstack/infra/Instance.h>
+
+namespace AIpStack {
+
+/**
+ * @addtogroup structure
+ * @{
+ */
+
+#ifndef IN_DOXYGEN
+
+// Holds the seed set by SetHashTableIndexSeed.
+struct HashTableIndexSeed {
+    inline static SipHashKey seed = SipHashKey{0, 0};
+};
+
+template<typename Arg>
+class HashTableIndex {
+    AIPSTACK_USE_TYPES(Arg, (HookAccessor, LookupKeyArg, KeyFuncs, LinkModel))
+    AIPSTACK_USE_VALS(Arg, (Duplicates, NumBuckets))
+    
+    AIPSTACK_USE_TYPES(LinkModel, (State, Ref, Link))
+    
+    static_assert(NumBuckets > 0);
+    
+    // SipHash-1-3 is sufficient for hash tables and faster than SipHash-2-4.
+    using Hasher = SipHash<1, 3>;
+    
+public:
+    class Node {
+        friend HashTableIndex;
+        
+        Link next;
+        Link prev;
+    };
+    
+    class Index {
+    public:
+        void init ()
+        {
+            // Use a different key for each index so that collisions found
+            // for one index do not apply to others.
+            m_key = HashTableIndexSeed::seed;
+            m_key.k0 ^= std::uint64_t(reinterpret_cast<std::uintptr_t>(this));
+            
+            for (Link &bucket : m_buckets) {
+                bucket = Link::null();
+            }
+            m_count = 0;
+        }
+        
+        void addEntry (Ref e, State st = State())
+        {
+            Link &bucket = m_buckets[bucket_for_key(KeyFuncs::GetKeyOfEntry(*e))];
+            
+            ac(e).next = bucket;
+            ac(e).prev = Link::null();
+            if (!bucket.isNull()) {
+                ac(bucket.ref(st)).prev = e.link(st);
+            }
+            bucket = e.link(st);
+            m_count++;
+        }
+        
+        void removeEntry (Ref e, State st = State())
+        {
+            AIPSTACK_ASSERT(m_count > 0);
+            
+            Link next = ac(e).next;
+            Link prev = ac(e).prev;
+            if (!next.isNull()) {
+                ac(next.ref(st)).prev = prev;
+            }
+            if (!prev.isNull()) {
+                ac(prev.ref(st)).next = next;
+            } else {
+                Link &bucket = m_buckets[bucket_for_key(KeyFuncs::GetKeyOfEntry(*e))];
+                AIPSTACK_ASSERT(bucket == e.link(st));
+                bucket = next;
+            }
+            m_count--;
+        }
+        
+        template<bool Enable = !Duplicates, typename = std::enable_if_t<Enable>>
+        inline Ref findEntry (LookupKeyArg key, State st = State()) const
+        {
+            return find_in_chain(key, m_buckets[bucket_for_key(key)].ref(st), st);
+        }
+        
+        template<bool Enable = Duplicates, typename = std::enable_if_t<Enable>>
+        inline Ref findFirst (LookupKeyArg key, State st = State()) const
+        {
+            return find_in_chain(key, m_buckets[bucket_for_key(key)].ref(st), st);
+        }
+        
+        template<bool Enable = Duplicates, typename = std::enable_if_t<Enable>>
+        inline Ref findNext (LookupKeyArg key, Ref prev_e, State st = State()) const
+        {
+            // Entries with equal keys are always in the same bucket.
+            return find_in_chain(key, ac(prev_e).next.ref(st), st);
+        }
+        
+        inline bool isEmpty () const
+        {
+            return m_count == 0;
+        }
+        
+        inline Ref first (State st = State()) const
+        {
+            return first_from_bucket(0, st);
+        }
+        
+        inline Ref next (Ref node, State st = State()) const
+        {
+            Link next = ac(node).next;
+            if (!next.isNull()) {
+                return next.ref(st);
+            }
+            std::size_t bucket = bucket_for_key(KeyFuncs::GetKeyOfEntry(*node));
+            return first_from_bucket(bucket + 1, st);
+        }
+        
+    private:
+        inline static Node & ac (Ref ref)
+        {
+            return HookAccessor::access(*ref);
+        }
+        
+        template<typename Key>
+        std::size_t bucket_for_key (Key const &key) const
+        {
+            Hasher hasher(m_key);
+            KeyFuncs::HashKey(key, hasher);
+            std::uint32_t hash = std::uint32_t(hasher.finish());
+            
+            // Map the hash to a bucket by multiplication, which works
+            // for any number of buckets.
+            return std::size_t((std::uint64_t(hash) * NumBuckets) >> 32);
+        }
+        
+        static Ref find_in_chain (LookupKeyArg key, Ref e, State st)
+        {
+            for (; !e.isNull(); e = ac(e).next.ref(st)) {
+                if (KeyFuncs::KeysAreEqual(KeyFuncs::GetKeyOfEntry(*e), key)) {
+                    return e;
+                }
+            }
+            return Ref::null();
+        }
+        
+        Ref first_from_bucket (std::size_t bucket, State st) const
+        {
+            for (; bucket < NumBuckets; bucket++) {
+                if (!m_buckets[bucket].isNull()) {
+                    return m_buckets[bucket].ref(st);
+                }
+            }
+            return Ref::null();
+        }
+        
+    private:
+        SipHashKey m_key;
+        std::size_t m_count;
+        Link m_buckets[NumBuckets];
+    };
+};
+
+#endif
+
+/**
+ * Set the secret seed for hashing in @ref HashTableIndexService indices.
+ * 
+ * Applications using @ref HashTableIndexService must call this once at
+ * startup with a random seed, before the network stack is constructed, since
+ * the seed applies to indices which are initialized after this call. Unlike
+ * the SYN cookie key, the seed is not derived from the platform by default:
+ * it is zero, and each index derives its own key from the seed and its
+ * address only. Without a random seed, remote parties that can guess the
+ * address could produce many entries hashing to the same bucket.
+ * 
+ * @param k0 First half of the seed.
+ * @param k1 Second half of the seed.
+ */
+inline void SetHashTableIndexSeed (std::uint64_t k0, std::uint64_t k1)
+{
+    HashTableIndexSeed::seed = SipHashKey{k0, k1};
+}
+
+/**
+ * Options for @ref HashTableIndexService.
+ */
+struct HashTableIndexServiceOptions {
+    /**
+     * Number of hash buckets in each index.
+     * 
+     * If zero (the default), the number of buckets is the maximum number of
+     * entries given by the user of the index (for example the number of PCBs
+     * for TCP), or 64 where that is not bounded (for example listeners).
+     * Each bucket uses the space of one link.
+     */
+    AIPSTACK_OPTION_DECL_VALUE(NumBuckets, std::size_t, 0)
+};
+
+/**
+ * An "index" family data structure implementation based on a hash table with
+ * a fixed number of buckets and doubly-linked chains.
+ * 
+ * Keys are hashed using SipHash-1-3 with a secret seed, which must be set
+ * using @ref SetHashTableIndexSeed. In addition to the usual functions, the
+ * KeyFuncs of the index must provide a function
+ * `static void HashKey (Key const &key, Hasher &hasher)` for both entry keys
+ * and lookup keys, which passes the key to `hasher.addWord(std::uint64_t)`.
+ * Keys which are equal must produce the same words.
+ * 
+ * Iteration using first() and next() visits entries in an arbitrary order.
+ * 
+ * Consult the @ref structure module for general information regarding
+ * configuration of data structures.
+ * 
+ * @tparam Options Assignments of options defined in @ref
+ *         HashTableIndexServiceOptions.
+ */
+template<typename ...Options>
+class HashTableIndexService {
+    AIPSTACK_OPTION_CONFIG_VALUE(HashTableIndexServiceOptions, NumBuckets)
+    
+    static constexpr std::size_t DefaultNumBuckets = 64;
+    
+public:
+    #ifndef IN_DOXYGEN
+    template<typename HookAccessor_, typename LookupKeyArg_,
+              typename KeyFuncs_, typename LinkModel_, bool Duplicates_,
+              std::size_t MaxEntries_ = 0>
+    struct Index {
+        using HookAccessor = HookAccessor_;
+        using LookupKeyArg = LookupKeyArg_;
+        using KeyFuncs = KeyFuncs_;
+        using LinkModel = LinkModel_;
+        inline static constexpr bool Duplicates = Duplicates_;
+        inline static constexpr std::size_t NumBuckets =
+            HashTableIndexService::NumBuckets != 0 ?
+                HashTableIndexService::NumBuckets :
+            MaxEntries_ != 0 ? MaxEntries_ : DefaultNumBuckets;
+        AIPSTACK_DEF_INSTANCE(Index, HashTableIndex)
+    };
+    #endif
+};
+
+/** @} */
+
+}
+
+#endif
@@ -25,6 +25,7 @@
 #ifndef AIPSTACK_MRU_LIST_INDEX_H
 #define AIPSTACK_MRU_LIST_INDEX_H
 
+#include <cstddef>
 #include <type_traits>
 
 #include <aipstack/misc/Use.h>
@@ -123,7 +124,7 @@ public:
         }
         
     private:
-        Ref findFirstNextCommon (LookupKeyArg key, Ref start, State st)
+        Ref findFirstNextCommon (LookupKeyArg key, Ref start, State st) const
         {
             for (Ref e = start; !e.isNull(); e = m_list.next(e, st)) {
                 if (KeyFuncs::KeysAreEqual(KeyFuncs::GetKeyOfEntry(*e), key)) {
@@ -151,7 +152,8 @@ class MruListIndexService {
 public:
     #ifndef IN_DOXYGEN
     template<typename HookAccessor_, typename LookupKeyArg_,
-              typename KeyFuncs_, typename LinkModel_, bool Duplicates_>
+              typename KeyFuncs_, typename LinkModel_, bool Duplicates_,
+              std::size_t MaxEntries_ = 0>
     struct Index {
         using HookAccessor = HookAccessor_;
         using LookupKeyArg = LookupKeyArg_;
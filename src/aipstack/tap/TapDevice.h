@@ -77,6 +77,14 @@ public:
      */
     using FrameReceivedHandler = Function<void(AIpStack::IpBufRef frame)>;
 
+    /**
+     * Type of callback used to report the end of a burst of received frames.
+     * 
+     * It is called after one or more frames have been delivered using the
+     * @ref FrameReceivedHandler, before returning to the event loop.
+     */
+    using BurstEndHandler = Function<void()>;
+
     /**
      * Constructor, initializes the driver and related resources.
      * 
@@ -91,9 +99,17 @@ public:
      *        description).
      * @param handler Callback function used to deliver Ethernet frames received
      *        from the driver (must not be null).
+     * @param burst_end_handler Callback function used to report the end of each
+     *        burst of received frames (may be null).
+     * @param rx_burst_size Maximum number of frames received from the driver and
+     *        delivered as one burst (must be at least one). On Linux, up to this
+     *        many frames are read into a preallocated ring of buffers before they
+     *        are delivered. On Windows this is ignored and each burst consists of
+     *        one frame.
      */
     TapDevice (AIpStack::EventLoop &loop, std::string const &device_id,
-               FrameReceivedHandler handler);
+               FrameReceivedHandler handler, BurstEndHandler burst_end_handler = nullptr,
+               std::size_t rx_burst_size = 1);
     
     /**
      * Destructor, disconnects from the driver and releases resources.
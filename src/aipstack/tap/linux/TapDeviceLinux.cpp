@@ -34,6 +34,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <net/if.h>
 #include <net/if_arp.h>
 #include <linux/if_tun.h>
@@ -47,12 +48,20 @@
 namespace AIpStack {
 
 TapDeviceLinux::TapDeviceLinux (
-    AIpStack::EventLoop &loop, std::string const &device_id, FrameReceivedHandler handler)
+    AIpStack::EventLoop &loop, std::string const &device_id, FrameReceivedHandler handler,
+    BurstEndHandler burst_end_handler, std::size_t rx_burst_size)
 :
     m_handler(handler),
+    m_burst_end_handler(burst_end_handler),
     m_fd_watcher(loop, AIPSTACK_BIND_MEMBER(&TapDeviceLinux::handleFdEvents, this)),
+    m_rx_burst_size(rx_burst_size),
+    m_rx_pool(nullptr),
     m_active(true)
 {
+    if (rx_burst_size == 0) {
+        throw std::runtime_error("TapDeviceLinux: rx_burst_size must not be zero.");
+    }
+    
     m_fd = AIpStack::FileDescriptorWrapper{::open("/dev/net/tun", O_RDWR)};
     if (!m_fd) {
         throw std::runtime_error("Failed to open /dev/net/tun.");
@@ -92,7 +101,9 @@ TapDeviceLinux::TapDeviceLinux (
         m_frame_mtu = std::size_t(ifr.ifr_mtu) + AIpStack::EthHeader::Size;
     }
     
-    m_read_buffer.resize(m_frame_mtu);
+    m_read_buffer.resize(m_rx_burst_size * m_frame_mtu);
+    m_read_lengths.resize(m_rx_burst_size);
+    m_read_pool_bufs.resize(m_rx_burst_size);
     m_write_buffer.resize(m_frame_mtu);
     
     m_fd_watcher.initFd(*m_fd, AIpStack::EventLoopFdEvents::Read);
@@ -106,6 +117,15 @@ std::size_t TapDeviceLinux::getMtu () const
     return m_frame_mtu;
 }
 
+void TapDeviceLinux::setRxPool (AIpStack::IpPacketBufPool *pool)
+{
+    if (pool != nullptr && pool->getBufSize() < m_frame_mtu) {
+        throw std::runtime_error("TapDeviceLinux: RX pool buffer size is less than MTU.");
+    }
+    
+    m_rx_pool = pool;
+}
+
 AIpStack::IpErr TapDeviceLinux::sendFrame (AIpStack::IpBufRef frame)
 {
     if (!m_active) {
@@ -119,12 +139,19 @@ AIpStack::IpErr TapDeviceLinux::sendFrame (AIpStack::IpBufRef frame)
         return AIpStack::IpErr::PacketTooLarge;
     }
     
-    char *buffer = m_write_buffer.data();
-    
     std::size_t len = frame.tot_len;
-    frame = ipBufTakeBytes(frame, len, buffer);
     
-    auto write_res = ::write(*m_fd, buffer, len);
+    struct iovec iov[MaxWriteIovecs];
+    std::size_t num_iov;
+    if (!AIpStack::ipBufToIovec(frame, iov, MaxWriteIovecs, num_iov)) {
+        char *buffer = m_write_buffer.data();
+        AIpStack::ipBufTakeBytes(frame, len, buffer);
+        iov[0].iov_base = buffer;
+        iov[0].iov_len = len;
+        num_iov = 1;
+    }
+    
+    auto write_res = ::writev(*m_fd, iov, int(num_iov));
     if (write_res < 0) {
         int error = errno;
         if (AIpStack::FileDescriptorWrapper::errIsEAGAINorEWOULDBLOCK(error)) {
@@ -143,40 +170,76 @@ void TapDeviceLinux::handleFdEvents (AIpStack::EventLoopFdEvents events)
 {
     AIPSTACK_ASSERT(m_active);
     
-    do {
-        if ((events & AIpStack::EventLoopFdEvents::Error) != AIpStack::Enum0) {
-            std::fprintf(stderr, "TapDeviceLinux: Error event. Stopping.\n");
-            goto error;
-        }
-        if ((events & AIpStack::EventLoopFdEvents::Hup) != AIpStack::Enum0) {
-            std::fprintf(stderr, "TapDeviceLinux: HUP event. Stopping.\n");
-            goto error;
-        }
+    if ((events & AIpStack::EventLoopFdEvents::Error) != AIpStack::Enum0) {
+        std::fprintf(stderr, "TapDeviceLinux: Error event. Stopping.\n");
+        goto error;
+    }
+    if ((events & AIpStack::EventLoopFdEvents::Hup) != AIpStack::Enum0) {
+        std::fprintf(stderr, "TapDeviceLinux: HUP event. Stopping.\n");
+        goto error;
+    }
+    
+    {
+        // Read up to m_rx_burst_size frames into the ring of frame buffers.
+        AIpStack::IpPacketBufPool *rx_pool = m_rx_pool;
+        std::size_t num_frames = 0;
+        bool read_error = false;
         
-        auto read_res = ::read(*m_fd, m_read_buffer.data(), m_frame_mtu);
-        if (read_res <= 0) {
-            bool is_error = false;
-            if (read_res < 0) {
-                int err = errno;
-                is_error = !AIpStack::FileDescriptorWrapper::errIsEAGAINorEWOULDBLOCK(err);
-            }
-            if (is_error) {
-                std::fprintf(stderr, "TapDeviceLinux: read failed. Stopping.\n");
-                goto error;
+        while (num_frames < m_rx_burst_size) {
+            // Use a pool buffer if possible, otherwise the slot in the ring.
+            AIpStack::IpPacketBuf *pool_buf =
+                (rx_pool != nullptr) ? rx_pool->alloc() : nullptr;
+            char *frame_buffer = (pool_buf != nullptr) ? pool_buf->getNode()->ptr :
+                m_read_buffer.data() + num_frames * m_frame_mtu;
+            
+            auto read_res = ::read(*m_fd, frame_buffer, m_frame_mtu);
+            if (read_res <= 0) {
+                if (pool_buf != nullptr) {
+                    rx_pool->unref(*pool_buf);
+                }
+                if (read_res < 0) {
+                    int err = errno;
+                    read_error = !AIpStack::FileDescriptorWrapper::errIsEAGAINorEWOULDBLOCK(err);
+                }
+                break;
             }
-            return;
+            
+            AIPSTACK_ASSERT(std::size_t(read_res) <= m_frame_mtu);
+            
+            m_read_lengths[num_frames] = std::size_t(read_res);
+            m_read_pool_bufs[num_frames] = pool_buf;
+            num_frames++;
         }
         
-        AIPSTACK_ASSERT(std::size_t(read_res) <= m_frame_mtu);
+        // Deliver the frames which have been read as one burst.
+        for (std::size_t i = 0; i < num_frames; i++) {
+            std::size_t frame_len = m_read_lengths[i];
+            AIpStack::IpPacketBuf *pool_buf = m_read_pool_bufs[i];
+            
+            if (pool_buf != nullptr) {
+                // The handler may take its own reference, then we release ours.
+                m_handler(pool_buf->getBufRef(frame_len));
+                rx_pool->unref(*pool_buf);
+            } else {
+                AIpStack::IpBufNode node{
+                    m_read_buffer.data() + i * m_frame_mtu,
+                    frame_len,
+                    nullptr
+                };
+                
+                m_handler(AIpStack::IpBufRef{&node, 0, frame_len});
+            }
+        }
         
-        AIpStack::IpBufNode node{
-            m_read_buffer.data(),
-            std::size_t(read_res),
-            nullptr
-        };
+        if (num_frames > 0 && m_burst_end_handler) {
+            m_burst_end_handler();
+        }
         
-        m_handler(AIpStack::IpBufRef{&node, 0, std::size_t(read_res)});
-    } while (false);
+        if (read_error) {
+            std::fprintf(stderr, "TapDeviceLinux: read failed. Stopping.\n");
+            goto error;
+        }
+    }
     
     return;
     
@@ -34,6 +34,7 @@
 #include <aipstack/misc/platform_specific/FileDescriptorWrapper.h>
 #include <aipstack/infra/Err.h>
 #include <aipstack/infra/Buf.h>
+#include <aipstack/infra/PacketBufPool.h>
 #include <aipstack/event_loop/EventLoop.h>
 
 namespace AIpStack {
@@ -44,8 +45,12 @@ class TapDeviceLinux :
 public:
     using FrameReceivedHandler = Function<void(AIpStack::IpBufRef frame)>;
 
+    using BurstEndHandler = Function<void()>;
+
     TapDeviceLinux (AIpStack::EventLoop &loop, std::string const &device_id,
-                    FrameReceivedHandler handler);
+                    FrameReceivedHandler handler,
+                    BurstEndHandler burst_end_handler = nullptr,
+                    std::size_t rx_burst_size = 1);
     
     ~TapDeviceLinux ();
     
@@ -53,15 +58,37 @@ public:
 
     AIpStack::IpErr sendFrame (AIpStack::IpBufRef frame);
 
+    // Receive frames into buffers from the given pool (Linux only). Frame handlers
+    // may then retain frames using IpPacketBufPool::takeRef; the same pool should be
+    // given as EthIfaceDriverParams::rx_pool so the stack can retain received
+    // packets without copying them. If no pool buffer is available, a frame is
+    // received into internal memory as without a pool. The pool buffer size must
+    // be at least getMtu() and the pool must outlive this object or be unset (by
+    // passing null) before it is destructed.
+    void setRxPool (AIpStack::IpPacketBufPool *pool);
+
 private:
     void handleFdEvents (AIpStack::EventLoopFdEvents events);
 
+    // Frames with up to this many chunks are written directly from the
+    // buffers using writev, others are first copied to m_write_buffer.
+    static constexpr std::size_t MaxWriteIovecs = 16;
+
 private:
     FrameReceivedHandler m_handler;
+    BurstEndHandler m_burst_end_handler;
     AIpStack::FileDescriptorWrapper m_fd;
     AIpStack::EventLoopFdWatcher m_fd_watcher;
     std::size_t m_frame_mtu;
+    std::size_t m_rx_burst_size;
+    // Ring of m_rx_burst_size frame buffers of m_frame_mtu bytes each.
     std::vector<char> m_read_buffer;
+    // Lengths of the frames read in the current burst.
+    std::vector<std::size_t> m_read_lengths;
+    // Pool buffers of the frames read in the current burst (null if read into
+    // m_read_buffer).
+    std::vector<AIpStack::IpPacketBuf *> m_read_pool_bufs;
+    AIpStack::IpPacketBufPool *m_rx_pool;
     std::vector<char> m_write_buffer;
     bool m_active;    
 };
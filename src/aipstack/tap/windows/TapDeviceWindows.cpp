@@ -74,9 +74,11 @@ void TapDeviceWindows::IoUnit::iocpNotifierHandler ()
 }
 
 TapDeviceWindows::TapDeviceWindows (
-    EventLoop &loop, std::string const &device_id, FrameReceivedHandler handler)
+    EventLoop &loop, std::string const &device_id, FrameReceivedHandler handler,
+    BurstEndHandler burst_end_handler, [[maybe_unused]] std::size_t rx_burst_size)
 :
     m_handler(handler),
+    m_burst_end_handler(burst_end_handler),
     m_send_first(0),
     m_send_count(0),
     m_send_units(ResourceArrayInitSame(), std::ref(loop), std::ref(*this)),
@@ -250,6 +252,11 @@ void TapDeviceWindows::recvCompleted (IoUnit &recv_unit)
     
     m_handler(IpBufRef{&node, 0, (std::size_t)bytes});
     
+    // Only one frame is received at a time, so each frame is a burst.
+    if (m_burst_end_handler) {
+        m_burst_end_handler();
+    }
+    
     startRecv();
 }
 
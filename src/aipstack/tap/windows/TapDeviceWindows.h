@@ -68,8 +68,12 @@ class TapDeviceWindows :
 public:
     using FrameReceivedHandler = Function<void(AIpStack::IpBufRef frame)>;
     
+    using BurstEndHandler = Function<void()>;
+    
     TapDeviceWindows (EventLoop &loop, std::string const &device_id,
-                      FrameReceivedHandler handler);
+                      FrameReceivedHandler handler,
+                      BurstEndHandler burst_end_handler = nullptr,
+                      std::size_t rx_burst_size = 1);
 
     ~TapDeviceWindows ();
     
@@ -86,6 +90,7 @@ private:
     
 private:
     FrameReceivedHandler m_handler;
+    BurstEndHandler m_burst_end_handler;
     std::shared_ptr<WinHandleWrapper> m_device;
     std::size_t m_frame_mtu;
     std::size_t m_send_first;
@@ -34,16 +34,17 @@
 #include <aipstack/misc/Hints.h>
 #include <aipstack/misc/Assert.h>
 #include <aipstack/misc/Use.h>
-#include <aipstack/misc/IntRange.h>
 #include <aipstack/misc/MinMax.h>
 #include <aipstack/misc/ResourceArray.h>
 #include <aipstack/misc/NonCopyable.h>
 #include <aipstack/misc/OneOf.h>
 #include <aipstack/misc/EnumUtils.h>
+#include <aipstack/misc/Function.h>
 #include <aipstack/structure/LinkedList.h>
 #include <aipstack/structure/LinkModel.h>
 #include <aipstack/structure/StructureRaiiWrapper.h>
 #include <aipstack/structure/Accessor.h>
+#include <aipstack/structure/OperatorKeyCompare.h>
 #include <aipstack/infra/Buf.h>
 #include <aipstack/infra/SendRetry.h>
 #include <aipstack/infra/Options.h>
@@ -51,17 +52,22 @@
 #include <aipstack/proto/Tcp4Proto.h>
 #include <aipstack/ip/IpAddr.h>
 #include <aipstack/ip/IpStack.h>
+#include <aipstack/ip/IpEphemeralPortAllocator.h>
 #include <aipstack/platform/PlatformFacade.h>
 #include <aipstack/tcp/TcpState.h>
 #include <aipstack/tcp/TcpSeqNum.h>
 #include <aipstack/tcp/TcpPcbFlags.h>
 #include <aipstack/tcp/TcpOosBuffer.h>
+#include <aipstack/tcp/TcpSackScoreboard.h>
+#include <aipstack/tcp/TcpCongControl.h>
 #include <aipstack/tcp/TcpApi.h>
 #include <aipstack/tcp/TcpListener.h>
 #include <aipstack/tcp/TcpConnection.h>
 #include <aipstack/tcp/TcpMultiTimer.h>
 #include <aipstack/tcp/TcpPcbKey.h>
 #include <aipstack/tcp/TcpOptions.h>
+#include <aipstack/tcp/TcpSynCookie.h>
+#include <aipstack/tcp/TcpFastOpenCache.h>
 #include <aipstack/tcp/IpTcpProto_constants.h>
 #include <aipstack/tcp/IpTcpProto_input.h>
 #include <aipstack/tcp/IpTcpProto_output.h>
@@ -76,16 +82,24 @@ class IpTcpProto :
     private NonCopyable<IpTcpProto<Arg>>,
     private TcpApi<Arg>
 {
-    AIPSTACK_USE_VALS(Arg::Params, (TcpTTL, NumTcpPcbs, NumOosSegs,
-        EphemeralPortFirst, EphemeralPortLast, LinkWithArrayIndices))
-    AIPSTACK_USE_TYPES(Arg::Params, (PcbIndexService))
+    AIPSTACK_USE_VALS(Arg::Params, (TcpTTL, NumTcpPcbs, NumTimeWaitRecords, NumOosSegs,
+        EphemeralPortFirst, EphemeralPortLast, LinkWithArrayIndices,
+        SackEnabled, NumSackRanges, TimestampsEnabled, DelayedAckTimeMs,
+        PacingEnabled, PacingBurstSegs, RackTlpEnabled, FrtoEnabled,
+        SynCookiesEnabled, SynCookieThresholdPercent, FastOpenEnabled,
+        NumFastOpenCookies))
+    AIPSTACK_USE_TYPES(Arg::Params, (PcbIndexService, CongControl))
     AIPSTACK_USE_TYPES(Arg, (PlatformImpl, StackArg))
     
     using Platform = PlatformFacade<PlatformImpl>;
     AIPSTACK_USE_TYPE(Platform, TimeType)
     
     static_assert(NumTcpPcbs > 0);
+    static_assert(NumTimeWaitRecords > 0);
     static_assert(NumOosSegs > 0 && NumOosSegs < 16);
+    static_assert(NumSackRanges > 0 && NumSackRanges < 16);
+    static_assert(PacingBurstSegs > 0);
+    static_assert(SynCookieThresholdPercent <= 100);
     static_assert(EphemeralPortFirst > 0);
     static_assert(EphemeralPortFirst <= EphemeralPortLast);
     
@@ -103,10 +117,15 @@ class IpTcpProto :
     AIPSTACK_USE_TYPES(Constants, (RttType))
     
     struct TcpPcb;
+    struct TcpTimeWait;
     
-    // Number of ephemeral ports.
-    inline static constexpr PortNum NumEphemeralPorts =
-        EphemeralPortLast - EphemeralPortFirst + 1;
+    // Number of SYN_RCVD PCBs at which SYN cookies start being used.
+    inline static constexpr int SynCookieThreshold =
+        MaxValue(1, int(NumTcpPcbs * std::int64_t(SynCookieThresholdPercent) / 100));
+    
+    // Delayed ACK timeout (zero if delayed ACKs are disabled).
+    inline static constexpr TimeType DelayedAckTicks =
+        (DelayedAckTimeMs / 1000.0) * Platform::TimeFreq;
     
     // Unsigned integer type usable as an index for the PCBs array.
     // We use the largest value of that type as null (which cannot
@@ -114,12 +133,22 @@ class IpTcpProto :
     using PcbIndexType = ChooseIntForMax<NumTcpPcbs, false>;
     inline static constexpr PcbIndexType PcbIndexNull = PcbIndexType(-1);
     
+    // Same for the TIME_WAIT records array.
+    using TimeWaitIndexType = ChooseIntForMax<NumTimeWaitRecords, false>;
+    inline static constexpr TimeWaitIndexType TimeWaitIndexNull = TimeWaitIndexType(-1);
+    
     // Instantiate the out-of-sequence buffering.
     using OosBufferService = TcpOosBufferService<
         TcpOosBufferServiceOptions::NumOosSegs::Is<NumOosSegs>
     >;
     AIPSTACK_MAKE_INSTANCE(OosBuffer, (OosBufferService))
     
+    // Instantiate the SACK scoreboard.
+    using SackScoreboardService = TcpSackScoreboardService<
+        TcpSackScoreboardServiceOptions::NumSackRanges::Is<NumSackRanges>
+    >;
+    AIPSTACK_MAKE_INSTANCE(SackScoreboard, (SackScoreboardService))
+    
     struct PcbLinkModel;
     
     // Instantiate the PCB index.
@@ -128,9 +157,25 @@ class IpTcpProto :
     struct PcbIndexKeyFuncs;
     AIPSTACK_MAKE_INSTANCE(PcbIndex, (PcbIndexService::template Index<
         PcbIndexAccessor, PcbIndexLookupKeyArg, PcbIndexKeyFuncs, PcbLinkModel,
-        /*Duplicates=*/false>))
+        /*Duplicates=*/false, /*MaxEntries=*/NumTcpPcbs>))
     
+    // Instantiate the TIME_WAIT index, with TIME_WAIT records
+    // indexed by the same key as PCBs.
+    struct TimeWaitLinkModel;
+    struct TimeWaitIndexAccessor;
+    struct TimeWaitIndexKeyFuncs;
+    AIPSTACK_MAKE_INSTANCE(TimeWaitIndex, (PcbIndexService::template Index<
+        TimeWaitIndexAccessor, PcbIndexLookupKeyArg, TimeWaitIndexKeyFuncs,
+        TimeWaitLinkModel, /*Duplicates=*/false,
+        /*MaxEntries=*/NumTimeWaitRecords>))
+    
+    // Instantiate the listener index, with listeners indexed by port.
+    struct ListenerIndexAccessor;
+    struct ListenerIndexKeyFuncs;
     using ListenerLinkModel = PointerLinkModel<TcpListener<Arg>>;
+    AIPSTACK_MAKE_INSTANCE(ListenerIndex, (PcbIndexService::template Index<
+        ListenerIndexAccessor, PortNum, ListenerIndexKeyFuncs, ListenerLinkModel,
+        /*Duplicates=*/true>))
     
     using Listener = TcpListener<Arg>;
     using Connection = TcpConnection<Arg>;
@@ -147,15 +192,17 @@ class IpTcpProto :
     
     /**
      * Timers:
-     * AbrtTimer: for aborting PCB (TIME_WAIT, abandonment)
+     * AbrtTimer: for aborting PCB (connection timeouts, abandonment)
      * OutputTimer: for pcb_output after send buffer extension
      * RtxTimer: for retransmission, window probe and cwnd idle reset
+     * AckTimer: for sending a delayed ACK
      */
     struct AbrtTimer {};
     struct OutputTimer {};
     struct RtxTimer {};
-    using PcbMultiTimer = TcpMultiTimer<
-        PlatformImpl, TcpPcb, MultiTimerUserData, AbrtTimer, OutputTimer, RtxTimer>;
+    struct AckTimer {};
+    using PcbMultiTimer = TcpMultiTimer<PlatformImpl, TcpPcb, MultiTimerUserData,
+        AbrtTimer, OutputTimer, RtxTimer, AckTimer>;
     
     /**
      * A TCP Protocol Control Block.
@@ -222,9 +269,16 @@ class IpTcpProto :
         typename IpTcpProto::TimeType rtt_test_time;
         RttType rto;
         
+        // Timestamps option state (used only with TsOpt): the most recent
+        // timestamp received from the peer which is to be echoed (TS.Recent),
+        // and our own timestamp clock when it was updated (for PAWS).
+        std::uint32_t ts_recent;
+        std::uint32_t ts_recent_time;
+        
         // The maximum segment size we will send.
         // This is dynamic based on Path MTU Discovery, but it will always
-        // be between Constants::MinAllowedMss and base_snd_mss.
+        // be between Constants::MinSndMss and base_snd_mss. With timestamps
+        // it is reduced by the length of the option (RFC 6691).
         // It is first properly initialized at the transition to ESTABLISHED
         // state, before that in SYN_SENT/SYN_RCVD is is used to store the
         // pmtu/iface_mss respectively.
@@ -233,13 +287,13 @@ class IpTcpProto :
         // ssthresh, cwnd and rtx_timer (see pcb_pmtu_changed).
         std::uint16_t snd_mss;
         
-        // NOTE: The following 5 fields are uint32_t to encourage compilers
+        // Flags (see comments in TcpPcbFlags).
+        TcpPcbFlagsBaseType flags;
+        
+        // NOTE: The following 4 fields are uint32_t to encourage compilers
         // to pack them into a single 32-bit word, if they were narrower
         // they may be packed less efficiently.
         
-        // Flags (see comments in TcpPcbFlags).
-        std::uint32_t flags : TcpPcbFlagsBits;
-        
         // PCB state.
         std::uint32_t state_val : TcpState::Bits;
         
@@ -320,6 +374,11 @@ class IpTcpProto :
             Output::pcb_rtx_timer_handler(this);
         }
         
+        inline void timerExpired (AckTimer)
+        {
+            Output::pcb_ack_timer_handler(this);
+        }
+        
         // Send retry callback.
         void retrySending () override final {
             Output::pcb_send_retry(this);
@@ -330,6 +389,44 @@ class IpTcpProto :
     struct PcbIndexAccessor : public MemberAccessor<
         TcpPcb, typename PcbIndex::Node, &TcpPcb::index_hook> {};
     
+    /**
+     * A TIME_WAIT record.
+     * A PCB entering TIME_WAIT is closed right away and only what is needed
+     * to respond to segments of the old connection is kept here, so that
+     * connections in TIME_WAIT do not occupy PCBs.
+     */
+    struct TcpTimeWait :
+        // Local/remote IP address and port
+        public TcpPcbKey
+    {
+        // Node for the TIME_WAIT index.
+        typename TimeWaitIndex::Node index_hook;
+        
+        // Node for the list of used records (ordered by expire_time)
+        // or the list of free records.
+        LinkedListNode<TimeWaitLinkModel> list_node;
+        
+        // Time when the TIME_WAIT ends.
+        TimeType expire_time;
+        
+        // Sequence numbers for ACKs (snd_nxt is the snd_una of the PCB).
+        TcpSeqNum snd_nxt;
+        TcpSeqNum rcv_nxt;
+        
+        // Receive window in bytes for checking RSTs, and its scaled
+        // value to be put into ACKs.
+        TcpSeqInt rcv_ann_wnd;
+        std::uint16_t window_size;
+        
+        // Whether the timestamps option was used, and TS.Recent.
+        bool ts_used;
+        std::uint32_t ts_recent;
+    };
+    
+    // Define the hook accessor for the TIME_WAIT index.
+    struct TimeWaitIndexAccessor : public MemberAccessor<
+        TcpTimeWait, typename TimeWaitIndex::Node, &TcpTimeWait::index_hook> {};
+    
 public:
     /**
      * Initialize the TCP protocol implementation.
@@ -339,10 +436,25 @@ public:
     IpTcpProto (IpProtocolHandlerArgs<StackArg> args) :
         m_stack(args.stack),
         m_current_pcb(nullptr),
-        m_next_ephemeral_port(EphemeralPortFirst),
+        m_burst_ack_pcb(nullptr),
+        m_rx_burst(false),
+        m_num_syn_rcvd_pcbs(0),
+        m_time_wait_timer(args.platform,
+            AIPSTACK_BIND_MEMBER_TN(&IpTcpProto::time_wait_timer_handler, this)),
         m_pcbs(ResourceArrayInitSame(), args.platform, this)
     {
         AIPSTACK_ASSERT(args.stack != nullptr);
+        
+        // Add all TIME_WAIT records to the free list.
+        for (TcpTimeWait &tw : m_time_waits) {
+            m_time_wait_free_list.append({tw, *this}, *this);
+        }
+        
+        // Derive an initial SYN cookie key, the application should
+        // set a random one using TcpApi::setSynCookieKey.
+        m_syn_cookie_key = TcpSynCookie::Key{
+            std::uint64_t(platform().getTime()),
+            std::uint64_t(reinterpret_cast<std::uintptr_t>(this))};
     }
     
     /**
@@ -353,7 +465,7 @@ public:
      */
     ~IpTcpProto ()
     {
-        AIPSTACK_ASSERT(m_listeners_list.isEmpty());
+        AIPSTACK_ASSERT(m_listener_index.isEmpty());
         AIPSTACK_ASSERT(m_current_pcb == nullptr);
     }
     
@@ -373,6 +485,11 @@ public:
         Input::handleIp4DestUnreach(this, du_meta, ip_info, dgram_initial);
     }
     
+    inline void handleRxBurstEnd ([[maybe_unused]] IpIface<StackArg> *iface)
+    {
+        Output::send_burst_ack(this);
+    }
+    
 private:
     inline Platform platform () const
     {
@@ -405,6 +522,7 @@ private:
         AIPSTACK_ASSERT(!pcb->tim(AbrtTimer()).isSet());
         AIPSTACK_ASSERT(!pcb->tim(OutputTimer()).isSet());
         AIPSTACK_ASSERT(!pcb->tim(RtxTimer()).isSet());
+        AIPSTACK_ASSERT(!pcb->tim(AckTimer()).isSet());
         AIPSTACK_ASSERT(!pcb->IpSendRetryRequest::isActive());
         AIPSTACK_ASSERT(pcb->tcp == this);
         AIPSTACK_ASSERT(pcb->state() == TcpStates::CLOSED);
@@ -415,8 +533,7 @@ private:
     {
         // This function aborts a PCB while sending an RST in
         // all states except these.
-        bool send_rst = pcb->state() !=
-            OneOf(TcpStates::SYN_SENT, TcpStates::SYN_RCVD, TcpStates::TIME_WAIT);
+        bool send_rst = pcb->state() != OneOf(TcpStates::SYN_SENT, TcpStates::SYN_RCVD);
         
         pcb_abort(pcb, send_rst);
     }
@@ -447,13 +564,14 @@ private:
             tcp->m_current_pcb = nullptr;
         }
         
-        // Remove the PCB from the index in which it is.
-        if (pcb->state() == TcpStates::TIME_WAIT) {
-            tcp->m_pcb_index_timewait.removeEntry({*pcb, *tcp}, *tcp);
-        } else {
-            tcp->m_pcb_index_active.removeEntry({*pcb, *tcp}, *tcp);
+        // Forget any ACK deferred to the end of the receive burst.
+        if (tcp->m_burst_ack_pcb == pcb) {
+            tcp->m_burst_ack_pcb = nullptr;
         }
         
+        // Remove the PCB from the index.
+        tcp->m_pcb_index_active.removeEntry({*pcb, *tcp}, *tcp);
+        
         // Make sure the PCB is at the end of the unreferenced list.
         if (pcb != tcp->m_unrefed_pcbs_list.lastNotEmpty(*tcp)) {
             tcp->m_unrefed_pcbs_list.remove({*pcb, *tcp}, *tcp);
@@ -468,40 +586,115 @@ private:
         tcp->pcb_assert_closed(pcb);
     }
     
-    // NOTE: doDelayedTimerUpdate must be called after return.
-    // We are okay because this is only called from pcb_input.
+    // This closes the PCB and keeps the TIME_WAIT state in a TIME_WAIT record.
+    // Since the PCB is closed, input processing must not continue after this.
     static void pcb_go_to_time_wait (TcpPcb *pcb)
     {
-        AIPSTACK_ASSERT(pcb->state() !=
-            OneOf(TcpStates::CLOSED, TcpStates::SYN_RCVD, TcpStates::TIME_WAIT));
+        AIPSTACK_ASSERT(pcb->state() ==
+            OneOf(TcpStates::CLOSING, TcpStates::FIN_WAIT_2_TIME_WAIT));
+        IpTcpProto *tcp = pcb->tcp;
         
-        // Disassociate any Connection. This will call the
-        // connectionAborted callback if we do have a Connection.
-        pcb_unlink_con(pcb, false);
+        // Send any pending ACK (for the FIN) while we still have the PCB.
+        if (pcb->hasAndClearFlag(TcpPcbFlags::AckPending)) {
+            Output::pcb_send_empty_ack(pcb);
+        }
         
-        // Set snd_nxt to snd_una in order to not accept any more acknowledgements.
-        // This is currently not necessary since we only enter TIME_WAIT after
-        // having received a FIN, but in the future we might do some non-standard
-        // transitions where this is not the case.
-        pcb->snd_nxt = pcb->snd_una;
+        // Get a TIME_WAIT record.
+        TcpTimeWait *tw = tcp->allocate_time_wait();
+        
+        // Fill in the record. Using snd_una as snd_nxt means that no more
+        // acknowledgements would be accepted. This is currently not necessary
+        // since we only enter TIME_WAIT after having received a FIN, but in
+        // the future we might do some non-standard transitions where this is
+        // not the case.
+        static_cast<TcpPcbKey &>(*tw) = *pcb;
+        tw->snd_nxt = pcb->snd_una;
+        tw->rcv_nxt = pcb->rcv_nxt;
+        tw->rcv_ann_wnd = pcb->rcv_ann_wnd;
+        tw->window_size = Input::pcb_ann_wnd(pcb);
+        tw->ts_used = pcb->hasFlag(TcpPcbFlags::TsOpt);
+        tw->ts_recent = pcb->ts_recent;
+        
+        // Insert the record into the TIME_WAIT index and start the timeout.
+        tcp->m_pcb_index_timewait.addEntry({*tw, *tcp}, *tcp);
+        tcp->start_time_wait_timeout(tw);
+        
+        // Close the PCB (without RST). This will disassociate any Connection
+        // and call the connectionAborted callback if we do have a Connection.
+        pcb_abort(pcb, false);
+    }
+    
+    TcpTimeWait * allocate_time_wait ()
+    {
+        TcpTimeWait *tw;
         
-        // Change state.
-        pcb->setState(TcpStates::TIME_WAIT);
+        if (AIPSTACK_LIKELY(!m_time_wait_free_list.isEmpty())) {
+            // Take a free record.
+            tw = m_time_wait_free_list.first(*this);
+            m_time_wait_free_list.remove({*tw, *this}, *this);
+        } else {
+            // No free record, end the oldest TIME_WAIT early and reuse its
+            // record. Any timer update is done by start_time_wait_timeout.
+            tw = m_time_wait_list.first(*this);
+            m_time_wait_list.remove({*tw, *this}, *this);
+            m_pcb_index_timewait.removeEntry({*tw, *this}, *this);
+        }
         
-        // Move the PCB from the active index to the time-wait index.
-        IpTcpProto *tcp = pcb->tcp;
-        tcp->m_pcb_index_active.removeEntry({*pcb, *tcp}, *tcp);
-        tcp->m_pcb_index_timewait.addEntry({*pcb, *tcp}, *tcp);
+        return tw;
+    }
+    
+    void free_time_wait (TcpTimeWait *tw)
+    {
+        m_pcb_index_timewait.removeEntry({*tw, *this}, *this);
+        m_time_wait_list.remove({*tw, *this}, *this);
+        m_time_wait_free_list.prepend({*tw, *this}, *this);
         
-        // Stop timers due to asserts in their handlers.
-        pcb->tim(OutputTimer()).unset();
-        pcb->tim(RtxTimer()).unset();
+        update_time_wait_timer();
+    }
+    
+    // Set the expiration time of a TIME_WAIT record, which must not be in the
+    // list of used records, and add it to the end of that list.
+    void start_time_wait_timeout (TcpTimeWait *tw)
+    {
+        tw->expire_time = platform().getTime() + Constants::TimeWaitTimeTicks;
+        m_time_wait_list.append({*tw, *this}, *this);
         
-        // Clear the OutPending flag due to its preconditions.
-        pcb->clearFlag(TcpPcbFlags::OutPending);
+        update_time_wait_timer();
+    }
+    
+    // Restart the timeout of a TIME_WAIT record (the list remains sorted
+    // since the record gets the latest expiration time).
+    void restart_time_wait_timeout (TcpTimeWait *tw)
+    {
+        m_time_wait_list.remove({*tw, *this}, *this);
+        start_time_wait_timeout(tw);
+    }
+    
+    // Set the TIME_WAIT timer for the record which expires first.
+    void update_time_wait_timer ()
+    {
+        TcpTimeWait *tw = m_time_wait_list.first(*this);
+        if (tw == nullptr) {
+            m_time_wait_timer.unset();
+        } else {
+            m_time_wait_timer.setAt(tw->expire_time);
+        }
+    }
+    
+    void time_wait_timer_handler ()
+    {
+        // Free any expired records, these are at the start of the list.
+        TimeType now = platform().getTime();
+        TcpTimeWait *tw;
+        while ((tw = m_time_wait_list.first(*this)) != nullptr &&
+               Platform::timeGreaterOrEqual(now, tw->expire_time))
+        {
+            m_pcb_index_timewait.removeEntry({*tw, *this}, *this);
+            m_time_wait_list.remove({*tw, *this}, *this);
+            m_time_wait_free_list.prepend({*tw, *this}, *this);
+        }
         
-        // Start the TIME_WAIT timeout.
-        pcb->tim(AbrtTimer()).setAfter(Constants::TimeWaitTimeTicks);
+        update_time_wait_timer();
     }
     
     // NOTE: doDelayedTimerUpdate must be called after return.
@@ -517,8 +710,9 @@ private:
         pcb->tim(OutputTimer()).unset();
         pcb->tim(RtxTimer()).unset();
         
-        // Clear the OutPending flag due to its preconditions.
-        pcb->clearFlag(TcpPcbFlags::OutPending);
+        // Clear the OutPending flag due to its preconditions, and PaceWait
+        // since the OutputTimer was stopped.
+        pcb->clearFlag(TcpPcbFlags::OutPending|TcpPcbFlags::PaceWait);
         
         // Reset the MTU reference.
         if (pcb->con != nullptr) {
@@ -563,6 +757,11 @@ private:
         AIPSTACK_ASSERT(lis->m_num_pcbs > 0);
         lis->m_num_pcbs--;
         
+        // Decrement the total count of SYN_RCVD PCBs.
+        IpTcpProto *tcp = pcb->tcp;
+        AIPSTACK_ASSERT(tcp->m_num_syn_rcvd_pcbs > 0);
+        tcp->m_num_syn_rcvd_pcbs--;
+        
         // Is this a PCB which is being accepted?
         if (lis->m_accept_pcb == pcb) {
             // Break the link from the listener.
@@ -570,7 +769,6 @@ private:
             
             // The PCB was removed from the list of unreferenced
             // PCBs, so we have to add it back.
-            IpTcpProto *tcp = pcb->tcp;
             tcp->m_unrefed_pcbs_list.append({*pcb, *tcp}, *tcp);
         }
         
@@ -658,13 +856,20 @@ private:
         return TcpSeqNum(TcpSeqInt(platform().getTime()));
     }
     
+    // Current value of the time counter for SYN cookies.
+    inline std::uint32_t syn_cookie_counter ()
+    {
+        return std::uint32_t(platform().getTime() / Constants::SynCookiePeriodTicks);
+    }
+    
     Listener * find_listener (Ip4Addr addr, PortNum port)
     {
-        for (Listener *lis = m_listeners_list.first();
-             lis != nullptr; lis = m_listeners_list.next(*lis))
+        for (Listener *lis = m_listener_index.findFirst(port);
+             lis != nullptr; lis = m_listener_index.findNext(port, *lis))
         {
             AIPSTACK_ASSERT(lis->m_listening);
-            if (lis->m_addr == addr && lis->m_port == port) {
+            AIPSTACK_ASSERT(lis->m_port == port);
+            if (lis->m_addr == addr) {
                 return lis;
             }
         }
@@ -733,14 +938,18 @@ private:
         
         // Initialize most of the PCB.
         pcb->setState(TcpStates::SYN_SENT);
-        // WndScale to send the window scale option
-        pcb->flags = AsUnderlying(TcpPcbFlags::WndScale);
+        // WndScale to send the window scale option, SackPerm to send
+        // the SACK-permitted option, TsOpt to send the timestamps option
+        pcb->flags = AsUnderlying(TcpPcbFlags::WndScale |
+            (SackEnabled ? TcpPcbFlags::SackPerm : TcpPcbFlags(0)) |
+            (TimestampsEnabled ? TcpPcbFlags::TsOpt : TcpPcbFlags(0)));
         pcb->con = con;
         pcb->local_addr = local_addr;
         pcb->remote_addr = remote_addr;
         pcb->local_port = local_port;
         pcb->remote_port = remote_port;
         pcb->rcv_nxt = TcpSeqNum(0u); // it is sent in the SYN
+        pcb->ts_recent = 0; // nothing to echo in the SYN
         pcb->rcv_ann_wnd = rcv_wnd;
         pcb->snd_una = iss;
         pcb->snd_nxt = iss;
@@ -751,6 +960,13 @@ private:
         pcb->snd_wnd_shift = 0;
         pcb->rcv_wnd_shift = Constants::RcvWndShift;
         
+        // With TCP Fast Open, the SYN carries a cookie or a cookie request.
+        bool syn_data = false;
+        if (FastOpenEnabled && args.fast_open) {
+            pcb->setFlag(TcpPcbFlags::FastOpen);
+            syn_data = m_fast_open_cache.find(remote_addr) != nullptr;
+        }
+        
         // Add the PCB to the active index.
         m_pcb_index_active.addEntry({*pcb, *this}, *this);
         
@@ -760,10 +976,17 @@ private:
         // Start the retransmission timer.
         pcb->tim(RtxTimer()).setAfter(Output::pcb_rto_time(pcb));
         
+        // If the SYN may carry data, send it from the OutputTimer so that the
+        // application can queue data after we return. Otherwise send it now.
+        if (syn_data) {
+            pcb->tim(OutputTimer()).setAfter(0);
+        }
+        
         pcb->doDelayedTimerUpdate();
         
-        // Send the SYN.
-        Output::pcb_send_syn(pcb);
+        if (!syn_data) {
+            Output::pcb_send_syn(pcb);
+        }
         
         // Return the PCB.
         *out_pcb = pcb;
@@ -773,17 +996,11 @@ private:
     PortNum get_ephemeral_port (
         Ip4Addr local_addr, Ip4Addr remote_addr, PortNum remote_port)
     {
-        for ([[maybe_unused]] PortNum i : IntRange(NumEphemeralPorts)) {
-            PortNum port = m_next_ephemeral_port;
-            m_next_ephemeral_port = (port < EphemeralPortLast) ?
-                (port + 1) : EphemeralPortFirst;
-            
-            if (find_pcb({local_addr, remote_addr, port, remote_port}) == nullptr) {
-                return port;
-            }
-        }
-        
-        return 0;
+        return m_ephemeral_ports.allocate(m_syn_cookie_key,
+            local_addr, remote_addr, remote_port, [&](PortNum port) {
+                TcpPcbKey key{local_addr, remote_addr, port, remote_port};
+                return find_pcb(key) == nullptr && find_time_wait(key) == nullptr;
+            });
     }
     
     inline static bool pcb_is_in_unreferenced_list (TcpPcb *pcb)
@@ -805,38 +1022,42 @@ private:
     // Find a PCB by address tuple.
     TcpPcb * find_pcb (TcpPcbKey const &key)
     {
-        // Look in the active index first.
         TcpPcb *pcb = m_pcb_index_active.findEntry(key, *this);
         AIPSTACK_ASSERT(pcb == nullptr ||
             pcb->state() != OneOf(TcpStates::CLOSED, TcpStates::TIME_WAIT));
-        
-        // If not found, look in the time-wait index.
-        if (AIPSTACK_UNLIKELY(pcb == nullptr)) {
-            pcb = m_pcb_index_timewait.findEntry(key, *this);
-            AIPSTACK_ASSERT(pcb == nullptr || pcb->state() == TcpStates::TIME_WAIT);
-        }
-        
         return pcb;
     }
     
+    // Find a TIME_WAIT record by address tuple.
+    inline TcpTimeWait * find_time_wait (TcpPcbKey const &key)
+    {
+        return m_pcb_index_timewait.findEntry(key, *this);
+    }
+    
     // Find a listener by local address and port. This also considers listeners bound
-    // to wildcard address since it is used to associate received segments with a listener.
+    // to wildcard address since it is used to associate received segments with a listener,
+    // but a listener bound to the specific address takes precedence.
     Listener * find_listener_for_rx (Ip4Addr local_addr, PortNum local_port)
     {
-        for (Listener *lis = m_listeners_list.first();
-             lis != nullptr; lis = m_listeners_list.next(*lis))
+        Listener *wildcard_lis = nullptr;
+        
+        for (Listener *lis = m_listener_index.findFirst(local_port);
+             lis != nullptr; lis = m_listener_index.findNext(local_port, *lis))
         {
             AIPSTACK_ASSERT(lis->m_listening);
-            if (lis->m_port == local_port &&
-                (lis->m_addr == local_addr || lis->m_addr.isZero()))
-            {
+            AIPSTACK_ASSERT(lis->m_port == local_port);
+            if (lis->m_addr == local_addr) {
                 return lis;
             }
+            if (lis->m_addr.isZero()) {
+                wildcard_lis = lis;
+            }
         }
-        return nullptr;
+        
+        return wildcard_lis;
     }
     
-    // This is used by the two PCB indexes to obtain the keys
+    // This is used by the PCB index to obtain the keys
     // defining the ordering of the PCBs and compare keys.
     // The key comparison functions are inherited from TcpPcbKeyCompare.
     struct PcbIndexKeyFuncs : public TcpPcbKeyCompare {
@@ -847,6 +1068,28 @@ private:
         }
     };
     
+    // Same for the TIME_WAIT index.
+    struct TimeWaitIndexKeyFuncs : public TcpPcbKeyCompare {
+        inline static TcpPcbKey const & GetKeyOfEntry (TcpTimeWait const &tw)
+        {
+            return tw;
+        }
+    };
+    
+    // This is used by the listener index to obtain the port of a listener.
+    struct ListenerIndexKeyFuncs : public OperatorKeyCompare {
+        inline static PortNum GetKeyOfEntry (Listener const &lis)
+        {
+            return lis.m_port;
+        }
+        
+        template<typename Hasher>
+        inline static void HashKey (PortNum port, Hasher &hasher)
+        {
+            hasher.addWord(port);
+        }
+    };
+    
     // Define the link model for data structures of PCBs.
     struct PcbArrayAccessor;
     struct PcbLinkModel : public std::conditional_t<LinkWithArrayIndices,
@@ -856,39 +1099,76 @@ private:
     > {};
     AIPSTACK_USE_TYPES(PcbLinkModel, (Ref, State))
     
+    // Define the link model for data structures of TIME_WAIT records.
+    struct TimeWaitArrayAccessor;
+    struct TimeWaitLinkModel : public std::conditional_t<LinkWithArrayIndices,
+        ArrayLinkModelWithAccessor<TcpTimeWait, TimeWaitIndexType, TimeWaitIndexNull,
+            IpTcpProto, TimeWaitArrayAccessor>,
+        PointerLinkModel<TcpTimeWait>
+    > {};
+    
 private:
-    using ListenersList = LinkedList<
-        MemberAccessor<Listener, LinkedListNode<ListenerLinkModel>,
-                       &Listener::m_listeners_node>,
-        ListenerLinkModel, false>;
+    struct ListenerIndexAccessor : public MemberAccessor<
+        Listener, typename ListenerIndex::Node, &Listener::m_index_node> {};
     
     using UnrefedPcbsList = LinkedList<
         MemberAccessor<TcpPcb, LinkedListNode<PcbLinkModel>, &TcpPcb::unrefed_list_node>,
         PcbLinkModel, true>;
     
+    using TimeWaitList = LinkedList<
+        MemberAccessor<TcpTimeWait, LinkedListNode<TimeWaitLinkModel>,
+            &TcpTimeWait::list_node>,
+        TimeWaitLinkModel, true>;
+    
     IpStack<StackArg> *m_stack;
-    StructureRaiiWrapper<ListenersList> m_listeners_list;
+    StructureRaiiWrapper<typename ListenerIndex::Index> m_listener_index;
     TcpPcb *m_current_pcb;
+    TcpPcb *m_burst_ack_pcb;
+    bool m_rx_burst;
     IpBufRef m_received_opts_buf;
     TcpOptions m_received_opts;
-    PortNum m_next_ephemeral_port;
+    IpEphemeralPortAllocator<EphemeralPortFirst, EphemeralPortLast> m_ephemeral_ports;
+    int m_num_syn_rcvd_pcbs;
+    TcpSynCookie::Key m_syn_cookie_key;
+    TcpFastOpenCache<(FastOpenEnabled ? NumFastOpenCookies : 0)> m_fast_open_cache;
     StructureRaiiWrapper<UnrefedPcbsList> m_unrefed_pcbs_list;
     StructureRaiiWrapper<typename PcbIndex::Index> m_pcb_index_active;
-    StructureRaiiWrapper<typename PcbIndex::Index> m_pcb_index_timewait;
+    StructureRaiiWrapper<typename TimeWaitIndex::Index> m_pcb_index_timewait;
+    StructureRaiiWrapper<TimeWaitList> m_time_wait_list;
+    StructureRaiiWrapper<TimeWaitList> m_time_wait_free_list;
+    typename Platform::Timer m_time_wait_timer;
     ResourceArray<TcpPcb, NumTcpPcbs> m_pcbs;
+    TcpTimeWait m_time_waits[NumTimeWaitRecords];
     
     struct PcbArrayAccessor : public MemberAccessor<
         IpTcpProto, ResourceArray<TcpPcb, NumTcpPcbs>, &IpTcpProto::m_pcbs> {};
+    
+    struct TimeWaitArrayAccessor : public MemberAccessor<
+        IpTcpProto, TcpTimeWait[NumTimeWaitRecords], &IpTcpProto::m_time_waits> {};
 };
 
 struct IpTcpProtoOptions {
     AIPSTACK_OPTION_DECL_VALUE(TcpTTL, std::uint8_t, 64)
     AIPSTACK_OPTION_DECL_VALUE(NumTcpPcbs, int, 32)
+    AIPSTACK_OPTION_DECL_VALUE(NumTimeWaitRecords, int, 32)
     AIPSTACK_OPTION_DECL_VALUE(NumOosSegs, std::uint8_t, 4)
     AIPSTACK_OPTION_DECL_VALUE(EphemeralPortFirst, std::uint16_t, 49152)
     AIPSTACK_OPTION_DECL_VALUE(EphemeralPortLast, std::uint16_t, 65535)
     AIPSTACK_OPTION_DECL_TYPE(PcbIndexService, void)
     AIPSTACK_OPTION_DECL_VALUE(LinkWithArrayIndices, bool, true)
+    AIPSTACK_OPTION_DECL_VALUE(SackEnabled, bool, false)
+    AIPSTACK_OPTION_DECL_VALUE(NumSackRanges, std::uint8_t, 4)
+    AIPSTACK_OPTION_DECL_VALUE(TimestampsEnabled, bool, false)
+    AIPSTACK_OPTION_DECL_VALUE(DelayedAckTimeMs, std::uint16_t, 0)
+    AIPSTACK_OPTION_DECL_TYPE(CongControl, TcpCongControlReno)
+    AIPSTACK_OPTION_DECL_VALUE(PacingEnabled, bool, false)
+    AIPSTACK_OPTION_DECL_VALUE(PacingBurstSegs, std::uint8_t, 4)
+    AIPSTACK_OPTION_DECL_VALUE(RackTlpEnabled, bool, false)
+    AIPSTACK_OPTION_DECL_VALUE(FrtoEnabled, bool, false)
+    AIPSTACK_OPTION_DECL_VALUE(SynCookiesEnabled, bool, false)
+    AIPSTACK_OPTION_DECL_VALUE(SynCookieThresholdPercent, std::uint8_t, 50)
+    AIPSTACK_OPTION_DECL_VALUE(FastOpenEnabled, bool, false)
+    AIPSTACK_OPTION_DECL_VALUE(NumFastOpenCookies, std::uint8_t, 8)
 };
 
 template<typename ...Options>
@@ -898,11 +1178,25 @@ class IpTcpProtoService {
     
     AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, TcpTTL)
     AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, NumTcpPcbs)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, NumTimeWaitRecords)
     AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, NumOosSegs)
     AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, EphemeralPortFirst)
     AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, EphemeralPortLast)
     AIPSTACK_OPTION_CONFIG_TYPE(IpTcpProtoOptions, PcbIndexService)
     AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, LinkWithArrayIndices)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, SackEnabled)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, NumSackRanges)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, TimestampsEnabled)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, DelayedAckTimeMs)
+    AIPSTACK_OPTION_CONFIG_TYPE(IpTcpProtoOptions, CongControl)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, PacingEnabled)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, PacingBurstSegs)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, RackTlpEnabled)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, FrtoEnabled)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, SynCookiesEnabled)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, SynCookieThresholdPercent)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, FastOpenEnabled)
+    AIPSTACK_OPTION_CONFIG_VALUE(IpTcpProtoOptions, NumFastOpenCookies)
     
 public:
     // This tells IpStack which IP protocol we receive packets for.
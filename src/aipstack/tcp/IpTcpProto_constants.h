@@ -36,6 +36,7 @@
 #include <aipstack/ip/IpStack.h>
 #include <aipstack/platform/PlatformFacade.h>
 #include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/tcp/TcpOptions.h>
 
 namespace AIpStack {
 
@@ -72,6 +73,11 @@ public:
     inline static constexpr std::uint16_t MinAllowedMss =
         IpStack<StackArg>::MinMTU - Ip4TcpHeaderSize;
     
+    // Minimum snd_mss, which may be less than MinAllowedMss due to
+    // the timestamps option being included in every segment.
+    inline static constexpr std::uint16_t MinSndMss =
+        MinAllowedMss - TcpOptionWriteLen::Timestamps;
+    
     // Common flags passed to IpStack::sendIp4Dgram.
     // We disable fragmentation of TCP segments sent by us, due to PMTUD.
     inline static constexpr IpSendFlags TcpIpSendFlags = IpSendFlags::DontFragmentFlag;
@@ -85,6 +91,10 @@ public:
     // How old at most an ACK may be to be considered acceptable (MAX.SND.WND in RFC 5961).
     inline static constexpr TcpSeqInt MaxAckBefore = 0xFFFF;
     
+    // Minimum distance of the ISS of a connection replacing one in TIME_WAIT
+    // from the snd_nxt of the old connection (more than an unscaled window).
+    inline static constexpr TcpSeqInt TimeWaitIssMargin = 0x10000;
+    
     // SYN_RCVD state timeout.
     inline static constexpr TimeType SynRcvdTimeoutTicks     = 20.0  * Platform::TimeFreq;
     
@@ -94,6 +104,10 @@ public:
     // TIME_WAIT state timeout.
     inline static constexpr TimeType TimeWaitTimeTicks       = 120.0 * Platform::TimeFreq;
     
+    // Period of the time counter used in SYN cookies. Cookies are accepted
+    // for up to TcpSynCookie::MaxCounterAge periods after they are sent.
+    inline static constexpr TimeType SynCookiePeriodTicks    = 64.0 * Platform::TimeFreq;
+    
     // Timeout to abort connection after it has been abandoned.
     inline static constexpr TimeType AbandonedTimeoutTicks   = 30.0  * Platform::TimeFreq;
     
@@ -126,10 +140,33 @@ public:
     inline static constexpr int DupAckBits =
         BitsInInt<FastRtxDupAcks + MaxAdditionaDupAcks>;
     
+    // Number of data segments acknowledged immediately at the start of a
+    // connection and after out-of-sequence data (quick-ACK), so as not to
+    // slow down the peer's slow start or loss recovery with delayed ACKs.
+    inline static constexpr std::uint8_t QuickAckSegs = 16;
+    
+    // Minimum loss probe timeout and the allowance added to it for a
+    // delayed ACK when a single segment is in flight (RFC 8985 section 7.2).
+    inline static constexpr RttType TlpMinTime               = 0.01 * RttTimeFreq;
+    inline static constexpr RttType TlpDelAckTime            = 0.2 * RttTimeFreq;
+    
+    // Reordering window for RACK relative to SRTT, as a shift count
+    // (RFC 8985 section 6.2 uses a quarter of the minimum RTT).
+    inline static constexpr int RackReoWndShift = 2;
+    
+    // Pacing rate relative to cwnd/srtt in slow start and congestion
+    // avoidance, in percent.
+    inline static constexpr std::uint32_t PacingGainSsPercent = 200;
+    inline static constexpr std::uint32_t PacingGainCaPercent = 125;
+    
     // Window scale shift count to send and use in outgoing ACKs.
     inline static constexpr std::uint8_t RcvWndShift = 6;
     static_assert(RcvWndShift <= 14);
     
+    // Time after which a TS.Recent is considered invalid for PAWS
+    // (RFC 7323 section 5.5), in units of the timestamp clock.
+    inline static constexpr std::uint32_t PawsIdleTime = 24.0 * 86400.0 * RttTimeFreq;
+    
     // Minimum amount to extend the receive window when a PCB is
     // abandoned before the FIN has been received.
     inline static constexpr TcpSeqInt MinAbandonRcvWndIncr = TypeMax<std::uint16_t>;
@@ -48,6 +48,7 @@
 #include <aipstack/tcp/TcpSeqNum.h>
 #include <aipstack/tcp/TcpPcbFlags.h>
 #include <aipstack/tcp/TcpOptions.h>
+#include <aipstack/tcp/TcpSynCookie.h>
 
 namespace AIpStack {
 
@@ -60,8 +61,8 @@ class IpTcpProto_input
 {
     using TcpProto = IpTcpProto<Arg>;
     
-    AIPSTACK_USE_TYPES(TcpProto, (Listener, Connection, TcpPcb, Output, Constants,
-                                  AbrtTimer, RtxTimer, OutputTimer, StackArg))
+    AIPSTACK_USE_TYPES(TcpProto, (Listener, Connection, TcpPcb, TcpTimeWait, Output,
+        Constants, AbrtTimer, RtxTimer, OutputTimer, StackArg, CongControl))
     AIPSTACK_USE_VALS(TcpProto, (pcb_aborted_in_callback))
     
 public:
@@ -89,14 +90,16 @@ public:
         tcp_meta.flags       = tcp_header.get(Tcp4Header::OffsetFlags());
         tcp_meta.window_size = tcp_header.get(Tcp4Header::WindowSize());
         
-        // Check TCP checksum.
-        IpChksumAccumulator chksum_accum;
-        chksum_accum.addWord(WrapType<std::uint32_t>(), ip_info.src_addr.value());
-        chksum_accum.addWord(WrapType<std::uint32_t>(), ip_info.dst_addr.value());
-        chksum_accum.addWord(WrapType<std::uint16_t>(), AsUnderlying(Ip4Protocol::Tcp));
-        chksum_accum.addWord(WrapType<std::uint16_t>(), std::uint16_t(dgram.tot_len));
-        if (AIPSTACK_UNLIKELY(chksum_accum.getChksum(dgram) != 0)) {
-            return;
+        // Check TCP checksum, unless the driver has already done that.
+        if ((ip_info.chksum_verified & IpChksumFlags::Transport) == Enum0) {
+            IpChksumAccumulator chksum_accum;
+            chksum_accum.addWord(WrapType<std::uint32_t>(), ip_info.src_addr.value());
+            chksum_accum.addWord(WrapType<std::uint32_t>(), ip_info.dst_addr.value());
+            chksum_accum.addWord(WrapType<std::uint16_t>(), AsUnderlying(Ip4Protocol::Tcp));
+            chksum_accum.addWord(WrapType<std::uint16_t>(), std::uint16_t(dgram.tot_len));
+            if (AIPSTACK_UNLIKELY(chksum_accum.getChksum(dgram) != 0)) {
+                return;
+            }
         }
         
         // Get a buffer reference starting at the option data.
@@ -121,6 +124,9 @@ public:
         tcp->m_received_opts_buf = tcp_data.subTo(opts_len);
         tcp_data = ipBufSkipBytes(tcp_data, opts_len);
         
+        // Remember if ACKs may be deferred to the end of the receive burst.
+        tcp->m_rx_burst = ip_info.iface->reportsRxBurstEnd();
+        
         // Try to handle using a PCB.
         TcpPcb *pcb = tcp->find_pcb({ip_info.dst_addr, ip_info.src_addr,
                                      tcp_meta.local_port, tcp_meta.remote_port});
@@ -129,6 +135,17 @@ public:
             return;
         }
         
+        // Try to handle using a TIME_WAIT record. If this is a SYN starting
+        // a new connection, we continue below so that the SYN is handled by a
+        // listener, which removes the record once it has created a PCB.
+        TcpTimeWait *tw = tcp->find_time_wait({ip_info.dst_addr, ip_info.src_addr,
+                                               tcp_meta.local_port, tcp_meta.remote_port});
+        if (AIPSTACK_UNLIKELY(tw != nullptr)) {
+            if (!time_wait_input(tcp, tw, tcp_meta)) {
+                return;
+            }
+        }
+        
         // Sanity check source address - reject broadcast addresses.
         // We do this after looking up the PCB for performance, since
         // the PCBs already have sanity checked addresses. There is a
@@ -142,7 +159,7 @@ public:
         // Try to handle using a listener.
         Listener *lis = tcp->find_listener_for_rx(ip_info.dst_addr, tcp_meta.local_port);
         if (lis != nullptr) {
-            return listen_input(lis, ip_info, tcp_meta, tcp_data.tot_len);
+            return listen_input(lis, ip_info, tcp_meta, tcp_data, tw);
         }
         
         // Reply with RST, unless this is an RST.
@@ -357,19 +374,36 @@ public:
         // Initialize some variables.
         Connection *con = pcb->con;
         con->m_v.snd_wnd = snd_wnd;
+        con->m_v.quick_acks = Constants::QuickAckSegs;
         con->m_v.cwnd = CalcInitialTcpCwnd(pcb->snd_mss);
         pcb->setFlag(TcpPcbFlags::CwndInit);
         con->m_v.ssthresh = Constants::MaxWindow;
         con->m_v.cwnd_acked = 0;
+        con->m_v.sack.init(pcb->snd_una);
+        CongControl::init(typename Output::CcContext{pcb});
     }
     
 private:
+    // If tw is not null, the segment is a SYN which may replace the connection
+    // in that TIME_WAIT record (see time_wait_input).
     static void listen_input (Listener *lis, IpRxInfoIp4<StackArg> const &ip_info,
-                              TcpSegMeta const &tcp_meta, std::size_t tcp_data_len)
+                              TcpSegMeta const &tcp_meta, IpBufRef tcp_data,
+                              TcpTimeWait *tw)
     {
         do {
             // For a new connection we expect SYN flag and no FIN, RST, ACK.
             if ((tcp_meta.flags & Tcp4Flags::BasicFlags) != Tcp4Flags::Syn) {
+                // An ACK without SYN and RST may complete a connection for
+                // which a SYN cookie was sent.
+                if (TcpProto::SynCookiesEnabled &&
+                    (tcp_meta.flags & (Tcp4Flags::Syn|Tcp4Flags::Rst|Tcp4Flags::Ack)) ==
+                        Tcp4Flags::Ack)
+                {
+                    if (listen_syn_cookie_ack_input(lis, ip_info, tcp_meta, tcp_data)) {
+                        return;
+                    }
+                }
+                
                 // If the segment has no RST and has ACK, reply with RST; otherwise drop.
                 // This includes dropping SYN+FIN packets though RFC 793 does not say this
                 // should be done.
@@ -379,16 +413,25 @@ private:
                 return;
             }
             
+            TcpProto *tcp = lis->m_tcp;
+            
+            // Use a SYN cookie instead of a PCB if the maximum number of PCBs for
+            // this listener is reached or if there are many SYN_RCVD PCBs overall.
+            // This way a SYN flood cannot take away all PCBs. But not for a SYN
+            // replacing a TIME_WAIT record, since the record would take the ACK
+            // and the ISS could not be chosen above the old snd_nxt.
+            bool lis_full = lis->m_num_pcbs >= lis->m_max_pcbs;
+            bool use_cookie = TcpProto::SynCookiesEnabled && tw == nullptr &&
+                (lis_full || tcp->m_num_syn_rcvd_pcbs >= TcpProto::SynCookieThreshold);
+            
             // Check maximum number of PCBs for this listener.
-            if (lis->m_num_pcbs >= lis->m_max_pcbs) {
+            if (lis_full && !use_cookie) {
                 goto refuse;
             }
             
             // Calculate the MSS based on the interface MTU.
             std::uint16_t iface_mss = ip_info.iface->getMtu() - Ip4TcpHeaderSize;
             
-            TcpProto *tcp = lis->m_tcp;
-            
             // Make sure received options are parsed.
             parse_received_opts(tcp);
             
@@ -400,6 +443,36 @@ private:
                 goto refuse;
             }
             
+            // Initially advertised receive window, at most 16-bit wide since
+            // SYN-ACK segments have unscaled window.
+            // NOTE: rcv_ann_wnd fits into size_t as required since m_initial_rcv_wnd
+            // also does (Listener::setInitialReceiveWindow).
+            AIPSTACK_ASSERT(lis->m_initial_rcv_wnd <= TypeMax<std::size_t>);
+            TcpSeqInt rcv_wnd = MinValueU(lis->m_initial_rcv_wnd, TypeMax<std::uint16_t>);
+            
+            if (use_cookie) {
+                // Encode the connection parameters into the SYN cookie and reply
+                // with a SYN-ACK which uses that as the initial sequence number.
+                // The timestamps option is not supported with SYN cookies.
+                TcpSynCookieInfo info;
+                info.mss = base_snd_mss;
+                info.wnd_scale =
+                    (tcp->m_received_opts.options & TcpOptionFlags::WndScale) != Enum0;
+                info.snd_wnd_shift = info.wnd_scale ?
+                    MinValue(std::uint8_t(14), tcp->m_received_opts.wnd_scale) : 0;
+                info.sack_perm = TcpProto::SackEnabled &&
+                    (tcp->m_received_opts.options & TcpOptionFlags::SackPerm) != Enum0;
+                
+                TcpPcbKey key{ip_info.dst_addr, ip_info.src_addr,
+                              tcp_meta.local_port, tcp_meta.remote_port};
+                TcpSeqNum iss = TcpSynCookie::encode(tcp->m_syn_cookie_key, key,
+                    tcp_meta.seq_num, tcp->syn_cookie_counter(), info);
+                
+                Output::send_syn_cookie_syn_ack(tcp, key, iss, tcp_meta.seq_num + 1u,
+                    std::uint16_t(rcv_wnd), iface_mss, info);
+                return;
+            }
+            
             // Allocate a PCB.
             TcpPcb *pcb = tcp->allocate_pcb();
             if (pcb == nullptr) {
@@ -409,35 +482,20 @@ private:
             // Generate an initial sequence number.
             TcpSeqNum iss = tcp->make_iss();
             
-            // Initially advertised receive window, at most 16-bit wide since
-            // SYN-ACK segments have unscaled window.
-            // NOTE: rcv_ann_wnd fits into size_t as required since m_initial_rcv_wnd
-            // also does (Listener::setInitialReceiveWindow).
-            AIPSTACK_ASSERT(lis->m_initial_rcv_wnd <= TypeMax<std::size_t>);
-            TcpSeqInt rcv_wnd = MinValueU(lis->m_initial_rcv_wnd, TypeMax<std::uint16_t>);
+            // The new connection replaces one in TIME_WAIT. Its ISS must be
+            // greater than the last sequence number used by the old connection
+            // (RFC 1122 section 4.2.2.13), with some margin so that segments of
+            // the old connection do not fall into the initial window.
+            if (tw != nullptr) {
+                if (!(tw->snd_nxt + Constants::TimeWaitIssMargin).mod_lt(iss)) {
+                    iss = tw->snd_nxt + Constants::TimeWaitIssMargin;
+                }
+                tcp->free_time_wait(tw);
+            }
             
             // Initialize most of the PCB.
-            pcb->setState(TcpStates::SYN_RCVD);
-            pcb->flags = 0;
-            pcb->lis = lis;
-            pcb->local_addr = ip_info.dst_addr;
-            pcb->remote_addr = ip_info.src_addr;
-            pcb->local_port = tcp_meta.local_port;
-            pcb->remote_port = tcp_meta.remote_port;
-            pcb->rcv_nxt = tcp_meta.seq_num + 1u;
-            pcb->rcv_ann_wnd = rcv_wnd;
-            pcb->snd_una = iss;
-            pcb->snd_nxt = iss;
-            pcb->snd_mss = iface_mss; // store iface_mss here temporarily
-            pcb->base_snd_mss = base_snd_mss;
-            pcb->rto = Constants::InitialRtxTime;
-            pcb->num_dupack = 0;
-            pcb->snd_wnd_shift = 0;
-            pcb->rcv_wnd_shift = 0;
-            
-            // Note, the PCB is on the list of unreferenced PCBs and we leave
-            // it since SYN_RCVD PCBs are considered unreferenced (except while
-            // being accepted).
+            listen_init_pcb(lis, pcb, ip_info, tcp_meta, iss, rcv_wnd,
+                            iface_mss, base_snd_mss);
             
             // Handle window scaling option.
             if ((tcp->m_received_opts.options & TcpOptionFlags::WndScale) != Enum0) {
@@ -447,23 +505,43 @@ private:
                 pcb->rcv_wnd_shift = Constants::RcvWndShift;
             }
             
-            // Increment the listener's PCB count.
-            AIPSTACK_ASSERT(lis->m_num_pcbs < TypeMax<int>);
-            lis->m_num_pcbs++;
-            
-            // Add the PCB to the active index.
-            tcp->m_pcb_index_active.addEntry({*pcb, *tcp}, *tcp);
+            // Handle SACK-permitted option, we will send it back if enabled.
+            if (TcpProto::SackEnabled &&
+                (tcp->m_received_opts.options & TcpOptionFlags::SackPerm) != Enum0)
+            {
+                pcb->setFlag(TcpPcbFlags::SackPerm);
+            }
             
-            // Move the PCB to the front of the unreferenced list.
-            tcp->move_unrefed_pcb_to_front(pcb);
+            // Handle timestamps option, we will use it if enabled.
+            if (TcpProto::TimestampsEnabled &&
+                (tcp->m_received_opts.options & TcpOptionFlags::Timestamps) != Enum0)
+            {
+                pcb->setFlag(TcpPcbFlags::TsOpt);
+                pcb->ts_recent = tcp->m_received_opts.ts_val;
+                pcb->ts_recent_time = Output::pcb_ts_now(pcb);
+            }
             
-            // Start the SYN_RCVD abort timeout.
-            pcb->tim(AbrtTimer()).setAfter(Constants::SynRcvdTimeoutTicks);
+            // Handle the fast open option if enabled for the listener. With a
+            // valid cookie and data the connection is accepted right away,
+            // otherwise we will send a cookie with the SYN-ACK.
+            bool fast_open_accept = false;
+            if (TcpProto::FastOpenEnabled && lis->m_fast_open &&
+                (tcp->m_received_opts.options & TcpOptionFlags::FastOpen) != Enum0)
+            {
+                fast_open_accept = tcp_data.tot_len > 0 &&
+                    listen_fast_open_cookie_valid(tcp, ip_info);
+                if (!fast_open_accept) {
+                    pcb->setFlag(TcpPcbFlags::FastOpen);
+                }
+            }
             
-            // Start the retransmission timer.
-            pcb->tim(RtxTimer()).setAfter(Output::pcb_rto_time(pcb));
+            // Register the PCB and start its timers.
+            listen_activate_pcb(lis, pcb);
             
-            pcb->doDelayedTimerUpdate();
+            if (fast_open_accept) {
+                listen_fast_open_accept(tcp, pcb, tcp_meta, tcp_data);
+                return;
+            }
             
             // Reply with a SYN-ACK.
             Output::pcb_send_syn(pcb);
@@ -472,7 +550,197 @@ private:
         
     refuse:
         // Refuse connection by RST.
-        Output::send_rst_reply(lis->m_tcp, ip_info, tcp_meta, tcp_data_len);
+        Output::send_rst_reply(lis->m_tcp, ip_info, tcp_meta, tcp_data.tot_len);
+    }
+    
+    // Handle an ACK received for a listener, which may be the final ACK of a
+    // handshake for which a SYN cookie was sent. If the cookie is valid, create
+    // the PCB in SYN_RCVD state as if the SYN-ACK had been sent from it and
+    // process the ACK using pcb_input which completes the connection. Returns
+    // false if the segment was not handled, including when the listener has
+    // no room for another PCB.
+    static bool listen_syn_cookie_ack_input (Listener *lis,
+        IpRxInfoIp4<StackArg> const &ip_info, TcpSegMeta const &tcp_meta,
+        IpBufRef tcp_data)
+    {
+        TcpProto *tcp = lis->m_tcp;
+        
+        // Validate the cookie and decode the connection parameters.
+        TcpPcbKey key{ip_info.dst_addr, ip_info.src_addr,
+                      tcp_meta.local_port, tcp_meta.remote_port};
+        TcpSeqNum iss = tcp_meta.ack_num - 1u;
+        TcpSynCookieInfo info;
+        if (!TcpSynCookie::decode(tcp->m_syn_cookie_key, key, tcp_meta.seq_num - 1u,
+                                  tcp->syn_cookie_counter(), iss, info))
+        {
+            return false;
+        }
+        
+        // The listener may still be at its limit of PCBs, in which case the
+        // connection is refused (the caller replies with RST).
+        if (lis->m_num_pcbs >= lis->m_max_pcbs) {
+            return false;
+        }
+        
+        // Calculate the MSS based on the interface MTU and the base_snd_mss.
+        // The latter is not less than MinAllowedMss since the MSS values
+        // which can be encoded are not and the iface_mss is not either.
+        static_assert(TcpSynCookie::MssTable[0] >= Constants::MinAllowedMss);
+        std::uint16_t iface_mss = ip_info.iface->getMtu() - Ip4TcpHeaderSize;
+        std::uint16_t base_snd_mss = MinValue(iface_mss, info.mss);
+        AIPSTACK_ASSERT(base_snd_mss >= Constants::MinAllowedMss);
+        
+        // Allocate a PCB.
+        TcpPcb *pcb = tcp->allocate_pcb();
+        if (pcb == nullptr) {
+            return false;
+        }
+        
+        // The same receive window was announced in the SYN-ACK.
+        AIPSTACK_ASSERT(lis->m_initial_rcv_wnd <= TypeMax<std::size_t>);
+        TcpSeqInt rcv_wnd = MinValueU(lis->m_initial_rcv_wnd, TypeMax<std::uint16_t>);
+        
+        // Initialize the PCB as when the SYN was received, with the
+        // parameters from the cookie.
+        TcpSegMeta syn_meta = tcp_meta;
+        syn_meta.seq_num = tcp_meta.seq_num - 1u;
+        listen_init_pcb(lis, pcb, ip_info, syn_meta, iss, rcv_wnd,
+                        iface_mss, base_snd_mss);
+        
+        if (info.wnd_scale) {
+            pcb->setFlag(TcpPcbFlags::WndScale);
+            pcb->snd_wnd_shift = info.snd_wnd_shift;
+            pcb->rcv_wnd_shift = Constants::RcvWndShift;
+        }
+        
+        if (info.sack_perm) {
+            pcb->setFlag(TcpPcbFlags::SackPerm);
+        }
+        
+        // The SYN-ACK has been sent.
+        pcb->snd_nxt = iss + 1u;
+        
+        // Register the PCB and start its timers.
+        listen_activate_pcb(lis, pcb);
+        
+        // Process the ACK (and any data) which completes the connection.
+        pcb_input(tcp, pcb, tcp_meta, tcp_data);
+        
+        return true;
+    }
+    
+    // Check if the cookie in the received fast open option is valid.
+    static bool listen_fast_open_cookie_valid (TcpProto *tcp,
+                                               IpRxInfoIp4<StackArg> const &ip_info)
+    {
+        static_assert(TcpSynCookie::FastOpenCookieLen <= TcpMaxFastOpenCookieLen);
+        
+        TcpOptions const &opts = tcp->m_received_opts;
+        if (opts.fast_open_cookie_len != TcpSynCookie::FastOpenCookieLen) {
+            return false;
+        }
+        
+        char cookie[TcpSynCookie::FastOpenCookieLen];
+        TcpSynCookie::fastOpenCookie(tcp->m_syn_cookie_key,
+            ip_info.dst_addr, ip_info.src_addr, cookie);
+        
+        return std::memcmp(cookie, opts.fast_open_cookie, sizeof(cookie)) == 0;
+    }
+    
+    // Accept a connection whose SYN carries data and a valid fast open cookie
+    // (RFC 7413). We send a SYN-ACK which also acknowledges the data (as much
+    // as fits into the announced window), then complete the connection as if
+    // the ACK to the SYN-ACK was received, which reports the connection to the
+    // listener and delivers the data to the accepted connection. Acknowledging
+    // the data before it is delivered is fine because the application must
+    // provide receive buffer for the announced window when accepting. The
+    // FastOpen flag is then set until an ACK is received, so that the SYN-ACK
+    // is retransmitted if the SYN is.
+    static void listen_fast_open_accept (TcpProto *tcp, TcpPcb *pcb,
+        TcpSegMeta const &tcp_meta, IpBufRef tcp_data)
+    {
+        AIPSTACK_ASSERT(pcb->state() == TcpStates::SYN_RCVD);
+        
+        // Accept only data within the announced window.
+        IpBufRef syn_data = tcp_data.subTo(MinValueU(tcp_data.tot_len, pcb->rcv_ann_wnd));
+        
+        // Send the SYN-ACK. If it could not be sent, continue as if the SYN had
+        // no data, the SYN-ACK will be sent later without acknowledging data.
+        Output::pcb_send_syn(pcb, TcpSeqInt(syn_data.tot_len));
+        if (pcb->snd_nxt == pcb->snd_una) {
+            return;
+        }
+        
+        // Make up the ACK from the SYN. The window in the SYN is not scaled.
+        TcpSegMeta ack_meta = tcp_meta;
+        ack_meta.flags = Tcp4Flags::Ack;
+        ack_meta.seq_num = tcp_meta.seq_num + 1u;
+        ack_meta.ack_num = pcb->snd_nxt;
+        ack_meta.window_size = std::uint16_t(tcp_meta.window_size >> pcb->snd_wnd_shift);
+        
+        // Process it with the data, which completes the connection.
+        pcb_input(tcp, pcb, ack_meta, syn_data);
+        
+        if (pcb->state().isActive()) {
+            pcb->setFlag(TcpPcbFlags::FastOpen);
+        }
+    }
+    
+    // Initialize a PCB for a connection to a listener, from the SYN.
+    static void listen_init_pcb (Listener *lis, TcpPcb *pcb,
+        IpRxInfoIp4<StackArg> const &ip_info, TcpSegMeta const &tcp_meta,
+        TcpSeqNum iss, TcpSeqInt rcv_wnd, std::uint16_t iface_mss,
+        std::uint16_t base_snd_mss)
+    {
+        pcb->setState(TcpStates::SYN_RCVD);
+        pcb->flags = 0;
+        pcb->lis = lis;
+        pcb->local_addr = ip_info.dst_addr;
+        pcb->remote_addr = ip_info.src_addr;
+        pcb->local_port = tcp_meta.local_port;
+        pcb->remote_port = tcp_meta.remote_port;
+        pcb->rcv_nxt = tcp_meta.seq_num + 1u;
+        pcb->rcv_ann_wnd = rcv_wnd;
+        pcb->snd_una = iss;
+        pcb->snd_nxt = iss;
+        pcb->snd_mss = iface_mss; // store iface_mss here temporarily
+        pcb->base_snd_mss = base_snd_mss;
+        pcb->rto = Constants::InitialRtxTime;
+        pcb->num_dupack = 0;
+        pcb->snd_wnd_shift = 0;
+        pcb->rcv_wnd_shift = 0;
+        pcb->ts_recent = 0;
+        
+        // Note, the PCB is on the list of unreferenced PCBs and we leave
+        // it since SYN_RCVD PCBs are considered unreferenced (except while
+        // being accepted).
+    }
+    
+    // Account the initialized SYN_RCVD PCB to the listener, add it to the
+    // active index and start its timers.
+    static void listen_activate_pcb (Listener *lis, TcpPcb *pcb)
+    {
+        TcpProto *tcp = lis->m_tcp;
+        
+        // Increment the listener's PCB count and the total count of
+        // SYN_RCVD PCBs.
+        AIPSTACK_ASSERT(lis->m_num_pcbs < TypeMax<int>);
+        lis->m_num_pcbs++;
+        tcp->m_num_syn_rcvd_pcbs++;
+        
+        // Add the PCB to the active index.
+        tcp->m_pcb_index_active.addEntry({*pcb, *tcp}, *tcp);
+        
+        // Move the PCB to the front of the unreferenced list.
+        tcp->move_unrefed_pcb_to_front(pcb);
+        
+        // Start the SYN_RCVD abort timeout.
+        pcb->tim(AbrtTimer()).setAfter(Constants::SynRcvdTimeoutTicks);
+        
+        // Start the retransmission timer.
+        pcb->tim(RtxTimer()).setAfter(Output::pcb_rto_time(pcb));
+        
+        pcb->doDelayedTimerUpdate();
     }
     
     static void pcb_input (TcpProto *tcp, TcpPcb *pcb, TcpSegMeta const &tcp_meta,
@@ -543,11 +811,6 @@ private:
                 return;
             }
         }
-        else if (pcb->state() == TcpStates::TIME_WAIT) {
-            // Reply with an ACK and restart the timeout.
-            pcb->setFlag(TcpPcbFlags::AckPending);
-            pcb->tim(AbrtTimer()).setAfter(Constants::TimeWaitTimeTicks);
-        }
         
         // Output if needed.
         if (pcb->hasAndClearFlag(TcpPcbFlags::OutPending)) {
@@ -565,6 +828,70 @@ private:
         if (pcb->hasAndClearFlag(TcpPcbFlags::AckPending)) {
             Output::pcb_send_empty_ack(pcb);
         }
+        
+        // If the ACK for received data is deferred to the end of the receive
+        // burst and was not sent above, remember this PCB.
+        if (pcb->hasFlag(TcpPcbFlags::AckBurst)) {
+            Output::pcb_defer_ack_to_burst_end(pcb);
+        }
+    }
+    
+    // Returns true if the segment is a SYN which may start a new connection in
+    // place of the one in TIME_WAIT. The caller then passes it to the listener,
+    // and the record is only removed if that creates a PCB.
+    static bool time_wait_input (TcpProto *tcp, TcpTimeWait *tw, TcpSegMeta const &tcp_meta)
+    {
+        if ((tcp_meta.flags & Tcp4Flags::Rst) != Enum0) {
+            // RST, handle as per RFC 5961 like for a PCB.
+            if (tcp_meta.seq_num == tw->rcv_nxt) {
+                tcp->free_time_wait(tw);
+            }
+            else if (tcp_meta.seq_num - tw->rcv_nxt <= tw->rcv_ann_wnd) {
+                Output::send_time_wait_ack(tcp, tw);
+            }
+            return false;
+        }
+        
+        // A SYN may start a new connection with the same address tuple if it is
+        // certainly not an old duplicate (RFC 6191) and there is a listener.
+        if ((tcp_meta.flags & Tcp4Flags::BasicFlags) == Tcp4Flags::Syn &&
+            time_wait_syn_acceptable(tcp, tw, tcp_meta) &&
+            tcp->find_listener_for_rx(tw->local_addr, tw->local_port) != nullptr)
+        {
+            return true;
+        }
+        
+        // Segments with neither SYN nor ACK are dropped as for a PCB.
+        if ((tcp_meta.flags & (Tcp4Flags::Syn|Tcp4Flags::Ack)) == Enum0) {
+            return false;
+        }
+        
+        // The only thing expected here is a retransmission of the FIN of the
+        // peer (RFC 793 p73), in which case restart the timeout. Reply to
+        // this as well as anything else (including a SYN) with an ACK.
+        if ((tcp_meta.flags & (Tcp4Flags::Syn|Tcp4Flags::Fin)) == Tcp4Flags::Fin) {
+            tcp->restart_time_wait_timeout(tw);
+        }
+        
+        Output::send_time_wait_ack(tcp, tw);
+        return false;
+    }
+    
+    static bool time_wait_syn_acceptable (
+        TcpProto *tcp, TcpTimeWait *tw, TcpSegMeta const &tcp_meta)
+    {
+        // If the old connection used timestamps and the SYN has the timestamps
+        // option, the SYN is acceptable if its timestamp is greater than TS.Recent.
+        if (tw->ts_used) {
+            parse_received_opts(tcp);
+            if ((tcp->m_received_opts.options & TcpOptionFlags::Timestamps) != Enum0) {
+                return pcb_ts_lt(tw->ts_recent, tcp->m_received_opts.ts_val);
+            }
+        }
+        
+        // Otherwise it is acceptable if its sequence number is greater than
+        // rcv_nxt of the old connection (RFC 1122 section 4.2.2.13).
+        return tw->rcv_nxt.mod_lt(tcp_meta.seq_num);
     }
     
     static bool pcb_input_basic_processing (TcpPcb *pcb, TcpSegMeta const &tcp_meta,
@@ -590,16 +917,26 @@ private:
             
             // Check ACK validity for SYN_SENT state (RFC 793 p66).
             // We require that the ACK acknowledges the SYN. We must also
-            // check that we have event sent the SYN (snd_nxt).
-            if (pcb->snd_nxt == pcb->snd_una || tcp_meta.ack_num != pcb->snd_nxt) {
+            // check that we have event sent the SYN (snd_nxt). With TCP Fast
+            // Open, any part of the data sent with the SYN may also be acked.
+            TcpSeqInt ack_minus_una = tcp_meta.ack_num - pcb->snd_una;
+            if (ack_minus_una == 0 || ack_minus_una > pcb->snd_nxt - pcb->snd_una) {
                 Output::send_rst(pcb->tcp, /*key=*/*pcb,
                     /*seq_num=*/tcp_meta.ack_num, /*ack=*/false, /*ack_num=*/TcpSeqNum(0));
                 return false;
             }
             
-            // The SYN is being acknowledged.
-            acked = 1;
+            // The SYN is being acknowledged, possibly with some data.
+            acked = ack_minus_una;
         } else {
+            // Protect against wrapped sequence numbers (PAWS).
+            if (pcb->hasFlag(TcpPcbFlags::TsOpt)) {
+                if (AIPSTACK_UNLIKELY(!pcb_paws_check(pcb))) {
+                    Output::pcb_send_empty_ack(pcb);
+                    return false;
+                }
+            }
+            
             // Calculate the right edge of the receive window.
             TcpSeqInt rcv_wnd = pcb->rcv_ann_wnd;
             if (AIPSTACK_LIKELY(
@@ -679,6 +1016,11 @@ private:
                 }
             }
             
+            // Update TS.Recent from an acceptable segment (RFC 7323 section 4.3).
+            if (pcb->hasFlag(TcpPcbFlags::TsOpt)) {
+                pcb_ts_recent_update(pcb, tcp_meta.seq_num);
+            }
+            
             // Check ACK validity as per RFC 5961.
             TcpSeqInt ack_minus_una = tcp_meta.ack_num - pcb->snd_una;
             if (AIPSTACK_LIKELY(ack_minus_una <= pcb->snd_nxt - pcb->snd_una)) {
@@ -753,6 +1095,15 @@ private:
                     Output::pcb_send_syn(pcb);
                     pcb->tim(AbrtTimer()).setAfter(Constants::SynRcvdTimeoutTicks);
                 }
+                // Similarly for a connection accepted with data in the SYN (TCP
+                // Fast Open) while our SYN-ACK has not been acknowledged.
+                else if (TcpProto::FastOpenEnabled &&
+                    pcb->state() != TcpStates::SYN_RCVD &&
+                    pcb->hasFlag(TcpPcbFlags::FastOpen) &&
+                    tcp_meta.seq_num.mod_lt(pcb->rcv_nxt))
+                {
+                    Output::pcb_send_syn(pcb);
+                }
                 else {
                     Output::pcb_send_empty_ack(pcb);
                 }
@@ -813,10 +1164,12 @@ private:
             return false;
         }
         
-        // In SYN_SENT and SYN_RCVD the remote acks only our SYN no more.
+        // In SYN_SENT and SYN_RCVD the remote acks only our SYN no more,
+        // except data sent with the SYN in SYN_SENT (TCP Fast Open).
         // Otherwise we would have bailed out already.
-        AIPSTACK_ASSERT(pcb->snd_nxt == pcb->snd_una + 1u);
-        AIPSTACK_ASSERT(tcp_meta.ack_num == pcb->snd_nxt);
+        AIPSTACK_ASSERT(syn_sent || pcb->snd_nxt == pcb->snd_una + 1u);
+        AIPSTACK_ASSERT(acked <= pcb->snd_nxt - pcb->snd_una);
+        AIPSTACK_ASSERT(tcp_meta.ack_num == pcb->snd_una + acked);
         
         // Stop the SYN_RCVD abort timer.
         pcb->tim(AbrtTimer()).unset();
@@ -875,6 +1228,29 @@ private:
                 pcb->rcv_wnd_shift = 0;
             }
             
+            // If the remote did not send the SACK-permitted option, SACK
+            // must not be used.
+            if ((tcp->m_received_opts.options & TcpOptionFlags::SackPerm) == Enum0) {
+                pcb->clearFlag(TcpPcbFlags::SackPerm);
+            }
+            
+            // Handle the timestamps option. If the remote did not send it,
+            // it must not be used. This must be done before snd_mss is
+            // calculated since the option reduces it.
+            if ((tcp->m_received_opts.options & TcpOptionFlags::Timestamps) != Enum0) {
+                pcb->ts_recent = tcp->m_received_opts.ts_val;
+                pcb->ts_recent_time = Output::pcb_ts_now(pcb);
+            } else {
+                pcb->clearFlag(TcpPcbFlags::TsOpt);
+            }
+            
+            // If the fast open option was sent, update the cookie cache and
+            // handle any data which was sent with the SYN.
+            std::size_t syn_data_acked = 0;
+            if (TcpProto::FastOpenEnabled && pcb->hasFlag(TcpPcbFlags::FastOpen)) {
+                syn_data_acked = pcb_fast_open_syn_acked(pcb, tcp_meta.ack_num, acked);
+            }
+            
             // Initialize certain sender variables.
             std::uint16_t pmtu = pcb->snd_mss; // pmtu was stored to snd_mss temporarily
             pcb_complete_established_transition(pcb, pmtu);
@@ -906,9 +1282,21 @@ private:
                 return false;
             }
             
+            // Report data-sent event for data acknowledged with the SYN, unless
+            // the connection was abandoned in the callback.
+            if (AIPSTACK_UNLIKELY(syn_data_acked > 0) && pcb->con != nullptr) {
+                pcb->con->data_sent(syn_data_acked);
+                if (AIPSTACK_UNLIKELY(pcb_aborted_in_callback(pcb))) {
+                    return false;
+                }
+            }
+            
             // Possible transitions in callback (except to CLOSED):
             // - ESTABLISHED->FIN_WAIT_1
         } else {
+            // The fast open cookie, if any, was sent with the SYN-ACK.
+            pcb->clearFlag(TcpPcbFlags::FastOpen);
+            
             // We have a Listener (if it went away the PCB would have been aborted).
             Listener *lis = pcb->lis;
             AIPSTACK_ASSERT(lis->m_listening);
@@ -960,6 +1348,58 @@ private:
         return true;
     }
     
+    // Called in SYN_SENT when the SYN-ACK is received for a SYN which included
+    // the fast open option. Updates the cookie cache and handles data sent with
+    // the SYN: the send buffer is advanced for data which was acknowledged and
+    // the remainder will be sent again as normal data. Returns the amount of
+    // data acknowledged.
+    static std::size_t pcb_fast_open_syn_acked (TcpPcb *pcb, TcpSeqNum ack_num,
+                                                TcpSeqInt acked)
+    {
+        AIPSTACK_ASSERT(pcb->state() == TcpStates::ESTABLISHED);
+        AIPSTACK_ASSERT(pcb->con != nullptr);
+        AIPSTACK_ASSERT(acked > 0);
+        
+        pcb->clearFlag(TcpPcbFlags::FastOpen);
+        
+        TcpProto *tcp = pcb->tcp;
+        Connection *con = pcb->con;
+        std::size_t data_acked = acked - 1u;
+        bool data_unacked = pcb->snd_nxt != ack_num;
+        
+        // Cache a cookie received from the server, along with the MSS which limits
+        // the data sent with later SYNs. If the server sent no cookie and did not
+        // accept the data, it does not (or no longer) support fast open with our
+        // cookie, so forget the cookie.
+        TcpOptions const &opts = tcp->m_received_opts;
+        if ((opts.options & TcpOptionFlags::FastOpen) != Enum0 &&
+            opts.fast_open_cookie_len > 0)
+        {
+            tcp->m_fast_open_cache.store(pcb->remote_addr, pcb->base_snd_mss,
+                opts.fast_open_cookie, opts.fast_open_cookie_len);
+        }
+        else if (data_acked == 0 && data_unacked) {
+            tcp->m_fast_open_cache.remove(pcb->remote_addr);
+        }
+        
+        // Continue sending from the acknowledged position.
+        pcb->snd_nxt = ack_num;
+        
+        // Advance the send buffer past the acknowledged data.
+        AIPSTACK_ASSERT(data_acked <= con->m_v.snd_buf.tot_len);
+        con->m_v.snd_buf = ipBufSkipBytes(con->m_v.snd_buf, data_acked);
+        con->m_v.snd_buf_cur = con->m_v.snd_buf;
+        
+        // Adjust the push index.
+        if (data_acked <= con->m_v.snd_psh_index) {
+            con->m_v.snd_psh_index -= data_acked;
+        } else {
+            con->m_v.snd_psh_index = 0;
+        }
+        
+        return data_acked;
+    }
+    
     static bool pcb_input_ack_wnd_processing (TcpPcb *pcb,
         TcpSegMeta const &tcp_meta, TcpSeqInt acked, std::size_t orig_data_len)
     {
@@ -971,6 +1411,20 @@ private:
             pcb->tcp->move_unrefed_pcb_to_front(pcb);
         }
         
+        // An ACK confirms that our SYN-ACK was received, if the connection was
+        // accepted with data in the SYN (TCP Fast Open).
+        if (TcpProto::FastOpenEnabled) {
+            pcb->clearFlag(TcpPcbFlags::FastOpen);
+        }
+        
+        // Update the SACK scoreboard. This is done before processing the
+        // acknowledgement since retransmissions may be done from there.
+        if (pcb->hasFlag(TcpPcbFlags::SackPerm) && pcb->state().canOutput() &&
+            pcb->con != nullptr)
+        {
+            pcb_sack_input(pcb, tcp_meta.ack_num, acked);
+        }
+        
         // Handle new acknowledgments.
         if (acked > 0) {
             // We can only get here if there was anything pending acknowledgement
@@ -1104,6 +1558,7 @@ private:
                     
                     // Stop the output timer due to assert in its handler.
                     pcb->tim(OutputTimer()).unset();
+                    pcb->clearFlag(TcpPcbFlags::PaceWait);
                 }
             }
         }
@@ -1118,11 +1573,23 @@ private:
                 pcb->con != nullptr &&
                 pcb_decode_wnd_size(pcb, tcp_meta.window_size) == pcb->con->m_v.snd_wnd
             ) {
+                // With F-RTO in progress, the timeout is considered genuine.
+                if (AIPSTACK_UNLIKELY(pcb->hasFlag(
+                        TcpPcbFlags::FrtoAck1|TcpPcbFlags::FrtoAck2)))
+                {
+                    Output::pcb_frto_dup_ack_received(pcb);
+                }
+                
                 if (pcb->num_dupack <
                         Constants::FastRtxDupAcks + Constants::MaxAdditionaDupAcks)
                 {
                     pcb->num_dupack++;
-                    if (pcb->num_dupack == Constants::FastRtxDupAcks) {
+                    if (pcb->num_dupack < Constants::FastRtxDupAcks) {
+                        // Limited Transmit (RFC 3042): pcb_output_active will
+                        // allow sending a new segment for this duplicate ACK.
+                        pcb->setFlag(TcpPcbFlags::OutPending);
+                    }
+                    else if (pcb->num_dupack == Constants::FastRtxDupAcks) {
                         Output::pcb_fast_rtx_dup_acks_received(pcb);
                     }
                     else if (pcb->num_dupack > Constants::FastRtxDupAcks) {
@@ -1223,6 +1690,10 @@ private:
                 pcb->setFlag(TcpPcbFlags::AckPending);
             }
             
+            // Enter quick-ACK mode so that the segments filling the hole and
+            // following are acknowledged immediately (RFC 5681 section 4.2).
+            con->m_v.quick_acks = Constants::QuickAckSegs;
+            
             if (tcp_data.tot_len > 0) {
                 // Check that there is buffer space available for the received data.
                 if (AIPSTACK_UNLIKELY(
@@ -1283,8 +1754,13 @@ private:
             pcb->rcv_ann_wnd = 0;
         }
         
-        // Make sure an ACK is sent.
-        pcb->setFlag(TcpPcbFlags::AckPending);
+        // Make sure an ACK is sent. For in-sequence data without FIN the
+        // ACK may be delayed.
+        if (AIPSTACK_LIKELY(rcv_seqlen == rcv_datalen)) {
+            Output::pcb_ack_received_data(pcb);
+        } else {
+            pcb->setFlag(TcpPcbFlags::AckPending);
+        }
         
         // Processing a FIN?
         if (AIPSTACK_UNLIKELY(rcv_seqlen > rcv_datalen)) {
@@ -1340,15 +1816,98 @@ private:
                 // - CLOSE_WAIT->LAST_ACK
             }
             
-            // Complete transition from FIN_WAIT_2 to TIME_WAIT.
+            // Complete transition from FIN_WAIT_2 to TIME_WAIT. This sends the
+            // ACK and closes the PCB so processing must not continue.
             if (pcb->state() == TcpStates::FIN_WAIT_2_TIME_WAIT) {
                 TcpProto::pcb_go_to_time_wait(pcb);
+                return false;
             }
         }
         
         return true;
     }
     
+    // PAWS check (RFC 7323 section 5.3), returns false if the segment is to
+    // be dropped. Segments without the timestamps option are accepted, as
+    // some stacks omit it on certain segments. This also ensures the received
+    // options are parsed, which Output relies on for RTT sampling.
+    static bool pcb_paws_check (TcpPcb *pcb)
+    {
+        AIPSTACK_ASSERT(pcb->hasFlag(TcpPcbFlags::TsOpt));
+        
+        TcpProto *tcp = pcb->tcp;
+        parse_received_opts(tcp);
+        if ((tcp->m_received_opts.options & TcpOptionFlags::Timestamps) == Enum0) {
+            return true;
+        }
+        
+        // If the connection has been idle for longer than the validity of
+        // TS.Recent, it cannot be compared against, so invalidate it.
+        std::uint32_t now = Output::pcb_ts_now(pcb);
+        if (AIPSTACK_UNLIKELY(now - pcb->ts_recent_time > Constants::PawsIdleTime)) {
+            pcb->ts_recent = tcp->m_received_opts.ts_val;
+            pcb->ts_recent_time = now;
+            return true;
+        }
+        
+        // Drop the segment if TSval is older than TS.Recent.
+        return !pcb_ts_lt(tcp->m_received_opts.ts_val, pcb->ts_recent);
+    }
+    
+    // Record TSval of an acceptable segment as TS.Recent, if the segment
+    // starts at or before rcv_nxt and TSval is not older.
+    static void pcb_ts_recent_update (TcpPcb *pcb, TcpSeqNum seq_num)
+    {
+        AIPSTACK_ASSERT(pcb->hasFlag(TcpPcbFlags::TsOpt));
+        
+        TcpOptions const &opts = pcb->tcp->m_received_opts;
+        if ((opts.options & TcpOptionFlags::Timestamps) != Enum0 &&
+            !pcb->rcv_nxt.mod_lt(seq_num) && !pcb_ts_lt(opts.ts_val, pcb->ts_recent))
+        {
+            pcb->ts_recent = opts.ts_val;
+            pcb->ts_recent_time = Output::pcb_ts_now(pcb);
+        }
+    }
+    
+    // Compare timestamp values modulo 2^32.
+    inline static bool pcb_ts_lt (std::uint32_t ts1, std::uint32_t ts2)
+    {
+        return std::uint32_t(ts1 - ts2) >= (std::uint32_t(1) << 31);
+    }
+    
+    // Update the SACK scoreboard based on the cumulative acknowledgement
+    // and any SACK option in the received segment.
+    static void pcb_sack_input (TcpPcb *pcb, TcpSeqNum ack_num, TcpSeqInt acked)
+    {
+        AIPSTACK_ASSERT(pcb->hasFlag(TcpPcbFlags::SackPerm));
+        AIPSTACK_ASSERT(pcb->state().canOutput());
+        AIPSTACK_ASSERT(pcb->con != nullptr);
+        
+        Connection *con = pcb->con;
+        
+        // Forget about ranges that are now acknowledged.
+        TcpSeqNum new_snd_una = pcb->snd_una;
+        if (acked > 0) {
+            con->m_v.sack.updateForAck(pcb->snd_una, ack_num);
+            new_snd_una = ack_num;
+        }
+        
+        // Add any received SACK blocks.
+        TcpProto *tcp = pcb->tcp;
+        parse_received_opts(tcp);
+        if ((tcp->m_received_opts.options & TcpOptionFlags::Sack) != Enum0) {
+            con->m_v.sack.addBlocks(new_snd_una, pcb->snd_nxt,
+                tcp->m_received_opts.sack_blocks, tcp->m_received_opts.num_sack_blocks);
+        }
+        
+        // With RACK, SACK information in a segment not acknowledging new data
+        // may start the reordering window. For new ACKs the rtx_timer is
+        // restarted by pcb_output_active which takes care of this.
+        if (TcpProto::RackTlpEnabled && acked == 0) {
+            Output::pcb_rack_sack_received(pcb);
+        }
+    }
+    
     // Apply window scaling to a received window size value.
     inline static TcpSeqInt pcb_decode_wnd_size (TcpPcb *pcb, std::uint16_t rx_wnd_size)
     {
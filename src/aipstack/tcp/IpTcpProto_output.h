@@ -27,6 +27,7 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
 
 #include <aipstack/misc/Use.h>
 #include <aipstack/misc/Assert.h>
@@ -38,6 +39,7 @@
 #include <aipstack/infra/Buf.h>
 #include <aipstack/infra/BufUtils.h>
 #include <aipstack/infra/Chksum.h>
+#include <aipstack/infra/ChksumBlockCache.h>
 #include <aipstack/infra/TxAllocHelper.h>
 #include <aipstack/infra/Err.h>
 #include <aipstack/proto/Tcp4Proto.h>
@@ -48,6 +50,7 @@
 #include <aipstack/tcp/TcpPcbFlags.h>
 #include <aipstack/tcp/TcpPcbKey.h>
 #include <aipstack/tcp/TcpOptions.h>
+#include <aipstack/tcp/TcpSynCookie.h>
 
 namespace AIpStack {
 
@@ -60,9 +63,10 @@ class IpTcpProto_output
 {
     using TcpProto = IpTcpProto<Arg>;
     
-    AIPSTACK_USE_TYPES(TcpProto, (TcpPcb, Input, TimeType, Constants, OutputTimer,
-                                  RtxTimer, StackArg, Connection))
+    AIPSTACK_USE_TYPES(TcpProto, (TcpPcb, TcpTimeWait, Input, TimeType, Constants,
+        OutputTimer, RtxTimer, AckTimer, StackArg, Connection, CongControl))
     AIPSTACK_USE_TYPES(Constants, (RttType, RttNextType))
+    using CcState = typename CongControl::State;
     AIPSTACK_USE_VALS(IpStack<StackArg>, (HeaderBeforeIp4Dgram))
 
     inline static constexpr RttType RttTypeMax = TypeMax<RttType>;
@@ -75,17 +79,25 @@ public:
     }
     
     // Send SYN or SYN-ACK packet (in the SYN_SENT or SYN_RCVD states respectively).
+    // With TCP Fast Open, the first SYN may carry data, and a SYN-ACK may also be
+    // sent in other states (FastOpen flag) when the connection was accepted with
+    // data in the SYN; syn_data_acked is the amount of that data which the first
+    // SYN-ACK acknowledges.
     AIPSTACK_NO_INLINE
-    static void pcb_send_syn (TcpPcb *pcb)
+    static void pcb_send_syn (TcpPcb *pcb, TcpSeqInt syn_data_acked = 0)
     {
-        AIPSTACK_ASSERT(pcb->state() == OneOf(TcpStates::SYN_SENT, TcpStates::SYN_RCVD));
+        AIPSTACK_ASSERT(pcb->state() == OneOf(TcpStates::SYN_SENT, TcpStates::SYN_RCVD) ||
+                        pcb->hasFlag(TcpPcbFlags::FastOpen));
+        AIPSTACK_ASSERT(syn_data_acked == 0 || pcb->state() == TcpStates::SYN_RCVD);
+        
+        bool syn_sent = pcb->state() == TcpStates::SYN_SENT;
+        bool syn_rcvd = pcb->state() == TcpStates::SYN_RCVD;
         
         // Include the MSS option.
         TcpOptions tcp_opts;
         tcp_opts.options = TcpOptionFlags::Mss;
-        // The iface_mss is stored in a variable otherwise unused in this state.
-        tcp_opts.mss = (pcb->state() == TcpStates::SYN_SENT) ?
-            pcb->base_snd_mss : pcb->snd_mss;
+        // The iface_mss is stored in a variable otherwise unused in SYN_RCVD.
+        tcp_opts.mss = syn_rcvd ? pcb->snd_mss : pcb->base_snd_mss;
         
         // Send the window scale option if needed.
         if (pcb->hasFlag(TcpPcbFlags::WndScale)) {
@@ -93,27 +105,68 @@ public:
             tcp_opts.wnd_scale = pcb->rcv_wnd_shift;
         }
         
+        // Send the SACK-permitted option if needed.
+        if (pcb->hasFlag(TcpPcbFlags::SackPerm)) {
+            tcp_opts.options |= TcpOptionFlags::SackPerm;
+        }
+        
+        // Send the timestamps option if needed. In SYN_SENT there is nothing
+        // to echo yet so TSecr is zero.
+        if (pcb->hasFlag(TcpPcbFlags::TsOpt)) {
+            tcp_opts.options |= TcpOptionFlags::Timestamps;
+            tcp_opts.ts_val = pcb_ts_now(pcb);
+            tcp_opts.ts_ecr = syn_sent ? 0 : pcb->ts_recent;
+        }
+        
+        // Send the fast open option and any data in the SYN if needed.
+        IpBufRef data = IpBufRef{};
+        if (TcpProto::FastOpenEnabled && pcb->hasFlag(TcpPcbFlags::FastOpen)) {
+            if (syn_sent) {
+                data = pcb_fast_open_syn_option(pcb, tcp_opts);
+            }
+            else if (syn_rcvd) {
+                tcp_opts.options |= TcpOptionFlags::FastOpen;
+                tcp_opts.fast_open_cookie_len = TcpSynCookie::FastOpenCookieLen;
+                TcpSynCookie::fastOpenCookie(pcb->tcp->m_syn_cookie_key,
+                    pcb->local_addr, pcb->remote_addr, tcp_opts.fast_open_cookie);
+            }
+        }
+        
         // The SYN and SYN-ACK must always have non-scaled window size.
         // For justification of assert see see create_connection, listen_input.
-        AIPSTACK_ASSERT(pcb->rcv_ann_wnd <= TypeMax<std::uint16_t>);
-        std::uint16_t window_size = std::uint16_t(pcb->rcv_ann_wnd);
+        // When a SYN-ACK is retransmitted after the connection was accepted the
+        // window may be larger but it is fine to announce less.
+        TcpSeqInt ann_wnd = pcb->rcv_ann_wnd;
+        AIPSTACK_ASSERT(!(syn_sent || syn_rcvd) || ann_wnd <= TypeMax<std::uint16_t>);
+        AIPSTACK_ASSERT(syn_data_acked <= ann_wnd);
+        std::uint16_t window_size =
+            std::uint16_t(MinValueU(ann_wnd - syn_data_acked, TypeMax<std::uint16_t>));
         
         // Send SYN or SYN-ACK flags depending on the state.
-        Tcp4Flags flags = Tcp4Flags::Syn |
-            ((pcb->state() == TcpStates::SYN_RCVD) ? Tcp4Flags::Ack : Tcp4Flags(0));
+        Tcp4Flags flags = Tcp4Flags::Syn | (syn_sent ? Tcp4Flags(0) : Tcp4Flags::Ack);
+        
+        // After the connection was accepted snd_una is just after the SYN, which
+        // is known not to have been acknowledged because of the FastOpen flag.
+        TcpSeqNum seq_num = (syn_sent || syn_rcvd) ? pcb->snd_una : (pcb->snd_una - 1u);
         
         // Send the segment.
-        IpErr err = send_tcp_nodata(pcb->tcp, *pcb, pcb->snd_una, pcb->rcv_nxt,
-                                    window_size, flags, &tcp_opts, pcb);
+        IpErr err = send_tcp_nodata(pcb->tcp, *pcb, seq_num, pcb->rcv_nxt + syn_data_acked,
+                                    window_size, flags, &tcp_opts, pcb, data);
         
-        if (err == IpErr::Success) {
+        if (err == IpErr::Success && (syn_sent || syn_rcvd)) {
             // Have we sent the SYN for the first time?
             if (pcb->snd_nxt == pcb->snd_una) {
                 // Start a round-trip-time measurement.
                 pcb_start_rtt_measurement(pcb, true);
                 
-                // Bump snd_nxt.
-                pcb->snd_nxt += 1u;
+                // Bump snd_nxt, also for any data.
+                pcb->snd_nxt += 1u + TcpSeqInt(data.tot_len);
+                
+                // Advance the send position for any data.
+                if (data.tot_len > 0) {
+                    Connection *con = pcb->con;
+                    con->m_v.snd_buf_cur = ipBufSkipBytes(con->m_v.snd_buf, data.tot_len);
+                }
             } else {
                 // Retransmission, stop any round-trip-time measurement.
                 pcb->clearFlag(TcpPcbFlags::RttPending);
@@ -121,6 +174,44 @@ public:
         }
     }
     
+    // Add the fast open option to a SYN being sent in SYN_SENT state, with the
+    // cached cookie for the server or a cookie request. If there is a cookie and
+    // this is the first SYN, return the data from the send buffer to include,
+    // which is limited based on the MSS of the server from the cache.
+    static IpBufRef pcb_fast_open_syn_option (TcpPcb *pcb, TcpOptions &tcp_opts)
+    {
+        AIPSTACK_ASSERT(pcb->state() == TcpStates::SYN_SENT);
+        AIPSTACK_ASSERT(pcb->con != nullptr);
+        
+        tcp_opts.options |= TcpOptionFlags::FastOpen;
+        tcp_opts.fast_open_cookie_len = 0;
+        
+        auto const *entry = pcb->tcp->m_fast_open_cache.find(pcb->remote_addr);
+        if (entry == nullptr) {
+            return IpBufRef{};
+        }
+        
+        tcp_opts.fast_open_cookie_len = entry->cookie_len;
+        std::memcpy(tcp_opts.fast_open_cookie, entry->cookie, entry->cookie_len);
+        
+        // Data is only sent with the first SYN, not retransmissions.
+        if (pcb->snd_nxt != pcb->snd_una) {
+            return IpBufRef{};
+        }
+        
+        // Limit the data to the MSS of the server and the path MTU (which is
+        // stored in snd_mss in SYN_SENT), reduced by the options.
+        std::uint16_t pmtu = pcb->snd_mss;
+        std::uint16_t max_seg = MinValue(entry->mss, std::uint16_t(pmtu - Ip4TcpHeaderSize));
+        std::uint8_t opts_len = CalcTcpOptionsLength(tcp_opts);
+        if (max_seg <= opts_len) {
+            return IpBufRef{};
+        }
+        
+        IpBufRef snd_buf = pcb->con->m_v.snd_buf;
+        return snd_buf.subTo(MinValueU(snd_buf.tot_len, std::size_t(max_seg - opts_len)));
+    }
+    
     // Send an empty ACK (which may be a window update).
     AIPSTACK_NO_INLINE
     static void pcb_send_empty_ack (TcpPcb *pcb)
@@ -128,9 +219,84 @@ public:
         // Get the window size value.
         std::uint16_t window_size = Input::pcb_ann_wnd(pcb);
         
+        TcpOptions tcp_opts;
+        tcp_opts.options = TcpOptionFlags(0);
+        
+        // Include the timestamps option if used. In SYN_SENT it has only
+        // been offered, not yet agreed upon.
+        bool ts_used = pcb->hasFlag(TcpPcbFlags::TsOpt) &&
+            pcb->state() != TcpStates::SYN_SENT;
+        if (ts_used) {
+            pcb_set_ts_option(pcb, tcp_opts);
+        }
+        
+        // Include SACK blocks if there is out-of-sequence data.
+        if (pcb_sack_blocks_needed(pcb)) {
+            std::uint8_t max_blocks = ts_used ? TcpMaxSackBlocksWithTs : TcpMaxSackBlocks;
+            tcp_opts.num_sack_blocks = pcb->con->m_v.ooseq.getSackBlocks(
+                pcb->rcv_nxt, tcp_opts.sack_blocks, max_blocks);
+            if (tcp_opts.num_sack_blocks > 0) {
+                tcp_opts.options |= TcpOptionFlags::Sack;
+            }
+        }
+        
+        TcpOptions *opts = (tcp_opts.options != Enum0) ? &tcp_opts : nullptr;
+        
         // Send it.
         send_tcp_nodata(pcb->tcp, *pcb, pcb->snd_nxt, pcb->rcv_nxt, window_size,
-                        Tcp4Flags::Ack, nullptr, pcb);
+                        Tcp4Flags::Ack, opts, pcb);
+        
+        // Any delayed or deferred ACK has now been sent.
+        pcb->clearFlag(TcpPcbFlags::AckDelayed|TcpPcbFlags::AckBurst);
+    }
+    
+    // Get the current value of our timestamp clock (TSval). This is the
+    // platform time with the same granularity as used for RTT calculations.
+    static std::uint32_t ts_now (TcpProto *tcp)
+    {
+        return std::uint32_t(tcp->platform().getTime() >> Constants::RttShift);
+    }
+    
+    // Send an ACK for a TIME_WAIT record.
+    static void send_time_wait_ack (TcpProto *tcp, TcpTimeWait *tw)
+    {
+        TcpOptions tcp_opts;
+        TcpOptions *opts = nullptr;
+        
+        // Include the timestamps option if it was used by the connection.
+        if (tw->ts_used) {
+            tcp_opts.options = TcpOptionFlags::Timestamps;
+            tcp_opts.ts_val = ts_now(tcp);
+            tcp_opts.ts_ecr = tw->ts_recent;
+            opts = &tcp_opts;
+        }
+        
+        send_tcp_nodata(tcp, *tw, tw->snd_nxt, tw->rcv_nxt, tw->window_size,
+                        Tcp4Flags::Ack, opts, /*retryReq=*/nullptr);
+    }
+    
+    static std::uint32_t pcb_ts_now (TcpPcb *pcb)
+    {
+        return ts_now(pcb->tcp);
+    }
+    
+    // Add the timestamps option with the current time and TS.Recent.
+    static void pcb_set_ts_option (TcpPcb *pcb, TcpOptions &tcp_opts)
+    {
+        AIPSTACK_ASSERT(pcb->hasFlag(TcpPcbFlags::TsOpt));
+        
+        tcp_opts.options |= TcpOptionFlags::Timestamps;
+        tcp_opts.ts_val = pcb_ts_now(pcb);
+        tcp_opts.ts_ecr = pcb->ts_recent;
+    }
+    
+    // Check if ACKs should include SACK blocks, that is if SACK is used
+    // and there is out-of-sequence data buffered. Data segments do not
+    // include SACK blocks, so an empty ACK is needed in this case.
+    static bool pcb_sack_blocks_needed (TcpPcb *pcb)
+    {
+        return pcb->hasFlag(TcpPcbFlags::SackPerm) && pcb->state().isAcceptingData() &&
+            pcb->con != nullptr && !pcb->con->m_v.ooseq.isNothingBuffered();
     }
     
     // Send an RST for this PCB.
@@ -141,6 +307,66 @@ public:
         send_rst(pcb->tcp, *pcb, /*seq_num=*/pcb->snd_nxt, ack, /*ack_num=*/pcb->rcv_nxt);
     }
     
+    // Arrange for acknowledging received in-sequence data. The ACK is
+    // delayed (RFC 1122 section 4.2.3.2) except for every second segment,
+    // in quick-ACK mode and if delayed ACKs are disabled.
+    static void pcb_ack_received_data (TcpPcb *pcb)
+    {
+        AIPSTACK_ASSERT(pcb->inInputProcessing());
+        AIPSTACK_ASSERT(pcb->con != nullptr);
+        
+        Connection *con = pcb->con;
+        
+        if (TcpProto::DelayedAckTimeMs == 0 || con->m_v.quick_acks > 0 ||
+            pcb->hasFlag(TcpPcbFlags::AckDelayed))
+        {
+            if (con->m_v.quick_acks > 0) {
+                con->m_v.quick_acks--;
+            }
+            
+            // If the interface reports the ends of receive bursts, send one
+            // ACK for the data of the whole burst, at its end.
+            if (pcb->tcp->m_rx_burst) {
+                pcb->setFlag(TcpPcbFlags::AckBurst);
+            } else {
+                pcb->setFlag(TcpPcbFlags::AckPending);
+            }
+        } else {
+            // Delay the ACK. Any segment sent in the meantime will clear
+            // AckDelayed, then the timer expiration does nothing.
+            pcb->setFlag(TcpPcbFlags::AckDelayed);
+            pcb->tim(AckTimer()).setAfter(TcpProto::DelayedAckTicks);
+        }
+    }
+    
+    // Called at the end of input processing when the PCB has an ACK deferred to
+    // the end of the receive burst. Only one PCB at a time is remembered, if the
+    // burst is for more connections, the ACK of the previous one is sent now.
+    static void pcb_defer_ack_to_burst_end (TcpPcb *pcb)
+    {
+        AIPSTACK_ASSERT(pcb->hasFlag(TcpPcbFlags::AckBurst));
+        
+        TcpProto *tcp = pcb->tcp;
+        if (tcp->m_burst_ack_pcb != pcb) {
+            send_burst_ack(tcp);
+            tcp->m_burst_ack_pcb = pcb;
+        }
+    }
+    
+    // Send the ACK deferred to the end of the receive burst, unless it was
+    // already sent with another segment.
+    static void send_burst_ack (TcpProto *tcp)
+    {
+        TcpPcb *pcb = tcp->m_burst_ack_pcb;
+        if (pcb != nullptr) {
+            tcp->m_burst_ack_pcb = nullptr;
+            
+            if (pcb->hasFlag(TcpPcbFlags::AckBurst)) {
+                pcb_send_empty_ack(pcb);
+            }
+        }
+    }
+    
     static void pcb_need_ack (TcpPcb *pcb)
     {
         AIPSTACK_ASSERT(pcb->state() != TcpStates::CLOSED);
@@ -267,6 +493,8 @@ public:
         TcpSeqInt rem_wnd;
         std::size_t data_threshold;
         bool fin;
+        bool nagle = false;
+        bool paced = false;
         
         if (AIPSTACK_UNLIKELY(rtx_or_window_probe)) {
             // Send from the start of the start buffer. We take care to not
@@ -294,9 +522,18 @@ public:
             // Use and update real snd_buf_cur.
             snd_buf_cur = &con->m_v.snd_buf_cur;
             
+            // With Limited Transmit (RFC 3042), each duplicate ACK received
+            // before fast retransmit allows sending one segment beyond cwnd.
+            TcpSeqInt cwnd = con->m_v.cwnd;
+            if (AIPSTACK_UNLIKELY(pcb->num_dupack > 0) &&
+                pcb->num_dupack < Constants::FastRtxDupAcks)
+            {
+                AddToSat(cwnd, TcpSeqInt(pcb->num_dupack) * pcb->snd_mss);
+            }
+            
             // Calculate the miniumum of snd_wnd and cwnd which is how much
             // we can send relative to the start of the send buffer.
-            TcpSeqInt full_wnd = MinValue(con->m_v.snd_wnd, con->m_v.cwnd);
+            TcpSeqInt full_wnd = MinValue(con->m_v.snd_wnd, cwnd);
             
             // Calculate the remaining window relative to snd_buf_cur.
             std::size_t snd_offset = con->m_v.snd_buf.tot_len - snd_buf_cur->tot_len;
@@ -313,10 +550,30 @@ public:
             std::size_t psh_to_end = con->m_v.snd_buf.tot_len - con->m_v.snd_psh_index;
             data_threshold = MinValue(psh_to_end, std::size_t(pcb->snd_mss - 1));
             
+            // When corked, or with the Nagle algorithm (RFC 896) while there is
+            // unacknowledged data, less than snd_mss data is delayed even if pushed.
+            nagle = con->m_v.nagle;
+            if (AIPSTACK_UNLIKELY(con->m_v.corked || (nagle && pcb_has_snd_unacked(pcb)))) {
+                data_threshold = pcb->snd_mss - 1;
+            }
+            
             // Allow sending a FIN if it is queued.
             fin = pcb->hasFlag(TcpPcbFlags::FinPending);
+            
+            // With pacing (once the RTT is known), nothing is sent until
+            // the OutputTimer set for pacing expires.
+            if (TcpProto::PacingEnabled && pcb->hasFlag(TcpPcbFlags::RttValid)) {
+                paced = true;
+                if (pcb->hasFlag(TcpPcbFlags::PaceWait)) {
+                    rem_wnd = 0;
+                }
+            }
         }
         
+        // Number of segments and sequence length sent, for pacing.
+        std::uint8_t burst_segs = 0;
+        TcpSeqInt burst_len = 0;
+        
         // Create the output helper (which optimizes sending multiple segments at a time).
         PcbOutputHelper output_helper;
         
@@ -379,11 +636,32 @@ public:
                 *snd_buf_cur = ipBufSkipBytes(*snd_buf_cur, data_sent);
             }
             
+            // With Nagle, the data just sent is unacknowledged so any
+            // remaining partial segment must be delayed.
+            if (AIPSTACK_UNLIKELY(nagle)) {
+                data_threshold = pcb->snd_mss - 1;
+            }
+            
             // Decrement remaining window.
             rem_wnd -= seg_seqlen;
             
-            // Clear AckPending flag to avoid sending an empty ACK needlessly.
-            pcb->clearFlag(TcpPcbFlags::AckPending);
+            // Clear AckPending flag to avoid sending an empty ACK needlessly,
+            // unless SACK information needs to be sent in an empty ACK.
+            // Any delayed or deferred ACK has been sent with this segment.
+            if (AIPSTACK_LIKELY(!pcb_sack_blocks_needed(pcb))) {
+                pcb->clearFlag(TcpPcbFlags::AckPending);
+            }
+            pcb->clearFlag(TcpPcbFlags::AckDelayed|TcpPcbFlags::AckBurst);
+            
+            // With pacing, after a burst of segments, stop and continue
+            // sending when the OutputTimer expires.
+            if (AIPSTACK_UNLIKELY(paced)) {
+                burst_len += seg_seqlen;
+                if (++burst_segs >= TcpProto::PacingBurstSegs) {
+                    pcb_set_output_timer_for_pacing(pcb, burst_len);
+                    break;
+                }
+            }
         }
         
         // If the IdleTimer flag is set, clear it and ensure that the RtxTimer
@@ -402,7 +680,7 @@ public:
         // !pcb_may_delay_snd but we don't for simplicity.
         if (!pcb->tim(RtxTimer()).isSet()) {
             if (AIPSTACK_LIKELY(pcb_has_snd_unacked(pcb)) || pcb->con->m_v.snd_wnd == 0) {
-                pcb->tim(RtxTimer()).setAfter(pcb_rto_time(pcb));
+                pcb_start_rtx_timer(pcb);
             }
         }
     }
@@ -439,7 +717,8 @@ public:
                 pcb->clearFlag(TcpPcbFlags::FinPending);
                 
                 // Clear AckPending flag to avoid sending an empty ACK needlessly.
-                pcb->clearFlag(TcpPcbFlags::AckPending);
+                pcb->clearFlag(TcpPcbFlags::AckPending|TcpPcbFlags::AckDelayed|
+                               TcpPcbFlags::AckBurst);
             }
         }
         
@@ -471,6 +750,22 @@ public:
     // OutputTimer handler. Sends any queued data/FIN as permissible.
     inline static void pcb_output_timer_handler (TcpPcb *pcb)
     {
+        // In SYN_SENT this is for sending the first SYN with TCP Fast Open
+        // (see create_connection), unless it has already been sent due to
+        // a retransmission timeout.
+        if (AIPSTACK_UNLIKELY(pcb->state() == TcpStates::SYN_SENT)) {
+            if (pcb->snd_nxt == pcb->snd_una) {
+                pcb_send_syn(pcb);
+            }
+            
+            // Delayed timer update is needed by timer expiration.
+            pcb->doDelayedTimerUpdate();
+            return;
+        }
+        
+        // Sending is allowed again if this was for pacing.
+        pcb->clearFlag(TcpPcbFlags::PaceWait);
+        
         // Output using pcb_output.
         pcb_output(pcb, false);
         
@@ -488,6 +783,19 @@ public:
         pcb->doDelayedTimerUpdate();
     }
     
+    inline static void pcb_ack_timer_handler (TcpPcb *pcb)
+    {
+        AIPSTACK_ASSERT(pcb->state() != OneOf(TcpStates::CLOSED, TcpStates::TIME_WAIT));
+        
+        // Send the delayed ACK unless it was already sent with another segment.
+        if (pcb->hasFlag(TcpPcbFlags::AckDelayed)) {
+            pcb_send_empty_ack(pcb);
+        }
+        
+        // Delayed timer update is needed by timer expiration.
+        pcb->doDelayedTimerUpdate();
+    }
+    
     static void pcb_rtx_timer_handler_core (TcpPcb *pcb)
     {
         // This timer is only for SYN_SENT, SYN_RCVD and canOutput()
@@ -531,6 +839,9 @@ public:
             }
             con->m_v.cwnd_acked = 0;
             
+            // Inform the congestion control algorithm.
+            CongControl::idleRestart(CcContext{pcb});
+            
             // This is all, the remainder of this function is for retransmission.
             return;
         }
@@ -553,6 +864,17 @@ public:
             return;
         }
         
+        // Handle expiration of the RACK reordering window or the loss probe
+        // timeout, unless the conditions for these no longer hold, in which
+        // case this is handled as a retransmission timeout.
+        if (TcpProto::RackTlpEnabled && !syn_sent_rcvd &&
+            pcb->hasFlag(TcpPcbFlags::TlpTimer|TcpPcbFlags::RackTimer))
+        {
+            if (pcb_rack_tlp_timer_expired(pcb)) {
+                return;
+            }
+        }
+        
         // Double the retransmission timeout and restart the timer.
         RttType doubled_rto = (pcb->rto > RttTypeMax / 2) ? RttTypeMax : (2 * pcb->rto);
         pcb->rto = MinValue(Constants::MaxRtxTime, doubled_rto);
@@ -575,16 +897,34 @@ public:
         } else {
             // This is for data or FIN retransmission while not abandoned.
             
+            // Use F-RTO to detect a spurious timeout (RFC 5682) if this is the
+            // first retransmission and we are not already recovering from a loss.
+            bool frto = false;
+            
             // Check for first retransmission.
             if (!pcb->hasFlag(TcpPcbFlags::RtxActive)) {
                 // Set flag to indicate there has been a retransmission.
                 // This will be cleared upon new ACK.
                 pcb->setFlag(TcpPcbFlags::RtxActive);
                 
+                if (TcpProto::FrtoEnabled && !pcb->hasFlag(TcpPcbFlags::Recover) &&
+                    pcb->num_dupack < Constants::FastRtxDupAcks)
+                {
+                    frto = true;
+                    
+                    // Remember the congestion state to restore it if the
+                    // timeout turns out to be spurious.
+                    con->m_v.prior_cwnd = con->m_v.cwnd;
+                    con->m_v.prior_ssthresh = con->m_v.ssthresh;
+                }
+                
                 // Update ssthresh (RFC 5681).
-                pcb_update_ssthresh_for_rtx(pcb);
+                CongControl::rtoExpired(CcContext{pcb});
             }
             
+            // Any F-RTO from a previous timeout is abandoned.
+            pcb->clearFlag(TcpPcbFlags::FrtoAck1|TcpPcbFlags::FrtoAck2);
+            
             // Set cwnd to one segment (RFC 5681).
             // Also reset cwnd_acked to avoid old accumulated value
             // from causing an undesired cwnd increase later.
@@ -599,6 +939,18 @@ public:
             // Exit any fast recovery.
             pcb->num_dupack = 0;
             
+            // Discard SACK information since the receiver may have
+            // reneged (RFC 2018 section 8).
+            con->m_v.sack.init(pcb->snd_una);
+            
+            // With F-RTO, only retransmit the first unacknowledged segment
+            // and decide how to continue based on the following ACKs.
+            if (frto) {
+                pcb->setFlag(TcpPcbFlags::FrtoAck1);
+                pcb_output_active(pcb, true);
+                return;
+            }
+            
             // Requeue all data and FIN.
             pcb_requeue_everything(pcb);
             
@@ -642,6 +994,13 @@ public:
         
         Connection *con = pcb->con;
         
+        // Handle the ACKs following a retransmission timeout with F-RTO.
+        // If this takes care of the cwnd, skip the regular processing below.
+        bool skip_cc = false;
+        if (AIPSTACK_UNLIKELY(pcb->hasFlag(TcpPcbFlags::FrtoAck1|TcpPcbFlags::FrtoAck2))) {
+            skip_cc = pcb_frto_ack_received(pcb, ack_num, acked);
+        }
+        
         // Handle end of round-trip-time measurement.
         if (pcb->hasFlag(TcpPcbFlags::RttPending)) {
             // If we have RttPending outside of SYN_SENT/SYN_RCVD we must
@@ -649,14 +1008,25 @@ public:
             AIPSTACK_ASSERT(con != nullptr);
             
             if (con->m_v.rtt_test_seq.mod_lt(ack_num)) {
-                // Update the RTT variables and RTO.
-                pcb_end_rtt_measurement(pcb);
+                // Update the RTT variables and RTO, unless this is done
+                // for every ACK using timestamps (below).
+                if (AIPSTACK_LIKELY(!pcb->hasFlag(TcpPcbFlags::TsOpt))) {
+                    pcb_end_rtt_measurement(pcb);
+                } else {
+                    pcb->clearFlag(TcpPcbFlags::RttPending);
+                }
                 
                 // Allow more CWND increase in congestion avoidance.
                 pcb->clearFlag(TcpPcbFlags::CwndIncrd);
             }
         }
         
+        // With timestamps, take an RTT sample from every ACK which
+        // acknowledges new data (RFC 7323 section 4).
+        if (pcb->hasFlag(TcpPcbFlags::TsOpt) && con != nullptr) {
+            pcb_ts_rtt_sample(pcb);
+        }
+        
         // Connection was abandoned?
         if (AIPSTACK_UNLIKELY(con == nullptr)) {
             // Reset the duplicate ACK counter.
@@ -668,23 +1038,15 @@ public:
             pcb->num_dupack = 0;
             
             // Perform congestion-control processing.
-            if (con->m_v.cwnd <= con->m_v.ssthresh) {
+            if (AIPSTACK_UNLIKELY(skip_cc)) {
+                // The cwnd was set by pcb_frto_ack_received.
+            }
+            else if (con->m_v.cwnd <= con->m_v.ssthresh) {
                 // Slow start.
                 pcb_increase_cwnd_acked(pcb, acked);
             } else {
                 // Congestion avoidance.
-                if (!pcb->hasFlag(TcpPcbFlags::CwndIncrd)) {
-                    // Increment cwnd_acked.
-                    AddToSat(con->m_v.cwnd_acked, acked);
-                    
-                    // If cwnd data has now been acked, increment cwnd and reset cwnd_acked,
-                    // and inhibit such increments until the next RTT measurement completes.
-                    if (AIPSTACK_UNLIKELY(con->m_v.cwnd_acked >= con->m_v.cwnd)) {
-                        pcb_increase_cwnd_acked(pcb, con->m_v.cwnd_acked);
-                        con->m_v.cwnd_acked = 0;
-                        pcb->setFlag(TcpPcbFlags::CwndIncrd);
-                    }
-                }
+                CongControl::congAvoidAck(CcContext{pcb}, acked);
             }
         }
         // In fast recovery
@@ -707,8 +1069,13 @@ public:
                 // Reset num_dupack to indicate end of fast recovery.
                 pcb->num_dupack = 0;
             } else {
-                // Retransmit the first unacknowledged segment.
-                pcb_output_active(pcb, true);
+                // Retransmit the first unacknowledged segment, or with SACK,
+                // the next hole which was not yet retransmitted.
+                if (pcb->hasFlag(TcpPcbFlags::SackPerm) && !con->m_v.sack.isEmpty()) {
+                    pcb_sack_rtx_hole(pcb, ack_num);
+                } else {
+                    pcb_rtx_after_ack(pcb, ack_num);
+                }
                 
                 // Deflate CWND by the amount of data ACKed.
                 // Be careful to not bring CWND below snd_mss.
@@ -733,6 +1100,86 @@ public:
         }
     }
     
+    // Process a new ACK while F-RTO is in progress (RFC 5682 section 2.1),
+    // before the related state changes are made. Returns whether the cwnd has
+    // been set here so that no further congestion-control processing is to
+    // be done for this ACK.
+    static bool pcb_frto_ack_received (TcpPcb *pcb, TcpSeqNum ack_num, TcpSeqInt acked)
+    {
+        AIPSTACK_ASSERT(pcb->hasFlag(TcpPcbFlags::FrtoAck1|TcpPcbFlags::FrtoAck2));
+        
+        bool second_ack = pcb->hasFlag(TcpPcbFlags::FrtoAck2);
+        pcb->clearFlag(TcpPcbFlags::FrtoAck1|TcpPcbFlags::FrtoAck2);
+        
+        Connection *con = pcb->con;
+        if (AIPSTACK_UNLIKELY(con == nullptr)) {
+            return false;
+        }
+        
+        // The F-RTO retransmission was the first segment. Is anything
+        // still outstanding after it (beyond the recover point nothing
+        // was sent, since snd_buf_cur was not requeued)?
+        TcpSeqInt rem_after_ack = pcb->snd_nxt - ack_num;
+        
+        if (second_ack) {
+            // The second ACK also acknowledges data which was not retransmitted,
+            // so the original segments arrived and the timeout was spurious.
+            // Restore the congestion state and continue sending new data.
+            con->m_v.ssthresh = MaxValue(con->m_v.prior_ssthresh, TcpSeqInt(pcb->snd_mss));
+            con->m_v.cwnd = MaxValue(con->m_v.prior_cwnd, TcpSeqInt(pcb->snd_mss));
+            con->m_v.cwnd_acked = 0;
+            
+            // The recover point protects against entering fast recovery due to
+            // duplicate ACKs caused by the retransmission, which is not needed
+            // when there was just one retransmitted segment.
+            pcb->clearFlag(TcpPcbFlags::Recover);
+            
+            return true;
+        }
+        
+        // First ACK: if it does not acknowledge all of the retransmitted
+        // segment, or it acknowledges everything up to the recover point, or
+        // there is no new data to send, continue with the conventional RTO
+        // recovery (go-back-N).
+        TcpSeqInt rtx_len =
+            MinValue(TcpSeqInt(pcb->snd_mss), TcpSeqInt(pcb->snd_nxt - pcb->snd_una));
+        bool have_new = con->m_v.snd_buf_cur.tot_len > 0 ||
+            pcb->hasFlag(TcpPcbFlags::FinPending);
+        if (acked < rtx_len || rem_after_ack == 0 || !have_new) {
+            pcb_requeue_everything(pcb);
+            return false;
+        }
+        
+        // Send up to two new segments and wait for the second ACK.
+        con->m_v.cwnd = rem_after_ack;
+        AddToSat(con->m_v.cwnd, 2u * TcpSeqInt(pcb->snd_mss));
+        pcb->setFlag(TcpPcbFlags::FrtoAck2);
+        
+        return true;
+    }
+    
+    // Called from Input when a duplicate ACK has been received while F-RTO
+    // is in progress. This shows that the timeout was not spurious, so the
+    // conventional RTO recovery is done (go-back-N).
+    static void pcb_frto_dup_ack_received (TcpPcb *pcb)
+    {
+        AIPSTACK_ASSERT(pcb->hasFlag(TcpPcbFlags::FrtoAck1|TcpPcbFlags::FrtoAck2));
+        AIPSTACK_ASSERT(pcb->state().canOutput());
+        AIPSTACK_ASSERT(pcb_has_snd_unacked(pcb));
+        
+        pcb->clearFlag(TcpPcbFlags::FrtoAck1|TcpPcbFlags::FrtoAck2);
+        
+        // If the cwnd was raised for sending new segments, bring it back
+        // to one segment as set on the timeout.
+        if (AIPSTACK_LIKELY(pcb->con != nullptr)) {
+            pcb->con->m_v.cwnd = pcb->snd_mss;
+        }
+        
+        // Requeue everything and schedule output.
+        pcb_requeue_everything(pcb);
+        pcb->setFlag(TcpPcbFlags::OutPending);
+    }
+    
     // Called from Input when the number of duplicate ACKs has
     // reached FastRtxDupAcks, the fast recovery threshold.
     static void pcb_fast_rtx_dup_acks_received (TcpPcb *pcb)
@@ -750,17 +1197,26 @@ public:
             return;
         }
         
-        // Do the retransmission.
-        pcb_output(pcb, true);
-        
         Connection *con = pcb->con;
+        
+        // Do the retransmission. With SACK information, retransmit the first
+        // hole, which normally starts at snd_una.
+        if (con != nullptr && pcb->hasFlag(TcpPcbFlags::SackPerm) &&
+            !con->m_v.sack.isEmpty())
+        {
+            con->m_v.sack.startRecovery(pcb->snd_una);
+            pcb_sack_rtx_hole(pcb, pcb->snd_una);
+        } else {
+            pcb_output(pcb, true);
+        }
+        
         if (AIPSTACK_LIKELY(con != nullptr)) {
             // Set recover.
             pcb->setFlag(TcpPcbFlags::Recover);
             con->m_v.recover = pcb->snd_nxt;
             
             // Update ssthresh.
-            pcb_update_ssthresh_for_rtx(pcb);
+            CongControl::lossDetected(CcContext{pcb});
             
             // Update cwnd.
             TcpSeqInt cwnd = con->m_v.ssthresh;
@@ -785,6 +1241,13 @@ public:
             // Increment CWND by snd_mss.
             AddToSat(pcb->con->m_v.cwnd, pcb->snd_mss);
             
+            // With SACK, retransmit the next hole (if any). Thereby all holes
+            // are repaired within about one round-trip, instead of one hole
+            // per round-trip as with partial acknowledgements only.
+            if (pcb->hasFlag(TcpPcbFlags::SackPerm)) {
+                pcb_sack_rtx_hole(pcb, pcb->snd_una);
+            }
+            
             // Schedule output due to possible CWND increase.
             pcb->setFlag(TcpPcbFlags::OutPending);
         }
@@ -795,6 +1258,171 @@ public:
         return TimeType(pcb->rto) << Constants::RttShift;
     }
     
+    // Start the rtx_timer for outstanding data/FIN or a window probe. With
+    // RACK-TLP this may instead be for the RACK reordering window (when
+    // there is SACK information) or for a tail loss probe (RFC 8985).
+    static void pcb_start_rtx_timer (TcpPcb *pcb)
+    {
+        pcb->clearFlag(TcpPcbFlags::TlpTimer|TcpPcbFlags::RackTimer);
+        
+        if (TcpProto::RackTlpEnabled && pcb_rack_tlp_allowed(pcb)) {
+            if (!pcb->con->m_v.sack.isEmpty()) {
+                pcb_start_rack_timer(pcb);
+            } else {
+                pcb->setFlag(TcpPcbFlags::TlpTimer);
+                pcb->tim(RtxTimer()).setAfter(pcb_pto_time(pcb));
+            }
+            return;
+        }
+        
+        pcb->tim(RtxTimer()).setAfter(pcb_rto_time(pcb));
+    }
+    
+    // RACK and TLP are used only with SACK, once the RTT is known, outside
+    // of any loss recovery, and when there is unacknowledged data and the
+    // send window is not zero (otherwise the rtx_timer is for a window probe).
+    static bool pcb_rack_tlp_allowed (TcpPcb *pcb)
+    {
+        return pcb->con != nullptr &&
+            pcb->hasFlag(TcpPcbFlags::SackPerm) && pcb->hasFlag(TcpPcbFlags::RttValid) &&
+            !pcb->hasFlag(TcpPcbFlags::RtxActive|TcpPcbFlags::Recover) &&
+            pcb->num_dupack < Constants::FastRtxDupAcks &&
+            pcb->con->m_v.snd_wnd != 0 && pcb_has_snd_unacked(pcb);
+    }
+    
+    // Calculate the probe timeout (RFC 8985 section 7.2). When only one segment
+    // is in flight, allow for the peer delaying the ACK. The PTO is not greater
+    // than the RTO.
+    static TimeType pcb_pto_time (TcpPcb *pcb)
+    {
+        RttType srtt = pcb->con->m_v.srtt;
+        RttType pto = (srtt > RttTypeMax / 2) ? RttTypeMax : (2 * srtt);
+        if (pcb->snd_nxt - pcb->snd_una <= pcb->snd_mss) {
+            AddToSat(pto, Constants::TlpDelAckTime);
+        }
+        pto = MaxValue(Constants::TlpMinTime, MinValue(pcb->rto, pto));
+        
+        return TimeType(pto) << Constants::RttShift;
+    }
+    
+    // Start the rtx_timer for the RACK reordering window. SACK information
+    // shows that data sent after snd_una has been delivered, so the segment
+    // at snd_una was sent at least about one RTT ago. Once the reordering
+    // window has also passed it is deemed lost (RFC 8985 section 6.2).
+    static void pcb_start_rack_timer (TcpPcb *pcb)
+    {
+        RttType reo_wnd = MaxValue(RttType(1),
+            RttType(pcb->con->m_v.srtt >> Constants::RackReoWndShift));
+        
+        pcb->setFlag(TcpPcbFlags::RackTimer);
+        pcb->tim(RtxTimer()).setAfter(TimeType(reo_wnd) << Constants::RttShift);
+    }
+    
+    // Called from Input when SACK information has been processed for a
+    // segment which did not acknowledge new data. Starts the RACK reordering
+    // window if not already started. For new ACKs this is done by
+    // pcb_output_active via pcb_start_rtx_timer.
+    // NOTE: doDelayedTimerUpdate must be called after return.
+    static void pcb_rack_sack_received (TcpPcb *pcb)
+    {
+        AIPSTACK_ASSERT(TcpProto::RackTlpEnabled);
+        AIPSTACK_ASSERT(pcb->state().canOutput());
+        AIPSTACK_ASSERT(pcb->con != nullptr);
+        
+        if (!pcb->hasFlag(TcpPcbFlags::RackTimer) && !pcb->con->m_v.sack.isEmpty() &&
+            pcb_rack_tlp_allowed(pcb))
+        {
+            pcb->clearFlag(TcpPcbFlags::TlpTimer);
+            pcb_start_rack_timer(pcb);
+        }
+    }
+    
+    // Handle expiration of the rtx_timer set for the RACK reordering window
+    // or a tail loss probe. Returns false if RACK-TLP is no longer applicable
+    // and the expiration should be handled as a retransmission timeout.
+    static bool pcb_rack_tlp_timer_expired (TcpPcb *pcb)
+    {
+        bool rack = pcb->hasFlag(TcpPcbFlags::RackTimer);
+        pcb->clearFlag(TcpPcbFlags::TlpTimer|TcpPcbFlags::RackTimer);
+        
+        if (!pcb_rack_tlp_allowed(pcb)) {
+            return false;
+        }
+        
+        if (rack) {
+            // If the SACKed data has since been cumulatively acknowledged,
+            // nothing is deemed lost, just restart the timer.
+            if (pcb->con->m_v.sack.isEmpty()) {
+                pcb_start_rtx_timer(pcb);
+                return true;
+            }
+            
+            // The retransmission timeout follows (without backoff).
+            pcb->tim(RtxTimer()).setAfter(pcb_rto_time(pcb));
+            
+            // The segment at snd_una is lost, start fast recovery just as
+            // if the duplicate ACK threshold had been reached.
+            pcb->num_dupack = Constants::FastRtxDupAcks;
+            pcb_fast_rtx_dup_acks_received(pcb);
+            
+            // Send anything allowed by the new cwnd right away, since
+            // OutPending is only handled in input processing.
+            pcb->clearFlag(TcpPcbFlags::OutPending);
+            pcb_output_active(pcb, false);
+        } else {
+            // The retransmission timeout follows (without backoff).
+            pcb->tim(RtxTimer()).setAfter(pcb_rto_time(pcb));
+            
+            // Send a loss probe (RFC 8985 section 7.3): new data if that can
+            // be sent, otherwise retransmit the most recently sent segment.
+            // The ACK of the probe then triggers SACK-based recovery of any
+            // lost tail instead of waiting for the RTO.
+            TcpSeqNum old_snd_nxt = pcb->snd_nxt;
+            pcb_output_active(pcb, false);
+            if (pcb->snd_nxt == old_snd_nxt) {
+                pcb_tlp_rtx_last(pcb);
+            }
+        }
+        
+        return true;
+    }
+    
+    // Retransmit the most recently sent segment as a tail loss probe.
+    static void pcb_tlp_rtx_last (TcpPcb *pcb)
+    {
+        AIPSTACK_ASSERT(pcb->state().canOutput());
+        AIPSTACK_ASSERT(pcb->con != nullptr);
+        AIPSTACK_ASSERT(pcb_has_snd_unacked(pcb));
+        
+        Connection *con = pcb->con;
+        
+        // If no data has been sent, only the FIN is outstanding,
+        // retransmit it in the usual manner.
+        std::size_t sent_len = con->m_v.snd_buf.tot_len - con->m_v.snd_buf_cur.tot_len;
+        if (sent_len == 0) {
+            pcb_output_active(pcb, true);
+            return;
+        }
+        
+        // Resend up to snd_mss of the sent data, with the FIN if it was sent.
+        // The window passed is just enough for that.
+        std::size_t offset = sent_len - MinValueU(sent_len, pcb->snd_mss);
+        bool fin = pcb->hasFlag(TcpPcbFlags::FinSent) &&
+            !pcb->hasFlag(TcpPcbFlags::FinPending);
+        IpBufRef data = ipBufSkipBytes(con->m_v.snd_buf, offset);
+        TcpSeqInt probe_wnd = TcpSeqInt(sent_len - offset) + fin;
+        
+        PcbOutputHelper output_helper;
+        TcpSeqInt seg_seqlen;
+        IpErr err = pcb_output_segment(
+            pcb, output_helper, data, fin, probe_wnd, &seg_seqlen);
+        
+        if (AIPSTACK_UNLIKELY(err == IpErr::FragmentationNeeded)) {
+            // See the same in pcb_output_active.
+            pcb->tcp->m_stack->handleLocalPacketTooBig(pcb->remote_addr);
+        }
+    }
+    
     static void pcb_end_rtt_measurement (TcpPcb *pcb)
     {
         AIPSTACK_ASSERT(pcb->hasFlag(TcpPcbFlags::RttPending));
@@ -807,6 +1435,36 @@ public:
         TimeType time_diff = pcb->platform().getTime() - pcb->rtt_test_time;
         RttType this_rtt = MinValueU(RttTypeMax, time_diff >> Constants::RttShift);
         
+        // Update the RTT variables and RTO.
+        pcb_update_rtt(pcb, this_rtt);
+    }
+    
+    // Take an RTT sample from the timestamp echoed in the received segment.
+    // The received options have been parsed by Input (pcb_paws_check).
+    static void pcb_ts_rtt_sample (TcpPcb *pcb)
+    {
+        AIPSTACK_ASSERT(pcb->hasFlag(TcpPcbFlags::TsOpt));
+        AIPSTACK_ASSERT(pcb->con != nullptr);
+        
+        TcpOptions const &opts = pcb->tcp->m_received_opts;
+        if ((opts.options & TcpOptionFlags::Timestamps) == Enum0 || opts.ts_ecr == 0) {
+            return;
+        }
+        
+        // Ignore an echoed timestamp from the future (bogus).
+        std::uint32_t ts_diff = pcb_ts_now(pcb) - opts.ts_ecr;
+        if (AIPSTACK_UNLIKELY(ts_diff >= std::uint32_t(1) << 31)) {
+            return;
+        }
+        
+        pcb_update_rtt(pcb, RttType(MinValueU(RttTypeMax, ts_diff)));
+    }
+    
+    // Update RTTVAR, SRTT and RTO with a new RTT sample (RFC 6298).
+    static void pcb_update_rtt (TcpPcb *pcb, RttType this_rtt)
+    {
+        AIPSTACK_ASSERT(pcb->con != nullptr);
+        
         Connection *con = pcb->con;
         
         // Update RTTVAR and SRTT.
@@ -860,11 +1518,18 @@ public:
         std::uint16_t mtu_mss = pmtu - Ip4TcpHeaderSize;
         std::uint16_t snd_mss = MinValue(pcb->base_snd_mss, mtu_mss);
         
-        // This snd_mss cannot be less than MinAllowedMss:
+        // With timestamps, every segment includes the option so there is
+        // that much less space for data (RFC 6691).
+        if (pcb->hasFlag(TcpPcbFlags::TsOpt)) {
+            snd_mss -= TcpOptionWriteLen::Timestamps;
+        }
+        
+        // This snd_mss cannot be less than MinSndMss:
         // - base_snd_mss was explicitly checked in CalcTcpSndMss.
-        // - mtu-Ip4TcpHeaderSize cannot be less because
+        // - mtu-Ip4TcpHeaderSize cannot be less than MinAllowedMss because
         //   MinAllowedMss==MinMTU-Ip4TcpHeaderSize.
-        AIPSTACK_ASSERT(snd_mss >= Constants::MinAllowedMss);
+        // - The timestamps option takes MinAllowedMss-MinSndMss at most.
+        AIPSTACK_ASSERT(snd_mss >= Constants::MinSndMss);
         
         return snd_mss;
     }
@@ -1008,6 +1673,30 @@ public:
         send_rst(tcp, key, rst_seq_num, rst_ack, rst_ack_num);
     }
     
+    // Send a SYN-ACK whose sequence number is a SYN cookie, as a reply
+    // to a SYN received for a listener (without a PCB).
+    static void send_syn_cookie_syn_ack (TcpProto *tcp, TcpPcbKey const &key,
+        TcpSeqNum iss, TcpSeqNum rcv_nxt, std::uint16_t window_size,
+        std::uint16_t iface_mss, TcpSynCookieInfo const &info)
+    {
+        // Include the same options as pcb_send_syn, except timestamps.
+        TcpOptions tcp_opts;
+        tcp_opts.options = TcpOptionFlags::Mss;
+        tcp_opts.mss = iface_mss;
+        
+        if (info.wnd_scale) {
+            tcp_opts.options |= TcpOptionFlags::WndScale;
+            tcp_opts.wnd_scale = Constants::RcvWndShift;
+        }
+        
+        if (info.sack_perm) {
+            tcp_opts.options |= TcpOptionFlags::SackPerm;
+        }
+        
+        send_tcp_nodata(tcp, key, iss, rcv_nxt, window_size,
+            Tcp4Flags::Syn|Tcp4Flags::Ack, &tcp_opts, /*retryReq=*/nullptr);
+    }
+    
     AIPSTACK_NO_INLINE
     static void send_rst (TcpProto *tcp,
         TcpPcbKey const &key, TcpSeqNum seq_num, bool ack, TcpSeqNum ack_num)
@@ -1017,6 +1706,70 @@ public:
             /*window_size=*/0, flags, /*opts=*/nullptr, /*retryReq=*/nullptr);
     }
     
+    // Context through which the congestion control algorithm accesses
+    // the connection (see TcpCongControlReno).
+    struct CcContext {
+        TcpPcb *pcb;
+        
+        inline static constexpr double TimeFreq = Constants::RttTimeFreq;
+        
+        inline CcState & state () const
+        {
+            return pcb->con->m_v.cc;
+        }
+        
+        inline TcpSeqInt cwnd () const
+        {
+            return pcb->con->m_v.cwnd;
+        }
+        
+        inline void increaseCwnd (TcpSeqInt amount) const
+        {
+            AddToSat(pcb->con->m_v.cwnd, amount);
+            pcb->clearFlag(TcpPcbFlags::CwndInit);
+        }
+        
+        inline TcpSeqInt & ssthresh () const
+        {
+            return pcb->con->m_v.ssthresh;
+        }
+        
+        inline TcpSeqInt & cwndAcked () const
+        {
+            return pcb->con->m_v.cwnd_acked;
+        }
+        
+        inline std::uint16_t sndMss () const
+        {
+            return pcb->snd_mss;
+        }
+        
+        inline TcpSeqInt flightSize () const
+        {
+            return pcb->snd_nxt - pcb->snd_una;
+        }
+        
+        inline std::uint32_t now () const
+        {
+            return pcb_ts_now(pcb);
+        }
+        
+        inline std::uint32_t srtt () const
+        {
+            return pcb->con->m_v.srtt;
+        }
+        
+        inline bool hasCwndIncrd () const
+        {
+            return pcb->hasFlag(TcpPcbFlags::CwndIncrd);
+        }
+        
+        inline void setCwndIncrd () const
+        {
+            pcb->setFlag(TcpPcbFlags::CwndIncrd);
+        }
+    };
+
 private:
     class PcbOutputHelper;
     
@@ -1040,6 +1793,28 @@ private:
         }
     }
     
+    // Set the OutputTimer for sending the next burst of segments with
+    // pacing, after burst_len has just been sent. The pacing rate is
+    // cwnd/srtt times a gain which is larger in slow start.
+    // NOTE: doDelayedTimerUpdate must be called after return.
+    static void pcb_set_output_timer_for_pacing (TcpPcb *pcb, TcpSeqInt burst_len)
+    {
+        AIPSTACK_ASSERT(pcb->con != nullptr);
+        AIPSTACK_ASSERT(pcb->hasFlag(TcpPcbFlags::RttValid));
+        
+        Connection *con = pcb->con;
+        
+        std::uint32_t gain_percent = (con->m_v.cwnd < con->m_v.ssthresh) ?
+            Constants::PacingGainSsPercent : Constants::PacingGainCaPercent;
+        TimeType srtt_time = TimeType(con->m_v.srtt) << Constants::RttShift;
+        TimeType after = TimeType((std::uint64_t(burst_len) * srtt_time * 100) /
+            (std::uint64_t(gain_percent) * con->m_v.cwnd));
+        
+        pcb->tim(OutputTimer()).setAfter(after);
+        pcb->clearFlag(TcpPcbFlags::OutRetry);
+        pcb->setFlag(TcpPcbFlags::PaceWait);
+    }
+    
     // Set the OutputTimer for retrying sending.
     // NOTE: doDelayedTimerUpdate must be called after return.
     static void pcb_set_output_timer_for_retry (TcpPcb *pcb, IpErr err)
@@ -1051,10 +1826,92 @@ private:
             Constants::OutputRetryFullTicks : Constants::OutputRetryOtherTicks;
         pcb->tim(OutputTimer()).setAfter(after);
         pcb->setFlag(TcpPcbFlags::OutRetry);
+        pcb->clearFlag(TcpPcbFlags::PaceWait);
+    }
+    
+    // Retransmit one segment from the next hole in the SACK scoreboard which
+    // has not been retransmitted yet in the current recovery. The snd_una
+    // argument is the (possibly not yet updated) snd_una relative to which
+    // holes are found. This does not touch any timers.
+    AIPSTACK_NO_INLINE
+    static void pcb_sack_rtx_hole (TcpPcb *pcb, TcpSeqNum snd_una)
+    {
+        AIPSTACK_ASSERT(pcb->state().canOutput());
+        AIPSTACK_ASSERT(pcb->con != nullptr);
+        AIPSTACK_ASSERT(pcb->hasFlag(TcpPcbFlags::SackPerm));
+        
+        Connection *con = pcb->con;
+        
+        // Find the hole, if there is none there is nothing to do.
+        TcpSeqNum hole_start;
+        TcpSeqInt hole_len;
+        if (!con->m_v.sack.nextHole(snd_una, hole_start, hole_len)) {
+            return;
+        }
+        
+        // SACKed ranges never go beyond the data in the send buffer (excluding
+        // a FIN), so the hole is fully within the send buffer, which starts at
+        // pcb->snd_una.
+        std::size_t offset = hole_start - pcb->snd_una;
+        AIPSTACK_ASSERT(offset < con->m_v.snd_buf.tot_len);
+        AIPSTACK_ASSERT(hole_len <= con->m_v.snd_buf.tot_len - offset);
+        IpBufRef data = ipBufSkipBytes(con->m_v.snd_buf, offset);
+        
+        // Send one segment of no more than the hole.
+        PcbOutputHelper output_helper;
+        TcpSeqInt seg_seqlen;
+        IpErr err = pcb_output_segment(
+            pcb, output_helper, data, /*fin=*/false, hole_len, &seg_seqlen);
+        
+        if (AIPSTACK_LIKELY(err == IpErr::Success)) {
+            // Remember what has been retransmitted.
+            con->m_v.sack.holeRetransmitted(hole_start + seg_seqlen);
+        }
+        else if (err == IpErr::FragmentationNeeded) {
+            // See the same in pcb_output_active.
+            pcb->tcp->m_stack->handleLocalPacketTooBig(pcb->remote_addr);
+        }
+    }
+    
+    // Retransmit one segment starting at ack_num, which is the new snd_una
+    // for an ACK which is being processed (snd_una is not updated yet).
+    // This does not touch any timers.
+    AIPSTACK_NO_INLINE
+    static void pcb_rtx_after_ack (TcpPcb *pcb, TcpSeqNum ack_num)
+    {
+        AIPSTACK_ASSERT(pcb->state().canOutput());
+        AIPSTACK_ASSERT(pcb->con != nullptr);
+        
+        Connection *con = pcb->con;
+        
+        // Something is outstanding after ack_num. The FIN is not acked, so
+        // the acked part is all data.
+        std::size_t offset = ack_num - pcb->snd_una;
+        AIPSTACK_ASSERT(offset <= con->m_v.snd_buf.tot_len);
+        IpBufRef data = ipBufSkipBytes(con->m_v.snd_buf, offset);
+        bool fin = !pcb->state().isSndOpen();
+        AIPSTACK_ASSERT(data.tot_len > 0 || fin);
+        
+        // Send no more than allowed by the receiver window (which is still
+        // relative to snd_una) but at least one count, like for any
+        // retransmission in pcb_output_active.
+        TcpSeqInt rem_wnd = (con->m_v.snd_wnd > offset) ?
+            TcpSeqInt(con->m_v.snd_wnd - offset) : 1;
+        
+        PcbOutputHelper output_helper;
+        TcpSeqInt seg_seqlen;
+        IpErr err = pcb_output_segment(
+            pcb, output_helper, data, fin, rem_wnd, &seg_seqlen);
+        
+        if (AIPSTACK_UNLIKELY(err == IpErr::FragmentationNeeded)) {
+            // See the same in pcb_output_active.
+            pcb->tcp->m_stack->handleLocalPacketTooBig(pcb->remote_addr);
+        }
     }
     
     // This function sends data/FIN for referenced PCBs. It is designed to be
-    // inlined into pcb_output_active and should not be called from elsewhere.
+    // inlined into pcb_output_active, pcb_sack_rtx_hole, pcb_rtx_after_ack and
+    // pcb_tlp_rtx_last and should not be called from elsewhere.
     AIPSTACK_ALWAYS_INLINE
     static IpErr pcb_output_segment (TcpPcb *pcb, PcbOutputHelper &helper,
         IpBufRef data, bool fin, TcpSeqInt rem_wnd, TcpSeqInt *out_seg_seqlen)
@@ -1154,11 +2011,20 @@ private:
         // Get the windows size to announce.
         std::uint16_t window_size = Input::pcb_ann_wnd(pcb);
 
+        // Include the timestamps option if used.
+        TcpOptions tcp_opts;
+        TcpOptions *opts = nullptr;
+        if (pcb->hasFlag(TcpPcbFlags::TsOpt)) {
+            tcp_opts.options = TcpOptionFlags(0);
+            pcb_set_ts_option(pcb, tcp_opts);
+            opts = &tcp_opts;
+        }
+        
         // Send a FIN segment.
         Tcp4Flags flags = Tcp4Flags::Ack|Tcp4Flags::Fin|Tcp4Flags::Psh;
         IpErr err = send_tcp_nodata(pcb->tcp, *pcb,
             /*seq_num=*/pcb->snd_una, /*ack_num=*/pcb->rcv_nxt,
-            window_size, flags, /*opts=*/nullptr, /*retryReq=*/pcb);
+            window_size, flags, opts, /*retryReq=*/pcb);
         
         // On success take note of what was sent.
         if (AIPSTACK_LIKELY(err == IpErr::Success)) {
@@ -1187,17 +2053,6 @@ private:
         pcb->clearFlag(TcpPcbFlags::CwndInit);
     }
     
-    // Sets sshthresh according to RFC 5681 equation (4).
-    static void pcb_update_ssthresh_for_rtx (TcpPcb *pcb)
-    {
-        AIPSTACK_ASSERT(pcb->state().canOutput());
-        AIPSTACK_ASSERT(pcb->con != nullptr);
-        
-        TcpSeqInt half_flight_size = (pcb->snd_nxt - pcb->snd_una) / 2u;
-        TcpSeqInt two_smss = 2u * TcpSeqInt(pcb->snd_mss);
-        pcb->con->m_v.ssthresh = MaxValue(half_flight_size, two_smss);
-    }
-    
     static void pcb_start_rtt_measurement (TcpPcb *pcb, bool syn)
     {
         AIPSTACK_ASSERT(!syn ||
@@ -1218,9 +2073,11 @@ private:
     class PcbOutputHelper {
     private:
         bool prepared;
+        std::uint8_t opts_len;
         IpChksumAccumulator::State partial_chksum_state;
         IpSendPreparedIp4<StackArg> ip_prep;
-        TxAllocHelper<Tcp4Header::Size, HeaderBeforeIp4Dgram> dgram_alloc;
+        TxAllocHelper<Tcp4Header::Size + TcpOptionWriteLen::Timestamps,
+                      HeaderBeforeIp4Dgram> dgram_alloc;
         
     public:
         inline PcbOutputHelper ()
@@ -1236,9 +2093,6 @@ private:
         IpErr sendSegment (TcpPcb *pcb,
             TcpSeqNum seq_num, Tcp4Flags seg_flags, IpBufRef data)
         {
-            // Reset the TxAllocHelper.
-            dgram_alloc.reset(Tcp4Header::Size);
-            
             // If this is the first tranamission, prepare common things.
             if (!prepared) {
                 IpErr err = prepareCommon(pcb);
@@ -1247,6 +2101,10 @@ private:
                 }
             }
             
+            // Reset the TxAllocHelper.
+            std::size_t hdr_len = Tcp4Header::Size + opts_len;
+            dgram_alloc.reset(hdr_len);
+            
             // Continue calculating the checksum from the partial calculation.
             IpChksumAccumulator chksum(partial_chksum_state);
             
@@ -1258,12 +2116,12 @@ private:
             chksum.addWord(WrapType<TcpSeqInt>(), seq_num.value());
             
             // Offset+flags
-            Tcp4Flags offset_flags = Tcp4EncodeOffset(5) | seg_flags;
+            Tcp4Flags offset_flags = Tcp4EncodeOffset(5 + opts_len / 4) | seg_flags;
             tcp_header.set(Tcp4Header::OffsetFlags(), offset_flags);
             chksum.addWord(WrapType<std::uint16_t>(), AsUnderlying(offset_flags));
             
             // Add TCP length to checksum.
-            std::uint16_t tcp_len = std::uint16_t(Tcp4Header::Size + data.tot_len);
+            std::uint16_t tcp_len = std::uint16_t(hdr_len + data.tot_len);
             chksum.addWord(WrapType<std::uint16_t>(), tcp_len);
             
             // Include any data.
@@ -1273,8 +2131,17 @@ private:
                 dgram_alloc.setNext(&data_node, data.tot_len);
             }
             
-            // Calculate checksum.
-            tcp_header.set(Tcp4Header::Checksum(), chksum.getChksum(data));
+            // Calculate checksum, unless the driver calculates it. Use the cache
+            // of send buffer block checksums if the application has set one.
+            std::uint16_t calc_chksum = 0;
+            if (AIPSTACK_LIKELY((ip_prep.route_info.iface->getTxChksumOffload() &
+                                 IpChksumFlags::Transport) == Enum0))
+            {
+                IpChksumBlockCache *cache = pcb->con->m_v.snd_chksum_cache;
+                calc_chksum = (cache != nullptr) ?
+                    cache->getChksum(chksum, data) : chksum.getChksum(data);
+            }
+            tcp_header.set(Tcp4Header::Checksum(), calc_chksum);
             
             // Get the complete datagram reference starting with the TCP header.
             IpBufRef dgram = dgram_alloc.getBufRef();
@@ -1286,6 +2153,9 @@ private:
     private:
         IpErr prepareCommon (TcpPcb *pcb)
         {
+            // Initialize the TxAllocHelper so that the header can be written.
+            dgram_alloc.reset(Tcp4Header::Size);
+            
             // We will calculate part of the checksum.
             IpChksumAccumulator chksum;
             
@@ -1312,6 +2182,15 @@ private:
             // Urgent pointer
             tcp_header.set(Tcp4Header::UrgentPtr(), 0);
             
+            // Timestamps option, the same for all segments sent at once.
+            opts_len = 0;
+            if (pcb->hasFlag(TcpPcbFlags::TsOpt)) {
+                char *opt_ptr = dgram_alloc.getPtr() + Tcp4Header::Size;
+                WriteTcpTimestampsOption(opt_ptr, pcb_ts_now(pcb), pcb->ts_recent);
+                chksum.addEvenBytes(opt_ptr, TcpOptionWriteLen::Timestamps);
+                opts_len = TcpOptionWriteLen::Timestamps;
+            }
+            
             // Add known pseudo-header fields to checksum.
             chksum.addWord(WrapType<std::uint16_t>(), AsUnderlying(Ip4Protocol::Tcp));
             chksum.addWord(WrapType<std::uint32_t>(), pcb->local_addr.value());
@@ -1334,10 +2213,13 @@ private:
         }
     };
     
+    // Send a segment which is not constructed from the send buffer. This
+    // normally has no data, except for a SYN with TCP Fast Open.
     AIPSTACK_NO_INLINE
     static IpErr send_tcp_nodata (TcpProto *tcp, TcpPcbKey const &key,
         TcpSeqNum seq_num, TcpSeqNum ack_num, std::uint16_t window_size,
-        Tcp4Flags flags, TcpOptions *opts, IpSendRetryRequest *retryReq)
+        Tcp4Flags flags, TcpOptions *opts, IpSendRetryRequest *retryReq,
+        IpBufRef data = IpBufRef{})
     {
         // Compute length of TCP options.
         std::uint8_t opts_len = (opts != nullptr) ? CalcTcpOptionsLength(*opts) : 0;
@@ -1384,6 +2266,13 @@ private:
             WriteTcpOptions(*opts, dgram_alloc.getPtr() + Tcp4Header::Size);
         }
         
+        // Include any data.
+        IpBufNode data_node;
+        if (data.tot_len > 0) {
+            data_node = ipBufRefToNode(data);
+            dgram_alloc.setNext(&data_node, data.tot_len);
+        }
+        
         // Construct the datagram reference including any data.
         IpBufRef dgram = dgram_alloc.getBufRef();
         
@@ -25,9 +25,12 @@
 #ifndef AIPSTACK_TCP_API_H
 #define AIPSTACK_TCP_API_H
 
+#include <cstdint>
+
 #include <aipstack/misc/NonCopyable.h>
 #include <aipstack/platform/PlatformFacade.h>
 #include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/tcp/TcpSynCookie.h>
 #include <aipstack/tcp/TcpListener.h>
 #include <aipstack/tcp/TcpConnection.h>
 #include <aipstack/tcp/IpTcpProto_constants.h>
@@ -73,6 +76,26 @@ public:
     {
         return proto().platform();
     }
+    
+    /**
+     * Set the secret key used to generate and validate SYN cookies.
+     * 
+     * SYN cookies (if the SynCookiesEnabled option of @ref IpTcpProtoOptions is
+     * enabled) are used by listeners when many connections are in the SYN_RCVD
+     * state or the listener's limit of such connections is reached.
+     * The key is also used for TCP Fast Open cookies and to randomize the
+     * selection of ephemeral ports.
+     * The key should be random; by default one is derived from the time of
+     * initialization, which is predictable. Cookies sent with a previous key
+     * are no longer valid after the key is changed.
+     * 
+     * @param k0 First half of the key.
+     * @param k1 Second half of the key.
+     */
+    inline void setSynCookieKey (std::uint64_t k0, std::uint64_t k1)
+    {
+        proto().m_syn_cookie_key = TcpSynCookie::Key{k0, k1};
+    }
 };
 
 }
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2016 Ambroz Bizjak
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AIPSTACK_TCP_CONG_CONTROL_H
+#define AIPSTACK_TCP_CONG_CONTROL_H
+
+#include <cstdint>
+
+#include <aipstack/misc/MinMax.h>
+#include <aipstack/misc/Hints.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+
+namespace AIpStack {
+
+/**
+ * Reno congestion control (RFC 5681), the default congestion control
+ * algorithm for @ref IpTcpProto.
+ * 
+ * A congestion control algorithm is selected using the
+ * @ref IpTcpProtoOptions::CongControl option. It is a class which provides
+ * a per-connection `State` type (which must be trivially copyable) and the
+ * static functions listed below. Each function is passed a context object
+ * `ctx` through which the connection is accessed:
+ * - `ctx.state()`: reference to the `State` of the connection.
+ * - `ctx.cwnd()`, `ctx.increaseCwnd(amount)`: get and increase cwnd.
+ * - `ctx.ssthresh()`, `ctx.cwndAcked()`: references to ssthresh and the
+ *   counter of data acknowledged available for use by the algorithm.
+ * - `ctx.sndMss()`, `ctx.flightSize()`: the send MSS and the amount of
+ *   sent and unacknowledged data.
+ * - `ctx.now()`, `ctx.srtt()`: the current time and the smoothed RTT, in
+ *   units of `Ctx::TimeFreq` per second.
+ * - `ctx.hasCwndIncrd()`, `ctx.setCwndIncrd()`: a flag which is cleared
+ *   when an RTT measurement completes (approximately once per RTT).
+ * 
+ * Slow start, fast recovery (cwnd inflation and deflation) and the cwnd
+ * reductions after a retransmission timeout and idle period are performed
+ * by the stack. The algorithm is responsible for:
+ * - `init(ctx)`: initialize the state when the connection is established.
+ * - `congAvoidAck(ctx, acked)`: increase cwnd in congestion avoidance
+ *   (cwnd>ssthresh and not in fast recovery) when new data is acknowledged.
+ * - `lossDetected(ctx)`: set ssthresh when entering fast recovery.
+ * - `rtoExpired(ctx)`: set ssthresh at the first retransmission timeout
+ *   (cwnd is then set to one segment).
+ * - `idleRestart(ctx)`: update the state after an idle period (cwnd has
+ *   been reduced to at most the initial window).
+ * 
+ * Implementations must keep ssthresh no less than the send MSS.
+ */
+class TcpCongControlReno {
+public:
+    /**
+     * Per-connection state (none needed for Reno).
+     */
+    struct State {};
+    
+    template<typename Ctx>
+    static void init (Ctx)
+    {
+    }
+    
+    template<typename Ctx>
+    static void congAvoidAck (Ctx ctx, TcpSeqInt acked)
+    {
+        if (!ctx.hasCwndIncrd()) {
+            // Increment cwnd_acked.
+            AddToSat(ctx.cwndAcked(), acked);
+            
+            // If cwnd data has now been acked, increment cwnd and reset cwnd_acked,
+            // and inhibit such increments until the next RTT measurement completes.
+            if (AIPSTACK_UNLIKELY(ctx.cwndAcked() >= ctx.cwnd())) {
+                ctx.increaseCwnd(MinValueU(ctx.cwndAcked(), ctx.sndMss()));
+                ctx.cwndAcked() = 0;
+                ctx.setCwndIncrd();
+            }
+        }
+    }
+    
+    template<typename Ctx>
+    static void lossDetected (Ctx ctx)
+    {
+        update_ssthresh(ctx);
+    }
+    
+    template<typename Ctx>
+    static void rtoExpired (Ctx ctx)
+    {
+        update_ssthresh(ctx);
+    }
+    
+    template<typename Ctx>
+    static void idleRestart (Ctx)
+    {
+    }
+    
+private:
+    // Sets sshthresh according to RFC 5681 equation (4).
+    template<typename Ctx>
+    static void update_ssthresh (Ctx ctx)
+    {
+        TcpSeqInt half_flight_size = ctx.flightSize() / 2u;
+        TcpSeqInt two_smss = 2u * TcpSeqInt(ctx.sndMss());
+        ctx.ssthresh() = MaxValue(half_flight_size, two_smss);
+    }
+};
+
+}
+
+#endif
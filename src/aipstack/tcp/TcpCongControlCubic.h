@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2016 Ambroz Bizjak
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AIPSTACK_TCP_CONG_CONTROL_CUBIC_H
+#define AIPSTACK_TCP_CONG_CONTROL_CUBIC_H
+
+#include <cstdint>
+
+#include <aipstack/misc/MinMax.h>
+#include <aipstack/misc/Hints.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+
+namespace AIpStack {
+
+/**
+ * CUBIC congestion control (RFC 8312).
+ * 
+ * To use it, include this header and set @ref IpTcpProtoOptions::CongControl
+ * to this class. See @ref TcpCongControlReno for the interface.
+ * 
+ * In congestion avoidance, the window grows as a cubic function of the time
+ * since the last reduction, independently of the RTT, so long-RTT paths
+ * are filled much faster than with Reno. Near the window where the last
+ * loss occurred the growth is slow, and beyond it, it accelerates again.
+ * The growth is never slower than an estimate of the Reno window.
+ * 
+ * Constants are C=0.4 and beta=0.7, with fast convergence. Integer arithmetic
+ * is used throughout.
+ */
+class TcpCongControlCubic {
+public:
+    /**
+     * Per-connection state.
+     */
+    struct State {
+        // Window before the last reduction (W_max).
+        TcpSeqInt w_max;
+        // Window at the plateau of the cubic function in the current epoch.
+        TcpSeqInt origin;
+        // Estimate of the Reno window for the TCP-friendly region (W_est).
+        TcpSeqInt w_est;
+        // Start time of the current epoch.
+        std::uint32_t epoch_start;
+        // Time from epoch_start to reach origin (K).
+        std::uint32_t k;
+        // Whether an epoch has started (epoch_start, origin, w_est and k valid).
+        bool epoch_valid;
+    };
+    
+    template<typename Ctx>
+    static void init (Ctx ctx)
+    {
+        State &st = ctx.state();
+        st.w_max = 0;
+        st.epoch_valid = false;
+    }
+    
+    template<typename Ctx>
+    static void congAvoidAck (Ctx ctx, TcpSeqInt acked)
+    {
+        State &st = ctx.state();
+        TcpSeqInt cwnd = ctx.cwnd();
+        std::uint16_t mss = ctx.sndMss();
+        std::uint32_t now = ctx.now();
+        
+        // Start a new epoch at the first ACK in congestion avoidance.
+        if (AIPSTACK_UNLIKELY(!st.epoch_valid)) {
+            st.epoch_valid = true;
+            st.epoch_start = now;
+            if (cwnd < st.w_max) {
+                st.k = calc_k<Ctx>(st.w_max - cwnd, mss);
+                st.origin = st.w_max;
+            } else {
+                st.k = 0;
+                st.origin = cwnd;
+            }
+            st.w_est = cwnd;
+            ctx.cwndAcked() = 0;
+        }
+        
+        // Calculate the target window W_cubic(t+RTT).
+        std::uint32_t t = MinValueU(now - st.epoch_start, MaxTime) + ctx.srtt();
+        std::uint32_t offset = (t < st.k) ? (st.k - t) : (t - st.k);
+        std::uint64_t delta = cubic_delta<Ctx>(MinValue(offset, MaxTime), mss);
+        TcpSeqInt target;
+        if (t < st.k) {
+            target = st.origin - TcpSeqInt(MinValueU(delta, st.origin));
+        } else {
+            target = st.origin;
+            AddToSat(target, TcpSeqInt(MinValueU(delta, TypeMax<TcpSeqInt>)));
+        }
+        
+        // Update W_est, which grows by 3*(1-beta)/(1+beta) = 9/17 segments
+        // per RTT, and use it if larger (TCP-friendly region).
+        std::uint64_t est_inc = (std::uint64_t(acked) * mss * 9) / (17 * std::uint64_t(cwnd));
+        AddToSat(st.w_est, TcpSeqInt(MinValueU(est_inc, TypeMax<TcpSeqInt>)));
+        target = MaxValue(target, st.w_est);
+        
+        // Increase by no more than half of cwnd per RTT.
+        target = MinValue(target, TcpSeqInt(cwnd + MinValue(cwnd / 2, TypeMax<TcpSeqInt> - cwnd)));
+        
+        // Increase cwnd by (target-cwnd)/cwnd for each byte acknowledged. Accumulate
+        // acknowledged data in cwnd_acked so that small increments are not lost.
+        if (target > cwnd) {
+            AddToSat(ctx.cwndAcked(), acked);
+            std::uint64_t inc = (std::uint64_t(target - cwnd) * ctx.cwndAcked()) / cwnd;
+            if (inc > 0) {
+                ctx.increaseCwnd(TcpSeqInt(MinValueU(inc, target - cwnd)));
+                ctx.cwndAcked() = 0;
+            }
+        }
+    }
+    
+    template<typename Ctx>
+    static void lossDetected (Ctx ctx)
+    {
+        reduce(ctx);
+    }
+    
+    template<typename Ctx>
+    static void rtoExpired (Ctx ctx)
+    {
+        reduce(ctx);
+    }
+    
+    template<typename Ctx>
+    static void idleRestart (Ctx ctx)
+    {
+        // Start a new epoch, so that the idle period does not count as
+        // time for window growth.
+        ctx.state().epoch_valid = false;
+    }
+    
+private:
+    // Maximum time offset used in the cubic function, in units of the
+    // context time (at most 1 kHz). This prevents overflows below.
+    inline static constexpr std::uint32_t MaxTime = 40000;
+    
+    template<typename Ctx>
+    static void reduce (Ctx ctx)
+    {
+        State &st = ctx.state();
+        TcpSeqInt cwnd = ctx.cwnd();
+        
+        // Fast convergence: if the window did not reach W_max since the last
+        // reduction, release bandwidth by lowering W_max by (1+beta)/2.
+        if (cwnd < st.w_max) {
+            st.w_max = TcpSeqInt((std::uint64_t(cwnd) * 17) / 20);
+        } else {
+            st.w_max = cwnd;
+        }
+        
+        // Multiplicative decrease by beta.
+        TcpSeqInt reduced = TcpSeqInt((std::uint64_t(cwnd) * 7) / 10);
+        ctx.ssthresh() = MaxValue(reduced, TcpSeqInt(2u * TcpSeqInt(ctx.sndMss())));
+        
+        // A new epoch will start in congestion avoidance.
+        st.epoch_valid = false;
+    }
+    
+    // Cube of the time frequency, for conversions from time to seconds.
+    template<typename Ctx>
+    inline static constexpr std::uint64_t TimeFreqCubed =
+        std::uint64_t(Ctx::TimeFreq * Ctx::TimeFreq * Ctx::TimeFreq);
+    
+    // Calculate C*t^3 in bytes, C=0.4 segments/s^3.
+    template<typename Ctx>
+    static std::uint64_t cubic_delta (std::uint32_t t, std::uint16_t mss)
+    {
+        static_assert(Ctx::TimeFreq <= 1000.0);
+        std::uint64_t t3 = std::uint64_t(t) * t * t;
+        return (t3 * 2 * mss) / (5 * TimeFreqCubed<Ctx>);
+    }
+    
+    // Calculate K = cbrt(reduction/C), reduction in segments.
+    template<typename Ctx>
+    static std::uint32_t calc_k (TcpSeqInt reduction, std::uint16_t mss)
+    {
+        std::uint64_t red_c = (std::uint64_t(reduction) * 5) / (2 * std::uint64_t(mss));
+        return MinValueU(cube_root(red_c * TimeFreqCubed<Ctx>), MaxTime);
+    }
+    
+    // Integer cube root (bit-by-bit).
+    static std::uint32_t cube_root (std::uint64_t x)
+    {
+        std::uint64_t y = 0;
+        for (int s = 63; s >= 0; s -= 3) {
+            y = 2 * y;
+            std::uint64_t b = 3 * y * (y + 1) + 1;
+            if ((x >> s) >= b) {
+                x -= b << s;
+                y++;
+            }
+        }
+        return std::uint32_t(y);
+    }
+};
+
+}
+
+#endif
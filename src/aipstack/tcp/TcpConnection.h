@@ -36,6 +36,7 @@
 #include <aipstack/misc/Hints.h>
 #include <aipstack/infra/Buf.h>
 #include <aipstack/infra/BufUtils.h>
+#include <aipstack/infra/ChksumBlockCache.h>
 #include <aipstack/infra/Err.h>
 #include <aipstack/ip/IpAddr.h>
 #include <aipstack/ip/IpMtuRef.h>
@@ -60,6 +61,18 @@ struct TcpStartConnectionArgs {
     Ip4Addr addr = Ip4Addr::ZeroAddr();
     std::uint16_t port = 0;
     std::size_t rcv_wnd = 0;
+    
+    /**
+     * Whether to use TCP Fast Open (RFC 7413).
+     * 
+     * This has effect only if the FastOpenEnabled option of @ref IpTcpProtoOptions
+     * is enabled. If a cookie for the server address is cached, the SYN is sent
+     * shortly after @ref TcpConnection::startConnection returns (rather than from
+     * it) and carries the cookie and any data which has been queued to the send
+     * buffer by then. Otherwise, the SYN requests a cookie which will be cached
+     * for later connections.
+     */
+    bool fast_open = false;
 };
 
 /**
@@ -89,6 +102,8 @@ class TcpConnection :
     using TcpConOutput = typename TcpConProto::Output;
     using TcpConConstants = typename TcpConProto::Constants;
     using TcpConOosBuffer = typename TcpConProto::OosBuffer;
+    using TcpConSackScoreboard = typename TcpConProto::SackScoreboard;
+    using TcpConCcState = typename TcpConProto::CongControl::State;
 
 public:
     /**
@@ -156,9 +171,12 @@ public:
         // Clear the m_accept_pcb link from the listener.
         lis.m_accept_pcb = nullptr;
         
-        // Decrement the listener's PCB count.
+        // Decrement the listener's PCB count and the total count of
+        // SYN_RCVD PCBs.
         AIPSTACK_ASSERT(lis.m_num_pcbs > 0);
         lis.m_num_pcbs--;
+        AIPSTACK_ASSERT(tcp->m_num_syn_rcvd_pcbs > 0);
+        tcp->m_num_syn_rcvd_pcbs--;
         
         // Note that the PCB has already been removed from the list of
         // unreferenced PCBs, so we must not try to remove it here.
@@ -233,6 +251,8 @@ public:
         src_con->assert_connected();
         
         static_assert(std::is_trivially_copy_constructible_v<TcpConOosBuffer>);
+        static_assert(std::is_trivially_copy_constructible_v<TcpConSackScoreboard>);
+        static_assert(std::is_trivially_copy_constructible_v<TcpConCcState>);
         
         // Byte-copy the whole m_v.
         std::memcpy(&m_v, &src_con->m_v, sizeof(m_v));
@@ -453,7 +473,8 @@ public:
     
     /**
      * Returns the amount of send buffer that could remain unsent
-     * indefinitely in the absence of sendPush or endSending.
+     * indefinitely in the absence of sendPush or endSending
+     * (and while not corked, see @ref setCork).
      * 
      * For accepted connections, this does not change, and for
      * initiated connections, it only possibly decreases when the
@@ -501,6 +522,24 @@ public:
         }
     }
     
+    /**
+     * Sets a cache of block checksums for the send buffer (or clears it with null).
+     * May only be called in CONNECTED or CLOSED state.
+     * 
+     * If set, checksums of outgoing data segments are calculated using the cache,
+     * so that retransmitted data does not need to be summed again. The cache must
+     * be associated with the buffer node which is used for the send buffer (see
+     * @ref IpChksumBlockCache::reset), and the application must invalidate the
+     * ranges of the buffer which are written before they are added to the send
+     * buffer. @ref SendRingBuffer does this when given a cache.
+     */
+    inline void setSendChksumCache (IpChksumBlockCache *cache)
+    {
+        assert_started();
+        
+        m_v.snd_chksum_cache = cache;
+    }
+    
     /**
      * Extends the send buffer for the specified amount.
      * May only be called in CONNECTED or CLOSED state.
@@ -602,10 +641,55 @@ public:
         m_v.snd_psh_index = m_v.snd_buf.tot_len;
         
         // Tell the output code to push, if necessary.
-        if (m_v.pcb != nullptr && m_v.pcb->state().isSndOpen() &&
-            m_v.snd_buf.tot_len > 0)
-        {
-            TcpConOutput::pcb_push_output(m_v.pcb);
+        push_output_if_needed();
+    }
+    
+    /**
+     * Enables or disables the Nagle algorithm (RFC 896).
+     * May only be called in CONNECTED or CLOSED state.
+     * 
+     * When enabled, a segment with less than the MSS of data is not sent
+     * while there is any unacknowledged data, even if the data has been
+     * pushed using @ref sendPush. This reduces the number of small segments
+     * for applications which write many small pieces of data. By default
+     * the Nagle algorithm is disabled.
+     * 
+     * @param enabled Whether to use the Nagle algorithm.
+     */
+    void setNagle (bool enabled)
+    {
+        assert_started();
+        
+        m_v.nagle = enabled;
+        
+        // Disabling may allow sending delayed data.
+        if (!enabled) {
+            push_output_if_needed();
+        }
+    }
+    
+    /**
+     * Enables or disables cork mode.
+     * May only be called in CONNECTED or CLOSED state.
+     * 
+     * While corked, a segment with less than the MSS of data is not sent,
+     * even if the data has been pushed using @ref sendPush; only full-sized
+     * segments are sent. Uncorking pushes any queued data, like sendPush.
+     * A FIN queued using @ref closeSending is sent regardless of cork mode,
+     * together with any remaining data.
+     * 
+     * @param corked Whether to enable (true) or disable (false) cork mode.
+     */
+    void setCork (bool corked)
+    {
+        assert_started();
+        
+        m_v.corked = corked;
+        
+        // On uncork, push any queued data.
+        if (!corked && !m_v.snd_closed) {
+            m_v.snd_psh_index = m_v.snd_buf.tot_len;
+            push_output_if_needed();
         }
     }
     
@@ -689,6 +773,15 @@ private:
         AIPSTACK_ASSERT(!m_v.snd_closed);
     }
     
+    void push_output_if_needed ()
+    {
+        if (m_v.pcb != nullptr && m_v.pcb->state().isSndOpen() &&
+            m_v.snd_buf.tot_len > 0)
+        {
+            TcpConOutput::pcb_push_output(m_v.pcb);
+        }
+    }
+    
     void setup_common_started ()
     {
         // Clear buffer variables.
@@ -696,6 +789,9 @@ private:
         m_v.rcv_buf = IpBufRef{};
         m_v.snd_buf_cur = IpBufRef{};
         m_v.snd_psh_index = 0;
+        m_v.snd_chksum_cache = nullptr;
+        m_v.nagle = false;
+        m_v.corked = false;
         
         // Initialize rcv_ann_thres.
         m_v.rcv_ann_thres = TcpConConstants::DefaultWndAnnThreshold;
@@ -812,6 +908,8 @@ private:
         TcpSeqInt cwnd;
         TcpSeqInt ssthresh;
         TcpSeqInt cwnd_acked;
+        TcpSeqInt prior_cwnd;
+        TcpSeqInt prior_ssthresh;
         TcpSeqNum recover;
         TcpSeqInt rcv_ann_thres : 30;
         TcpSeqInt end_sent : 1;
@@ -819,8 +917,14 @@ private:
         TcpSeqNum rtt_test_seq;
         typename TcpConConstants::RttType rttvar;
         typename TcpConConstants::RttType srtt;
+        std::uint8_t quick_acks;
+        bool nagle;
+        bool corked;
         TcpConOosBuffer ooseq;
+        TcpConSackScoreboard sack;
+        TcpConCcState cc;
         std::size_t snd_psh_index;
+        IpChksumBlockCache *snd_chksum_cache;
     };
     
     TcpConVars m_v;
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2016 Ambroz Bizjak
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AIPSTACK_TCP_FAST_OPEN_CACHE_H
+#define AIPSTACK_TCP_FAST_OPEN_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <array>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/ip/IpAddr.h>
+#include <aipstack/tcp/TcpOptions.h>
+
+namespace AIpStack {
+
+/**
+ * Client side cache of TCP Fast Open cookies (RFC 7413).
+ * 
+ * It remembers the cookie and the MSS received from up to a statically
+ * configured number of servers, keyed by the server address. When the
+ * cache is full, entries are replaced in round-robin order.
+ * 
+ * @tparam NumEntries Number of entries (may be zero).
+ */
+template<int NumEntries>
+class TcpFastOpenCache
+{
+    static_assert(NumEntries >= 0);
+    
+public:
+    /**
+     * A cache entry.
+     */
+    struct Entry {
+        Ip4Addr addr;
+        std::uint16_t mss;
+        // Zero for unused entries, valid cookies are at least 4 bytes.
+        std::uint8_t cookie_len;
+        char cookie[TcpMaxFastOpenCookieLen];
+    };
+    
+    /**
+     * Initialize the cache with no entries.
+     */
+    TcpFastOpenCache () :
+        m_next(0)
+    {
+        for (Entry &entry : m_entries) {
+            entry.cookie_len = 0;
+        }
+    }
+    
+    /**
+     * Find the entry for a server address, or return null.
+     */
+    Entry const * find (Ip4Addr addr) const
+    {
+        for (Entry const &entry : m_entries) {
+            if (entry.cookie_len != 0 && entry.addr == addr) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+    
+    /**
+     * Store a cookie and the MSS for a server address.
+     * 
+     * @param cookie_len Length of the cookie, must be between 4 and
+     *        @ref TcpMaxFastOpenCookieLen.
+     */
+    void store (Ip4Addr addr, std::uint16_t mss, char const *cookie,
+                std::uint8_t cookie_len)
+    {
+        AIPSTACK_ASSERT(cookie_len >= 4 && cookie_len <= TcpMaxFastOpenCookieLen);
+        
+        if constexpr (NumEntries > 0) {
+            // Update the existing entry or replace the next one.
+            Entry *entry = find_entry(addr);
+            if (entry == nullptr) {
+                entry = &m_entries[m_next];
+                m_next = (m_next + 1 < NumEntries) ? (m_next + 1) : 0;
+            }
+            
+            entry->addr = addr;
+            entry->mss = mss;
+            entry->cookie_len = cookie_len;
+            std::memcpy(entry->cookie, cookie, cookie_len);
+        }
+    }
+    
+    /**
+     * Remove any entry for a server address.
+     */
+    void remove (Ip4Addr addr)
+    {
+        Entry *entry = find_entry(addr);
+        if (entry != nullptr) {
+            entry->cookie_len = 0;
+        }
+    }
+    
+private:
+    inline Entry * find_entry (Ip4Addr addr)
+    {
+        return const_cast<Entry *>(find(addr));
+    }
+    
+private:
+    std::array<Entry, NumEntries> m_entries;
+    int m_next;
+};
+
+}
+
+#endif
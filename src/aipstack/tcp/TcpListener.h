@@ -32,7 +32,6 @@
 #include <aipstack/misc/MinMax.h>
 #include <aipstack/misc/Use.h>
 #include <aipstack/misc/Function.h>
-#include <aipstack/structure/LinkedList.h>
 #include <aipstack/ip/IpAddr.h>
 #include <aipstack/tcp/TcpSeqNum.h>
 
@@ -54,6 +53,19 @@ struct TcpListenParams {
     Ip4Addr addr = Ip4Addr::ZeroAddr();
     PortNum port = 0;
     int max_pcbs = 0;
+    
+    /**
+     * Whether to accept TCP Fast Open (RFC 7413) connections.
+     * 
+     * This has effect only if the FastOpenEnabled option of @ref IpTcpProtoOptions
+     * is enabled. Cookies are then issued to clients which request one, and when a
+     * SYN with a valid cookie carries data, the connection is reported to the
+     * @ref TcpListener::EstablishedHandler right away and the data is delivered
+     * to the accepted connection via @ref TcpConnection::dataReceived. The
+     * application must provide a receive buffer of at least
+     * @ref TcpConnection::getAnnouncedRcvWnd when accepting.
+     */
+    bool fast_open = false;
 };
 
 /**
@@ -124,7 +136,7 @@ public:
     {
         // Stop listening.
         if (m_listening) {
-            m_tcp->m_listeners_list.remove(*this);
+            m_tcp->m_listener_index.removeEntry(*this);
             m_tcp->unlink_listener(this);
         }
         
@@ -188,8 +200,9 @@ public:
         m_port = params.port;
         m_max_pcbs = params.max_pcbs;
         m_num_pcbs = 0;
+        m_fast_open = params.fast_open;
         m_listening = true;
-        m_tcp->m_listeners_list.prepend(*this);
+        m_tcp->m_listener_index.addEntry(*this);
         
         return true;
     }
@@ -215,7 +228,7 @@ public:
     
 private:
     EstablishedHandler m_established_handler;
-    LinkedListNode<typename TcpProto::ListenerLinkModel> m_listeners_node;
+    typename TcpProto::ListenerIndex::Node m_index_node;
     TcpProto *m_tcp;
     TcpSeqInt m_initial_rcv_wnd;
     TcpPcb *m_accept_pcb;
@@ -223,6 +236,7 @@ private:
     PortNum m_port;
     int m_max_pcbs;
     int m_num_pcbs;
+    bool m_fast_open;
     bool m_listening;
 };
 
@@ -34,6 +34,7 @@
 #include <aipstack/infra/Options.h>
 #include <aipstack/infra/Instance.h>
 #include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/tcp/TcpOptions.h>
 
 namespace AIpStack {
 
@@ -109,6 +110,10 @@ private:
     // the end segment are undefined.
     OosSeg m_ooseq[NumOosSegs];
     
+    // Start of the most recently received out-of-sequence data segment,
+    // used to choose the first SACK block (RFC 2018 section 4).
+    TcpSeqNum m_recent_seq;
+    
 public:
     /**
      * Initialize (clear) the out-of-sequence information.
@@ -186,6 +191,9 @@ public:
         
         // If the new segment has any data, update the segments.
         if (seg_datalen > 0) {
+            // Remember this segment for reporting SACK blocks.
+            m_recent_seq = seg_start;
+            
             // Skip over segments strictly before this one.
             // Note: we would never skip over a FIN segment due to check (A) above.
             IndexType pos = 0;
@@ -343,6 +351,53 @@ public:
             m_ooseq[0].getFinSeq() == rcv_nxt + datalen;
     }
     
+    /**
+     * Generate SACK blocks describing the buffered out-of-sequence data.
+     * 
+     * As required by RFC 2018, the first block is the one containing the
+     * most recently received segment (if it is still buffered), followed
+     * by the remaining blocks in sequence order. A buffered FIN is not
+     * reported since it cannot be selectively acknowledged.
+     * 
+     * @param rcv_nxt The first sequence number that has not been received.
+     * @param out_blocks Array where the blocks will be written.
+     * @param max_blocks Maximum number of blocks to write.
+     * @return The number of blocks written (zero if there is no
+     *         out-of-sequence data).
+     */
+    std::uint8_t getSackBlocks (TcpSeqNum rcv_nxt, TcpSackBlock *out_blocks,
+                                std::uint8_t max_blocks) const
+    {
+        std::uint8_t num_blocks = 0;
+        
+        // Find the segment containing the most recently received data
+        // and report it first.
+        IndexType recent_pos = NumOosSegs;
+        for (IndexType i = 0; i < NumOosSegs && !m_ooseq[i].isEndOrFin(); i++) {
+            if (rcv_nxt.ref_lte(m_ooseq[i].start, m_recent_seq) &&
+                rcv_nxt.ref_lt(m_recent_seq, m_ooseq[i].end))
+            {
+                recent_pos = i;
+                if (num_blocks < max_blocks) {
+                    out_blocks[num_blocks++] = TcpSackBlock{m_ooseq[i].start, m_ooseq[i].end};
+                }
+                break;
+            }
+        }
+        
+        // Report the other data segments in sequence order.
+        for (IndexType i = 0; i < NumOosSegs && !m_ooseq[i].isEndOrFin(); i++) {
+            if (num_blocks >= max_blocks) {
+                break;
+            }
+            if (i != recent_pos) {
+                out_blocks[num_blocks++] = TcpSackBlock{m_ooseq[i].start, m_ooseq[i].end};
+            }
+        }
+        
+        return num_blocks;
+    }
+    
 private:
     // Return the number of out-of-sequence segments by counting
     // until an end marker is found or the end of segments is reached.
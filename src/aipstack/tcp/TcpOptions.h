@@ -27,14 +27,17 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <cstring>
 
 #include <aipstack/misc/Assert.h>
+#include <aipstack/misc/MinMax.h>
 #include <aipstack/misc/EnumUtils.h>
 #include <aipstack/misc/EnumBitfieldUtils.h>
 #include <aipstack/infra/Buf.h>
 #include <aipstack/infra/BufUtils.h>
 #include <aipstack/infra/Struct.h>
 #include <aipstack/proto/Tcp4Proto.h>
+#include <aipstack/tcp/TcpSeqNum.h>
 
 namespace AIpStack {
 
@@ -42,23 +45,74 @@ namespace AIpStack {
 enum class TcpOptionFlags : std::uint8_t {
     Mss      = 1 << 0,
     WndScale = 1 << 1,
+    SackPerm = 1 << 2,
+    Sack     = 1 << 3,
+    Timestamps = 1 << 4,
+    FastOpen = 1 << 5,
 };
 AIPSTACK_ENUM_BITFIELD(TcpOptionFlags)
 
+// One block of a SACK option, [start, end) in sequence space.
+struct TcpSackBlock {
+    TcpSeqNum start;
+    TcpSeqNum end;
+};
+
+// Maximum number of SACK blocks that fit into the options space,
+// without and with the timestamps option.
+inline constexpr std::uint8_t TcpMaxSackBlocks = 4;
+inline constexpr std::uint8_t TcpMaxSackBlocksWithTs = 3;
+
+// Maximum length of a TCP Fast Open cookie that we handle. RFC 7413 allows
+// up to 16 bytes but longer cookies would not fit into the SYN together
+// with the other options; longer cookies are ignored.
+inline constexpr std::uint8_t TcpMaxFastOpenCookieLen = 8;
+
 // Container for TCP options that we care about.
+// The sack_blocks are only valid when the Sack flag is set, and then
+// num_sack_blocks (1 to TcpMaxSackBlocks) of them are used.
+// The fast_open_cookie is only valid when the FastOpen flag is set, and
+// then fast_open_cookie_len bytes of it are used. A zero length is a cookie
+// request, otherwise the length is even and at least 4.
 struct TcpOptions {
     TcpOptionFlags options;
     std::uint8_t wnd_scale;
     std::uint16_t mss;
+    std::uint32_t ts_val;
+    std::uint32_t ts_ecr;
+    std::uint8_t num_sack_blocks;
+    TcpSackBlock sack_blocks[TcpMaxSackBlocks];
+    std::uint8_t fast_open_cookie_len;
+    char fast_open_cookie[TcpMaxFastOpenCookieLen];
 };
 
 namespace TcpOptionWriteLen {
     inline constexpr std::size_t MSS = 4;
     inline constexpr std::size_t WndScale = 4;
+    inline constexpr std::size_t SackPerm = 4;
+    inline constexpr std::size_t SackBase = 4;
+    inline constexpr std::size_t SackBlock = 8;
+    inline constexpr std::size_t Timestamps = 12;
+    inline constexpr std::size_t FastOpenMax = 12;
 }
 
+// Options in SYN segments (MSS, WndScale, SackPerm, Timestamps, FastOpen) and options
+// in other segments (Timestamps, SACK) are never written together, so the
+// maximum is the largest of these combinations.
+inline constexpr std::size_t MaxTcpSynOptionsWriteLen =
+    TcpOptionWriteLen::MSS + TcpOptionWriteLen::WndScale +
+    TcpOptionWriteLen::SackPerm + TcpOptionWriteLen::Timestamps +
+    TcpOptionWriteLen::FastOpenMax;
+
+inline constexpr std::size_t MaxTcpAckOptionsWriteLen = MaxValue(
+    TcpOptionWriteLen::SackBase + TcpMaxSackBlocks * TcpOptionWriteLen::SackBlock,
+    TcpOptionWriteLen::Timestamps + TcpOptionWriteLen::SackBase +
+        TcpMaxSackBlocksWithTs * TcpOptionWriteLen::SackBlock);
+
 inline constexpr std::size_t MaxTcpOptionsWriteLen =
-    TcpOptionWriteLen::MSS + TcpOptionWriteLen::WndScale;
+    MaxValue(MaxTcpSynOptionsWriteLen, MaxTcpAckOptionsWriteLen);
+
+static_assert(MaxTcpOptionsWriteLen <= 40);
 
 inline void ParseTcpOptions (IpBufRef buf, TcpOptions &out_opts)
 {
@@ -115,6 +169,56 @@ inline void ParseTcpOptions (IpBufRef buf, TcpOptions &out_opts)
                 out_opts.wnd_scale = value;
             } break;
             
+            // SACK Permitted
+            case TcpOption::SackPerm: {
+                if (opt_data_len != 0) {
+                    goto skip_option;
+                }
+                out_opts.options |= TcpOptionFlags::SackPerm;
+            } break;
+            
+            // SACK
+            case TcpOption::Sack: {
+                if (opt_data_len == 0 || opt_data_len % 8 != 0 ||
+                    opt_data_len / 8 > TcpMaxSackBlocks)
+                {
+                    goto skip_option;
+                }
+                std::uint8_t num_blocks = opt_data_len / 8;
+                for (std::uint8_t i = 0; i < num_blocks; i++) {
+                    char opt_data[8];
+                    buf = ipBufTakeBytes(buf, 8, opt_data);
+                    out_opts.sack_blocks[i].start = ReadSingleField<TcpSeqNum>(opt_data);
+                    out_opts.sack_blocks[i].end = ReadSingleField<TcpSeqNum>(opt_data + 4);
+                }
+                out_opts.options |= TcpOptionFlags::Sack;
+                out_opts.num_sack_blocks = num_blocks;
+            } break;
+            
+            // Timestamps
+            case TcpOption::Timestamps: {
+                if (opt_data_len != 8) {
+                    goto skip_option;
+                }
+                char opt_data[8];
+                buf = ipBufTakeBytes(buf, opt_data_len, opt_data);
+                out_opts.options |= TcpOptionFlags::Timestamps;
+                out_opts.ts_val = ReadSingleField<std::uint32_t>(opt_data);
+                out_opts.ts_ecr = ReadSingleField<std::uint32_t>(opt_data + 4);
+            } break;
+            
+            // TCP Fast Open
+            case TcpOption::FastOpen: {
+                if (opt_data_len != 0 && (opt_data_len < 4 || opt_data_len % 2 != 0 ||
+                                          opt_data_len > TcpMaxFastOpenCookieLen))
+                {
+                    goto skip_option;
+                }
+                buf = ipBufTakeBytes(buf, opt_data_len, out_opts.fast_open_cookie);
+                out_opts.options |= TcpOptionFlags::FastOpen;
+                out_opts.fast_open_cookie_len = opt_data_len;
+            } break;
+            
             // Unknown option (also used to handle bad options).
             skip_option:
             default: {
@@ -124,6 +228,22 @@ inline void ParseTcpOptions (IpBufRef buf, TcpOptions &out_opts)
     }
 }
 
+inline void WriteTcpTimestampsOption (char *out, std::uint32_t ts_val, std::uint32_t ts_ecr)
+{
+    WriteSingleField<std::uint8_t >(out + 0, AsUnderlying(TcpOption::Nop));
+    WriteSingleField<std::uint8_t >(out + 1, AsUnderlying(TcpOption::Nop));
+    WriteSingleField<std::uint8_t >(out + 2, AsUnderlying(TcpOption::Timestamps));
+    WriteSingleField<std::uint8_t >(out + 3, /*length=*/10);
+    WriteSingleField<std::uint32_t>(out + 4, ts_val);
+    WriteSingleField<std::uint32_t>(out + 8, ts_ecr);
+}
+
+// Length of the fast open option including padding to a multiple of 4.
+inline std::uint8_t CalcTcpFastOpenOptionLength (std::uint8_t cookie_len)
+{
+    return std::uint8_t((2 + cookie_len + 3) & ~3);
+}
+
 inline std::uint8_t CalcTcpOptionsLength (TcpOptions const &tcp_opts)
 {
     std::uint8_t opts_len = 0;
@@ -133,6 +253,22 @@ inline std::uint8_t CalcTcpOptionsLength (TcpOptions const &tcp_opts)
     if ((tcp_opts.options & TcpOptionFlags::WndScale) != Enum0) {
         opts_len += TcpOptionWriteLen::WndScale;
     }
+    if ((tcp_opts.options & TcpOptionFlags::SackPerm) != Enum0) {
+        opts_len += TcpOptionWriteLen::SackPerm;
+    }
+    if ((tcp_opts.options & TcpOptionFlags::Timestamps) != Enum0) {
+        opts_len += TcpOptionWriteLen::Timestamps;
+    }
+    if ((tcp_opts.options & TcpOptionFlags::Sack) != Enum0) {
+        AIPSTACK_ASSERT(tcp_opts.num_sack_blocks > 0);
+        AIPSTACK_ASSERT(tcp_opts.num_sack_blocks <= TcpMaxSackBlocks);
+        opts_len += TcpOptionWriteLen::SackBase +
+            tcp_opts.num_sack_blocks * TcpOptionWriteLen::SackBlock;
+    }
+    if ((tcp_opts.options & TcpOptionFlags::FastOpen) != Enum0) {
+        AIPSTACK_ASSERT(tcp_opts.fast_open_cookie_len <= TcpMaxFastOpenCookieLen);
+        opts_len += CalcTcpFastOpenOptionLength(tcp_opts.fast_open_cookie_len);
+    }
     AIPSTACK_ASSERT(opts_len <= MaxTcpOptionsWriteLen);
     AIPSTACK_ASSERT(opts_len % 4 == 0); // caller needs padding to 4-byte alignment
     return opts_len;
@@ -154,6 +290,46 @@ inline void WriteTcpOptions (TcpOptions const &tcp_opts, char *out)
         WriteSingleField<std::uint8_t>(out + 3, tcp_opts.wnd_scale);
         out += TcpOptionWriteLen::WndScale;
     }
+    
+    if ((tcp_opts.options & TcpOptionFlags::SackPerm) != Enum0) {
+        WriteSingleField<std::uint8_t>(out + 0, AsUnderlying(TcpOption::Nop));
+        WriteSingleField<std::uint8_t>(out + 1, AsUnderlying(TcpOption::Nop));
+        WriteSingleField<std::uint8_t>(out + 2, AsUnderlying(TcpOption::SackPerm));
+        WriteSingleField<std::uint8_t>(out + 3, /*length=*/2);
+        out += TcpOptionWriteLen::SackPerm;
+    }
+    
+    if ((tcp_opts.options & TcpOptionFlags::Timestamps) != Enum0) {
+        WriteTcpTimestampsOption(out, tcp_opts.ts_val, tcp_opts.ts_ecr);
+        out += TcpOptionWriteLen::Timestamps;
+    }
+    
+    if ((tcp_opts.options & TcpOptionFlags::Sack) != Enum0) {
+        std::uint8_t num_blocks = tcp_opts.num_sack_blocks;
+        WriteSingleField<std::uint8_t>(out + 0, AsUnderlying(TcpOption::Nop));
+        WriteSingleField<std::uint8_t>(out + 1, AsUnderlying(TcpOption::Nop));
+        WriteSingleField<std::uint8_t>(out + 2, AsUnderlying(TcpOption::Sack));
+        WriteSingleField<std::uint8_t>(out + 3, std::uint8_t(2 + 8 * num_blocks));
+        out += TcpOptionWriteLen::SackBase;
+        for (std::uint8_t i = 0; i < num_blocks; i++) {
+            WriteSingleField<TcpSeqNum>(out + 0, tcp_opts.sack_blocks[i].start);
+            WriteSingleField<TcpSeqNum>(out + 4, tcp_opts.sack_blocks[i].end);
+            out += TcpOptionWriteLen::SackBlock;
+        }
+    }
+    
+    if ((tcp_opts.options & TcpOptionFlags::FastOpen) != Enum0) {
+        std::uint8_t cookie_len = tcp_opts.fast_open_cookie_len;
+        std::uint8_t opt_len = 2 + cookie_len;
+        std::uint8_t padded_len = CalcTcpFastOpenOptionLength(cookie_len);
+        for (std::uint8_t i = opt_len; i < padded_len; i++) {
+            WriteSingleField<std::uint8_t>(out++, AsUnderlying(TcpOption::Nop));
+        }
+        WriteSingleField<std::uint8_t>(out + 0, AsUnderlying(TcpOption::FastOpen));
+        WriteSingleField<std::uint8_t>(out + 1, opt_len);
+        std::memcpy(out + 2, tcp_opts.fast_open_cookie, cookie_len);
+        out += opt_len;
+    }
 }
 
 }
@@ -31,9 +31,7 @@
 
 namespace AIpStack {
 
-using TcpPcbFlagsBaseType = std::uint16_t;
-
-inline constexpr int TcpPcbFlagsBits = 14;
+using TcpPcbFlagsBaseType = std::uint32_t;
 
 enum class TcpPcbFlags : TcpPcbFlagsBaseType {
     // ACK is needed; used in input processing
@@ -67,7 +65,29 @@ enum class TcpPcbFlags : TcpPcbFlagsBaseType {
     OutRetry   = TcpPcbFlagsBaseType(1) << 12,
     // rcv_ann_wnd needs update before sending a segment, implies con != nullptr
     RcvWndUpd  = TcpPcbFlagsBaseType(1) << 13,
-    // NOTE: Currently no more bits are available, see TcpPcb::flags.
+    // SACK is used (in SYN_SENT/SYN_RCVD: SACK-permitted is to be sent)
+    SackPerm   = TcpPcbFlagsBaseType(1) << 14,
+    // Timestamps option is used (in SYN_SENT: timestamps option is to be sent)
+    TsOpt      = TcpPcbFlagsBaseType(1) << 15,
+    // The ACK for a received segment is being delayed (AckTimer is set)
+    AckDelayed = TcpPcbFlagsBaseType(1) << 16,
+    // OutputTimer is set for pacing and no new data may be sent until it expires
+    PaceWait   = TcpPcbFlagsBaseType(1) << 17,
+    // If rtx_timer is running it is for a tail loss probe
+    TlpTimer   = TcpPcbFlagsBaseType(1) << 18,
+    // If rtx_timer is running it is for the RACK reordering window
+    RackTimer  = TcpPcbFlagsBaseType(1) << 19,
+    // F-RTO is waiting for the first ACK after a retransmission timeout
+    FrtoAck1   = TcpPcbFlagsBaseType(1) << 20,
+    // F-RTO is waiting for the second ACK after a retransmission timeout
+    FrtoAck2   = TcpPcbFlagsBaseType(1) << 21,
+    // TCP Fast Open: in SYN_SENT the SYN carries the fast open option, in SYN_RCVD
+    // a cookie is to be sent in the SYN-ACK, in other states the SYN-ACK of a
+    // connection accepted with data in the SYN has not been acknowledged yet
+    FastOpen   = TcpPcbFlagsBaseType(1) << 22,
+    // The ACK for received data is deferred to the end of the receive burst
+    // (the PCB is m_burst_ack_pcb)
+    AckBurst   = TcpPcbFlagsBaseType(1) << 23,
 };
 AIPSTACK_ENUM_BITFIELD(TcpPcbFlags)
 
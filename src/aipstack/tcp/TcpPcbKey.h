@@ -25,6 +25,8 @@
 #ifndef AIPSTACK_TCP_PCB_KEY_H
 #define AIPSTACK_TCP_PCB_KEY_H
 
+#include <cstdint>
+
 #include <aipstack/ip/IpAddr.h>
 
 namespace AIpStack {
@@ -92,6 +94,15 @@ public:
                op1.local_port  == op2.local_port  &&
                op1.local_addr  == op2.local_addr;
     }
+    
+    // Provides the key to hash table indices.
+    template<typename Hasher>
+    static void HashKey (TcpPcbKey const &key, Hasher &hasher)
+    {
+        hasher.addWord((std::uint64_t(key.local_addr.value()) << 32) |
+                       key.remote_addr.value());
+        hasher.addWord((std::uint64_t(key.local_port) << 16) | key.remote_port);
+    }
 };
 
 }
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2016 Ambroz Bizjak
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AIPSTACK_TCP_SACK_SCOREBOARD_H
+#define AIPSTACK_TCP_SACK_SCOREBOARD_H
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#include <aipstack/meta/ChooseInt.h>
+#include <aipstack/misc/Assert.h>
+#include <aipstack/infra/Options.h>
+#include <aipstack/infra/Instance.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/tcp/TcpOptions.h>
+
+namespace AIpStack {
+
+/**
+ * Implements the sender side SACK scoreboard (RFC 2018, RFC 6675).
+ * 
+ * It keeps up to a statically configured number of disjoint
+ * sequence number ranges above snd_una which the receiver has
+ * reported as received using the SACK option, and the position up
+ * to which holes between those ranges have been retransmitted in
+ * the current recovery episode.
+ */
+template<typename Arg>
+class TcpSackScoreboard
+{
+    static_assert(Arg::NumSackRanges > 0);
+    using IndexType = ChooseIntForMax<Arg::NumSackRanges, false>;
+    inline static constexpr IndexType NumSackRanges = Arg::NumSackRanges;
+    
+private:
+    // SACKed ranges, sorted by sequence number, not touching each other
+    // and all above snd_una. Only the first m_num_ranges are valid.
+    TcpSackBlock m_ranges[NumSackRanges];
+    
+    // Number of valid ranges.
+    IndexType m_num_ranges;
+    
+    // Holes before this sequence number have already been retransmitted
+    // in the current recovery. Always kept at or above snd_una.
+    TcpSeqNum m_rtx_nxt;
+    
+public:
+    /**
+     * Initialize (clear) the scoreboard.
+     * 
+     * This is also used to discard all SACK information after a
+     * retransmission timeout, as suggested by RFC 2018 section 8.
+     * 
+     * @param snd_una The current snd_una.
+     */
+    inline void init (TcpSeqNum snd_una)
+    {
+        m_num_ranges = 0;
+        m_rtx_nxt = snd_una;
+    }
+    
+    /**
+     * Check if no SACKed ranges are known.
+     * 
+     * @return Whether the scoreboard is empty.
+     */
+    inline bool isEmpty () const
+    {
+        return m_num_ranges == 0;
+    }
+    
+    /**
+     * Start a new recovery episode, considering all holes as not
+     * yet retransmitted.
+     * 
+     * @param snd_una The current snd_una.
+     */
+    inline void startRecovery (TcpSeqNum snd_una)
+    {
+        m_rtx_nxt = snd_una;
+    }
+    
+    /**
+     * Update the scoreboard due to a cumulative acknowledgement.
+     * 
+     * Ranges which are now acknowledged are removed.
+     * 
+     * @param snd_una The snd_una before this acknowledgement.
+     * @param ack_num The acknowledgement number, must be after snd_una.
+     */
+    void updateForAck (TcpSeqNum snd_una, TcpSeqNum ack_num)
+    {
+        // Remove ranges which end at or before ack_num.
+        IndexType num_acked = 0;
+        while (num_acked < m_num_ranges &&
+               !snd_una.ref_lt(ack_num, m_ranges[num_acked].end))
+        {
+            num_acked++;
+        }
+        if (num_acked > 0) {
+            std::move(&m_ranges[num_acked], &m_ranges[m_num_ranges], &m_ranges[0]);
+            m_num_ranges -= num_acked;
+        }
+        
+        // If the next range extends over ack_num (the receiver has not
+        // acknowledged data that it has SACKed before), trim it.
+        if (m_num_ranges > 0 && snd_una.ref_lt(m_ranges[0].start, ack_num)) {
+            m_ranges[0].start = ack_num;
+        }
+        
+        // Keep m_rtx_nxt at or above the new snd_una.
+        if (snd_una.ref_lt(m_rtx_nxt, ack_num)) {
+            m_rtx_nxt = ack_num;
+        }
+    }
+    
+    /**
+     * Add the SACK blocks from a received segment to the scoreboard.
+     * 
+     * Blocks which are not within (snd_una, snd_nxt] are ignored.
+     * If there is no space for a new range, the highest range is
+     * discarded, since ranges closer to snd_una matter most for
+     * retransmission.
+     * 
+     * @param snd_una The snd_una after processing the cumulative
+     *                acknowledgement of the segment.
+     * @param snd_nxt The current snd_nxt.
+     * @param blocks Pointer to the received SACK blocks.
+     * @param num_blocks Number of received SACK blocks.
+     */
+    void addBlocks (TcpSeqNum snd_una, TcpSeqNum snd_nxt,
+                    TcpSackBlock const *blocks, std::uint8_t num_blocks)
+    {
+        for (std::uint8_t i = 0; i < num_blocks; i++) {
+            TcpSeqNum start = blocks[i].start;
+            TcpSeqNum end = blocks[i].end;
+            
+            // Check that the block is sane, otherwise ignore it.
+            if (start == snd_una || !snd_una.ref_lt(start, end) ||
+                !snd_una.ref_lte(end, snd_nxt))
+            {
+                continue;
+            }
+            
+            add_range(snd_una, start, end);
+        }
+    }
+    
+    /**
+     * Find the next hole which should be retransmitted.
+     * 
+     * A hole is a range of sequence numbers which has not been SACKed and
+     * is followed by a SACKed range. Holes (or parts of holes) before the
+     * retransmission position are skipped.
+     * 
+     * @param snd_una The current snd_una.
+     * @param hole_start Set to the start of the hole on success.
+     * @param hole_len Set to the length of the hole on success (nonzero).
+     * @return Whether a hole was found.
+     */
+    bool nextHole (TcpSeqNum snd_una, TcpSeqNum &hole_start, TcpSeqInt &hole_len) const
+    {
+        TcpSeqNum pos = m_rtx_nxt;
+        
+        for (IndexType i = 0; i < m_num_ranges; i++) {
+            if (snd_una.ref_lt(pos, m_ranges[i].start)) {
+                hole_start = pos;
+                hole_len = m_ranges[i].start - pos;
+                return true;
+            }
+            if (snd_una.ref_lt(pos, m_ranges[i].end)) {
+                pos = m_ranges[i].end;
+            }
+        }
+        
+        return false;
+    }
+    
+    /**
+     * Record that data up to the given sequence number has been
+     * retransmitted in this recovery episode.
+     * 
+     * @param rtx_end One past the last retransmitted sequence number.
+     */
+    inline void holeRetransmitted (TcpSeqNum rtx_end)
+    {
+        m_rtx_nxt = rtx_end;
+    }
+    
+private:
+    void add_range (TcpSeqNum snd_una, TcpSeqNum start, TcpSeqNum end)
+    {
+        // Skip over ranges strictly before this one.
+        IndexType pos = 0;
+        while (pos < m_num_ranges && snd_una.ref_lt(m_ranges[pos].end, start)) {
+            pos++;
+        }
+        
+        // If the range does not intersect or touch [pos], insert it here.
+        if (pos == m_num_ranges || snd_una.ref_lt(end, m_ranges[pos].start)) {
+            // If all slots are used, discard the highest range, unless the
+            // new range would be the highest in which case it is dropped.
+            if (m_num_ranges == NumSackRanges) {
+                if (pos == NumSackRanges) {
+                    return;
+                }
+                m_num_ranges--;
+            }
+            
+            if (pos < m_num_ranges) {
+                std::move_backward(
+                    &m_ranges[pos], &m_ranges[m_num_ranges], &m_ranges[m_num_ranges + 1]);
+            }
+            m_ranges[pos] = TcpSackBlock{start, end};
+            m_num_ranges++;
+            return;
+        }
+        
+        // Extend [pos] to the left if needed.
+        if (snd_una.ref_lt(start, m_ranges[pos].start)) {
+            m_ranges[pos].start = start;
+        }
+        
+        // Extend [pos] to the right if needed, and merge subsequent ranges
+        // which it now intersects or touches.
+        if (snd_una.ref_lt(m_ranges[pos].end, end)) {
+            m_ranges[pos].end = end;
+            
+            IndexType merge_pos = pos + 1;
+            while (merge_pos < m_num_ranges &&
+                   !snd_una.ref_lt(end, m_ranges[merge_pos].start))
+            {
+                if (snd_una.ref_lt(end, m_ranges[merge_pos].end)) {
+                    m_ranges[pos].end = m_ranges[merge_pos].end;
+                }
+                merge_pos++;
+            }
+            
+            IndexType num_merged = merge_pos - (pos + 1);
+            if (num_merged > 0) {
+                std::move(&m_ranges[merge_pos], &m_ranges[m_num_ranges], &m_ranges[pos + 1]);
+                m_num_ranges -= num_merged;
+            }
+        }
+    }
+};
+
+struct TcpSackScoreboardServiceOptions {
+    AIPSTACK_OPTION_DECL_VALUE(NumSackRanges, std::size_t, 4)
+};
+
+template<typename ...Options>
+class TcpSackScoreboardService {
+    template<typename>
+    friend class TcpSackScoreboard;
+    
+    AIPSTACK_OPTION_CONFIG_VALUE(TcpSackScoreboardServiceOptions, NumSackRanges)
+
+public:
+    AIPSTACK_DEF_INSTANCE(TcpSackScoreboardService, TcpSackScoreboard)
+};
+
+}
+
+#endif
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2016 Ambroz Bizjak
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef AIPSTACK_TCP_SYN_COOKIE_H
+#define AIPSTACK_TCP_SYN_COOKIE_H
+
+#include <cstdint>
+
+#include <aipstack/misc/SipHash.h>
+#include <aipstack/ip/IpAddr.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/tcp/TcpPcbKey.h>
+
+namespace AIpStack {
+
+/**
+ * Connection parameters which are encoded in a SYN cookie.
+ */
+struct TcpSynCookieInfo {
+    /**
+     * The MSS to use for sending (rounded down to a value from
+     * @ref TcpSynCookie::MssTable).
+     */
+    std::uint16_t mss;
+    
+    /**
+     * The window scale shift count of the peer, if @ref wnd_scale.
+     */
+    std::uint8_t snd_wnd_shift;
+    
+    /**
+     * Whether the peer sent the window scale option.
+     */
+    bool wnd_scale;
+    
+    /**
+     * Whether SACK is to be used.
+     */
+    bool sack_perm;
+};
+
+/**
+ * Generation and validation of SYN cookies.
+ * 
+ * A SYN cookie is an initial sequence number which encodes the parameters of
+ * a connection (@ref TcpSynCookieInfo) and authenticates them with a keyed
+ * hash of the connection key, the peer's initial sequence number and a
+ * coarse time counter. This allows the listener to reply to a SYN without
+ * keeping any state, and to create the connection once the ACK to the
+ * SYN-ACK arrives.
+ * 
+ * The cookie consists of the low bits of the time counter in the top
+ * @ref CounterBits bits, and in the remaining bits the sum of the hash
+ * and the encoded parameters. The hash is SipHash-2-4.
+ * 
+ * The same keyed hash is used to generate TCP Fast Open cookies.
+ */
+class TcpSynCookie {
+public:
+    /**
+     * Secret key for the keyed hash.
+     */
+    using Key = SipHashKey;
+    
+    /**
+     * Number of bits of the time counter in the cookie.
+     */
+    inline static constexpr int CounterBits = 5;
+    
+    /**
+     * Maximum age of a cookie in units of the time counter.
+     */
+    inline static constexpr std::uint32_t MaxCounterAge = 1;
+    
+    /**
+     * MSS values which can be encoded, in increasing order.
+     */
+    inline static constexpr std::uint16_t MssTable[] =
+        {216, 536, 1024, 1220, 1300, 1400, 1440, 1460};
+    
+    /**
+     * Length of TCP Fast Open cookies generated by @ref fastOpenCookie.
+     */
+    inline static constexpr int FastOpenCookieLen = 8;
+    
+private:
+    inline static constexpr int MssBits = 3;
+    inline static constexpr int WndShiftBits = 4;
+    inline static constexpr int DataBits = MssBits + 1 + WndShiftBits;
+    inline static constexpr int HashBits = 32 - CounterBits;
+    inline static constexpr std::uint32_t HashMask = (std::uint32_t(1) << HashBits) - 1;
+    inline static constexpr std::uint8_t NoWndScale = (1 << WndShiftBits) - 1;
+    
+    static_assert(sizeof(MssTable) / sizeof(MssTable[0]) == 1 << MssBits);
+    
+public:
+    /**
+     * Generate a SYN cookie.
+     * 
+     * @param key The secret key.
+     * @param conn Connection key (addresses and ports).
+     * @param peer_isn The initial sequence number of the peer.
+     * @param counter The current value of the time counter.
+     * @param info Parameters to encode; info.mss must be at least MssTable[0]
+     *        and info.snd_wnd_shift at most 14 if info.wnd_scale.
+     * @return The cookie, to be used as the initial sequence number.
+     */
+    static TcpSeqNum encode (Key const &key, TcpPcbKey const &conn, TcpSeqNum peer_isn,
+                             std::uint32_t counter, TcpSynCookieInfo const &info)
+    {
+        // Find the largest MSS value in the table not above the MSS.
+        std::uint32_t mss_idx = 0;
+        while (mss_idx + 1 < (1 << MssBits) && MssTable[mss_idx + 1] <= info.mss) {
+            mss_idx++;
+        }
+        
+        std::uint32_t wnd_shift = info.wnd_scale ? info.snd_wnd_shift : NoWndScale;
+        
+        std::uint32_t data = mss_idx | (std::uint32_t(info.sack_perm) << MssBits) |
+            (wnd_shift << (MssBits + 1));
+        
+        std::uint32_t hash = calc_hash(key, conn, peer_isn, counter);
+        
+        return TcpSeqNum((counter << HashBits) | ((hash + data) & HashMask));
+    }
+    
+    /**
+     * Validate a SYN cookie and decode the parameters.
+     * 
+     * @param key The secret key.
+     * @param conn Connection key (addresses and ports).
+     * @param peer_isn The initial sequence number of the peer.
+     * @param counter The current value of the time counter.
+     * @param cookie The cookie (the acknowledgement number minus one).
+     * @param info Set to the decoded parameters on success.
+     * @return Whether the cookie is valid.
+     */
+    static bool decode (Key const &key, TcpPcbKey const &conn, TcpSeqNum peer_isn,
+                        std::uint32_t counter, TcpSeqNum cookie, TcpSynCookieInfo &info)
+    {
+        // Check the age based on the counter bits, modulo their range.
+        std::uint32_t age = (counter - (cookie.value() >> HashBits)) &
+            ((std::uint32_t(1) << CounterBits) - 1);
+        if (age > MaxCounterAge) {
+            return false;
+        }
+        
+        // Recover the parameters, which must be in range.
+        std::uint32_t hash = calc_hash(key, conn, peer_isn, counter - age);
+        std::uint32_t data = (cookie.value() - hash) & HashMask;
+        if (data >= (std::uint32_t(1) << DataBits)) {
+            return false;
+        }
+        
+        std::uint8_t wnd_shift = std::uint8_t(data >> (MssBits + 1));
+        if (wnd_shift != NoWndScale && wnd_shift > 14) {
+            return false;
+        }
+        
+        info.mss = MssTable[data & ((1 << MssBits) - 1)];
+        info.sack_perm = ((data >> MssBits) & 1) != 0;
+        info.wnd_scale = wnd_shift != NoWndScale;
+        info.snd_wnd_shift = info.wnd_scale ? wnd_shift : 0;
+        
+        return true;
+    }
+    
+    /**
+     * Generate a TCP Fast Open cookie (RFC 7413) for a client address.
+     * 
+     * The cookie is a keyed hash of the local and remote addresses. It does not
+     * depend on time, the server invalidates cookies by changing the key.
+     * 
+     * @param key The secret key.
+     * @param local_addr The local (server) address.
+     * @param remote_addr The remote (client) address.
+     * @param cookie Output buffer for the cookie of length @ref FastOpenCookieLen.
+     */
+    static void fastOpenCookie (Key const &key, Ip4Addr local_addr, Ip4Addr remote_addr,
+                                char *cookie)
+    {
+        // The third word distinguishes these from the SYN cookie hashes.
+        std::uint64_t h = sip_hash(key, local_addr.value(), remote_addr.value(),
+                                   std::uint64_t(1) << 63);
+        for (int i = 0; i < FastOpenCookieLen; i++) {
+            cookie[i] = char(std::uint8_t(h >> (8 * i)));
+        }
+    }
+    
+private:
+    static std::uint32_t calc_hash (Key const &key, TcpPcbKey const &conn,
+                                    TcpSeqNum peer_isn, std::uint32_t counter)
+    {
+        std::uint64_t h = sip_hash(key,
+            (std::uint64_t(conn.local_addr.value()) << 32) | conn.remote_addr.value(),
+            (std::uint64_t(conn.local_port) << 48) |
+                (std::uint64_t(conn.remote_port) << 32) | peer_isn.value(),
+            counter);
+        return std::uint32_t(h ^ (h >> 32));
+    }
+    
+    // SipHash-2-4 of a 24-byte message given as three 64-bit words.
+    static std::uint64_t sip_hash (Key const &key,
+                                   std::uint64_t m0, std::uint64_t m1, std::uint64_t m2)
+    {
+        SipHash<2, 4> h(key);
+        h.addWord(m0);
+        h.addWord(m1);
+        h.addWord(m2);
+        return h.finish();
+    }
+};
+
+}
+
+#endif
@@ -34,26 +34,29 @@
 #include <aipstack/misc/Assert.h>
 #include <aipstack/misc/Hints.h>
 #include <aipstack/misc/MinMax.h>
-#include <aipstack/misc/IntRange.h>
 #include <aipstack/misc/Function.h>
 #include <aipstack/misc/EnumUtils.h>
+#include <aipstack/misc/SipHash.h>
 #include <aipstack/structure/LinkedList.h>
 #include <aipstack/structure/LinkModel.h>
 #include <aipstack/structure/StructureRaiiWrapper.h>
 #include <aipstack/structure/Accessor.h>
 #include <aipstack/structure/LexiKeyCompare.h>
+#include <aipstack/structure/OperatorKeyCompare.h>
 #include <aipstack/infra/Options.h>
 #include <aipstack/infra/Instance.h>
 #include <aipstack/infra/Err.h>
 #include <aipstack/infra/Buf.h>
 #include <aipstack/infra/Chksum.h>
 #include <aipstack/infra/SendRetry.h>
+#include <aipstack/infra/PacketBufPool.h>
 #include <aipstack/proto/Ip4Proto.h>
 #include <aipstack/proto/Udp4Proto.h>
 #include <aipstack/proto/Icmp4Proto.h>
 #include <aipstack/platform/PlatformFacade.h>
 #include <aipstack/ip/IpAddr.h>
 #include <aipstack/ip/IpStack.h>
+#include <aipstack/ip/IpEphemeralPortAllocator.h>
 
 namespace AIpStack {
 
@@ -67,6 +70,9 @@ class UdpListener;
 template<typename Arg>
 class UdpAssociation;
 
+template<typename Arg>
+class UdpRetainedDgram;
+
 template<typename Arg>
 class IpUdpProto;
 #endif
@@ -143,12 +149,28 @@ public:
 
     using Association = UdpAssociation<Arg>;
 
+    using RetainedDgram = UdpRetainedDgram<Arg>;
+
     inline static constexpr std::size_t HeaderBeforeUdpData =
         IpStack<StackArg>::HeaderBeforeIp4Dgram + Udp4Header::Size;
 
     inline static constexpr std::size_t MaxUdpDataLenIp4 =
         TypeMax<std::uint16_t> - Udp4Header::Size;
 
+    /**
+     * Set the secret key used to randomize the selection of ephemeral ports.
+     * 
+     * The key should be random; by default one is derived from the time of
+     * initialization, which is predictable.
+     * 
+     * @param k0 First half of the key.
+     * @param k1 Second half of the key.
+     */
+    void setEphemeralPortKey (std::uint64_t k0, std::uint64_t k1)
+    {
+        proto().m_ephemeral_port_key = SipHashKey{k0, k1};
+    }
+
     IpErr sendUdpIp4Packet (Ip4AddrPair const &addrs, UdpTxInfo<Arg> const &udp_info,
                             IpBufRef udp_data, IpIface<StackArg> *iface,
                             IpSendRetryRequest *retryReq, IpSendFlags send_flags)
@@ -166,17 +188,24 @@ public:
         udp_header.set(Udp4Header::Length(),   std::uint16_t(dgram.tot_len));
         udp_header.set(Udp4Header::Checksum(), 0);
         
-        // Calculate UDP checksum.
-        IpChksumAccumulator chksum_accum;
-        chksum_accum.addWord(WrapType<std::uint32_t>(), addrs.local_addr.value());
-        chksum_accum.addWord(WrapType<std::uint32_t>(), addrs.remote_addr.value());
-        chksum_accum.addWord(WrapType<std::uint16_t>(), AsUnderlying(Ip4Protocol::Udp));
-        chksum_accum.addWord(WrapType<std::uint16_t>(), std::uint16_t(dgram.tot_len));
-        std::uint16_t checksum = chksum_accum.getChksum(dgram);
-        if (checksum == 0) {
-            checksum = TypeMax<std::uint16_t>;
+        // Calculate UDP checksum, unless the interface is forced and its driver
+        // calculates it (otherwise the interface is not known here). The driver
+        // cannot do that if the datagram will be fragmented for this interface.
+        if (iface == nullptr ||
+            (iface->getTxChksumOffload() & IpChksumFlags::Transport) == Enum0 ||
+            Ip4Header::Size + dgram.tot_len > iface->getMtu())
+        {
+            IpChksumAccumulator chksum_accum;
+            chksum_accum.addWord(WrapType<std::uint32_t>(), addrs.local_addr.value());
+            chksum_accum.addWord(WrapType<std::uint32_t>(), addrs.remote_addr.value());
+            chksum_accum.addWord(WrapType<std::uint16_t>(), AsUnderlying(Ip4Protocol::Udp));
+            chksum_accum.addWord(WrapType<std::uint16_t>(), std::uint16_t(dgram.tot_len));
+            std::uint16_t checksum = chksum_accum.getChksum(dgram);
+            if (checksum == 0) {
+                checksum = TypeMax<std::uint16_t>;
+            }
+            udp_header.set(Udp4Header::Checksum(), checksum);
         }
-        udp_header.set(Udp4Header::Checksum(), checksum);
         
         // Send the datagram.
         return proto().m_stack->sendIp4Dgram(dgram, iface, retryReq,
@@ -190,7 +219,7 @@ class UdpListener :
 {
     template<typename> friend class IpUdpProto;
     
-    AIPSTACK_USE_TYPES(IpUdpProto<Arg>, (ListenersLinkModel))
+    AIPSTACK_USE_TYPES(IpUdpProto<Arg>, (ListenersLinkModel, ListenerIndex))
 
 public:
     using StackArg = typename Arg::StackArg;
@@ -213,9 +242,13 @@ public:
     {
         if (m_udp != nullptr) {
             if (m_udp->m_next_listener == this) {
-                m_udp->m_next_listener = m_udp->m_listeners_list.next(*this);
+                m_udp->m_next_listener = m_udp->next_rx_listener(this);
+            }
+            if (m_params.port != 0) {
+                m_udp->m_listener_index.removeEntry(*this);
+            } else {
+                m_udp->m_any_port_listeners.remove(*this);
             }
-            m_udp->m_listeners_list.remove(*this);
             m_udp = nullptr;
         }
     }
@@ -246,7 +279,11 @@ public:
         m_udp = &udp.proto();
         m_params = params;
         
-        m_udp->m_listeners_list.prepend(*this);
+        if (m_params.port != 0) {
+            m_udp->m_listener_index.addEntry(*this);
+        } else {
+            m_udp->m_any_port_listeners.prepend(*this);
+        }
 
         return IpErr::Success;
     }
@@ -291,6 +328,7 @@ private:
 private:
     UdpIp4PacketHandler m_handler;
     LinkedListNode<ListenersLinkModel> m_list_node;
+    typename ListenerIndex::Node m_index_node;
     IpUdpProto<Arg> *m_udp;
     UdpListenParams<Arg> m_params;
 };
@@ -387,6 +425,116 @@ private:
     UdpAssociationParams<Arg> m_params;
 };
 
+/**
+ * Holds a received UDP datagram so that it can be processed after the receive
+ * handler has returned, without copying it.
+ * 
+ * This is possible when the datagram is stored in a buffer of the packet buffer
+ * pool of the receiving interface (@ref IpIfaceDriverParams::rx_pool). Then @ref
+ * retain takes a reference to that buffer, which is released by @ref release or
+ * the destructor.
+ */
+template<typename Arg>
+class UdpRetainedDgram :
+    private NonCopyable<UdpRetainedDgram<Arg>>
+{
+public:
+    using StackArg = typename Arg::StackArg;
+
+    UdpRetainedDgram () :
+        m_pool(nullptr),
+        m_buf(nullptr)
+    {}
+
+    ~UdpRetainedDgram ()
+    {
+        release();
+    }
+
+    /**
+     * Retain a datagram from within a @ref UdpListener or @ref UdpAssociation
+     * receive handler, releasing any previously retained datagram.
+     * 
+     * @param ip_info IP information as passed to the handler.
+     * @param udp_info UDP information as passed to the handler.
+     * @param udp_data UDP data as passed to the handler.
+     * @return True if the datagram is now retained, false if it is not stored in
+     *         the packet buffer pool of the interface and needs to be copied.
+     */
+    bool retain (IpRxInfoIp4<StackArg> const &ip_info,
+                 UdpRxInfo<Arg> const &udp_info, IpBufRef udp_data)
+    {
+        release();
+
+        IpPacketBufPool *pool = ip_info.iface->getRxPool();
+        if (pool == nullptr) {
+            return false;
+        }
+
+        IpPacketBuf *buf = pool->takeRef(udp_data);
+        if (buf == nullptr) {
+            return false;
+        }
+
+        m_pool = pool;
+        m_buf = buf;
+        m_addrs = Ip4AddrPair{ip_info.dst_addr, ip_info.src_addr};
+        m_udp_info = udp_info;
+        m_data = udp_data;
+
+        return true;
+    }
+
+    /**
+     * Release the retained datagram, if any.
+     */
+    void release ()
+    {
+        if (m_buf != nullptr) {
+            m_pool->unref(*m_buf);
+            m_pool = nullptr;
+            m_buf = nullptr;
+        }
+    }
+
+    bool isRetained () const
+    {
+        return m_buf != nullptr;
+    }
+
+    /**
+     * Get the addresses of the retained datagram; the local address is its
+     * destination address.
+     */
+    Ip4AddrPair const & getAddrs () const
+    {
+        AIPSTACK_ASSERT(isRetained());
+
+        return m_addrs;
+    }
+
+    UdpRxInfo<Arg> const & getUdpInfo () const
+    {
+        AIPSTACK_ASSERT(isRetained());
+
+        return m_udp_info;
+    }
+
+    IpBufRef getData () const
+    {
+        AIPSTACK_ASSERT(isRetained());
+
+        return m_data;
+    }
+
+private:
+    IpPacketBufPool *m_pool;
+    IpPacketBuf *m_buf;
+    Ip4AddrPair m_addrs;
+    UdpRxInfo<Arg> m_udp_info;
+    IpBufRef m_data;
+};
+
 #ifndef IN_DOXYGEN
 
 template<typename Arg>
@@ -407,9 +555,6 @@ class IpUdpProto :
 
     using Platform = PlatformFacade<PlatformImpl>;
 
-    inline static constexpr PortNum NumEphemeralPorts =
-        EphemeralPortLast - EphemeralPortFirst + 1;
-
     struct ListenerListNodeAccessor;
     using ListenersLinkModel = PointerLinkModel<UdpListener<Arg>>;
 
@@ -420,6 +565,32 @@ class IpUdpProto :
         UdpListener<Arg>, LinkedListNode<ListenersLinkModel>,
         &UdpListener<Arg>::m_list_node> {};
     
+    // Listeners on a specific port are in the listener index, those on all
+    // ports (port 0) are in the list.
+    struct ListenerIndexNodeAccessor;
+    struct ListenerIndexKeyFuncs;
+
+    AIPSTACK_MAKE_INSTANCE(ListenerIndex, (UdpIndexService::template Index<
+        ListenerIndexNodeAccessor, PortNum, ListenerIndexKeyFuncs, ListenersLinkModel,
+        /*Duplicates=*/true>))
+
+    struct ListenerIndexNodeAccessor : public MemberAccessor<
+        UdpListener<Arg>, typename ListenerIndex::Node,
+        &UdpListener<Arg>::m_index_node> {};
+    
+    struct ListenerIndexKeyFuncs : public OperatorKeyCompare {
+        inline static PortNum GetKeyOfEntry (UdpListener<Arg> const &lis)
+        {
+            return lis.m_params.port;
+        }
+        
+        template<typename Hasher>
+        inline static void HashKey (PortNum port, Hasher &hasher)
+        {
+            hasher.addWord(port);
+        }
+    };
+    
     struct AssociationIndexNodeAccessor;
     struct AssociationIndexKeyFuncs;
     using AssociationLinkModel = PointerLinkModel<UdpAssociation<Arg>>;
@@ -446,18 +617,32 @@ class IpUdpProto :
         {
             return assoc.m_params.key;
         }
+        
+        template<typename Hasher>
+        inline static void HashKey (UdpAssociationKey const &key, Hasher &hasher)
+        {
+            hasher.addWord((std::uint64_t(key.local_addr.value()) << 32) |
+                           key.remote_addr.value());
+            hasher.addWord((std::uint64_t(key.local_port) << 16) | key.remote_port);
+        }
     };
 
 public:
     IpUdpProto (IpProtocolHandlerArgs<StackArg> args) :
         m_stack(args.stack),
-        m_next_listener(nullptr),
-        m_next_ephemeral_port(EphemeralPortFirst)
-    {}
+        m_next_listener(nullptr)
+    {
+        // Derive an initial key for ephemeral port selection, the application
+        // should set a random one using UdpApi::setEphemeralPortKey.
+        m_ephemeral_port_key = SipHashKey{
+            std::uint64_t(args.platform.getTime()),
+            std::uint64_t(reinterpret_cast<std::uintptr_t>(this))};
+    }
 
     ~IpUdpProto ()
     {
-        AIPSTACK_ASSERT(m_listeners_list.isEmpty());
+        AIPSTACK_ASSERT(m_listener_index.isEmpty());
+        AIPSTACK_ASSERT(m_any_port_listeners.isEmpty());
         AIPSTACK_ASSERT(m_associations_index.isEmpty());
         AIPSTACK_ASSERT(m_next_listener == nullptr);
     }
@@ -560,14 +745,19 @@ public:
             updateCachedInfo();
         } while (false);
         
-        // Look for listeners which match the incoming packet.
+        // Look for listeners which match the incoming packet, first those listening
+        // on the destination port then those listening on all ports.
         // NOTE: `lis` must be properly adjusted at the end of each iteration!
-        for (UdpListener<Arg> *lis = m_listeners_list.first(); lis != nullptr;) {
+        UdpListener<Arg> *lis = m_listener_index.findFirst(udp_info.dst_port);
+        if (lis == nullptr) {
+            lis = m_any_port_listeners.first();
+        }
+        while (lis != nullptr) {
             AIPSTACK_ASSERT(lis->m_udp == this);
             
             // Check if the listener matches, if not skip it.
             if (!lis->incomingPacketMatches(ip_info, udp_info, dst_is_iface_addr)) {
-                lis = m_listeners_list.next(*lis);
+                lis = next_rx_listener(lis);
                 continue;
             }
 
@@ -581,7 +771,7 @@ public:
             // UdpListener::reset() will advance m_next_listener so that we can safely
             // continue iterating.
             AIPSTACK_ASSERT(m_next_listener == nullptr);
-            m_next_listener = m_listeners_list.next(*lis);
+            m_next_listener = next_rx_listener(lis);
 
             // Pass the packet to the listener.
             IpBufRef udp_data = dgram.hideHeader(Udp4Header::Size);
@@ -627,6 +817,11 @@ public:
     {
     }
 
+    void handleRxBurstEnd ([[maybe_unused]] IpIface<StackArg> *iface)
+    {
+        // Datagrams are delivered as they are received, nothing is deferred.
+    }
+
 private:
     static bool verifyChecksum (
         IpRxInfoIp4<StackArg> const &ip_info, Udp4Header::Ref udp_header,
@@ -636,7 +831,10 @@ private:
 
         has_checksum = (checksum != 0);
 
-        if (has_checksum) {
+        // Verify the checksum, unless the driver has already done that.
+        if (has_checksum &&
+            (ip_info.chksum_verified & IpChksumFlags::Transport) == Enum0)
+        {
             IpChksumAccumulator chksum_accum;
             chksum_accum.addWord(WrapType<std::uint32_t>(), ip_info.src_addr.value());
             chksum_accum.addWord(WrapType<std::uint32_t>(), ip_info.dst_addr.value());
@@ -651,29 +849,43 @@ private:
         return true;
     }
 
-    bool get_ephemeral_port (UdpAssociationKey &key)
+    // Return the listener after `lis` in the order in which listeners are offered
+    // a received datagram: those listening on its destination port (which is the
+    // port of `lis` unless that is zero), followed by those listening on all ports.
+    UdpListener<Arg> * next_rx_listener (UdpListener<Arg> *lis)
     {
-        for ([[maybe_unused]] PortNum i : IntRange(NumEphemeralPorts)) {
-            PortNum port = m_next_ephemeral_port;
-            m_next_ephemeral_port = (port < EphemeralPortLast) ?
-                (port + 1) : EphemeralPortFirst;
-            
-            key.local_port = port;
-
-            if (m_associations_index.findEntry(key).isNull()) {
-                return true;
-            }
+        PortNum port = lis->m_params.port;
+        if (port == 0) {
+            return m_any_port_listeners.next(*lis);
         }
         
-        return false;
+        UdpListener<Arg> *next = m_listener_index.findNext(port, *lis);
+        if (next == nullptr) {
+            next = m_any_port_listeners.first();
+        }
+        return next;
+    }
+
+    bool get_ephemeral_port (UdpAssociationKey &key)
+    {
+        key.local_port = m_ephemeral_ports.allocate(m_ephemeral_port_key,
+            key.local_addr, key.remote_addr, key.remote_port, [&](PortNum port) {
+                UdpAssociationKey port_key = key;
+                port_key.local_port = port;
+                return m_associations_index.findEntry(port_key).isNull();
+            });
+        
+        return key.local_port != 0;
     }
     
 private:
     IpStack<StackArg> *m_stack;
-    StructureRaiiWrapper<ListenersList> m_listeners_list;
+    StructureRaiiWrapper<typename ListenerIndex::Index> m_listener_index;
+    StructureRaiiWrapper<ListenersList> m_any_port_listeners;
     StructureRaiiWrapper<typename AssociationIndex::Index> m_associations_index;
     UdpListener<Arg> *m_next_listener;
-    PortNum m_next_ephemeral_port;
+    SipHashKey m_ephemeral_port_key;
+    IpEphemeralPortAllocator<EphemeralPortFirst, EphemeralPortLast> m_ephemeral_ports;
 };
 
 #endif
@@ -35,6 +35,7 @@
 #include <aipstack/misc/MemRef.h>
 #include <aipstack/infra/Buf.h>
 #include <aipstack/infra/BufUtils.h>
+#include <aipstack/infra/ChksumBlockCache.h>
 #include <aipstack/tcp/TcpConnection.h>
 
 namespace AIpStack {
@@ -42,7 +43,10 @@ namespace AIpStack {
 template<typename TcpArg>
 class SendRingBuffer {
 public:
-    void setup (TcpConnection<TcpArg> &con, char *buf, std::size_t buf_size)
+    // If chksum_cache is given, it is reset for this buffer and used for calculating
+    // checksums of outgoing data (see TcpConnection::setSendChksumCache).
+    void setup (TcpConnection<TcpArg> &con, char *buf, std::size_t buf_size,
+                IpChksumBlockCache *chksum_cache = nullptr)
     {
         AIPSTACK_ASSERT(buf != nullptr);
         AIPSTACK_ASSERT(buf_size > 0);
@@ -50,6 +54,12 @@ public:
         
         m_buf_node = IpBufNode{buf, buf_size, &m_buf_node};
         
+        m_chksum_cache = chksum_cache;
+        if (chksum_cache != nullptr) {
+            chksum_cache->reset(&m_buf_node);
+        }
+        con.setSendChksumCache(chksum_cache);
+        
         IpBufRef old_send_buf = con.getSendBuf();
 
         IpBufRef send_buf = IpBufRef{&m_buf_node, std::size_t(0), old_send_buf.tot_len};
@@ -80,7 +90,12 @@ public:
     
     inline void provideData (TcpConnection<TcpArg> &con, std::size_t amount)
     {
-        AIPSTACK_ASSERT(amount <= getWriteRange(con).tot_len);
+        IpBufRef write_range = getWriteRange(con);
+        AIPSTACK_ASSERT(amount <= write_range.tot_len);
+        
+        if (m_chksum_cache != nullptr) {
+            m_chksum_cache->invalidate(write_range.offset, amount);
+        }
         
         con.extendSendBuf(amount);
     }
@@ -93,6 +108,7 @@ private:
     
 private:
     IpBufNode m_buf_node;
+    IpChksumBlockCache *m_chksum_cache;
 };
 
 template<typename TcpArg>
@@ -12,6 +12,11 @@ namespace aipstack_buf_test {
 
 constexpr Modulo Mod = Modulo(10);
 
+struct TestIovec {
+    void *iov_base;
+    std::size_t iov_len;
+};
+
 void test_with_offset(std::size_t off)
 {
     char buffer[Mod.modulus()];
@@ -82,6 +87,27 @@ void test_with_offset(std::size_t off)
     AIPSTACK_ASSERT_FORCE(ipBufStartsWith(all, AIpStack::MemRef(), rem7) == true);
     AIPSTACK_ASSERT_FORCE(rem7.offset == all.offset);
     AIPSTACK_ASSERT_FORCE(rem7.tot_len == all.tot_len);
+
+    // toIovec tests
+
+    std::size_t num_chunks = (off == 0) ? 1 : 2;
+    TestIovec iov[2];
+    std::size_t num_iov;
+
+    AIPSTACK_ASSERT_FORCE(ipBufToIovec(all, iov, 2, num_iov) == true);
+    AIPSTACK_ASSERT_FORCE(num_iov == num_chunks);
+    AIPSTACK_ASSERT_FORCE(iov[0].iov_base == buffer + off);
+    AIPSTACK_ASSERT_FORCE(iov[0].iov_len == Mod.modulus() - off);
+    if (num_chunks == 2) {
+        AIPSTACK_ASSERT_FORCE(iov[1].iov_base == buffer);
+        AIPSTACK_ASSERT_FORCE(iov[1].iov_len == off);
+    }
+
+    AIPSTACK_ASSERT_FORCE(ipBufToIovec(all, iov, 1, num_iov) == (num_chunks == 1));
+    AIPSTACK_ASSERT_FORCE(num_iov == 1);
+
+    AIPSTACK_ASSERT_FORCE(ipBufToIovec(all.subTo(0), iov, 0, num_iov) == true);
+    AIPSTACK_ASSERT_FORCE(num_iov == 0);
 }
 
 }
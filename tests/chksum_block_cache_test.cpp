@@ -0,0 +1,88 @@
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <aipstack/infra/Chksum.h>
+#include <aipstack/infra/ChksumBlockCache.h>
+
+using namespace AIpStack;
+
+namespace aipstack_chksum_block_cache_test {
+
+using random_bytes_engine = std::independent_bits_engine<
+    std::mt19937, std::numeric_limits<unsigned char>::digits, unsigned char>;
+
+constexpr int Iterations = 200000;
+
+static void test_with_size (std::size_t buf_size, std::mt19937 &rng,
+                            random_bytes_engine &rbe)
+{
+    std::vector<char> buf(buf_size);
+    std::generate(buf.begin(), buf.end(), std::ref(rbe));
+
+    IpBufNode node{buf.data(), buf_size, nullptr};
+    node.next = &node;
+
+    std::vector<IpChksumBlockCache::Entry> entries(
+        IpChksumBlockCache::numEntriesForSize(buf_size));
+    IpChksumBlockCache cache(entries.data(), entries.size());
+    cache.reset(&node);
+
+    auto rand_size = [&](std::size_t max) {
+        return std::uniform_int_distribution<std::size_t>(0, max)(rng);
+    };
+
+    for (int iter = 0; iter < Iterations; iter++) {
+        // Occasionally overwrite a random (possibly wrapping) range and invalidate it.
+        if (rand_size(7) == 0) {
+            std::size_t offset = rand_size(buf_size - 1);
+            std::size_t len = rand_size(buf_size / 4);
+            for (std::size_t i = 0; i < len; i++) {
+                buf[(offset + i) % buf_size] = char(rbe());
+            }
+            cache.invalidate(offset, len);
+        }
+
+        // Checksum a random range (possibly wrapping) with some header word, using
+        // the cache and the regular way.
+        std::size_t offset = rand_size(buf_size - 1);
+        std::size_t len = rand_size(buf_size);
+        IpBufRef data{&node, offset, len};
+        std::uint16_t header_word = std::uint16_t(rand_size(0xFFFF));
+
+        IpChksumAccumulator accum1;
+        accum1.addWord(WrapType<std::uint16_t>(), header_word);
+        std::uint16_t chksum = cache.getChksum(accum1, data);
+
+        IpChksumAccumulator accum2;
+        accum2.addWord(WrapType<std::uint16_t>(), header_word);
+        std::uint16_t good_chksum = accum2.getChksum(data);
+
+        AIPSTACK_ASSERT_FORCE(chksum == good_chksum);
+    }
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_chksum_block_cache_test;
+
+    std::random_device rd;
+    std::mt19937 rng(rd());
+    random_bytes_engine rbe(rd());
+
+    // Sizes which are and are not a multiple of the block size, including odd.
+    for (std::size_t buf_size : {std::size_t(1), std::size_t(63), std::size_t(1024),
+                                 std::size_t(1001), std::size_t(6000)})
+    {
+        test_with_size(buf_size, rng, rbe);
+    }
+
+    return 0;
+}
@@ -0,0 +1,105 @@
+
+#include <chrono>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/misc/Function.h>
+#include <aipstack/event_loop/EventLoop.h>
+
+using namespace AIpStack;
+
+namespace aipstack_event_loop_flush_hook_test {
+
+// Flush hooks scheduled while handling events run before the event loop waits
+// for more events: the hooks run right after the first timer and long before
+// the second one expires.
+class FlushHookTest {
+public:
+    FlushHookTest () :
+        m_timer1(m_loop, AIPSTACK_BIND_MEMBER(&FlushHookTest::timer1Handler, this)),
+        m_timer2(m_loop, AIPSTACK_BIND_MEMBER(&FlushHookTest::timer2Handler, this)),
+        m_hook1(m_loop, AIPSTACK_BIND_MEMBER(&FlushHookTest::hook1Handler, this)),
+        m_hook2(m_loop, AIPSTACK_BIND_MEMBER(&FlushHookTest::hook2Handler, this)),
+        m_hook3(m_loop, AIPSTACK_BIND_MEMBER(&FlushHookTest::hook3Handler, this))
+    {}
+    
+    void run ()
+    {
+        m_timer1.setAfter(std::chrono::milliseconds(0));
+        m_loop.run();
+        
+        AIPSTACK_ASSERT_FORCE((m_events == std::vector<int>{1, 2, 3, 4}));
+        AIPSTACK_ASSERT_FORCE(m_hooks_time - m_timer1_time < MaxHookDelay);
+        AIPSTACK_ASSERT_FORCE(!m_hook1.isScheduled() && !m_hook2.isScheduled());
+    }
+
+private:
+    static constexpr std::chrono::milliseconds Timer2Delay{500};
+    static constexpr std::chrono::milliseconds MaxHookDelay{250};
+    
+    void timer1Handler ()
+    {
+        m_events.push_back(1);
+        m_timer1_time = EventLoop::getTime();
+        
+        m_hook1.schedule();
+        m_hook1.schedule();
+        AIPSTACK_ASSERT_FORCE(m_hook1.isScheduled());
+        
+        // An unscheduled hook is not called.
+        m_hook3.schedule();
+        m_hook3.unschedule();
+        AIPSTACK_ASSERT_FORCE(!m_hook3.isScheduled());
+        
+        m_timer2.setAfter(Timer2Delay);
+    }
+    
+    void hook1Handler ()
+    {
+        m_events.push_back(2);
+        AIPSTACK_ASSERT_FORCE(!m_hook1.isScheduled());
+        
+        // A hook scheduled from a hook handler also runs before waiting.
+        m_hook2.schedule();
+    }
+    
+    void hook2Handler ()
+    {
+        m_events.push_back(3);
+        m_hooks_time = EventLoop::getTime();
+    }
+    
+    void hook3Handler ()
+    {
+        AIPSTACK_ASSERT_FORCE(false);
+    }
+    
+    void timer2Handler ()
+    {
+        m_events.push_back(4);
+        m_loop.stop();
+    }
+
+private:
+    EventLoop m_loop;
+    EventLoopTimer m_timer1;
+    EventLoopTimer m_timer2;
+    EventLoopFlushHook m_hook1;
+    EventLoopFlushHook m_hook2;
+    EventLoopFlushHook m_hook3;
+    std::vector<int> m_events;
+    EventLoopTime m_timer1_time;
+    EventLoopTime m_hooks_time;
+};
+
+}
+
+int main ()
+{
+    using namespace aipstack_event_loop_flush_hook_test;
+    
+    FlushHookTest test;
+    test.run();
+    
+    return 0;
+}
@@ -0,0 +1,283 @@
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/misc/SipHash.h>
+#include <aipstack/infra/Instance.h>
+#include <aipstack/ip/IpAddr.h>
+#include <aipstack/structure/Accessor.h>
+#include <aipstack/structure/LinkModel.h>
+#include <aipstack/structure/StructureRaiiWrapper.h>
+#include <aipstack/structure/index/AvlTreeIndex.h>
+#include <aipstack/structure/index/HashTableIndex.h>
+#include <aipstack/tcp/TcpPcbKey.h>
+
+using namespace AIpStack;
+
+namespace aipstack_hash_table_index_test {
+
+// Number of entries, the same order as a large number of TCP PCBs.
+constexpr std::size_t NumEntries = 2048;
+
+struct Entry;
+struct Container;
+struct EntryArrayAccessor;
+
+using EntryLinkModel = ArrayLinkModelWithAccessor<
+    Entry, std::uint16_t, 0xFFFF, Container, EntryArrayAccessor>;
+
+using EntryState = EntryLinkModel::State;
+using EntryRef = EntryLinkModel::Ref;
+
+struct KeyFuncs : public TcpPcbKeyCompare {
+    inline static TcpPcbKey const & GetKeyOfEntry (Entry const &entry);
+};
+
+struct HashIndexAccessor;
+struct AvlIndexAccessor;
+
+// The number of buckets is derived from the maximum number of entries.
+using HashIndexArg = HashTableIndexService<>::Index<
+    HashIndexAccessor, TcpPcbKey const &, KeyFuncs, EntryLinkModel, false, NumEntries>;
+static_assert(HashIndexArg::NumBuckets == NumEntries);
+
+AIPSTACK_MAKE_INSTANCE(HashIndex, (HashIndexArg))
+
+AIPSTACK_MAKE_INSTANCE(AvlIndex, (AvlTreeIndexService::Index<
+    AvlIndexAccessor, TcpPcbKey const &, KeyFuncs, EntryLinkModel, false>))
+
+struct Entry {
+    TcpPcbKey key;
+    bool in_index;
+    HashIndex::Node hash_node;
+    AvlIndex::Node avl_node;
+};
+
+struct Container {
+    Entry entries[NumEntries];
+};
+
+TcpPcbKey const & KeyFuncs::GetKeyOfEntry (Entry const &entry)
+{
+    return entry.key;
+}
+
+struct HashIndexAccessor : public
+    MemberAccessor<Entry, HashIndex::Node, &Entry::hash_node> {};
+struct AvlIndexAccessor : public
+    MemberAccessor<Entry, AvlIndex::Node, &Entry::avl_node> {};
+struct EntryArrayAccessor : public
+    MemberAccessor<Container, Entry[NumEntries], &Container::entries> {};
+
+static std::uint32_t rand_state = 1;
+
+static std::uint32_t random32 ()
+{
+    rand_state = rand_state * 1103515245u + 12345u;
+    return rand_state;
+}
+
+// Keys like those of connections to a server: a few local ports and
+// many remote addresses and ports.
+static TcpPcbKey makeKey (std::size_t i)
+{
+    return TcpPcbKey(Ip4Addr(192, 168, 1, 1),
+        Ip4Addr(std::uint32_t(0x0A000000u + (i >> 4))),
+        PortNum(80 + (i % 4)), PortNum(40000 + (i & 15)));
+}
+
+static TcpPcbKey makeMissingKey (std::size_t i)
+{
+    TcpPcbKey key = makeKey(i);
+    key.local_port = 8080;
+    return key;
+}
+
+static void testSipHash ()
+{
+    // Reference vector for the 8-byte message 00 01 .. 07 and the
+    // key 00 01 .. 0f, from the SipHash paper.
+    SipHashKey key{0x0706050403020100u, 0x0f0e0d0c0b0a0908u};
+    SipHash<2, 4> h(key);
+    h.addWord(0x0706050403020100u);
+    AIPSTACK_ASSERT_FORCE(h.finish() == 0x93f5f5799a932462u);
+}
+
+static void testIndex (Container &c)
+{
+    EntryState st(c);
+    
+    StructureRaiiWrapper<HashIndex::Index> hash_index;
+    StructureRaiiWrapper<AvlIndex::Index> avl_index;
+    
+    for (std::size_t i = 0; i < NumEntries; i++) {
+        c.entries[i].key = makeKey(i);
+        c.entries[i].in_index = false;
+    }
+    
+    // Randomly add and remove entries and compare with the AVL tree.
+    for (int iter = 0; iter < 20000; iter++) {
+        Entry &entry = c.entries[random32() % NumEntries];
+        EntryRef ref = EntryRef(entry, st);
+        if (entry.in_index) {
+            hash_index.removeEntry(ref, st);
+            avl_index.removeEntry(ref, st);
+        } else {
+            hash_index.addEntry(ref, st);
+            avl_index.addEntry(ref, st);
+        }
+        entry.in_index = !entry.in_index;
+    }
+    
+    std::size_t num_in_index = 0;
+    for (std::size_t i = 0; i < NumEntries; i++) {
+        Entry &entry = c.entries[i];
+        EntryRef found = hash_index.findEntry(entry.key, st);
+        AIPSTACK_ASSERT_FORCE(found == avl_index.findEntry(entry.key, st));
+        AIPSTACK_ASSERT_FORCE(found == (entry.in_index ? EntryRef(entry) : EntryRef::null()));
+        AIPSTACK_ASSERT_FORCE(hash_index.findEntry(makeMissingKey(i), st).isNull());
+        num_in_index += entry.in_index;
+    }
+    
+    // Iteration visits each entry once.
+    std::size_t num_iterated = 0;
+    for (EntryRef e = hash_index.first(st); !e.isNull(); e = hash_index.next(e, st)) {
+        AIPSTACK_ASSERT_FORCE((*e).in_index);
+        num_iterated++;
+    }
+    AIPSTACK_ASSERT_FORCE(num_iterated == num_in_index);
+    
+    // Remove all.
+    for (std::size_t i = 0; i < NumEntries; i++) {
+        Entry &entry = c.entries[i];
+        if (entry.in_index) {
+            hash_index.removeEntry(EntryRef(entry, st), st);
+            avl_index.removeEntry(EntryRef(entry, st), st);
+            entry.in_index = false;
+        }
+    }
+    AIPSTACK_ASSERT_FORCE(hash_index.isEmpty());
+    AIPSTACK_ASSERT_FORCE(hash_index.first(st).isNull());
+}
+
+struct DupEntry;
+struct DupAccessor;
+using DupLinkModel = PointerLinkModel<DupEntry>;
+
+struct DupKeyFuncs : public TcpPcbKeyCompare {
+    inline static TcpPcbKey const & GetKeyOfEntry (DupEntry const &entry);
+};
+
+// An explicit number of buckets overrides the maximum number of entries.
+using DupIndexArg = HashTableIndexService<
+    HashTableIndexServiceOptions::NumBuckets::Is<3>>::Index<
+        DupAccessor, TcpPcbKey const &, DupKeyFuncs, DupLinkModel, true, 100>;
+static_assert(DupIndexArg::NumBuckets == 3);
+
+AIPSTACK_MAKE_INSTANCE(DupIndex, (DupIndexArg))
+
+struct DupEntry {
+    TcpPcbKey key;
+    DupIndex::Node node;
+};
+
+TcpPcbKey const & DupKeyFuncs::GetKeyOfEntry (DupEntry const &entry)
+{
+    return entry.key;
+}
+
+struct DupAccessor : public MemberAccessor<DupEntry, DupIndex::Node, &DupEntry::node> {};
+
+static void testDuplicates ()
+{
+    using Ref = DupLinkModel::Ref;
+    
+    StructureRaiiWrapper<DupIndex::Index> index;
+    
+    DupEntry entries[12];
+    for (std::size_t i = 0; i < 12; i++) {
+        entries[i].key = makeKey(i % 4);
+        index.addEntry(entries[i]);
+    }
+    
+    for (std::size_t k = 0; k < 4; k++) {
+        int num_found = 0;
+        for (Ref e = index.findFirst(makeKey(k)); !e.isNull();
+             e = index.findNext(makeKey(k), e))
+        {
+            AIPSTACK_ASSERT_FORCE(e >= entries && e < entries + 12);
+            AIPSTACK_ASSERT_FORCE(std::size_t(e - entries) % 4 == k);
+            num_found++;
+        }
+        AIPSTACK_ASSERT_FORCE(num_found == 3);
+    }
+    
+    for (std::size_t i = 0; i < 12; i++) {
+        index.removeEntry(entries[i]);
+    }
+    AIPSTACK_ASSERT_FORCE(index.isEmpty());
+}
+
+template<typename IndexType>
+static double benchmarkLookups (Container &c, int rounds)
+{
+    EntryState st(c);
+    StructureRaiiWrapper<IndexType> index;
+    for (std::size_t i = 0; i < NumEntries; i++) {
+        c.entries[i].key = makeKey(i);
+        index.addEntry(EntryRef(c.entries[i], st), st);
+    }
+    
+    std::size_t found = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++) {
+        for (std::size_t i = 0; i < NumEntries; i++) {
+            std::size_t j = (i * 769) % NumEntries;
+            found += !index.findEntry(c.entries[j].key, st).isNull();
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    AIPSTACK_ASSERT_FORCE(found == NumEntries * std::size_t(rounds));
+    
+    for (std::size_t i = 0; i < NumEntries; i++) {
+        index.removeEntry(EntryRef(c.entries[i], st), st);
+    }
+    
+    std::chrono::duration<double, std::nano> dur = end - start;
+    return dur.count() / double(NumEntries * std::size_t(rounds));
+}
+
+static void benchmark (Container &c)
+{
+    int const rounds = 2000;
+    double avl_ns = benchmarkLookups<AvlIndex::Index>(c, rounds);
+    double hash_ns = benchmarkLookups<HashIndex::Index>(c, rounds);
+    std::printf("Lookup with %zu entries: AVL tree %.1f ns, hash table %.1f ns\n",
+                NumEntries, avl_ns, hash_ns);
+}
+
+static Container container;
+
+}
+
+int main (int argc, char *argv[])
+{
+    using namespace aipstack_hash_table_index_test;
+    
+    SetHashTableIndexSeed(0x0123456789abcdefu, 0xfedcba9876543210u);
+    
+    testSipHash();
+    testIndex(container);
+    testDuplicates();
+    
+    // The benchmark is run only when requested: hash_table_index_test bench
+    if (argc > 1 && std::strcmp(argv[1], "bench") == 0) {
+        benchmark(container);
+    }
+    
+    return 0;
+}
@@ -0,0 +1,142 @@
+
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <aipstack/infra/Chksum.h>
+
+using namespace AIpStack;
+
+namespace aipstack_ip_chksum_simd_test {
+
+using random_bytes_engine = std::independent_bits_engine<
+    std::mt19937, std::numeric_limits<unsigned char>::digits, unsigned char>;
+
+constexpr std::size_t MaxLen = 4000;
+constexpr std::size_t MaxAlign = 64;
+constexpr int Iterations = 100000;
+constexpr int MaxNodes = 8;
+
+// Check all available implementations against the expected result.
+static void checkImpls (char const *data, std::size_t len, std::uint16_t good_sum)
+{
+    AIPSTACK_ASSERT_FORCE(IpChksumInverted(data, len) == good_sum);
+
+#if AIPSTACK_CHKSUM_X86_SIMD
+    if (__builtin_cpu_supports("sse2")) {
+        AIPSTACK_ASSERT_FORCE(IpChksumInvertedSse2(data, len) == good_sum);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        AIPSTACK_ASSERT_FORCE(IpChksumInvertedAvx2(data, len) == good_sum);
+    }
+#endif
+}
+
+// Make a chain of up to MaxNodes buffers with random lengths referencing the data.
+static IpBufRef makeChain (char *data, std::size_t len, IpBufNode (&node)[MaxNodes],
+                           std::mt19937 &rng)
+{
+    int num_nodes = 0;
+    std::size_t pos = 0;
+    while (num_nodes < MaxNodes) {
+        std::size_t rem = len - pos;
+        std::size_t chunk = (num_nodes == MaxNodes - 1) ? rem :
+            std::uniform_int_distribution<std::size_t>(0, rem)(rng);
+        node[num_nodes] = {data + pos, chunk, nullptr};
+        if (num_nodes > 0) {
+            node[num_nodes - 1].next = &node[num_nodes];
+        }
+        num_nodes++;
+        pos += chunk;
+        if (pos == len) {
+            break;
+        }
+    }
+    return IpBufRef{&node[0], 0, len};
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_ip_chksum_simd_test;
+
+    std::random_device rd;
+    std::mt19937 rng(rd());
+    random_bytes_engine rbe(rd());
+
+    // Large all-ones buffer so that the vector lanes must be folded more than once
+    // (maximum carries in every lane). This is beyond the 65535-byte limit of
+    // IpChksumInverted but the SIMD implementations are expected to handle it. The
+    // inverted checksum of an even number of 0xFF bytes is 0xFFFF, and an extra
+    // 0xFF byte (0xFF00 word) makes it 0xFF00.
+    {
+        std::vector<char> data(std::size_t(5) << 20, char(0xFF));
+        for (std::size_t len : {data.size(), data.size() - 1}) {
+            std::uint16_t good_sum = (len % 2 == 0) ? 0xFFFF : 0xFF00;
+#if AIPSTACK_CHKSUM_X86_SIMD
+            if (__builtin_cpu_supports("sse2")) {
+                AIPSTACK_ASSERT_FORCE(IpChksumInvertedSse2(data.data(), len) == good_sum);
+            }
+            if (__builtin_cpu_supports("avx2")) {
+                AIPSTACK_ASSERT_FORCE(IpChksumInvertedAvx2(data.data(), len) == good_sum);
+            }
+#endif
+        }
+        checkImpls(data.data(), 65535, 0xFF00);
+    }
+
+    std::vector<char> buf(MaxLen + MaxAlign);
+    std::vector<char> out(MaxLen);
+
+    for (int iter = 0; iter < Iterations; iter++) {
+        std::generate(buf.begin(), buf.end(), std::ref(rbe));
+
+        // Random length and alignment of a contiguous buffer.
+        std::size_t len = std::uniform_int_distribution<std::size_t>(0, MaxLen)(rng);
+        std::size_t align = std::uniform_int_distribution<std::size_t>(0, MaxAlign)(rng);
+        char const *data = buf.data() + align;
+
+        checkImpls(data, len, IpChksumInvertedScalar(data, len));
+
+        // Split the same data into a chain with random (often odd) chunk lengths,
+        // which exercises the byte swapping in IpChksumAccumulator.
+        IpBufNode node[MaxNodes];
+        IpBufRef chain = makeChain(const_cast<char *>(data), len, node, rng);
+
+        std::uint16_t good_chksum = std::uint16_t(~IpChksumInvertedScalar(data, len));
+        AIPSTACK_ASSERT_FORCE(IpChksum(chain) == good_chksum);
+
+        // Fused copy and checksum out of a chain.
+        {
+            IpChksumAccumulator accum;
+            IpBufRef rem = ipBufTakeBytesChksum(chain, len, out.data(), accum);
+            AIPSTACK_ASSERT_FORCE(rem.tot_len == 0);
+            AIPSTACK_ASSERT_FORCE(std::memcmp(out.data(), data, len) == 0);
+            AIPSTACK_ASSERT_FORCE(accum.getChksum() == good_chksum);
+        }
+
+        // Fused copy and checksum into a differently split chain, from contiguous
+        // memory and from the chain.
+        for (bool from_chain : {false, true}) {
+            std::fill(out.begin(), out.end(), char(0));
+            IpBufNode out_node[MaxNodes];
+            IpBufRef out_chain = makeChain(out.data(), len, out_node, rng);
+
+            IpChksumAccumulator accum;
+            IpBufRef rem = from_chain ?
+                ipBufGiveBufChksum(out_chain, chain, accum) :
+                ipBufGiveBytesChksum(out_chain, MemRef(data, len), accum);
+            AIPSTACK_ASSERT_FORCE(rem.tot_len == 0);
+            AIPSTACK_ASSERT_FORCE(std::memcmp(out.data(), data, len) == 0);
+            AIPSTACK_ASSERT_FORCE(accum.getChksum() == good_chksum);
+        }
+    }
+
+    return 0;
+}
@@ -61,6 +61,35 @@ int main ()
         AIPSTACK_ASSERT_FORCE(chksum == 0xFF);
     }
     
+    // Test incremental checksum update (RFC 1624). A 20-byte header with the checksum
+    // in bytes 10-11 has one 16-bit and one 32-bit field replaced, then the updated
+    // checksum must verify like a newly calculated one.
+    for (int iter = 0; iter < 100000; iter++) {
+        char header[20];
+        std::generate(header, header+20, std::ref(rbe));
+        
+        WriteSingleField<std::uint16_t>(header + 10, 0);
+        WriteSingleField<std::uint16_t>(header + 10, IpChksum(header, 20));
+        
+        char new_data[6];
+        std::generate(new_data, new_data+6, std::ref(rbe));
+        
+        auto chksum = IpChksumAccumulator::fromChksum(
+            ReadSingleField<std::uint16_t>(header + 10));
+        chksum.replaceWord(WrapType<std::uint16_t>(),
+            ReadSingleField<std::uint16_t>(header + 2),
+            ReadSingleField<std::uint16_t>(new_data));
+        chksum.replaceWord(WrapType<std::uint32_t>(),
+            ReadSingleField<std::uint32_t>(header + 12),
+            ReadSingleField<std::uint32_t>(new_data + 2));
+        
+        std::memcpy(header + 2, new_data, 2);
+        std::memcpy(header + 12, new_data + 2, 4);
+        WriteSingleField<std::uint16_t>(header + 10, chksum.getChksum());
+        
+        AIPSTACK_ASSERT_FORCE(IpChksum(header, 20) == 0);
+    }
+    
     char buf[BufSize];
     
     for (int iter = 0; iter < Iterations; iter++) {
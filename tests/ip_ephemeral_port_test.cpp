@@ -0,0 +1,88 @@
+
+#include <cstdint>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/misc/SipHash.h>
+#include <aipstack/ip/IpAddr.h>
+#include <aipstack/ip/IpEphemeralPortAllocator.h>
+
+using namespace AIpStack;
+
+namespace aipstack_ip_ephemeral_port_test {
+
+constexpr PortNum PortFirst = 1000;
+constexpr PortNum PortLast = 1099;
+constexpr int NumPorts = PortLast - PortFirst + 1;
+
+static SipHashKey const key{0x0123456789abcdefu, 0xfedcba9876543210u};
+
+static Ip4Addr const local_addr = Ip4Addr(192, 168, 1, 10);
+
+static void testAllocate ()
+{
+    IpEphemeralPortAllocator<PortFirst, PortLast> alloc;
+    bool used[NumPorts] = {};
+    int num_checks = 0;
+    
+    auto is_free = [&](PortNum port) {
+        AIPSTACK_ASSERT_FORCE(port >= PortFirst && port <= PortLast);
+        num_checks++;
+        return !used[port - PortFirst];
+    };
+    
+    // Allocate all ports for one destination; each allocation should
+    // find a free port on the first attempt.
+    Ip4Addr remote_addr = Ip4Addr(10, 0, 0, 1);
+    PortNum first_port = 0;
+    for (int i = 0; i < NumPorts; i++) {
+        num_checks = 0;
+        PortNum port = alloc.allocate(key, local_addr, remote_addr, 80, is_free);
+        AIPSTACK_ASSERT_FORCE(port != 0);
+        AIPSTACK_ASSERT_FORCE(num_checks == 1);
+        used[port - PortFirst] = true;
+        
+        // Ports for the same destination are consecutive.
+        if (i == 0) {
+            first_port = port;
+        } else {
+            AIPSTACK_ASSERT_FORCE(port == PortFirst +
+                (first_port - PortFirst + i) % NumPorts);
+        }
+    }
+    
+    // All ports are in use.
+    AIPSTACK_ASSERT_FORCE(alloc.allocate(key, local_addr, remote_addr, 80, is_free) == 0);
+    
+    // Free one port, it is found.
+    used[17] = false;
+    PortNum port = alloc.allocate(key, local_addr, Ip4Addr(10, 0, 0, 2), 443, is_free);
+    AIPSTACK_ASSERT_FORCE(port == PortFirst + 17);
+}
+
+static void testDestinations ()
+{
+    // Different destinations start at different offsets.
+    IpEphemeralPortAllocator<PortFirst, PortLast> alloc;
+    auto is_free = [](PortNum) { return true; };
+    
+    int num_same = 0;
+    PortNum prev = alloc.allocate(key, local_addr, Ip4Addr(10, 0, 1, 0), 80, is_free);
+    for (std::uint8_t i = 1; i < 20; i++) {
+        PortNum port = alloc.allocate(key, local_addr, Ip4Addr(10, 0, 1, i), 80, is_free);
+        num_same += (port == prev);
+        prev = port;
+    }
+    AIPSTACK_ASSERT_FORCE(num_same < 5);
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_ip_ephemeral_port_test;
+    
+    testAllocate();
+    testDestinations();
+    
+    return 0;
+}
@@ -0,0 +1,181 @@
+
+#include <cstdint>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/misc/Function.h>
+#include <aipstack/ip/IpAddr.h>
+#include <aipstack/proto/Ip4Proto.h>
+#include <aipstack/proto/Udp4Proto.h>
+#include <aipstack/structure/index/AvlTreeIndex.h>
+#include <aipstack/structure/index/HashTableIndex.h>
+#include <aipstack/tcp/IpTcpProto.h>
+#include <aipstack/tcp/TcpApi.h>
+#include <aipstack/udp/IpUdpProto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_listener_index_test {
+
+using HashService = HashTableIndexService<
+    HashTableIndexServiceOptions::NumBuckets::Is<4>>;
+
+template<typename IndexService>
+using Stack = AIpStackTests::TcpUdpTestStack<
+    IpTcpProtoService<IpTcpProtoOptions::PcbIndexService::Is<IndexService>>,
+    IpUdpProtoService<IpUdpProtoOptions::UdpIndexService::Is<IndexService>>>;
+
+static constexpr PortNum ServerPort = 80;
+static constexpr PortNum UdpPort = 5000;
+
+// A SYN goes to the listener bound to its destination address in preference
+// to a wildcard listener on the same port, whichever started listening first.
+// Without the former, the wildcard listener gets it.
+template<typename IndexService>
+static void testTcpExactPreferred (bool wildcard_first)
+{
+    using TheStack = Stack<IndexService>;
+    using TcpArg = typename TheStack::Stack::template GetProtoArg<TcpApi>;
+    using Listener = AIpStackTests::TestListener<TcpArg>;
+    using Peer = AIpStackTests::TcpTestPeer<TheStack>;
+    
+    TheStack stack;
+    Listener exact_lis;
+    Listener wildcard_lis;
+    
+    // Another port, to have more than one port in the index.
+    Listener other_lis;
+    AIPSTACK_ASSERT_FORCE(other_lis.startListening(stack.template api<TcpApi>(),
+        {Ip4Addr::ZeroAddr(), ServerPort + 1, /*max_pcbs=*/4}));
+    
+    auto start_exact = [&]() {
+        AIPSTACK_ASSERT_FORCE(exact_lis.startListening(stack.template api<TcpApi>(),
+            {AIpStackTests::StackAddr, ServerPort, /*max_pcbs=*/4}));
+    };
+    auto start_wildcard = [&]() {
+        AIPSTACK_ASSERT_FORCE(wildcard_lis.startListening(stack.template api<TcpApi>(),
+            {Ip4Addr::ZeroAddr(), ServerPort, /*max_pcbs=*/4}));
+    };
+    if (wildcard_first) {
+        start_wildcard();
+        start_exact();
+    } else {
+        start_exact();
+        start_wildcard();
+    }
+    
+    Peer peer1(stack, 50000, ServerPort);
+    peer1.connect(Peer::mssOptions());
+    peer1.receiveAll();
+    AIPSTACK_ASSERT_FORCE(exact_lis.connections.size() == 1);
+    AIPSTACK_ASSERT_FORCE(wildcard_lis.connections.empty());
+    
+    exact_lis.reset();
+    
+    Peer peer2(stack, 50001, ServerPort);
+    peer2.connect(Peer::mssOptions());
+    peer2.receiveAll();
+    AIPSTACK_ASSERT_FORCE(wildcard_lis.connections.size() == 1);
+    AIPSTACK_ASSERT_FORCE(other_lis.connections.empty());
+}
+
+template<typename IndexService>
+class RecordingUdpListener
+{
+    using UdpArg = typename Stack<IndexService>::Stack::template GetProtoArg<UdpApi>;
+
+public:
+    RecordingUdpListener (Stack<IndexService> &stack, PortNum port, int id,
+                          std::vector<int> &order) :
+        m_lis(AIPSTACK_BIND_MEMBER_TN(&RecordingUdpListener::handler, this)),
+        m_id(id),
+        m_order(order)
+    {
+        UdpListenParams<UdpArg> params;
+        params.port = port;
+        AIPSTACK_ASSERT_FORCE(m_lis.startListening(stack.template api<UdpApi>(), params) ==
+                              IpErr::Success);
+    }
+
+private:
+    UdpRecvResult handler (IpRxInfoIp4<typename UdpArg::StackArg> const &,
+                           UdpRxInfo<UdpArg> const &, IpBufRef)
+    {
+        m_order.push_back(m_id);
+        return UdpRecvResult::AcceptContinue;
+    }
+
+private:
+    UdpListener<UdpArg> m_lis;
+    int m_id;
+    std::vector<int> &m_order;
+};
+
+static std::vector<char> makeUdpPacket (PortNum dst_port)
+{
+    std::vector<char> udp(Udp4Header::Size);
+    auto udp_header = Udp4Header::MakeRef(udp.data());
+    udp_header.set(Udp4Header::SrcPort(), 4000);
+    udp_header.set(Udp4Header::DstPort(), dst_port);
+    udp_header.set(Udp4Header::Length(), std::uint16_t(udp.size()));
+    udp_header.set(Udp4Header::Checksum(), 0);
+    
+    return AIpStackTests::makeIp4Packet(AIpStackTests::PeerAddr,
+        AIpStackTests::StackAddr, Ip4Protocol::Udp, udp);
+}
+
+// A datagram is offered to the listeners on its port before those on all
+// ports, even though the latter started listening first. Listeners on other
+// ports are not involved.
+template<typename IndexService>
+static void testUdpAllPortsLast ()
+{
+    using Listener = RecordingUdpListener<IndexService>;
+    
+    Stack<IndexService> stack;
+    std::vector<int> order;
+    
+    Listener any_lis1(stack, 0, 1, order);
+    Listener port_lis1(stack, UdpPort, 2, order);
+    Listener other_lis(stack, UdpPort + 1, 3, order);
+    Listener any_lis2(stack, 0, 4, order);
+    Listener port_lis2(stack, UdpPort, 5, order);
+    
+    stack.receive(makeUdpPacket(UdpPort));
+    
+    AIPSTACK_ASSERT_FORCE(order.size() == 4);
+    AIPSTACK_ASSERT_FORCE((order[0] == 2 && order[1] == 5) ||
+                          (order[0] == 5 && order[1] == 2));
+    AIPSTACK_ASSERT_FORCE((order[2] == 1 && order[3] == 4) ||
+                          (order[2] == 4 && order[3] == 1));
+    
+    // A datagram to a port without a port listener goes to all-ports
+    // listeners only.
+    order.clear();
+    stack.receive(makeUdpPacket(UdpPort + 2));
+    AIPSTACK_ASSERT_FORCE(order.size() == 2);
+    AIPSTACK_ASSERT_FORCE((order[0] == 1 && order[1] == 4) ||
+                          (order[0] == 4 && order[1] == 1));
+}
+
+template<typename IndexService>
+static void testIndexService ()
+{
+    testTcpExactPreferred<IndexService>(false);
+    testTcpExactPreferred<IndexService>(true);
+    testUdpAllPortsLast<IndexService>();
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_listener_index_test;
+    
+    testIndexService<AvlTreeIndexService>();
+    testIndexService<HashService>();
+    
+    return 0;
+}
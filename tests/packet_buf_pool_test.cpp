@@ -0,0 +1,84 @@
+
+#include <cstddef>
+#include <cstring>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/infra/Buf.h>
+#include <aipstack/infra/PacketBufPool.h>
+
+using namespace AIpStack;
+
+namespace aipstack_packet_buf_pool_test {
+
+constexpr std::size_t NumBufs = 4;
+constexpr std::size_t BufSize = 100;
+
+static IpPacketBuf bufs[NumBufs];
+static char mem[NumBufs * BufSize];
+
+}
+
+int main ()
+{
+    using namespace aipstack_packet_buf_pool_test;
+
+    IpPacketBufPool pool(bufs, NumBufs, mem, BufSize);
+    AIPSTACK_ASSERT_FORCE(pool.getBufSize() == BufSize);
+
+    // Allocate all buffers, then allocation fails.
+    IpPacketBuf *alloced[NumBufs];
+    for (std::size_t i = 0; i < NumBufs; i++) {
+        alloced[i] = pool.alloc();
+        AIPSTACK_ASSERT_FORCE(alloced[i] != nullptr);
+        AIPSTACK_ASSERT_FORCE(alloced[i]->getRefCount() == 1);
+        AIPSTACK_ASSERT_FORCE(alloced[i]->getNode()->len == BufSize);
+        AIPSTACK_ASSERT_FORCE(pool.findBuf(alloced[i]->getNode()) == alloced[i]);
+    }
+    AIPSTACK_ASSERT_FORCE(pool.alloc() == nullptr);
+
+    IpPacketBufPoolStats stats = pool.getStats();
+    AIPSTACK_ASSERT_FORCE(stats.num_bufs == NumBufs);
+    AIPSTACK_ASSERT_FORCE(stats.num_free == 0);
+    AIPSTACK_ASSERT_FORCE(stats.min_free == 0);
+    AIPSTACK_ASSERT_FORCE(stats.alloc_failures == 1);
+
+    // Write a packet and retain a part of it (as a protocol would, with the
+    // header hidden) beyond the release by the "driver".
+    IpPacketBuf *pkt_buf = alloced[1];
+    std::memcpy(pkt_buf->getNode()->ptr, "HDRpayload", 10);
+    IpBufRef pkt = pkt_buf->getBufRef(10).hideHeader(3);
+
+    IpPacketBuf *retained = pool.takeRef(pkt);
+    AIPSTACK_ASSERT_FORCE(retained == pkt_buf);
+    AIPSTACK_ASSERT_FORCE(retained->getRefCount() == 2);
+
+    for (std::size_t i = 0; i < NumBufs; i++) {
+        pool.unref(*alloced[i]);
+    }
+    AIPSTACK_ASSERT_FORCE(pool.getStats().num_free == NumBufs - 1);
+    AIPSTACK_ASSERT_FORCE(std::memcmp(pkt.getChunkPtr(), "payload", 7) == 0);
+
+    // Data not in the pool (or with an unrelated node) cannot be retained.
+    char other[10];
+    IpBufNode other_node{other, sizeof(other), nullptr};
+    AIPSTACK_ASSERT_FORCE(pool.takeRef(IpBufRef{&other_node, 0, sizeof(other)}) == nullptr);
+    AIPSTACK_ASSERT_FORCE(pool.findBuf(&other_node) == nullptr);
+
+    // Data extending beyond the buffer (into other nodes) cannot be retained.
+    AIPSTACK_ASSERT_FORCE(
+        pool.takeRef(IpBufRef{pkt_buf->getNode(), 5, BufSize - 4}) == nullptr);
+
+    // Free buffers cannot be retained.
+    AIPSTACK_ASSERT_FORCE(pool.takeRef(alloced[0]->getBufRef(1)) == nullptr);
+
+    // Releasing the last reference returns the buffer to the pool.
+    pool.unref(*retained);
+    AIPSTACK_ASSERT_FORCE(pool.getStats().num_free == NumBufs);
+
+    pool.resetStats();
+    stats = pool.getStats();
+    AIPSTACK_ASSERT_FORCE(stats.min_free == NumBufs);
+    AIPSTACK_ASSERT_FORCE(stats.alloc_failures == 0);
+
+    return 0;
+}
@@ -0,0 +1,834 @@
+
+#ifndef AIPSTACK_STACK_TEST_HARNESS_H
+#define AIPSTACK_STACK_TEST_HARNESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/misc/NonCopyable.h>
+#include <aipstack/misc/Function.h>
+#include <aipstack/misc/MinMax.h>
+#include <aipstack/meta/TypeList.h>
+#include <aipstack/infra/Buf.h>
+#include <aipstack/infra/Chksum.h>
+#include <aipstack/infra/Err.h>
+#include <aipstack/infra/PacketBufPool.h>
+#include <aipstack/proto/Ip4Proto.h>
+#include <aipstack/proto/Tcp4Proto.h>
+#include <aipstack/proto/Udp4Proto.h>
+#include <aipstack/platform/PlatformFacade.h>
+#include <aipstack/structure/index/AvlTreeIndex.h>
+#include <aipstack/ip/IpAddr.h>
+#include <aipstack/ip/IpStackTypes.h>
+#include <aipstack/ip/IpStack.h>
+#include <aipstack/ip/IpDriverIface.h>
+#include <aipstack/ip/IpPathMtuCache.h>
+#include <aipstack/ip/IpReassembly.h>
+#include <aipstack/tcp/IpTcpProto.h>
+#include <aipstack/tcp/TcpApi.h>
+#include <aipstack/tcp/TcpOptions.h>
+#include <aipstack/udp/IpUdpProto.h>
+
+/**
+ * Shared helpers for tests which run a complete @ref AIpStack::IpStack.
+ *
+ * The stack runs on a platform with a manually advanced clock and a single
+ * interface whose transmitted packets are captured, so that a test can play the
+ * remote side of a conversation by injecting packets and inspecting the replies.
+ */
+namespace AIpStackTests {
+
+using namespace AIpStack;
+
+/**
+ * Platform implementation with a clock which only moves when told to.
+ *
+ * Timers fire from @ref advance, in the order of their expiration times.
+ */
+class TestPlatformImpl :
+    private NonCopyable<TestPlatformImpl>
+{
+public:
+    using ThePlatformRef = PlatformRef<TestPlatformImpl>;
+    
+    inline static constexpr bool ImplIsStatic = false;
+    
+    using TimeType = std::uint64_t;
+    
+    inline static constexpr double TimeFreq = 1000.0;
+    
+    inline static constexpr TimeType RelativeTimeLimit = TypeMax<TimeType>;
+    
+    TimeType getTime ()
+    {
+        return m_now;
+    }
+    
+    TimeType getEventTime ()
+    {
+        return m_now;
+    }
+    
+    class Timer :
+        private ThePlatformRef,
+        private NonCopyable<Timer>
+    {
+        friend class TestPlatformImpl;
+    
+    public:
+        using TimerHandler = Function<void()>;
+        
+        Timer (ThePlatformRef ref, TimerHandler handler) :
+            ThePlatformRef(ref),
+            m_handler(handler),
+            m_is_set(false),
+            m_set_time(0)
+        {
+            ref.platformImpl()->m_timers.push_back(this);
+        }
+        
+        ~Timer ()
+        {
+            auto &timers = ThePlatformRef::platformImpl()->m_timers;
+            timers.erase(std::find(timers.begin(), timers.end(), this));
+        }
+        
+        inline ThePlatformRef ref () const
+        {
+            return ThePlatformRef::ref();
+        }
+        
+        inline bool isSet () const
+        {
+            return m_is_set;
+        }
+        
+        inline TimeType getSetTime () const
+        {
+            return m_set_time;
+        }
+        
+        void unset ()
+        {
+            m_is_set = false;
+        }
+        
+        void setAt (TimeType abs_time)
+        {
+            m_is_set = true;
+            m_set_time = abs_time;
+        }
+    
+    private:
+        TimerHandler m_handler;
+        bool m_is_set;
+        TimeType m_set_time;
+    };
+    
+    /**
+     * Move the clock forward by the given number of milliseconds, dispatching
+     * the timers which expire on the way (including those already due).
+     */
+    void advance (TimeType ticks)
+    {
+        TimeType end_time = m_now + ticks;
+        
+        while (Timer *timer = nextTimer(end_time)) {
+            m_now = std::max(m_now, timer->m_set_time);
+            timer->m_is_set = false;
+            timer->m_handler();
+        }
+        
+        m_now = end_time;
+    }
+    
+    /**
+     * Dispatch timers which are due without moving the clock.
+     */
+    void dispatch ()
+    {
+        advance(0);
+    }
+
+private:
+    Timer * nextTimer (TimeType end_time) const
+    {
+        Timer *first = nullptr;
+        for (Timer *timer : m_timers) {
+            if (timer->m_is_set && timer->m_set_time <= end_time &&
+                (first == nullptr || timer->m_set_time < first->m_set_time))
+            {
+                first = timer;
+            }
+        }
+        return first;
+    }
+
+private:
+    // Start away from zero so that times in the past do not wrap.
+    TimeType m_now = 1000000;
+    std::vector<Timer *> m_timers;
+};
+
+using TestPlatform = PlatformFacade<TestPlatformImpl>;
+
+/**
+ * Address of the interface of the stack under test.
+ */
+inline constexpr Ip4Addr StackAddr = Ip4Addr(192, 168, 1, 1);
+
+/**
+ * Address used for the remote side played by the test.
+ */
+inline constexpr Ip4Addr PeerAddr = Ip4Addr(192, 168, 1, 100);
+
+/**
+ * Interface parameters for @ref TestStack.
+ */
+struct TestIfaceParams {
+    std::size_t ip_mtu = 1500;
+    IpChksumFlags tx_chksum_offload = IpChksumFlags();
+    bool rx_burst_end = false;
+    IpPacketBufPool *rx_pool = nullptr;
+};
+
+/**
+ * IP stack with the given protocols and one interface at @ref StackAddr/24.
+ *
+ * Packets sent by the stack are appended to @ref sent as copies starting at
+ * the IP header.
+ */
+template<typename ProtocolServicesList>
+class TestStack :
+    private NonCopyable<TestStack<ProtocolServicesList>>
+{
+    using StackService = IpStackService<
+        IpStackOptions::PathMtuCacheService::Is<
+            IpPathMtuCacheService<
+                IpPathMtuCacheOptions::NumMtuEntries::Is<16>,
+                IpPathMtuCacheOptions::MtuIndexService::Is<AvlTreeIndexService>
+            >
+        >,
+        IpStackOptions::ReassemblyService::Is<IpReassemblyService<>>
+    >;
+
+public:
+    class StackArg :
+        public StackService::template Compose<TestPlatformImpl, ProtocolServicesList> {};
+    
+    using Stack = IpStack<StackArg>;
+    
+    TestStack (TestIfaceParams const &params = TestIfaceParams()) :
+        m_stack(TestPlatform(&m_platform_impl)),
+        m_iface(&m_stack, makeDriverParams(params))
+    {
+        m_iface.iface().setIp4Addr(IpIfaceIp4AddrSetting(24, StackAddr));
+    }
+    
+    inline TestPlatformImpl & platformImpl ()
+    {
+        return m_platform_impl;
+    }
+    
+    inline Stack & stack ()
+    {
+        return m_stack;
+    }
+    
+    inline IpIface<StackArg> & iface ()
+    {
+        return m_iface.iface();
+    }
+    
+    template<template<typename> class ProtoApi>
+    inline ProtoApi<typename Stack::template GetProtoArg<ProtoApi>> & api ()
+    {
+        return m_stack.template getProtoApi<ProtoApi>();
+    }
+    
+    /**
+     * Pass a packet (starting at the IP header) to the stack as received
+     * by the interface, then dispatch any timers which became due.
+     */
+    void receive (std::vector<char> pkt)
+    {
+        IpBufNode node{pkt.data(), pkt.size(), nullptr};
+        m_iface.recvIp4Packet(IpBufRef{&node, 0, pkt.size()});
+        m_platform_impl.dispatch();
+    }
+    
+    /**
+     * Like @ref receive but for a packet in a buffer provided by the caller.
+     */
+    void receiveBuf (IpBufRef pkt)
+    {
+        m_iface.recvIp4Packet(pkt);
+        m_platform_impl.dispatch();
+    }
+    
+    /**
+     * Like @ref receive but without dispatching timers, for packets which
+     * are part of one receive burst.
+     */
+    void receiveInBurst (std::vector<char> pkt)
+    {
+        IpBufNode node{pkt.data(), pkt.size(), nullptr};
+        m_iface.recvIp4Packet(IpBufRef{&node, 0, pkt.size()});
+    }
+    
+    /**
+     * Report the end of a receive burst, then dispatch due timers.
+     */
+    void burstEnd ()
+    {
+        m_iface.recvBurstEnd();
+        m_platform_impl.dispatch();
+    }
+    
+    void advance (TestPlatformImpl::TimeType ticks)
+    {
+        m_platform_impl.advance(ticks);
+    }
+    
+    void dispatch ()
+    {
+        m_platform_impl.dispatch();
+    }
+    
+    /**
+     * Return the captured packets and clear the capture.
+     */
+    std::vector<std::vector<char>> takeSent ()
+    {
+        std::vector<std::vector<char>> pkts;
+        pkts.swap(sent);
+        return pkts;
+    }
+    
+    std::vector<std::vector<char>> sent;
+
+private:
+    IpIfaceDriverParams makeDriverParams (TestIfaceParams const &params)
+    {
+        IpIfaceDriverParams drv;
+        drv.ip_mtu = params.ip_mtu;
+        drv.send_ip4_packet = AIPSTACK_BIND_MEMBER_TN(&TestStack::sendIp4Packet, this);
+        drv.get_state = AIPSTACK_BIND_MEMBER_TN(&TestStack::getState, this);
+        drv.tx_chksum_offload = params.tx_chksum_offload;
+        drv.rx_burst_end = params.rx_burst_end;
+        drv.rx_pool = params.rx_pool;
+        return drv;
+    }
+    
+    IpErr sendIp4Packet (IpBufRef pkt, Ip4Addr, IpSendRetryRequest *)
+    {
+        std::vector<char> data(pkt.tot_len);
+        ipBufTakeBytes(pkt, data.size(), data.data());
+        sent.push_back(std::move(data));
+        return IpErr::Success;
+    }
+    
+    IpIfaceDriverState getState ()
+    {
+        return IpIfaceDriverState();
+    }
+
+private:
+    TestPlatformImpl m_platform_impl;
+    Stack m_stack;
+    IpDriverIface<StackArg> m_iface;
+};
+
+/**
+ * Stack with TCP and UDP using the given protocol services.
+ */
+template<typename TcpService, typename UdpService = IpUdpProtoService<
+    IpUdpProtoOptions::UdpIndexService::Is<AvlTreeIndexService>>>
+using TcpUdpTestStack = TestStack<MakeTypeList<TcpService, UdpService>>;
+
+/**
+ * Stack with TCP using the AVL tree PCB index and the given additional TCP
+ * options, and UDP with the default options.
+ */
+template<typename... TcpOptions>
+using TcpTestStack = TcpUdpTestStack<IpTcpProtoService<
+    IpTcpProtoOptions::PcbIndexService::Is<AvlTreeIndexService>, TcpOptions...>>;
+
+/**
+ * Build an IPv4 packet without options around the given payload.
+ */
+inline std::vector<char> makeIp4Packet (Ip4Addr src_addr, Ip4Addr dst_addr,
+    Ip4Protocol proto, std::vector<char> const &payload,
+    Ip4Flags flags_offset = Ip4Flags(), std::uint16_t ident = 0)
+{
+    std::vector<char> pkt(Ip4Header::Size + payload.size());
+    auto ip4_header = Ip4Header::MakeRef(pkt.data());
+    ip4_header.set(Ip4Header::VersionIhlDscpEcn(), (4 << 12) | (5 << 8));
+    ip4_header.set(Ip4Header::TotalLen(), std::uint16_t(pkt.size()));
+    ip4_header.set(Ip4Header::Ident(), ident);
+    ip4_header.set(Ip4Header::FlagsOffset(), flags_offset);
+    ip4_header.set(Ip4Header::Ttl(), 64);
+    ip4_header.set(Ip4Header::Proto(), proto);
+    ip4_header.set(Ip4Header::HeaderChksum(), 0);
+    ip4_header.set(Ip4Header::SrcAddr(), src_addr);
+    ip4_header.set(Ip4Header::DstAddr(), dst_addr);
+    ip4_header.set(Ip4Header::HeaderChksum(), IpChksum(pkt.data(), Ip4Header::Size));
+    std::memcpy(pkt.data() + Ip4Header::Size, payload.data(), payload.size());
+    return pkt;
+}
+
+/**
+ * Compute the TCP/UDP checksum of a transport segment including the
+ * pseudo-header.
+ */
+inline std::uint16_t transportChksum (Ip4Addr src_addr, Ip4Addr dst_addr,
+    Ip4Protocol proto, char const *data, std::size_t len)
+{
+    std::vector<char> buf(12 + len);
+    WriteSingleField<Ip4Addr>(buf.data() + 0, src_addr);
+    WriteSingleField<Ip4Addr>(buf.data() + 4, dst_addr);
+    WriteSingleField<std::uint16_t>(buf.data() + 8, std::uint16_t(proto));
+    WriteSingleField<std::uint16_t>(buf.data() + 10, std::uint16_t(len));
+    std::memcpy(buf.data() + 12, data, len);
+    return IpChksum(buf.data(), buf.size());
+}
+
+/**
+ * Decoded IPv4 header fields of a captured packet.
+ */
+struct Ip4Info {
+    Ip4Addr src_addr;
+    Ip4Addr dst_addr;
+    Ip4Protocol proto;
+    Ip4Flags flags_offset;
+    std::uint16_t ident;
+};
+
+/**
+ * Parse the IPv4 header of a captured packet, verifying its checksum and
+ * length, and return the payload.
+ */
+inline std::vector<char> parseIp4Packet (std::vector<char> pkt, Ip4Info &info)
+{
+    AIPSTACK_ASSERT_FORCE(pkt.size() >= Ip4Header::Size);
+    AIPSTACK_ASSERT_FORCE(IpChksum(pkt.data(), Ip4Header::Size) == 0);
+    auto ip4_header = Ip4Header::MakeRef(pkt.data());
+    AIPSTACK_ASSERT_FORCE(ip4_header.get(Ip4Header::TotalLen()) == pkt.size());
+    info.src_addr = ip4_header.get(Ip4Header::SrcAddr());
+    info.dst_addr = ip4_header.get(Ip4Header::DstAddr());
+    info.proto = ip4_header.get(Ip4Header::Proto());
+    info.flags_offset = ip4_header.get(Ip4Header::FlagsOffset());
+    info.ident = ip4_header.get(Ip4Header::Ident());
+    return std::vector<char>(pkt.begin() + Ip4Header::Size, pkt.end());
+}
+
+/**
+ * A TCP segment as built by the test or parsed from the stack output.
+ */
+struct TcpSegment {
+    Ip4Addr src_addr = PeerAddr;
+    Ip4Addr dst_addr = StackAddr;
+    PortNum src_port = 0;
+    PortNum dst_port = 0;
+    TcpSeqNum seq_num;
+    TcpSeqNum ack_num;
+    Tcp4Flags flags = Tcp4Flags();
+    std::uint16_t window_size = 0xFFFF;
+    TcpOptions opts = TcpOptions();
+    std::vector<char> data;
+    
+    inline bool has (Tcp4Flags flag) const
+    {
+        return (flags & flag) != Enum0;
+    }
+    
+    inline bool hasOption (TcpOptionFlags option) const
+    {
+        return (opts.options & option) != Enum0;
+    }
+    
+    // Length in sequence space.
+    inline TcpSeqInt seqLen () const
+    {
+        return TcpSeqInt(data.size()) + has(Tcp4Flags::Syn) + has(Tcp4Flags::Fin);
+    }
+};
+
+/**
+ * Build the IP packet carrying the given TCP segment.
+ */
+inline std::vector<char> makeTcpPacket (TcpSegment const &seg)
+{
+    std::uint8_t opts_len = CalcTcpOptionsLength(seg.opts);
+    std::size_t hdr_len = Tcp4Header::Size + opts_len;
+    std::vector<char> tcp(hdr_len + seg.data.size());
+    
+    auto tcp_header = Tcp4Header::MakeRef(tcp.data());
+    tcp_header.set(Tcp4Header::SrcPort(), seg.src_port);
+    tcp_header.set(Tcp4Header::DstPort(), seg.dst_port);
+    tcp_header.set(Tcp4Header::SeqNum(), seg.seq_num);
+    tcp_header.set(Tcp4Header::AckNum(), seg.ack_num);
+    tcp_header.set(Tcp4Header::OffsetFlags(),
+        Tcp4EncodeOffset(std::uint8_t(hdr_len / 4)) | seg.flags);
+    tcp_header.set(Tcp4Header::WindowSize(), seg.window_size);
+    tcp_header.set(Tcp4Header::Checksum(), 0);
+    tcp_header.set(Tcp4Header::UrgentPtr(), 0);
+    WriteTcpOptions(seg.opts, tcp.data() + Tcp4Header::Size);
+    if (!seg.data.empty()) {
+        std::memcpy(tcp.data() + hdr_len, seg.data.data(), seg.data.size());
+    }
+    
+    tcp_header.set(Tcp4Header::Checksum(), transportChksum(
+        seg.src_addr, seg.dst_addr, Ip4Protocol::Tcp, tcp.data(), tcp.size()));
+    
+    return makeIp4Packet(seg.src_addr, seg.dst_addr, Ip4Protocol::Tcp, tcp);
+}
+
+/**
+ * Parse a captured packet as a TCP segment, verifying the checksums.
+ * Returns false if the packet is not TCP.
+ */
+inline bool parseTcpPacket (std::vector<char> const &pkt, TcpSegment &seg)
+{
+    Ip4Info ip_info;
+    std::vector<char> tcp = parseIp4Packet(pkt, ip_info);
+    if (ip_info.proto != Ip4Protocol::Tcp) {
+        return false;
+    }
+    
+    AIPSTACK_ASSERT_FORCE(tcp.size() >= Tcp4Header::Size);
+    AIPSTACK_ASSERT_FORCE(transportChksum(ip_info.src_addr, ip_info.dst_addr,
+        Ip4Protocol::Tcp, tcp.data(), tcp.size()) == 0);
+    
+    auto tcp_header = Tcp4Header::MakeRef(tcp.data());
+    Tcp4Flags offset_flags = tcp_header.get(Tcp4Header::OffsetFlags());
+    std::size_t hdr_len = 4 * (AsUnderlying(offset_flags) >> TcpOffsetShift);
+    AIPSTACK_ASSERT_FORCE(hdr_len >= Tcp4Header::Size && hdr_len <= tcp.size());
+    
+    seg = TcpSegment();
+    seg.src_addr = ip_info.src_addr;
+    seg.dst_addr = ip_info.dst_addr;
+    seg.src_port = tcp_header.get(Tcp4Header::SrcPort());
+    seg.dst_port = tcp_header.get(Tcp4Header::DstPort());
+    seg.seq_num = tcp_header.get(Tcp4Header::SeqNum());
+    seg.ack_num = tcp_header.get(Tcp4Header::AckNum());
+    seg.flags = offset_flags & ~Tcp4Flags(0xF000);
+    seg.window_size = tcp_header.get(Tcp4Header::WindowSize());
+    
+    std::size_t opts_len = hdr_len - Tcp4Header::Size;
+    IpBufNode opts_node{tcp.data() + Tcp4Header::Size, opts_len, nullptr};
+    ParseTcpOptions(IpBufRef{&opts_node, 0, opts_len}, seg.opts);
+    
+    seg.data.assign(tcp.begin() + std::ptrdiff_t(hdr_len), tcp.end());
+    return true;
+}
+
+/**
+ * Parse all captured packets as TCP segments (all must be TCP).
+ */
+inline std::vector<TcpSegment> parseTcpPackets (
+    std::vector<std::vector<char>> const &pkts)
+{
+    std::vector<TcpSegment> segs;
+    for (auto const &pkt : pkts) {
+        TcpSegment seg;
+        AIPSTACK_ASSERT_FORCE(parseTcpPacket(pkt, seg));
+        segs.push_back(std::move(seg));
+    }
+    return segs;
+}
+
+/**
+ * TCP connection with ring buffers, which consumes received data right away
+ * and records the events reported to it.
+ */
+template<typename TcpArg>
+class TestConnection :
+    public TcpConnection<TcpArg>
+{
+public:
+    inline static constexpr std::size_t BufSize = 65536;
+    
+    TestConnection () :
+        m_rx_buf(BufSize),
+        m_tx_buf(BufSize),
+        m_rx_node{m_rx_buf.data(), BufSize, &m_rx_node},
+        m_tx_node{m_tx_buf.data(), BufSize, &m_tx_node}
+    {
+    }
+    
+    /**
+     * Set up the buffers, after the connection was accepted or started.
+     */
+    void setupBuffers (std::size_t rcv_buf_size = BufSize)
+    {
+        TcpConnection<TcpArg>::setRecvBuf(IpBufRef{&m_rx_node, 0, rcv_buf_size});
+        TcpConnection<TcpArg>::setSendBuf(IpBufRef{&m_tx_node, 0, 0});
+    }
+    
+    /**
+     * Queue the given amount of data for sending (and push it).
+     */
+    void send (std::size_t amount, bool push = true)
+    {
+        TcpConnection<TcpArg>::extendSendBuf(amount);
+        if (push) {
+            TcpConnection<TcpArg>::sendPush();
+        }
+    }
+    
+    bool aborted = false;
+    bool established = false;
+    bool end_received = false;
+    std::size_t received = 0;
+    std::size_t acked = 0;
+
+private:
+    void connectionAborted () override final
+    {
+        aborted = true;
+    }
+    
+    void connectionEstablished () override final
+    {
+        established = true;
+    }
+    
+    void dataReceived (std::size_t amount) override final
+    {
+        if (amount == 0) {
+            end_received = true;
+        } else {
+            received += amount;
+            TcpConnection<TcpArg>::extendRecvBuf(amount);
+        }
+    }
+    
+    void dataSent (std::size_t amount) override final
+    {
+        acked += amount;
+    }
+
+private:
+    std::vector<char> m_rx_buf;
+    std::vector<char> m_tx_buf;
+    IpBufNode m_rx_node;
+    IpBufNode m_tx_node;
+};
+
+/**
+ * Listener which accepts every connection into a new @ref TestConnection.
+ */
+template<typename TcpArg>
+class TestListener :
+    public TcpListener<TcpArg>
+{
+public:
+    TestListener () :
+        TcpListener<TcpArg>(AIPSTACK_BIND_MEMBER_TN(&TestListener::established, this))
+    {
+    }
+    
+    std::vector<std::unique_ptr<TestConnection<TcpArg>>> connections;
+    
+    // If false, connections are not accepted (they stay with the listener).
+    bool accept = true;
+
+private:
+    void established ()
+    {
+        if (!accept) {
+            return;
+        }
+        auto con = std::make_unique<TestConnection<TcpArg>>();
+        AIPSTACK_ASSERT_FORCE(con->acceptConnection(*this) == IpErr::Success);
+        con->setupBuffers();
+        connections.push_back(std::move(con));
+    }
+};
+
+/**
+ * Plays the remote end of one TCP connection.
+ *
+ * It keeps the remote sequence state (@ref snd_nxt for what it sends and
+ * @ref rcv_nxt for what it has received in order) and builds segments with it.
+ */
+template<typename TheTestStack>
+class TcpTestPeer
+{
+public:
+    TcpTestPeer (TheTestStack &stack, PortNum local_port_, PortNum remote_port_,
+                 TcpSeqNum iss = TcpSeqNum(0x10000000u)) :
+        m_stack(stack),
+        local_port(local_port_),
+        remote_port(remote_port_),
+        snd_nxt(iss)
+    {
+    }
+    
+    /**
+     * Make a segment from the peer with the current sequence numbers.
+     */
+    TcpSegment segment (Tcp4Flags flags, std::size_t data_len = 0) const
+    {
+        TcpSegment seg;
+        seg.src_port = local_port;
+        seg.dst_port = remote_port;
+        seg.seq_num = snd_nxt;
+        seg.ack_num = rcv_nxt;
+        seg.flags = flags;
+        seg.window_size = window_size;
+        seg.data.assign(data_len, 'x');
+        return seg;
+    }
+    
+    /**
+     * Send a segment and advance @ref snd_nxt by its length.
+     */
+    void send (TcpSegment const &seg)
+    {
+        snd_nxt = seg.seq_num + seg.seqLen();
+        m_stack.receive(makeTcpPacket(seg));
+    }
+    
+    void sendAck ()
+    {
+        send(segment(Tcp4Flags::Ack));
+    }
+    
+    void sendAck (TcpSeqNum ack_num)
+    {
+        TcpSegment seg = segment(Tcp4Flags::Ack);
+        seg.ack_num = ack_num;
+        send(seg);
+    }
+    
+    void sendData (std::size_t len)
+    {
+        send(segment(Tcp4Flags::Ack|Tcp4Flags::Psh, len));
+    }
+    
+    /**
+     * Active open towards a listener: send a SYN with the given options,
+     * expect the SYN-ACK and complete the handshake.
+     */
+    TcpSegment connect (TcpOptions const &syn_opts, bool complete = true)
+    {
+        TcpSegment syn = segment(Tcp4Flags::Syn);
+        syn.opts = syn_opts;
+        send(syn);
+        
+        std::vector<TcpSegment> out = receiveAll();
+        AIPSTACK_ASSERT_FORCE(out.size() == 1);
+        TcpSegment const &syn_ack = out[0];
+        AIPSTACK_ASSERT_FORCE(syn_ack.has(Tcp4Flags::Syn|Tcp4Flags::Ack));
+        AIPSTACK_ASSERT_FORCE(syn_ack.ack_num == snd_nxt);
+        rcv_nxt = syn_ack.seq_num + TcpSeqInt(1);
+        
+        if (complete) {
+            sendAck();
+        }
+        return syn_ack;
+    }
+    
+    /**
+     * Take the captured segments, all of which must belong to this connection,
+     * and advance @ref rcv_nxt over in-order data and FIN.
+     */
+    std::vector<TcpSegment> receiveAll ()
+    {
+        std::vector<TcpSegment> segs = parseTcpPackets(m_stack.takeSent());
+        for (TcpSegment const &seg : segs) {
+            AIPSTACK_ASSERT_FORCE(seg.src_port == remote_port);
+            AIPSTACK_ASSERT_FORCE(seg.dst_port == local_port);
+            if (seg.seq_num == rcv_nxt && !seg.has(Tcp4Flags::Syn)) {
+                rcv_nxt += seg.seqLen();
+            }
+        }
+        return segs;
+    }
+    
+    /**
+     * Basic MSS-only SYN options.
+     */
+    static TcpOptions mssOptions (std::uint16_t mss = 1460)
+    {
+        TcpOptions opts = TcpOptions();
+        opts.options = TcpOptionFlags::Mss;
+        opts.mss = mss;
+        return opts;
+    }
+
+private:
+    TheTestStack &m_stack;
+
+public:
+    PortNum local_port;
+    PortNum remote_port;
+    TcpSeqNum snd_nxt;
+    TcpSeqNum rcv_nxt;
+    std::uint16_t window_size = 0xFFFF;
+};
+
+/**
+ * Stack with a listener on @ref ServerPort and a @ref TcpTestPeer which
+ * connects to it from @ref PeerPort.
+ */
+template<typename TheTestStack>
+class TcpServerFixture
+{
+public:
+    using Stack = TheTestStack;
+    using TcpArg = typename Stack::Stack::template GetProtoArg<TcpApi>;
+    using Peer = TcpTestPeer<Stack>;
+    
+    inline static constexpr PortNum ServerPort = 80;
+    inline static constexpr PortNum PeerPort = 50000;
+    
+    TcpServerFixture (TestIfaceParams const &params = TestIfaceParams(),
+                      int max_pcbs = 1) :
+        stack(params),
+        peer(stack, PeerPort, ServerPort)
+    {
+        AIPSTACK_ASSERT_FORCE(lis.startListening(stack.template api<TcpApi>(),
+            {StackAddr, ServerPort, max_pcbs}));
+    }
+    
+    /**
+     * Connect the peer with the given SYN options and check that the
+     * connection was accepted. If @p handshake_rtt is nonzero, the handshake
+     * is completed after that many ticks, giving the stack an RTT sample.
+     * Returns the SYN-ACK.
+     */
+    TcpSegment accept (TcpOptions const &syn_opts = Peer::mssOptions(),
+                       std::uint64_t handshake_rtt = 0)
+    {
+        TcpSegment syn_ack = peer.connect(syn_opts, /*complete=*/false);
+        stack.advance(handshake_rtt);
+        peer.sendAck();
+        peer.receiveAll();
+        AIPSTACK_ASSERT_FORCE(lis.connections.size() == 1);
+        return syn_ack;
+    }
+    
+    /**
+     * The first accepted connection.
+     */
+    TestConnection<TcpArg> & con ()
+    {
+        return *lis.connections[0];
+    }
+    
+    Stack stack;
+    TestListener<TcpArg> lis;
+    Peer peer;
+};
+
+}
+
+#endif
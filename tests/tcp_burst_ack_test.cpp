@@ -0,0 +1,162 @@
+
+#include <cstddef>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/tcp/IpTcpProto.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/proto/Tcp4Proto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_burst_ack_test {
+
+using Stack = AIpStackTests::TcpTestStack<>;
+using Server = AIpStackTests::TcpServerFixture<Stack>;
+using Peer = AIpStackTests::TcpTestPeer<Stack>;
+using Segment = AIpStackTests::TcpSegment;
+
+static constexpr std::size_t SegLen = 500;
+
+static AIpStackTests::TestIfaceParams burstParams ()
+{
+    AIpStackTests::TestIfaceParams params;
+    params.rx_burst_end = true;
+    return params;
+}
+
+// Pass a segment from the peer to the stack as part of a receive burst.
+static void sendInBurst (Stack &stack, Peer &peer, Segment const &seg)
+{
+    peer.snd_nxt = seg.seq_num + seg.seqLen();
+    stack.receiveInBurst(AIpStackTests::makeTcpPacket(seg));
+}
+
+static void sendDataInBurst (Stack &stack, Peer &peer)
+{
+    sendInBurst(stack, peer, peer.segment(Tcp4Flags::Ack|Tcp4Flags::Psh, SegLen));
+}
+
+// The ACKs for the data received in a burst are combined into one ACK which
+// is sent at the end of the burst.
+static void testAckAtBurstEnd ()
+{
+    Server s(burstParams(), /*max_pcbs=*/4);
+    s.accept();
+    Peer &peer = s.peer;
+    
+    for (int i = 0; i < 4; i++) {
+        sendDataInBurst(s.stack, peer);
+    }
+    AIPSTACK_ASSERT_FORCE(s.stack.sent.empty());
+    AIPSTACK_ASSERT_FORCE(s.con().received == 4 * SegLen);
+    
+    s.stack.burstEnd();
+    std::vector<Segment> out = peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].data.empty() && out[0].ack_num == peer.snd_nxt);
+    
+    // Nothing more is sent later.
+    s.stack.advance(1000);
+    AIPSTACK_ASSERT_FORCE(s.stack.sent.empty());
+}
+
+// Without burst end reports, each segment is acknowledged right away (in
+// quick-ACK mode after the connection was established).
+static void testNoBurstEnd ()
+{
+    Server s(AIpStackTests::TestIfaceParams{}, /*max_pcbs=*/4);
+    s.accept();
+    Peer &peer = s.peer;
+    
+    for (int i = 0; i < 4; i++) {
+        sendDataInBurst(s.stack, peer);
+    }
+    std::vector<Segment> out = peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 4);
+    AIPSTACK_ASSERT_FORCE(out[3].ack_num == peer.snd_nxt);
+}
+
+// The duplicate ACK for out-of-sequence data and the ACK for the data filling
+// the hole are sent right away (RFC 5681 section 4.2), not at the end of the
+// burst.
+static void testOutOfSequence ()
+{
+    Server s(burstParams(), /*max_pcbs=*/4);
+    s.accept();
+    Peer &peer = s.peer;
+    
+    TcpSeqNum start = peer.snd_nxt;
+    Segment seg2 = peer.segment(Tcp4Flags::Ack|Tcp4Flags::Psh, SegLen);
+    seg2.seq_num = start + TcpSeqInt(SegLen);
+    sendInBurst(s.stack, peer, seg2);
+    std::vector<Segment> out = peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].ack_num == start);
+    
+    Segment seg1 = peer.segment(Tcp4Flags::Ack|Tcp4Flags::Psh, SegLen);
+    seg1.seq_num = start;
+    sendInBurst(s.stack, peer, seg1);
+    out = peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].ack_num == start + TcpSeqInt(2 * SegLen));
+    
+    s.stack.burstEnd();
+    AIPSTACK_ASSERT_FORCE(s.stack.sent.empty());
+}
+
+// With data for two connections in a burst, the ACK for the first one is
+// sent when data for the second one arrives.
+static void testTwoConnections ()
+{
+    Server s(burstParams(), /*max_pcbs=*/4);
+    s.accept();
+    Peer &peer1 = s.peer;
+    Peer peer2(s.stack, 50001, Server::ServerPort);
+    peer2.connect(Peer::mssOptions());
+    peer2.receiveAll();
+    
+    sendDataInBurst(s.stack, peer1);
+    sendDataInBurst(s.stack, peer1);
+    AIPSTACK_ASSERT_FORCE(s.stack.sent.empty());
+    
+    sendDataInBurst(s.stack, peer2);
+    std::vector<Segment> out = peer1.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].ack_num == peer1.snd_nxt);
+    
+    s.stack.burstEnd();
+    out = peer2.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].ack_num == peer2.snd_nxt);
+}
+
+// An ACK deferred for a connection which is aborted before the end of the
+// burst is not sent.
+static void testAbortBeforeBurstEnd ()
+{
+    Server s(burstParams(), /*max_pcbs=*/4);
+    s.accept();
+    Peer &peer = s.peer;
+    
+    sendDataInBurst(s.stack, peer);
+    sendInBurst(s.stack, peer, peer.segment(Tcp4Flags::Rst));
+    AIPSTACK_ASSERT_FORCE(s.con().aborted);
+    
+    s.stack.burstEnd();
+    AIPSTACK_ASSERT_FORCE(s.stack.sent.empty());
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_burst_ack_test;
+    
+    testAckAtBurstEnd();
+    testNoBurstEnd();
+    testOutOfSequence();
+    testTwoConnections();
+    testAbortBeforeBurstEnd();
+    
+    return 0;
+}
@@ -0,0 +1,146 @@
+
+#include <cstddef>
+#include <cstdint>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/misc/MinMax.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/tcp/TcpCongControl.h>
+#include <aipstack/tcp/TcpCongControlCubic.h>
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_cong_control_test {
+
+constexpr std::uint16_t Mss = 1000;
+
+// Simulated connection, accessed by the algorithm through Context.
+template<typename CongControl>
+struct Conn {
+    typename CongControl::State state;
+    TcpSeqInt cwnd = 10 * Mss;
+    TcpSeqInt ssthresh = 5 * Mss;
+    TcpSeqInt cwnd_acked = 0;
+    TcpSeqInt flight_size = 0;
+    std::uint32_t now = 0;
+    std::uint32_t srtt = 100;
+    bool cwnd_incrd = false;
+};
+
+template<typename CongControl>
+struct Context {
+    Conn<CongControl> *c;
+    
+    inline static constexpr double TimeFreq = 1000.0;
+    
+    typename CongControl::State & state () const { return c->state; }
+    TcpSeqInt cwnd () const { return c->cwnd; }
+    void increaseCwnd (TcpSeqInt amount) const { AddToSat(c->cwnd, amount); }
+    TcpSeqInt & ssthresh () const { return c->ssthresh; }
+    TcpSeqInt & cwndAcked () const { return c->cwnd_acked; }
+    std::uint16_t sndMss () const { return Mss; }
+    TcpSeqInt flightSize () const { return c->flight_size; }
+    std::uint32_t now () const { return c->now; }
+    std::uint32_t srtt () const { return c->srtt; }
+    bool hasCwndIncrd () const { return c->cwnd_incrd; }
+    void setCwndIncrd () const { c->cwnd_incrd = true; }
+};
+
+// Simulate one RTT of congestion avoidance with a full window of ACKs.
+template<typename CongControl>
+static void simulateRtt (Conn<CongControl> &c)
+{
+    TcpSeqInt cwnd = c.cwnd;
+    for (TcpSeqInt acked = 0; acked < cwnd; acked += Mss) {
+        CongControl::congAvoidAck(Context<CongControl>{&c}, Mss);
+    }
+    c.now += c.srtt;
+    c.cwnd_incrd = false;
+}
+
+static void testReno ()
+{
+    using Reno = TcpCongControlReno;
+    Conn<Reno> c;
+    Reno::init(Context<Reno>{&c});
+    
+    // One segment per RTT.
+    simulateRtt(c);
+    AIPSTACK_ASSERT_FORCE(c.cwnd == 11 * Mss);
+    simulateRtt(c);
+    AIPSTACK_ASSERT_FORCE(c.cwnd == 12 * Mss);
+    
+    // Half of the flight size, but at least two segments.
+    c.flight_size = 20 * Mss;
+    Reno::lossDetected(Context<Reno>{&c});
+    AIPSTACK_ASSERT_FORCE(c.ssthresh == 10 * Mss);
+    c.flight_size = 3 * Mss;
+    Reno::rtoExpired(Context<Reno>{&c});
+    AIPSTACK_ASSERT_FORCE(c.ssthresh == 2 * Mss);
+}
+
+static void testCubic ()
+{
+    using Cubic = TcpCongControlCubic;
+    Conn<Cubic> c;
+    c.cwnd = 100 * Mss;
+    Cubic::init(Context<Cubic>{&c});
+    
+    // Loss at 100 segments: ssthresh is beta*cwnd, then continue from there.
+    Cubic::lossDetected(Context<Cubic>{&c});
+    AIPSTACK_ASSERT_FORCE(c.ssthresh == 70 * Mss);
+    c.cwnd = c.ssthresh;
+    
+    // The window must grow back to W_max after about K = cbrt(30/0.4) = 4.2 s,
+    // slowly near W_max (concave), and beyond it accelerate (convex).
+    TcpSeqInt prev_cwnd = c.cwnd;
+    TcpSeqInt prev_inc = TypeMax<TcpSeqInt>;
+    while (c.now < 4000) {
+        simulateRtt(c);
+        AIPSTACK_ASSERT_FORCE(c.cwnd >= prev_cwnd);
+        AIPSTACK_ASSERT_FORCE(c.cwnd <= 100 * Mss);
+        TcpSeqInt inc = c.cwnd - prev_cwnd;
+        if (c.now > 500) {
+            AIPSTACK_ASSERT_FORCE(inc <= prev_inc);
+        }
+        prev_inc = inc;
+        prev_cwnd = c.cwnd;
+    }
+    AIPSTACK_ASSERT_FORCE(c.cwnd >= 97 * Mss);
+    
+    while (c.now < 8000) {
+        simulateRtt(c);
+    }
+    AIPSTACK_ASSERT_FORCE(c.cwnd > 110 * Mss);
+    
+    // Fast convergence: a loss below W_max lowers W_max further.
+    c.cwnd = 90 * Mss;
+    Cubic::lossDetected(Context<Cubic>{&c});
+    AIPSTACK_ASSERT_FORCE(c.ssthresh == 63 * Mss);
+    AIPSTACK_ASSERT_FORCE(c.state.w_max == TcpSeqInt(90 * Mss * 17 / 20));
+    
+    // Much faster growth than Reno over a long RTT after a loss.
+    Conn<Cubic> lc;
+    lc.cwnd = 1000 * Mss;
+    lc.srtt = 500;
+    Cubic::init(Context<Cubic>{&lc});
+    Cubic::rtoExpired(Context<Cubic>{&lc});
+    lc.cwnd = lc.ssthresh;
+    for (int i = 0; i < 20; i++) {
+        simulateRtt(lc);
+    }
+    AIPSTACK_ASSERT_FORCE(lc.cwnd > 700 * Mss + 20 * Mss);
+    AIPSTACK_ASSERT_FORCE(lc.cwnd >= 990 * Mss);
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_cong_control_test;
+    
+    testReno();
+    testCubic();
+    
+    return 0;
+}
@@ -0,0 +1,179 @@
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/tcp/IpTcpProto.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/proto/Tcp4Proto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_delayed_ack_test {
+
+template<std::uint16_t DelayedAckTimeMs>
+using TestStack = AIpStackTests::TcpTestStack<
+    IpTcpProtoOptions::DelayedAckTimeMs::Is<DelayedAckTimeMs>
+>;
+
+using Segment = AIpStackTests::TcpSegment;
+
+static constexpr std::size_t SegSize = 1000;
+
+// Number of segments acknowledged immediately at the start of a connection.
+static constexpr int QuickAckSegs = 16;
+
+// Connection accepted from the peer.
+template<std::uint16_t DelayedAckTimeMs>
+struct Connection :
+    public AIpStackTests::TcpServerFixture<TestStack<DelayedAckTimeMs>>
+{
+    using Fixture = AIpStackTests::TcpServerFixture<TestStack<DelayedAckTimeMs>>;
+    using Fixture::peer;
+    
+    Connection ()
+    {
+        this->accept();
+    }
+    
+    // Send one data segment and return what is sent in response right away.
+    std::vector<Segment> sendSeg ()
+    {
+        peer.sendData(SegSize);
+        return peer.receiveAll();
+    }
+    
+    // Check that a pure ACK of everything sent by the peer was sent.
+    void checkAcked (std::vector<Segment> const &out)
+    {
+        AIPSTACK_ASSERT_FORCE(out.size() == 1);
+        AIPSTACK_ASSERT_FORCE(out[0].flags == Tcp4Flags::Ack);
+        AIPSTACK_ASSERT_FORCE(out[0].data.empty());
+        AIPSTACK_ASSERT_FORCE(out[0].ack_num == peer.snd_nxt);
+    }
+    
+    // Send segments until quick-ACK mode has ended, which leaves no ACK
+    // pending.
+    void endQuickAcks ()
+    {
+        for (int i = 0; i < QuickAckSegs; i++) {
+            checkAcked(sendSeg());
+        }
+        AIPSTACK_ASSERT_FORCE(sendSeg().empty());
+        checkAcked(sendSeg());
+    }
+};
+
+// After the initial quick ACKs, every second segment is acknowledged.
+static void testAckEverySecondSegment ()
+{
+    Connection<40> c;
+    
+    for (int i = 0; i < QuickAckSegs; i++) {
+        c.checkAcked(c.sendSeg());
+    }
+    
+    for (int i = 0; i < 5; i++) {
+        AIPSTACK_ASSERT_FORCE(c.sendSeg().empty());
+        c.checkAcked(c.sendSeg());
+    }
+    
+    std::size_t num_segs = QuickAckSegs + 10;
+    AIPSTACK_ASSERT_FORCE(c.con().received == num_segs * SegSize);
+}
+
+// A lone segment is acknowledged when the delayed ACK timer expires.
+static void testDelayedAckTimer ()
+{
+    Connection<40> c;
+    c.endQuickAcks();
+    
+    AIPSTACK_ASSERT_FORCE(c.sendSeg().empty());
+    c.stack.advance(39);
+    AIPSTACK_ASSERT_FORCE(c.stack.sent.empty());
+    c.stack.advance(1);
+    c.checkAcked(c.peer.receiveAll());
+    
+    // The timer does not fire again.
+    c.stack.advance(1000);
+    AIPSTACK_ASSERT_FORCE(c.stack.sent.empty());
+    
+    // The pairing starts over after the timer.
+    AIPSTACK_ASSERT_FORCE(c.sendSeg().empty());
+    c.checkAcked(c.sendSeg());
+}
+
+// The delayed ACK is sent with data, then the timer sends nothing.
+static void testAckWithData ()
+{
+    Connection<40> c;
+    c.endQuickAcks();
+    
+    AIPSTACK_ASSERT_FORCE(c.sendSeg().empty());
+    c.con().send(100);
+    c.stack.dispatch();
+    std::vector<Segment> out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].data.size() == 100);
+    AIPSTACK_ASSERT_FORCE(out[0].ack_num == c.peer.snd_nxt);
+    
+    c.peer.sendAck();
+    c.stack.advance(1000);
+    AIPSTACK_ASSERT_FORCE(c.stack.sent.empty());
+}
+
+// Out-of-sequence data is acknowledged immediately, and so are the segments
+// which fill the hole and follow it (quick-ACK).
+static void testOutOfSequence ()
+{
+    Connection<40> c;
+    c.endQuickAcks();
+    
+    // Send a segment after a hole, the duplicate ACK goes out right away.
+    TcpSeqNum hole_start = c.peer.snd_nxt;
+    Segment seg = c.peer.segment(Tcp4Flags::Ack, SegSize);
+    seg.seq_num = hole_start + TcpSeqInt(SegSize);
+    c.peer.send(seg);
+    std::vector<Segment> out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].ack_num == hole_start);
+    
+    // Fill the hole, both segments are acknowledged right away.
+    seg = c.peer.segment(Tcp4Flags::Ack, SegSize);
+    seg.seq_num = hole_start;
+    c.peer.send(seg);
+    c.peer.snd_nxt = hole_start + TcpSeqInt(2 * SegSize);
+    c.checkAcked(c.peer.receiveAll());
+    
+    // Following segments are acknowledged right away too.
+    c.checkAcked(c.sendSeg());
+    c.checkAcked(c.sendSeg());
+}
+
+// With a zero timeout (the default), delayed ACKs are disabled.
+static void testDisabled ()
+{
+    Connection<0> c;
+    
+    for (int i = 0; i < QuickAckSegs + 10; i++) {
+        c.checkAcked(c.sendSeg());
+    }
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_delayed_ack_test;
+    
+    testAckEverySecondSegment();
+    testDelayedAckTimer();
+    testAckWithData();
+    testOutOfSequence();
+    testDisabled();
+    
+    return 0;
+}
@@ -0,0 +1,146 @@
+
+#include <cstdint>
+#include <cstring>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/infra/Buf.h>
+#include <aipstack/ip/IpAddr.h>
+#include <aipstack/tcp/TcpOptions.h>
+#include <aipstack/tcp/TcpSynCookie.h>
+#include <aipstack/tcp/TcpFastOpenCache.h>
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_fast_open_test {
+
+static TcpSynCookie::Key const key{0x0706050403020100u, 0x0f0e0d0c0b0a0908u};
+
+static void parseOptions (char const *buf, std::uint8_t len, TcpOptions &parsed)
+{
+    IpBufNode node{const_cast<char *>(buf), len, nullptr};
+    ParseTcpOptions(IpBufRef{&node, 0, len}, parsed);
+}
+
+static void testOptions ()
+{
+    char buf[MaxTcpOptionsWriteLen];
+    TcpOptions parsed;
+    
+    // Cookie request.
+    TcpOptions req;
+    req.options = TcpOptionFlags::FastOpen;
+    req.fast_open_cookie_len = 0;
+    std::uint8_t len = CalcTcpOptionsLength(req);
+    AIPSTACK_ASSERT_FORCE(len == 4);
+    WriteTcpOptions(req, buf);
+    parseOptions(buf, len, parsed);
+    AIPSTACK_ASSERT_FORCE(parsed.options == TcpOptionFlags::FastOpen);
+    AIPSTACK_ASSERT_FORCE(parsed.fast_open_cookie_len == 0);
+    
+    // All SYN options with a cookie of each valid length.
+    for (std::uint8_t cookie_len = 4; cookie_len <= TcpMaxFastOpenCookieLen;
+         cookie_len += 2)
+    {
+        TcpOptions syn;
+        syn.options = TcpOptionFlags::Mss|TcpOptionFlags::WndScale|
+            TcpOptionFlags::SackPerm|TcpOptionFlags::Timestamps|TcpOptionFlags::FastOpen;
+        syn.mss = 1460;
+        syn.wnd_scale = 6;
+        syn.ts_val = 1;
+        syn.ts_ecr = 0;
+        syn.fast_open_cookie_len = cookie_len;
+        for (std::uint8_t i = 0; i < cookie_len; i++) {
+            syn.fast_open_cookie[i] = char(0xA0 + i);
+        }
+        
+        len = CalcTcpOptionsLength(syn);
+        AIPSTACK_ASSERT_FORCE(len <= MaxTcpOptionsWriteLen);
+        WriteTcpOptions(syn, buf);
+        parseOptions(buf, len, parsed);
+        AIPSTACK_ASSERT_FORCE(parsed.options == syn.options);
+        AIPSTACK_ASSERT_FORCE(parsed.mss == 1460);
+        AIPSTACK_ASSERT_FORCE(parsed.fast_open_cookie_len == cookie_len);
+        AIPSTACK_ASSERT_FORCE(
+            std::memcmp(parsed.fast_open_cookie, syn.fast_open_cookie, cookie_len) == 0);
+    }
+    
+    // Cookies of invalid or unsupported length are ignored.
+    char const bad[] = {34, 5, 1, 2, 3, 1, 1, 1, 34, 18, 0, 0, 0, 0, 0, 0, 0, 0,
+                        0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    parseOptions(bad, sizeof(bad), parsed);
+    AIPSTACK_ASSERT_FORCE(parsed.options == TcpOptionFlags(0));
+}
+
+static void testCookie ()
+{
+    Ip4Addr server = Ip4Addr(192, 168, 1, 1);
+    Ip4Addr client1 = Ip4Addr(192, 168, 1, 100);
+    Ip4Addr client2 = Ip4Addr(192, 168, 1, 101);
+    
+    char c1[TcpSynCookie::FastOpenCookieLen];
+    char c1b[TcpSynCookie::FastOpenCookieLen];
+    char c2[TcpSynCookie::FastOpenCookieLen];
+    TcpSynCookie::fastOpenCookie(key, server, client1, c1);
+    TcpSynCookie::fastOpenCookie(key, server, client1, c1b);
+    TcpSynCookie::fastOpenCookie(key, server, client2, c2);
+    
+    // Deterministic for a client, different for different clients and keys.
+    AIPSTACK_ASSERT_FORCE(std::memcmp(c1, c1b, sizeof(c1)) == 0);
+    AIPSTACK_ASSERT_FORCE(std::memcmp(c1, c2, sizeof(c1)) != 0);
+    
+    TcpSynCookie::Key key2 = key;
+    key2.k1 ^= 1;
+    TcpSynCookie::fastOpenCookie(key2, server, client1, c1b);
+    AIPSTACK_ASSERT_FORCE(std::memcmp(c1, c1b, sizeof(c1)) != 0);
+}
+
+static void testCache ()
+{
+    TcpFastOpenCache<2> cache;
+    Ip4Addr a1 = Ip4Addr(10, 0, 0, 1);
+    Ip4Addr a2 = Ip4Addr(10, 0, 0, 2);
+    Ip4Addr a3 = Ip4Addr(10, 0, 0, 3);
+    char const cookie[] = {1, 2, 3, 4, 5, 6, 7, 8};
+    
+    AIPSTACK_ASSERT_FORCE(cache.find(a1) == nullptr);
+    
+    cache.store(a1, 1460, cookie, 8);
+    cache.store(a2, 536, cookie, 4);
+    auto const *e1 = cache.find(a1);
+    AIPSTACK_ASSERT_FORCE(e1 != nullptr && e1->mss == 1460 && e1->cookie_len == 8);
+    AIPSTACK_ASSERT_FORCE(std::memcmp(e1->cookie, cookie, 8) == 0);
+    
+    // Updating an entry does not replace another one.
+    cache.store(a2, 1400, cookie, 6);
+    AIPSTACK_ASSERT_FORCE(cache.find(a1) != nullptr);
+    AIPSTACK_ASSERT_FORCE(cache.find(a2)->mss == 1400);
+    AIPSTACK_ASSERT_FORCE(cache.find(a2)->cookie_len == 6);
+    
+    // When full, the entries are replaced in round-robin order.
+    cache.store(a3, 1460, cookie, 8);
+    AIPSTACK_ASSERT_FORCE(cache.find(a1) == nullptr);
+    AIPSTACK_ASSERT_FORCE(cache.find(a2) != nullptr);
+    AIPSTACK_ASSERT_FORCE(cache.find(a3) != nullptr);
+    
+    cache.remove(a2);
+    AIPSTACK_ASSERT_FORCE(cache.find(a2) == nullptr);
+    AIPSTACK_ASSERT_FORCE(cache.find(a3) != nullptr);
+    
+    // A cache without entries stores nothing.
+    TcpFastOpenCache<0> empty_cache;
+    empty_cache.store(a1, 1460, cookie, 8);
+    AIPSTACK_ASSERT_FORCE(empty_cache.find(a1) == nullptr);
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_fast_open_test;
+    
+    testOptions();
+    testCookie();
+    testCache();
+    
+    return 0;
+}
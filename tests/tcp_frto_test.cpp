@@ -0,0 +1,152 @@
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/tcp/IpTcpProto.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/proto/Tcp4Proto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_frto_test {
+
+using Stack = AIpStackTests::TcpTestStack<
+    IpTcpProtoOptions::FrtoEnabled::Is<true>
+>;
+using Peer = AIpStackTests::TcpTestPeer<Stack>;
+using Segment = AIpStackTests::TcpSegment;
+
+static constexpr std::uint16_t Mss = 1000;
+
+// Connection whose last flight of segments is unacknowledged until the
+// retransmission timeout has expired once.
+struct TimedOutConnection :
+    public AIpStackTests::TcpServerFixture<Stack>
+{
+    TimedOutConnection ()
+    {
+        accept(Peer::mssOptions(Mss));
+        
+        // Queue plenty of data and let the cwnd grow for a few round trips.
+        con().send(100 * Mss);
+        for (int i = 0; i < 3; i++) {
+            stack.advance(10);
+            AIPSTACK_ASSERT_FORCE(!peer.receiveAll().empty());
+            peer.sendAck();
+        }
+        
+        // This flight is not acknowledged. It fills the cwnd.
+        stack.advance(10);
+        flight_segs = peer.receiveAll().size();
+        AIPSTACK_ASSERT_FORCE(flight_segs >= 4);
+        flight_end = peer.rcv_nxt;
+        una = flight_end - TcpSeqInt(flight_segs * Mss);
+        
+        // Wait for the timeout, the first segment is retransmitted.
+        while (stack.sent.empty()) {
+            stack.advance(10);
+        }
+        std::vector<Segment> out = peer.receiveAll();
+        AIPSTACK_ASSERT_FORCE(out.size() == 1);
+        AIPSTACK_ASSERT_FORCE(out[0].seq_num == una);
+        AIPSTACK_ASSERT_FORCE(out[0].data.size() == Mss);
+    }
+    
+    std::size_t flight_segs;
+    TcpSeqNum una;
+    TcpSeqNum flight_end;
+};
+
+// The original segments were only delayed: the first ACK after the timeout
+// covers the first two of them, and the second one the rest. New data is
+// sent after each ACK and the cwnd is restored to what it was.
+static void testSpuriousTimeout ()
+{
+    TimedOutConnection c;
+    
+    // Two new segments are sent, nothing is retransmitted.
+    c.peer.sendAck(c.una + TcpSeqInt(2 * Mss));
+    std::vector<Segment> out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 2);
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.flight_end);
+    AIPSTACK_ASSERT_FORCE(out[1].seq_num == c.flight_end + TcpSeqInt(Mss));
+    
+    // The cwnd is back at the size of the flight, two segments of which
+    // are in flight already.
+    c.peer.sendAck(c.flight_end);
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == c.flight_segs - 2);
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.flight_end + TcpSeqInt(2 * Mss));
+    
+    // The ssthresh was restored too, so the cwnd grows by slow start.
+    c.peer.sendAck();
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() > c.flight_segs);
+}
+
+// The flight was really lost: the first ACK acknowledges the retransmitted
+// segment and the second one is a duplicate ACK caused by the new segments.
+// The sender goes back to the first unacknowledged segment.
+static void testGenuineTimeout ()
+{
+    TimedOutConnection c;
+    
+    c.peer.sendAck(c.una + TcpSeqInt(Mss));
+    std::vector<Segment> out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 2);
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.flight_end);
+    
+    // Go-back-N from the first unacknowledged segment with the cwnd of one
+    // segment (plus one for Limited Transmit).
+    c.peer.sendAck(c.una + TcpSeqInt(Mss));
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 2);
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.una + TcpSeqInt(Mss));
+    AIPSTACK_ASSERT_FORCE(out[1].seq_num == c.una + TcpSeqInt(2 * Mss));
+    
+    // The retransmissions continue in slow start.
+    c.peer.sendAck(c.una + TcpSeqInt(3 * Mss));
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(!out.empty() && out.size() <= 2);
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.una + TcpSeqInt(3 * Mss));
+}
+
+// A duplicate ACK as the first ACK after the timeout also means that the
+// timeout was genuine, no new data is sent.
+static void testDupAckAfterTimeout ()
+{
+    TimedOutConnection c;
+    
+    c.peer.sendAck(c.una);
+    std::vector<Segment> out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(!out.empty() && out.size() <= 2);
+    for (Segment const &seg : out) {
+        AIPSTACK_ASSERT_FORCE(seg.seq_num.mod_lt(c.flight_end));
+    }
+    
+    // Old data continues to be retransmitted as it is acknowledged.
+    c.peer.sendAck(c.una + TcpSeqInt(2 * Mss));
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(!out.empty());
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.una + TcpSeqInt(2 * Mss));
+    for (Segment const &seg : out) {
+        AIPSTACK_ASSERT_FORCE(seg.seq_num.mod_lt(c.flight_end));
+    }
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_frto_test;
+    
+    testSpuriousTimeout();
+    testGenuineTimeout();
+    testDupAckAfterTimeout();
+    
+    return 0;
+}
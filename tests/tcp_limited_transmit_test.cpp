@@ -0,0 +1,109 @@
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/tcp/IpTcpProto.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/proto/Tcp4Proto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_limited_transmit_test {
+
+using Stack = AIpStackTests::TcpTestStack<>;
+using Peer = AIpStackTests::TcpTestPeer<Stack>;
+using Segment = AIpStackTests::TcpSegment;
+
+static constexpr std::uint16_t Mss = 1000;
+
+// Connection which has sent its initial window of four segments, with more
+// data queued. Nothing of the flight is acknowledged yet.
+struct Connection :
+    public AIpStackTests::TcpServerFixture<Stack>
+{
+    Connection ()
+    {
+        accept(Peer::mssOptions(Mss));
+        
+        con().send(100 * Mss);
+        stack.advance(1);
+        std::vector<Segment> out = peer.receiveAll();
+        AIPSTACK_ASSERT_FORCE(out.size() == 4);
+        start = out[0].seq_num;
+    }
+    
+    // Sequence number of the start of the given segment.
+    TcpSeqNum seq (std::size_t seg_index) const
+    {
+        return start + TcpSeqInt(seg_index * Mss);
+    }
+    
+    // Send an ACK and return the segments sent in response.
+    std::vector<Segment> ack (std::size_t seg_index)
+    {
+        peer.sendAck(seq(seg_index));
+        return peer.receiveAll();
+    }
+    
+    TcpSeqNum start;
+};
+
+// Each of the first two duplicate ACKs allows one new segment, the third
+// one triggers fast retransmit.
+static void testLimitedTransmit ()
+{
+    Connection c;
+    
+    std::vector<Segment> out = c.ack(0);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.seq(4) && out[0].data.size() == Mss);
+    
+    out = c.ack(0);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.seq(5) && out[0].data.size() == Mss);
+    
+    out = c.ack(0);
+    AIPSTACK_ASSERT_FORCE(!out.empty());
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.seq(0) && out[0].data.size() == Mss);
+}
+
+// In fast recovery, a partial ACK retransmits the next segment right away
+// (NewReno), and an ACK of everything up to the recover point ends recovery.
+static void testPartialAck ()
+{
+    Connection c;
+    
+    for (int i = 0; i < 3; i++) {
+        c.ack(0);
+    }
+    
+    // Segments 0 and 2 were lost, the retransmission of 0 fills the first
+    // hole.
+    std::vector<Segment> out = c.ack(2);
+    AIPSTACK_ASSERT_FORCE(!out.empty());
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.seq(2) && out[0].data.size() == Mss);
+    
+    // The ACK of the retransmission covers all six segments sent before
+    // fast retransmit, which ends recovery. Only new data is sent.
+    out = c.ack(6);
+    AIPSTACK_ASSERT_FORCE(!out.empty());
+    for (Segment const &seg : out) {
+        AIPSTACK_ASSERT_FORCE(!seg.seq_num.mod_lt(c.seq(6)));
+    }
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_limited_transmit_test;
+    
+    testLimitedTransmit();
+    testPartialAck();
+    
+    return 0;
+}
@@ -0,0 +1,136 @@
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/tcp/IpTcpProto.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/proto/Tcp4Proto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_nagle_test {
+
+using Stack = AIpStackTests::TcpTestStack<>;
+using Peer = AIpStackTests::TcpTestPeer<Stack>;
+using Segment = AIpStackTests::TcpSegment;
+
+static constexpr std::uint16_t Mss = 1000;
+
+// Connection accepted from the peer.
+struct Connection :
+    public AIpStackTests::TcpServerFixture<Stack>
+{
+    Connection ()
+    {
+        accept(Peer::mssOptions(Mss));
+    }
+    
+    // Queue and push data, then return the segments sent.
+    std::vector<Segment> send (std::size_t amount)
+    {
+        con().send(amount);
+        stack.advance(1);
+        return peer.receiveAll();
+    }
+};
+
+// Without the Nagle algorithm, each pushed piece of data is sent right away.
+static void testNagleDisabled ()
+{
+    Connection c;
+    
+    for (int i = 0; i < 3; i++) {
+        std::vector<Segment> out = c.send(100);
+        AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].data.size() == 100);
+    }
+}
+
+// With the Nagle algorithm, a small pushed segment is held back while data
+// is unacknowledged, and sent when everything is acknowledged.
+static void testNagle ()
+{
+    Connection c;
+    c.con().setNagle(true);
+    
+    // Nothing is unacknowledged, this is sent.
+    std::vector<Segment> out = c.send(100);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].data.size() == 100);
+    
+    // These are held back.
+    AIPSTACK_ASSERT_FORCE(c.send(100).empty());
+    AIPSTACK_ASSERT_FORCE(c.send(200).empty());
+    c.stack.advance(100);
+    AIPSTACK_ASSERT_FORCE(c.stack.sent.empty());
+    
+    // The ACK releases them in one segment.
+    c.peer.sendAck();
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].data.size() == 300);
+    
+    // A full segment is sent even with unacknowledged data, but not the
+    // partial segment after it.
+    out = c.send(Mss + 100);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].data.size() == Mss);
+    c.peer.sendAck();
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].data.size() == 100);
+    
+    // Disabling the Nagle algorithm sends held data.
+    c.peer.sendAck();
+    c.send(100);
+    AIPSTACK_ASSERT_FORCE(c.send(100).empty());
+    c.con().setNagle(false);
+    c.stack.advance(1);
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].data.size() == 100);
+}
+
+// While corked only full segments are sent, and uncorking sends the rest.
+static void testCork ()
+{
+    Connection c;
+    c.con().setCork(true);
+    
+    AIPSTACK_ASSERT_FORCE(c.send(100).empty());
+    AIPSTACK_ASSERT_FORCE(c.send(500).empty());
+    
+    std::vector<Segment> out = c.send(Mss);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].data.size() == Mss);
+    
+    c.con().setCork(false);
+    c.stack.advance(1);
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].data.size() == 600);
+}
+
+// A FIN is sent with the held data even while corked.
+static void testCorkFin ()
+{
+    Connection c;
+    c.con().setCork(true);
+    
+    AIPSTACK_ASSERT_FORCE(c.send(100).empty());
+    c.con().closeSending();
+    c.stack.advance(1);
+    std::vector<Segment> out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].data.size() == 100);
+    AIPSTACK_ASSERT_FORCE(out[0].has(Tcp4Flags::Fin));
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_nagle_test;
+    
+    testNagleDisabled();
+    testNagle();
+    testCork();
+    testCorkFin();
+    
+    return 0;
+}
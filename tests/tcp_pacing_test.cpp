@@ -0,0 +1,106 @@
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/tcp/IpTcpProto.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/proto/Tcp4Proto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_pacing_test {
+
+template<bool PacingEnabled>
+using TestStack = AIpStackTests::TcpTestStack<
+    IpTcpProtoOptions::PacingEnabled::Is<PacingEnabled>,
+    IpTcpProtoOptions::PacingBurstSegs::Is<2>
+>;
+
+using Segment = AIpStackTests::TcpSegment;
+
+static constexpr std::uint16_t Mss = 1000;
+
+// Round-trip time of the handshake in milliseconds.
+static constexpr std::uint64_t HandshakeRtt = 100;
+
+// Connection accepted from the peer with the given RTT measured in the
+// handshake, with plenty of data queued for sending.
+template<bool PacingEnabled>
+struct Connection :
+    public AIpStackTests::TcpServerFixture<TestStack<PacingEnabled>>
+{
+    using Fixture = AIpStackTests::TcpServerFixture<TestStack<PacingEnabled>>;
+    
+    Connection ()
+    {
+        this->accept(Fixture::Peer::mssOptions(Mss), HandshakeRtt);
+        this->con().send(100 * Mss);
+    }
+};
+
+// Without pacing, the whole initial window is sent at once.
+static void testNoPacing ()
+{
+    Connection<false> c;
+    
+    c.stack.advance(1);
+    std::vector<Segment> out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 4);
+}
+
+// With pacing, the initial window is sent in bursts of PacingBurstSegs
+// segments spread over the RTT.
+static void testBurstLimited ()
+{
+    Connection<true> c;
+    
+    c.stack.advance(1);
+    std::vector<Segment> out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 2);
+    TcpSeqNum next_seq = out[1].seq_num + TcpSeqInt(Mss);
+    
+    // The next burst comes after burst/cwnd of the RTT divided by the
+    // slow-start gain of two, that is 25 ms.
+    c.stack.advance(20);
+    AIPSTACK_ASSERT_FORCE(c.stack.sent.empty());
+    std::uint64_t waited = 20;
+    while (c.stack.sent.empty()) {
+        AIPSTACK_ASSERT_FORCE(waited < HandshakeRtt);
+        c.stack.advance(1);
+        waited++;
+    }
+    AIPSTACK_ASSERT_FORCE(waited >= 24 && waited <= 26);
+    
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 2);
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == next_seq);
+    
+    // The window is used up.
+    c.stack.advance(HandshakeRtt);
+    AIPSTACK_ASSERT_FORCE(c.stack.sent.empty());
+    
+    // The ACK of the first burst allows three segments (cwnd grows by
+    // one), but only a burst is sent right away.
+    c.peer.sendAck(next_seq);
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 2);
+    c.stack.advance(HandshakeRtt);
+    out = c.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_pacing_test;
+    
+    testNoPacing();
+    testBurstLimited();
+    
+    return 0;
+}
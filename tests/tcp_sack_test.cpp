@@ -0,0 +1,207 @@
+
+#include <cstddef>
+#include <cstdint>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/infra/Instance.h>
+#include <aipstack/infra/Buf.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/tcp/TcpOptions.h>
+#include <aipstack/tcp/TcpOosBuffer.h>
+#include <aipstack/tcp/TcpSackScoreboard.h>
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_sack_test {
+
+AIPSTACK_MAKE_INSTANCE(Scoreboard, (TcpSackScoreboardService<
+    TcpSackScoreboardServiceOptions::NumSackRanges::Is<3>>))
+
+AIPSTACK_MAKE_INSTANCE(OosBuffer, (TcpOosBufferService<
+    TcpOosBufferServiceOptions::NumOosSegs::Is<4>>))
+
+static TcpSeqNum seq (TcpSeqInt value)
+{
+    // Use a base close to wraparound to exercise modular comparisons.
+    return TcpSeqNum(0xFFFFFF00u) + value;
+}
+
+static void checkHole (Scoreboard const &sb, TcpSeqNum snd_una,
+                       TcpSeqInt exp_start, TcpSeqInt exp_len)
+{
+    TcpSeqNum hole_start;
+    TcpSeqInt hole_len;
+    AIPSTACK_ASSERT_FORCE(sb.nextHole(snd_una, hole_start, hole_len));
+    AIPSTACK_ASSERT_FORCE(hole_start == seq(exp_start));
+    AIPSTACK_ASSERT_FORCE(hole_len == exp_len);
+}
+
+static void testScoreboard ()
+{
+    Scoreboard sb;
+    TcpSeqNum una = seq(0);
+    TcpSeqNum nxt = seq(1000);
+    sb.init(una);
+    AIPSTACK_ASSERT_FORCE(sb.isEmpty());
+    
+    TcpSeqNum hole_start;
+    TcpSeqInt hole_len;
+    AIPSTACK_ASSERT_FORCE(!sb.nextHole(una, hole_start, hole_len));
+    
+    // Invalid blocks are ignored.
+    TcpSackBlock bad[] = {{seq(0), seq(100)}, {seq(200), seq(1100)}, {seq(300), seq(300)}};
+    sb.addBlocks(una, nxt, bad, 3);
+    AIPSTACK_ASSERT_FORCE(sb.isEmpty());
+    
+    // Two ranges with holes [0,100) and [200,400).
+    TcpSackBlock b1[] = {{seq(400), seq(500)}, {seq(100), seq(200)}};
+    sb.addBlocks(una, nxt, b1, 2);
+    checkHole(sb, una, 0, 100);
+    
+    // Retransmit part of the first hole, then the rest.
+    sb.startRecovery(una);
+    sb.holeRetransmitted(seq(50));
+    checkHole(sb, una, 50, 50);
+    sb.holeRetransmitted(seq(100));
+    checkHole(sb, una, 200, 200);
+    sb.holeRetransmitted(seq(400));
+    AIPSTACK_ASSERT_FORCE(!sb.nextHole(una, hole_start, hole_len));
+    
+    // Merge: a block bridging both ranges.
+    TcpSackBlock b2[] = {{seq(150), seq(450)}};
+    sb.addBlocks(una, nxt, b2, 1);
+    sb.startRecovery(una);
+    checkHole(sb, una, 0, 100);
+    sb.holeRetransmitted(seq(100));
+    AIPSTACK_ASSERT_FORCE(!sb.nextHole(una, hole_start, hole_len));
+    
+    // Fill the scoreboard; a new highest range is dropped when full,
+    // a new lower range evicts the highest one.
+    TcpSackBlock b3[] = {{seq(600), seq(700)}, {seq(800), seq(900)}};
+    sb.addBlocks(una, nxt, b3, 2);
+    sb.startRecovery(una);
+    sb.holeRetransmitted(seq(500));
+    checkHole(sb, una, 500, 100);
+    TcpSackBlock b4[] = {{seq(550), seq(560)}};
+    sb.addBlocks(una, nxt, b4, 1);
+    checkHole(sb, una, 500, 50);
+    sb.holeRetransmitted(seq(560));
+    checkHole(sb, una, 560, 40);
+    sb.holeRetransmitted(seq(600));
+    AIPSTACK_ASSERT_FORCE(!sb.nextHole(una, hole_start, hole_len));
+    
+    // Cumulative ACK within the first range trims it, and the
+    // retransmission position is kept at or above snd_una.
+    sb.updateForAck(una, seq(300));
+    una = seq(300);
+    sb.startRecovery(una);
+    AIPSTACK_ASSERT_FORCE(!sb.isEmpty());
+    checkHole(sb, una, 500, 50);
+    
+    // Cumulative ACK beyond all ranges empties the scoreboard.
+    sb.updateForAck(una, seq(700));
+    una = seq(700);
+    AIPSTACK_ASSERT_FORCE(sb.isEmpty());
+    AIPSTACK_ASSERT_FORCE(!sb.nextHole(una, hole_start, hole_len));
+}
+
+static void testOptions ()
+{
+    TcpOptions opts;
+    opts.options = TcpOptionFlags::Sack;
+    opts.num_sack_blocks = 3;
+    opts.sack_blocks[0] = TcpSackBlock{seq(10), seq(20)};
+    opts.sack_blocks[1] = TcpSackBlock{seq(30), seq(40)};
+    opts.sack_blocks[2] = TcpSackBlock{seq(50), seq(60)};
+    
+    std::uint8_t len = CalcTcpOptionsLength(opts);
+    AIPSTACK_ASSERT_FORCE(len == 4 + 3 * 8);
+    
+    char buf[MaxTcpOptionsWriteLen];
+    WriteTcpOptions(opts, buf);
+    
+    TcpOptions parsed;
+    IpBufNode node{buf, len, nullptr};
+    ParseTcpOptions(IpBufRef{&node, 0, len}, parsed);
+    AIPSTACK_ASSERT_FORCE(parsed.options == TcpOptionFlags::Sack);
+    AIPSTACK_ASSERT_FORCE(parsed.num_sack_blocks == 3);
+    for (int i = 0; i < 3; i++) {
+        AIPSTACK_ASSERT_FORCE(parsed.sack_blocks[i].start == opts.sack_blocks[i].start);
+        AIPSTACK_ASSERT_FORCE(parsed.sack_blocks[i].end == opts.sack_blocks[i].end);
+    }
+    
+    // SYN options including SACK-permitted.
+    TcpOptions syn_opts;
+    syn_opts.options = TcpOptionFlags::Mss|TcpOptionFlags::WndScale|TcpOptionFlags::SackPerm;
+    syn_opts.mss = 1460;
+    syn_opts.wnd_scale = 6;
+    len = CalcTcpOptionsLength(syn_opts);
+    AIPSTACK_ASSERT_FORCE(len == 12);
+    WriteTcpOptions(syn_opts, buf);
+    node = IpBufNode{buf, len, nullptr};
+    ParseTcpOptions(IpBufRef{&node, 0, len}, parsed);
+    AIPSTACK_ASSERT_FORCE(parsed.options == syn_opts.options);
+    AIPSTACK_ASSERT_FORCE(parsed.mss == 1460);
+    AIPSTACK_ASSERT_FORCE(parsed.wnd_scale == 6);
+    
+    // Timestamps with the maximum number of SACK blocks that fit.
+    TcpOptions ts_opts;
+    ts_opts.options = TcpOptionFlags::Timestamps|TcpOptionFlags::Sack;
+    ts_opts.ts_val = 0x12345678;
+    ts_opts.ts_ecr = 0xFEDCBA98;
+    ts_opts.num_sack_blocks = TcpMaxSackBlocksWithTs;
+    for (int i = 0; i < TcpMaxSackBlocksWithTs; i++) {
+        ts_opts.sack_blocks[i] = TcpSackBlock{seq(100 * i), seq(100 * i + 10)};
+    }
+    len = CalcTcpOptionsLength(ts_opts);
+    AIPSTACK_ASSERT_FORCE(len == 12 + 4 + TcpMaxSackBlocksWithTs * 8);
+    AIPSTACK_ASSERT_FORCE(len <= MaxTcpOptionsWriteLen);
+    WriteTcpOptions(ts_opts, buf);
+    node = IpBufNode{buf, len, nullptr};
+    ParseTcpOptions(IpBufRef{&node, 0, len}, parsed);
+    AIPSTACK_ASSERT_FORCE(parsed.options == ts_opts.options);
+    AIPSTACK_ASSERT_FORCE(parsed.ts_val == 0x12345678);
+    AIPSTACK_ASSERT_FORCE(parsed.ts_ecr == 0xFEDCBA98);
+    AIPSTACK_ASSERT_FORCE(parsed.num_sack_blocks == TcpMaxSackBlocksWithTs);
+}
+
+static void testOosSackBlocks ()
+{
+    OosBuffer oos;
+    oos.init();
+    TcpSeqNum rcv_nxt = seq(0);
+    bool need_ack;
+    TcpSackBlock blocks[TcpMaxSackBlocks];
+    
+    AIPSTACK_ASSERT_FORCE(oos.getSackBlocks(rcv_nxt, blocks, TcpMaxSackBlocks) == 0);
+    
+    AIPSTACK_ASSERT_FORCE(oos.updateForSegmentReceived(rcv_nxt, seq(100), 50, false, need_ack));
+    AIPSTACK_ASSERT_FORCE(oos.updateForSegmentReceived(rcv_nxt, seq(300), 50, true, need_ack));
+    AIPSTACK_ASSERT_FORCE(oos.updateForSegmentReceived(rcv_nxt, seq(200), 50, false, need_ack));
+    
+    // The most recent block comes first, the FIN is not reported.
+    std::uint8_t num = oos.getSackBlocks(rcv_nxt, blocks, TcpMaxSackBlocks);
+    AIPSTACK_ASSERT_FORCE(num == 3);
+    AIPSTACK_ASSERT_FORCE(blocks[0].start == seq(200) && blocks[0].end == seq(250));
+    AIPSTACK_ASSERT_FORCE(blocks[1].start == seq(100) && blocks[1].end == seq(150));
+    AIPSTACK_ASSERT_FORCE(blocks[2].start == seq(300) && blocks[2].end == seq(350));
+    
+    // Limited number of blocks.
+    num = oos.getSackBlocks(rcv_nxt, blocks, 2);
+    AIPSTACK_ASSERT_FORCE(num == 2);
+    AIPSTACK_ASSERT_FORCE(blocks[0].start == seq(200));
+    AIPSTACK_ASSERT_FORCE(blocks[1].start == seq(100));
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_sack_test;
+    
+    testScoreboard();
+    testOptions();
+    testOosSackBlocks();
+    
+    return 0;
+}
@@ -0,0 +1,160 @@
+
+#include <cstdint>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/ip/IpAddr.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/tcp/TcpPcbKey.h>
+#include <aipstack/tcp/TcpSynCookie.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_syn_cookie_test {
+
+static TcpSynCookie::Key const key{0x0706050403020100u, 0x0f0e0d0c0b0a0908u};
+
+static TcpPcbKey const conn{
+    Ip4Addr(192, 168, 1, 1), Ip4Addr(192, 168, 1, 100), 80, 50123};
+
+static void testRoundTrip ()
+{
+    TcpSeqNum peer_isn = TcpSeqNum(0x12345678u);
+    std::uint32_t counter = 1000;
+    
+    for (bool sack : {false, true}) {
+        for (int shift = -1; shift <= 14; shift++) {
+            TcpSynCookieInfo info;
+            info.mss = 1460;
+            info.wnd_scale = shift >= 0;
+            info.snd_wnd_shift = info.wnd_scale ? std::uint8_t(shift) : 0;
+            info.sack_perm = sack;
+            
+            TcpSeqNum cookie = TcpSynCookie::encode(key, conn, peer_isn, counter, info);
+            
+            TcpSynCookieInfo dec;
+            AIPSTACK_ASSERT_FORCE(
+                TcpSynCookie::decode(key, conn, peer_isn, counter, cookie, dec));
+            AIPSTACK_ASSERT_FORCE(dec.mss == 1460);
+            AIPSTACK_ASSERT_FORCE(dec.wnd_scale == info.wnd_scale);
+            AIPSTACK_ASSERT_FORCE(dec.snd_wnd_shift == info.snd_wnd_shift);
+            AIPSTACK_ASSERT_FORCE(dec.sack_perm == sack);
+        }
+    }
+}
+
+static void testMssRounding ()
+{
+    TcpSeqNum peer_isn = TcpSeqNum(1u);
+    std::uint32_t counter = 7;
+    
+    struct { std::uint16_t mss, expected; } const cases[] = {
+        {216, 216}, {535, 216}, {536, 536}, {1000, 536}, {1400, 1400},
+        {1459, 1440}, {1460, 1460}, {9000, 1460}};
+    
+    for (auto const &c : cases) {
+        TcpSynCookieInfo info{c.mss, 0, false, false};
+        TcpSeqNum cookie = TcpSynCookie::encode(key, conn, peer_isn, counter, info);
+        TcpSynCookieInfo dec;
+        AIPSTACK_ASSERT_FORCE(
+            TcpSynCookie::decode(key, conn, peer_isn, counter, cookie, dec));
+        AIPSTACK_ASSERT_FORCE(dec.mss == c.expected);
+    }
+}
+
+static bool isValid (TcpSynCookie::Key const &k, TcpPcbKey const &c,
+                     TcpSeqNum peer_isn, std::uint32_t counter, TcpSeqNum cookie)
+{
+    TcpSynCookieInfo dec;
+    return TcpSynCookie::decode(k, c, peer_isn, counter, cookie, dec);
+}
+
+static void testValidation ()
+{
+    TcpSeqNum peer_isn = TcpSeqNum(0xFFFFFFF0u);
+    // Exercise wraparound of the counter bits in the cookie.
+    std::uint32_t counter = 31;
+    TcpSynCookieInfo info{1460, 7, true, true};
+    TcpSeqNum cookie = TcpSynCookie::encode(key, conn, peer_isn, counter, info);
+    
+    // Accepted for the current and the next counter value, not later.
+    AIPSTACK_ASSERT_FORCE(isValid(key, conn, peer_isn, counter, cookie));
+    AIPSTACK_ASSERT_FORCE(isValid(key, conn, peer_isn, counter + 1, cookie));
+    AIPSTACK_ASSERT_FORCE(!isValid(key, conn, peer_isn, counter + 2, cookie));
+    AIPSTACK_ASSERT_FORCE(!isValid(key, conn, peer_isn, counter - 1, cookie));
+    
+    // A different key, connection or peer ISN is rejected.
+    TcpSynCookie::Key other_key{key.k0, key.k1 ^ 1};
+    AIPSTACK_ASSERT_FORCE(!isValid(other_key, conn, peer_isn, counter, cookie));
+    
+    TcpPcbKey other_conn = conn;
+    other_conn.remote_port = 50124;
+    AIPSTACK_ASSERT_FORCE(!isValid(key, other_conn, peer_isn, counter, cookie));
+    
+    AIPSTACK_ASSERT_FORCE(!isValid(key, conn, peer_isn + 1u, counter, cookie));
+    
+    // Random modifications of the cookie are almost always rejected.
+    int accepted = 0;
+    for (std::uint32_t i = 1; i < 10000; i++) {
+        TcpSeqNum bad = TcpSeqNum(cookie.value() ^ (i * 2654435761u));
+        if (isValid(key, conn, peer_isn, counter, bad)) {
+            accepted++;
+        }
+    }
+    AIPSTACK_ASSERT_FORCE(accepted <= 2);
+}
+
+using TestTcpService = IpTcpProtoService<
+    IpTcpProtoOptions::PcbIndexService::Is<AvlTreeIndexService>,
+    IpTcpProtoOptions::SynCookiesEnabled::Is<true>
+>;
+using Stack = AIpStackTests::TcpUdpTestStack<TestTcpService>;
+using TcpArg = Stack::Stack::GetProtoArg<TcpApi>;
+using Peer = AIpStackTests::TcpTestPeer<Stack>;
+
+// A cookie ACK must not create a PCB beyond the listener's limit.
+static void testCookieAckListenerFull ()
+{
+    Stack stack;
+    AIpStackTests::TestListener<TcpArg> lis;
+    AIPSTACK_ASSERT_FORCE(lis.startListening(stack.api<TcpApi>(),
+        {AIpStackTests::StackAddr, 80, /*max_pcbs=*/1}));
+    
+    // The first connection stays in SYN_RCVD and takes the only PCB.
+    Peer peer1(stack, 50001, 80);
+    peer1.connect(Peer::mssOptions(), /*complete=*/false);
+    
+    // The second one gets a SYN cookie.
+    Peer peer2(stack, 50002, 80);
+    peer2.connect(Peer::mssOptions(), /*complete=*/false);
+    
+    // The cookie ACK is refused with RST while the listener is full.
+    peer2.sendAck();
+    std::vector<AIpStackTests::TcpSegment> out = peer2.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].has(Tcp4Flags::Rst));
+    AIPSTACK_ASSERT_FORCE(lis.connections.empty());
+    
+    // After the first connection is reset, the cookie ACK is accepted.
+    peer1.send(peer1.segment(Tcp4Flags::Rst));
+    AIPSTACK_ASSERT_FORCE(stack.takeSent().empty());
+    
+    peer2.sendAck();
+    AIPSTACK_ASSERT_FORCE(lis.connections.size() == 1);
+    AIPSTACK_ASSERT_FORCE(lis.connections[0]->getRemotePort() == 50002);
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_syn_cookie_test;
+    
+    testRoundTrip();
+    testMssRounding();
+    testValidation();
+    testCookieAckListenerFull();
+    
+    return 0;
+}
@@ -0,0 +1,225 @@
+
+#include <cstdint>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/tcp/IpTcpProto.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/proto/Tcp4Proto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_time_wait_test {
+
+using Stack = AIpStackTests::TcpTestStack<
+    IpTcpProtoOptions::NumTimeWaitRecords::Is<2>
+>;
+using Server = AIpStackTests::TcpServerFixture<Stack>;
+using Peer = AIpStackTests::TcpTestPeer<Stack>;
+using Segment = AIpStackTests::TcpSegment;
+
+static constexpr PortNum ServerPort = Server::ServerPort;
+
+// The TIME_WAIT timeout (2 MSL) in milliseconds.
+static constexpr std::uint64_t TimeWaitTime = 120000;
+
+// Accept a connection from the peer, close it from our side and let the peer
+// close its side so that the connection enters TIME_WAIT. With simultaneous
+// close, the peer's FIN does not acknowledge ours (CLOSING), otherwise the
+// peer acknowledges our FIN first (FIN_WAIT_2).
+static void enterTimeWait (Server &s, Peer &peer, bool simultaneous = false)
+{
+    Stack &stack = s.stack;
+    std::size_t con_index = s.lis.connections.size();
+    peer.connect(Peer::mssOptions());
+    peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(s.lis.connections.size() == con_index + 1);
+    auto &con = *s.lis.connections[con_index];
+    
+    // We send a FIN.
+    con.closeSending();
+    stack.dispatch();
+    std::vector<Segment> out = peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].has(Tcp4Flags::Fin));
+    
+    if (simultaneous) {
+        // The peer sends its FIN without acknowledging ours (CLOSING).
+        Segment fin = peer.segment(Tcp4Flags::Fin|Tcp4Flags::Ack);
+        fin.ack_num = peer.rcv_nxt - 1u;
+        peer.send(fin);
+        out = peer.receiveAll();
+        AIPSTACK_ASSERT_FORCE(out.size() == 1);
+        AIPSTACK_ASSERT_FORCE(out[0].ack_num == peer.snd_nxt);
+        AIPSTACK_ASSERT_FORCE(!con.aborted);
+        
+        // The peer acknowledges our FIN and we enter TIME_WAIT.
+        peer.sendAck();
+        AIPSTACK_ASSERT_FORCE(stack.takeSent().empty());
+    } else {
+        // The peer acknowledges our FIN (FIN_WAIT_2).
+        peer.sendAck();
+        AIPSTACK_ASSERT_FORCE(stack.takeSent().empty());
+        AIPSTACK_ASSERT_FORCE(!con.aborted);
+        
+        // The peer sends its FIN, which we acknowledge and enter TIME_WAIT.
+        peer.send(peer.segment(Tcp4Flags::Fin|Tcp4Flags::Ack));
+        out = peer.receiveAll();
+        AIPSTACK_ASSERT_FORCE(out.size() == 1);
+        AIPSTACK_ASSERT_FORCE(out[0].flags == Tcp4Flags::Ack);
+        AIPSTACK_ASSERT_FORCE(out[0].ack_num == peer.snd_nxt);
+    }
+    
+    // The PCB is gone, the connection was reported as aborted.
+    AIPSTACK_ASSERT_FORCE(con.aborted);
+}
+
+// Check that the TIME_WAIT record of the peer's connection still exists, by
+// retransmitting the peer's FIN which must be acknowledged (without a record,
+// the listener would reply with RST).
+static void checkTimeWaitExists (Stack &stack, Peer &peer)
+{
+    Segment fin = peer.segment(Tcp4Flags::Fin|Tcp4Flags::Ack);
+    fin.seq_num = peer.snd_nxt - 1u;
+    stack.receive(AIpStackTests::makeTcpPacket(fin));
+    
+    std::vector<Segment> out = peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].flags == Tcp4Flags::Ack);
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == peer.rcv_nxt);
+    AIPSTACK_ASSERT_FORCE(out[0].ack_num == peer.snd_nxt);
+}
+
+// Check that there is no TIME_WAIT record of the peer's connection, so that
+// the retransmitted FIN reaches the listener which replies with RST.
+static void checkTimeWaitGone (Stack &stack, Peer &peer)
+{
+    Segment fin = peer.segment(Tcp4Flags::Fin|Tcp4Flags::Ack);
+    fin.seq_num = peer.snd_nxt - 1u;
+    stack.receive(AIpStackTests::makeTcpPacket(fin));
+    
+    std::vector<Segment> out = AIpStackTests::parseTcpPackets(stack.takeSent());
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].has(Tcp4Flags::Rst));
+}
+
+// Both ways of closing which end in TIME_WAIT leave a record.
+static void testCloseCreatesRecord ()
+{
+    for (bool simultaneous : {false, true}) {
+        Server s({}, /*max_pcbs=*/4);
+        enterTimeWait(s, s.peer, simultaneous);
+        checkTimeWaitExists(s.stack, s.peer);
+    }
+}
+
+// The record expires after the TIME_WAIT timeout, and a retransmitted FIN
+// restarts the timeout.
+static void testTimeout ()
+{
+    Server s({}, /*max_pcbs=*/4);
+    
+    Peer &peer1 = s.peer;
+    enterTimeWait(s, peer1);
+    Peer peer2(s.stack, 50001, ServerPort);
+    enterTimeWait(s, peer2);
+    
+    // Retransmit the FIN of the first connection late in TIME_WAIT.
+    s.stack.advance(TimeWaitTime - 1000);
+    checkTimeWaitExists(s.stack, peer1);
+    
+    // The second connection expires at its original time, the first
+    // one lives on.
+    s.stack.advance(2000);
+    checkTimeWaitGone(s.stack, peer2);
+    
+    s.stack.advance(TimeWaitTime - 3000);
+    checkTimeWaitExists(s.stack, peer1);
+    
+    s.stack.advance(TimeWaitTime + 1);
+    checkTimeWaitGone(s.stack, peer1);
+}
+
+// When all records are in use, the oldest one is reused.
+static void testEviction ()
+{
+    Server s({}, /*max_pcbs=*/4);
+    
+    // There are two records.
+    Peer &peer1 = s.peer;
+    enterTimeWait(s, peer1);
+    s.stack.advance(1000);
+    Peer peer2(s.stack, 50001, ServerPort);
+    enterTimeWait(s, peer2);
+    s.stack.advance(1000);
+    Peer peer3(s.stack, 50002, ServerPort);
+    enterTimeWait(s, peer3);
+    
+    checkTimeWaitGone(s.stack, peer1);
+    checkTimeWaitExists(s.stack, peer2);
+    checkTimeWaitExists(s.stack, peer3);
+}
+
+// A SYN for the tuple in TIME_WAIT starts a new connection, whose ISS is
+// above the sequence numbers of the old one.
+static void testSynReusesTimeWait ()
+{
+    Server s({}, /*max_pcbs=*/4);
+    
+    Peer &peer = s.peer;
+    enterTimeWait(s, peer);
+    TcpSeqNum old_snd_nxt = peer.rcv_nxt;
+    
+    s.stack.advance(1000);
+    
+    Peer new_peer(s.stack, 50000, ServerPort, peer.snd_nxt + 100000u);
+    Segment syn_ack = new_peer.connect(Peer::mssOptions());
+    AIPSTACK_ASSERT_FORCE((old_snd_nxt + TcpSeqInt(0xFFFF)).mod_lt(syn_ack.seq_num));
+    AIPSTACK_ASSERT_FORCE(s.lis.connections.size() == 2);
+    AIPSTACK_ASSERT_FORCE(!s.lis.connections[1]->aborted);
+    
+    // The new connection works.
+    new_peer.sendData(100);
+    s.stack.advance(1000);
+    AIPSTACK_ASSERT_FORCE(s.lis.connections[1]->received == 100);
+    std::vector<Segment> out = new_peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(!out.empty() && out.back().ack_num == new_peer.snd_nxt);
+}
+
+// If the listener refuses the SYN, the TIME_WAIT record remains.
+static void testSynRefusedKeepsTimeWait ()
+{
+    Server s({}, /*max_pcbs=*/1);
+    
+    Peer &peer = s.peer;
+    enterTimeWait(s, peer);
+    
+    // Another connection in SYN_RCVD fills up the listener.
+    Peer other(s.stack, 50001, ServerPort);
+    other.connect(Peer::mssOptions(), /*complete=*/false);
+    
+    // The SYN is refused.
+    Peer new_peer(s.stack, 50000, ServerPort, peer.snd_nxt + 100000u);
+    new_peer.send(new_peer.segment(Tcp4Flags::Syn));
+    std::vector<Segment> out = AIpStackTests::parseTcpPackets(s.stack.takeSent());
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].has(Tcp4Flags::Rst));
+    AIPSTACK_ASSERT_FORCE(s.lis.connections.size() == 1);
+    
+    checkTimeWaitExists(s.stack, peer);
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_time_wait_test;
+    
+    testCloseCreatesRecord();
+    testTimeout();
+    testEviction();
+    testSynReusesTimeWait();
+    testSynRefusedKeepsTimeWait();
+    
+    return 0;
+}
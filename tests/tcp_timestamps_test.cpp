@@ -0,0 +1,267 @@
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/tcp/IpTcpProto.h>
+#include <aipstack/tcp/TcpOptions.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/proto/Tcp4Proto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_timestamps_test {
+
+using Stack = AIpStackTests::TcpTestStack<
+    IpTcpProtoOptions::TimestampsEnabled::Is<true>
+>;
+using Peer = AIpStackTests::TcpTestPeer<Stack>;
+using Segment = AIpStackTests::TcpSegment;
+
+static constexpr std::uint16_t Mss = 1000;
+
+// Data in a full segment, which also carries the timestamps option.
+static constexpr std::size_t SegSize = Mss - TcpOptionWriteLen::Timestamps;
+
+// Round-trip time of the handshake in milliseconds.
+static constexpr std::uint64_t HandshakeRtt = 100;
+
+// The timestamp clock of the stack ticks every two milliseconds.
+static constexpr std::uint64_t TsTick = 2;
+
+// TSval of the SYN of the peer.
+static constexpr std::uint32_t PeerTsStart = 1000;
+
+// Connection accepted from a peer which uses the timestamps option, with an
+// RTT sample from the handshake.
+struct Connection :
+    public AIpStackTests::TcpServerFixture<Stack>
+{
+    Connection ()
+    {
+        TcpOptions syn_opts = Peer::mssOptions(Mss);
+        syn_opts.options |= TcpOptionFlags::Timestamps;
+        syn_opts.ts_val = PeerTsStart;
+        syn_opts.ts_ecr = 0;
+        Segment syn_ack = peer.connect(syn_opts, /*complete=*/false);
+        AIPSTACK_ASSERT_FORCE(syn_ack.hasOption(TcpOptionFlags::Timestamps));
+        AIPSTACK_ASSERT_FORCE(syn_ack.opts.ts_ecr == PeerTsStart);
+        stack_ts = syn_ack.opts.ts_val;
+        
+        stack.advance(HandshakeRtt);
+        send(segment(Tcp4Flags::Ack, 0, PeerTsStart));
+        AIPSTACK_ASSERT_FORCE(lis.connections.size() == 1);
+    }
+    
+    // Make a segment from the peer with the timestamps option, echoing the
+    // last TSval received from the stack.
+    Segment segment (Tcp4Flags flags, std::size_t data_len, std::uint32_t ts_val) const
+    {
+        Segment seg = peer.segment(flags, data_len);
+        seg.opts.options = TcpOptionFlags::Timestamps;
+        seg.opts.ts_val = ts_val;
+        seg.opts.ts_ecr = stack_ts;
+        return seg;
+    }
+    
+    // Send a segment and return the segments sent in response, which all
+    // must have the timestamps option.
+    std::vector<Segment> send (Segment const &seg)
+    {
+        peer.send(seg);
+        return receiveAll();
+    }
+    
+    std::vector<Segment> receiveAll ()
+    {
+        std::vector<Segment> out = peer.receiveAll();
+        for (Segment const &seg : out) {
+            AIPSTACK_ASSERT_FORCE(seg.hasOption(TcpOptionFlags::Timestamps));
+            stack_ts = seg.opts.ts_val;
+        }
+        return out;
+    }
+    
+    // Advance time until something is sent, return it and the time waited.
+    std::vector<Segment> waitForOutput (std::uint64_t &waited)
+    {
+        waited = 0;
+        while (stack.sent.empty()) {
+            AIPSTACK_ASSERT_FORCE(waited < 10000);
+            stack.advance(1);
+            waited++;
+        }
+        return receiveAll();
+    }
+    
+    std::uint32_t stack_ts;
+};
+
+// Without the timestamps option in the SYN, the option is not used.
+static void testNotNegotiated ()
+{
+    AIpStackTests::TcpServerFixture<Stack> f;
+    Segment syn_ack = f.accept(Peer::mssOptions(Mss));
+    AIPSTACK_ASSERT_FORCE(!syn_ack.hasOption(TcpOptionFlags::Timestamps));
+    
+    f.con().send(100);
+    f.stack.advance(1);
+    std::vector<Segment> out = f.peer.receiveAll();
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(!out[0].hasOption(TcpOptionFlags::Timestamps));
+}
+
+// A segment with a TSval older than TS.Recent is dropped and answered with an
+// ACK (PAWS). Segments without the option and with an equal TSval are
+// accepted.
+static void testPaws ()
+{
+    Connection c;
+    
+    std::vector<Segment> out = c.send(c.segment(Tcp4Flags::Ack, 100, PeerTsStart + 10));
+    AIPSTACK_ASSERT_FORCE(c.con().received == 100);
+    
+    TcpSeqNum rcv_nxt = c.peer.snd_nxt;
+    out = c.send(c.segment(Tcp4Flags::Ack, 100, PeerTsStart + 9));
+    AIPSTACK_ASSERT_FORCE(c.con().received == 100);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].data.empty());
+    AIPSTACK_ASSERT_FORCE(out[0].ack_num == rcv_nxt);
+    AIPSTACK_ASSERT_FORCE(out[0].opts.ts_ecr == PeerTsStart + 10);
+    c.peer.snd_nxt = rcv_nxt;
+    
+    c.send(c.segment(Tcp4Flags::Ack, 100, PeerTsStart + 10));
+    AIPSTACK_ASSERT_FORCE(c.con().received == 200);
+    
+    c.peer.sendData(100);
+    c.receiveAll();
+    AIPSTACK_ASSERT_FORCE(c.con().received == 300);
+}
+
+// A RST is not subject to PAWS.
+static void testRstIgnoresPaws ()
+{
+    Connection c;
+    
+    c.send(c.segment(Tcp4Flags::Ack, 100, PeerTsStart + 10));
+    c.send(c.segment(Tcp4Flags::Rst, 0, PeerTsStart));
+    AIPSTACK_ASSERT_FORCE(c.con().aborted);
+}
+
+// TS.Recent is taken from in-sequence segments only, and after the
+// connection was idle for longer than its validity, it is replaced by any
+// TSval.
+static void testTsRecentUpdate ()
+{
+    Connection c;
+    
+    // An in-sequence segment updates TS.Recent, which is echoed.
+    std::vector<Segment> out = c.send(c.segment(Tcp4Flags::Ack, 100, PeerTsStart + 10));
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].opts.ts_ecr == PeerTsStart + 10);
+    
+    // An out-of-sequence segment does not, the duplicate ACK echoes the
+    // previous TS.Recent.
+    TcpSeqNum hole_start = c.peer.snd_nxt;
+    Segment seg = c.segment(Tcp4Flags::Ack, 100, PeerTsStart + 20);
+    seg.seq_num = hole_start + TcpSeqInt(100);
+    out = c.send(seg);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].ack_num == hole_start);
+    AIPSTACK_ASSERT_FORCE(out[0].opts.ts_ecr == PeerTsStart + 10);
+    
+    // The segment filling the hole does.
+    seg = c.segment(Tcp4Flags::Ack, 100, PeerTsStart + 30);
+    seg.seq_num = hole_start;
+    out = c.send(seg);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].ack_num == hole_start + TcpSeqInt(200));
+    AIPSTACK_ASSERT_FORCE(out[0].opts.ts_ecr == PeerTsStart + 30);
+    c.peer.snd_nxt = hole_start + TcpSeqInt(200);
+    
+    // After a long idle time, an old TSval is accepted.
+    c.stack.advance(25 * 86400 * std::uint64_t(1000));
+    out = c.send(c.segment(Tcp4Flags::Ack, 100, PeerTsStart));
+    AIPSTACK_ASSERT_FORCE(c.con().received == 400);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].opts.ts_ecr == PeerTsStart);
+}
+
+// Every ACK gives an RTT sample, not only one per round trip. ACKs with a
+// growing RTT push the RTO above what the first one alone would give.
+static void testRttSampleEveryAck ()
+{
+    Connection c;
+    
+    c.con().send(4 * SegSize);
+    c.stack.advance(1);
+    std::vector<Segment> flight = c.receiveAll();
+    AIPSTACK_ASSERT_FORCE(flight.size() == 4);
+    
+    // Acknowledge the first three segments after 100, 250 and 300 ms.
+    std::uint64_t ack_times[] = {100, 250, 300};
+    std::uint64_t now = 1;
+    for (std::size_t i = 0; i < 3; i++) {
+        c.stack.advance(ack_times[i] - now);
+        now = ack_times[i];
+        Segment ack = c.segment(Tcp4Flags::Ack, 0, PeerTsStart + std::uint32_t(i));
+        ack.ack_num = flight[i].seq_num + TcpSeqInt(SegSize);
+        ack.opts.ts_ecr = flight[i].opts.ts_val;
+        c.send(ack);
+    }
+    
+    // With the first sample only the RTO would be at its minimum of 250 ms.
+    std::uint64_t waited;
+    std::vector<Segment> out = c.waitForOutput(waited);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].seq_num == flight[3].seq_num);
+    AIPSTACK_ASSERT_FORCE(waited >= 400 && waited <= 600);
+}
+
+// The ACK of a retransmitted segment gives an RTT sample from the echoed
+// TSval of the retransmission, so the backed-off RTO is recalculated.
+static void testRttSampleAfterRetransmission ()
+{
+    Connection c;
+    
+    c.con().send(SegSize);
+    c.stack.advance(1);
+    AIPSTACK_ASSERT_FORCE(c.receiveAll().size() == 1);
+    
+    // The RTO after the handshake is three times its RTT.
+    std::uint64_t waited;
+    std::vector<Segment> out = c.waitForOutput(waited);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].data.size() == SegSize);
+    AIPSTACK_ASSERT_FORCE(waited + 1 >= 3 * HandshakeRtt - TsTick &&
+                          waited + 1 <= 3 * HandshakeRtt + TsTick);
+    
+    // The retransmission is acknowledged after 20 ms.
+    c.stack.advance(20);
+    Segment ack = c.segment(Tcp4Flags::Ack, 0, PeerTsStart + 1);
+    ack.ack_num = out[0].seq_num + TcpSeqInt(SegSize);
+    c.send(ack);
+    AIPSTACK_ASSERT_FORCE(c.con().acked == SegSize);
+    
+    // Without the sample the RTO would remain doubled at 600 ms, and with
+    // the RTT from the original transmission it would be close to 500 ms.
+    c.con().send(SegSize);
+    c.stack.advance(1);
+    AIPSTACK_ASSERT_FORCE(c.receiveAll().size() == 1);
+    out = c.waitForOutput(waited);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(waited + 1 >= 300 && waited + 1 <= 340);
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_timestamps_test;
+    
+    testNotNegotiated();
+    testPaws();
+    testRstIgnoresPaws();
+    testTsRecentUpdate();
+    testRttSampleEveryAck();
+    testRttSampleAfterRetransmission();
+    
+    return 0;
+}
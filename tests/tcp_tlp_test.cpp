@@ -0,0 +1,143 @@
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/tcp/IpTcpProto.h>
+#include <aipstack/tcp/TcpOptions.h>
+#include <aipstack/tcp/TcpSeqNum.h>
+#include <aipstack/proto/Tcp4Proto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_tcp_tlp_test {
+
+template<bool RackTlpEnabled>
+using TestStack = AIpStackTests::TcpTestStack<
+    IpTcpProtoOptions::SackEnabled::Is<true>,
+    IpTcpProtoOptions::RackTlpEnabled::Is<RackTlpEnabled>
+>;
+
+using Segment = AIpStackTests::TcpSegment;
+
+static constexpr std::uint16_t Mss = 1000;
+
+// Round-trip time in milliseconds.
+static constexpr std::uint64_t Rtt = 50;
+
+// The retransmission timeout, which is at its minimum for this RTT.
+static constexpr std::uint64_t Rto = 250;
+
+// Connection with SACK, with an RTT sample from the handshake. Three
+// segments are sent and the peer acknowledges only the first one after an
+// RTT; the other two are lost.
+template<bool RackTlpEnabled>
+struct TailLossConnection :
+    public AIpStackTests::TcpServerFixture<TestStack<RackTlpEnabled>>
+{
+    using Fixture = AIpStackTests::TcpServerFixture<TestStack<RackTlpEnabled>>;
+    using Fixture::stack;
+    using Fixture::peer;
+    
+    TailLossConnection ()
+    {
+        TcpOptions syn_opts = Fixture::Peer::mssOptions(Mss);
+        syn_opts.options |= TcpOptionFlags::SackPerm;
+        Segment syn_ack = this->accept(syn_opts, Rtt);
+        AIPSTACK_ASSERT_FORCE(syn_ack.hasOption(TcpOptionFlags::SackPerm));
+        
+        this->con().send(3 * Mss);
+        stack.advance(1);
+        std::vector<Segment> out = peer.receiveAll();
+        AIPSTACK_ASSERT_FORCE(out.size() == 3);
+        start = out[0].seq_num;
+        
+        stack.advance(Rtt - 1);
+        peer.sendAck(seq(1));
+    }
+    
+    // Sequence number of the start of the given segment.
+    TcpSeqNum seq (std::size_t seg_index) const
+    {
+        return start + TcpSeqInt(seg_index * Mss);
+    }
+    
+    // Advance time until something is sent, return it and the time waited.
+    std::vector<Segment> waitForOutput (std::uint64_t &waited)
+    {
+        waited = 0;
+        while (stack.sent.empty()) {
+            AIPSTACK_ASSERT_FORCE(waited < 10 * Rto);
+            stack.advance(1);
+            waited++;
+        }
+        return peer.receiveAll();
+    }
+    
+    TcpSeqNum start;
+};
+
+// Without RACK-TLP the lost tail is only retransmitted after the RTO.
+static void testNoTlp ()
+{
+    TailLossConnection<false> c;
+    
+    std::uint64_t waited;
+    std::vector<Segment> out = c.waitForOutput(waited);
+    AIPSTACK_ASSERT_FORCE(waited == Rto);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1 && out[0].seq_num == c.seq(1));
+}
+
+// The last segment is retransmitted as a probe after two RTTs, well before
+// the RTO. Its SACK makes the sender retransmit the other lost segment, and
+// no RTO happens.
+static void testTlpBeforeRto ()
+{
+    TailLossConnection<true> c;
+    
+    std::uint64_t waited;
+    std::vector<Segment> out = c.waitForOutput(waited);
+    AIPSTACK_ASSERT_FORCE(waited == 2 * Rtt);
+    AIPSTACK_ASSERT_FORCE(waited < Rto);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.seq(2));
+    AIPSTACK_ASSERT_FORCE(out[0].data.size() == Mss);
+    
+    // The peer got the probe and reports it with SACK.
+    Segment ack = c.peer.segment(Tcp4Flags::Ack);
+    ack.ack_num = c.seq(1);
+    ack.opts.options = TcpOptionFlags::Sack;
+    ack.opts.num_sack_blocks = 1;
+    ack.opts.sack_blocks[0] = TcpSackBlock{c.seq(2), c.seq(3)};
+    c.peer.send(ack);
+    
+    // The hole is retransmitted after the reordering window, long before
+    // the RTO.
+    out = c.waitForOutput(waited);
+    AIPSTACK_ASSERT_FORCE(waited < Rtt);
+    AIPSTACK_ASSERT_FORCE(out.size() == 1);
+    AIPSTACK_ASSERT_FORCE(out[0].seq_num == c.seq(1));
+    AIPSTACK_ASSERT_FORCE(out[0].data.size() == Mss);
+    
+    // Everything is acknowledged, nothing more is sent.
+    c.peer.sendAck(c.seq(3));
+    c.peer.receiveAll();
+    c.stack.advance(10 * Rto);
+    AIPSTACK_ASSERT_FORCE(c.stack.sent.empty());
+    AIPSTACK_ASSERT_FORCE(c.con().acked == 3 * Mss);
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_tcp_tlp_test;
+    
+    testNoTlp();
+    testTlpBeforeRto();
+    
+    return 0;
+}
@@ -0,0 +1,116 @@
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/infra/Buf.h>
+#include <aipstack/infra/Chksum.h>
+#include <aipstack/ip/IpAddr.h>
+#include <aipstack/proto/Ip4Proto.h>
+#include <aipstack/proto/Udp4Proto.h>
+#include <aipstack/udp/IpUdpProto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_udp_chksum_offload_test {
+
+using TestTcpService = IpTcpProtoService<
+    IpTcpProtoOptions::PcbIndexService::Is<AvlTreeIndexService>
+>;
+using Stack = AIpStackTests::TcpUdpTestStack<TestTcpService>;
+
+static constexpr std::size_t HeaderSpace = 64;
+
+// Send a UDP datagram with the given payload length, optionally forcing the
+// interface, and return the reassembled UDP datagram (header and payload).
+static std::vector<char> sendAndCollect (
+    Stack &stack, std::size_t data_len, bool force_iface)
+{
+    std::vector<char> buf(HeaderSpace + data_len);
+    for (std::size_t i = 0; i < data_len; i++) {
+        buf[HeaderSpace + i] = char(i * 7 + 1);
+    }
+    IpBufNode node{buf.data(), buf.size(), nullptr};
+    IpBufRef udp_data{&node, HeaderSpace, data_len};
+    
+    IpErr err = stack.api<UdpApi>().sendUdpIp4Packet(
+        Ip4AddrPair{AIpStackTests::StackAddr, AIpStackTests::PeerAddr},
+        {/*src_port=*/4000, /*dst_port=*/5000}, udp_data,
+        force_iface ? &stack.iface() : nullptr, nullptr, IpSendFlags());
+    AIPSTACK_ASSERT_FORCE(err == IpErr::Success);
+    
+    // Put the fragments together, they are sent in order.
+    std::vector<char> dgram;
+    for (auto const &pkt : stack.takeSent()) {
+        AIpStackTests::Ip4Info info;
+        std::vector<char> payload = AIpStackTests::parseIp4Packet(pkt, info);
+        AIPSTACK_ASSERT_FORCE(info.proto == Ip4Protocol::Udp);
+        std::size_t offset = 8 * AsUnderlying(info.flags_offset & Ip4Flags::OffsetMask);
+        AIPSTACK_ASSERT_FORCE(offset == dgram.size());
+        dgram.insert(dgram.end(), payload.begin(), payload.end());
+    }
+    
+    AIPSTACK_ASSERT_FORCE(dgram.size() == Udp4Header::Size + data_len);
+    return dgram;
+}
+
+static std::uint16_t getChksumField (std::vector<char> const &dgram)
+{
+    return ReadSingleField<std::uint16_t>(dgram.data() + 6);
+}
+
+static bool chksumValid (std::vector<char> const &dgram)
+{
+    return AIpStackTests::transportChksum(AIpStackTests::StackAddr,
+        AIpStackTests::PeerAddr, Ip4Protocol::Udp, dgram.data(), dgram.size()) == 0;
+}
+
+static void testOffload ()
+{
+    AIpStackTests::TestIfaceParams params;
+    params.ip_mtu = 576;
+    params.tx_chksum_offload = IpChksumFlags::Transport;
+    Stack stack(params);
+    
+    // Fits into the MTU and the interface is forced: left to the driver.
+    std::vector<char> dgram = sendAndCollect(stack, 500, true);
+    AIPSTACK_ASSERT_FORCE(getChksumField(dgram) == 0);
+    
+    // Fragmented: the driver cannot calculate it so the stack does.
+    dgram = sendAndCollect(stack, 1000, true);
+    AIPSTACK_ASSERT_FORCE(getChksumField(dgram) != 0);
+    AIPSTACK_ASSERT_FORCE(chksumValid(dgram));
+    
+    // The interface is not forced: always calculated.
+    dgram = sendAndCollect(stack, 500, false);
+    AIPSTACK_ASSERT_FORCE(getChksumField(dgram) != 0);
+    AIPSTACK_ASSERT_FORCE(chksumValid(dgram));
+}
+
+static void testNoOffload ()
+{
+    AIpStackTests::TestIfaceParams params;
+    params.ip_mtu = 576;
+    Stack stack(params);
+    
+    for (std::size_t len : {std::size_t(0), std::size_t(500), std::size_t(1000)}) {
+        std::vector<char> dgram = sendAndCollect(stack, len, true);
+        AIPSTACK_ASSERT_FORCE(getChksumField(dgram) != 0);
+        AIPSTACK_ASSERT_FORCE(chksumValid(dgram));
+    }
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_udp_chksum_offload_test;
+    
+    testOffload();
+    testNoOffload();
+    
+    return 0;
+}
@@ -0,0 +1,184 @@
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <aipstack/misc/Assert.h>
+#include <aipstack/infra/Buf.h>
+#include <aipstack/infra/BufUtils.h>
+#include <aipstack/infra/PacketBufPool.h>
+#include <aipstack/ip/IpAddr.h>
+#include <aipstack/proto/Ip4Proto.h>
+#include <aipstack/proto/Udp4Proto.h>
+#include <aipstack/udp/IpUdpProto.h>
+
+#include "stack_test_harness.h"
+
+using namespace AIpStack;
+
+namespace aipstack_udp_retained_dgram_test {
+
+using TestTcpService = IpTcpProtoService<
+    IpTcpProtoOptions::PcbIndexService::Is<AvlTreeIndexService>
+>;
+using Stack = AIpStackTests::TcpUdpTestStack<TestTcpService>;
+using UdpArg = Stack::Stack::GetProtoArg<UdpApi>;
+
+static constexpr std::size_t NumBufs = 2;
+static constexpr std::size_t BufSize = 1500;
+static constexpr std::uint16_t LocalPort = 5000;
+static constexpr std::uint16_t RemotePort = 4000;
+
+static IpPacketBuf bufs[NumBufs];
+static char mem[NumBufs * BufSize];
+
+// Listener which retains each datagram it receives.
+struct RetainingListener {
+    RetainingListener (Stack &stack) :
+        lis(AIPSTACK_BIND_MEMBER(&RetainingListener::handler, this))
+    {
+        UdpListenParams<UdpArg> params;
+        params.port = LocalPort;
+        AIPSTACK_ASSERT_FORCE(lis.startListening(stack.api<UdpApi>(), params) ==
+                              IpErr::Success);
+    }
+    
+    UdpRecvResult handler (IpRxInfoIp4<UdpArg::StackArg> const &ip_info,
+                           UdpRxInfo<UdpArg> const &udp_info, IpBufRef udp_data)
+    {
+        num_received++;
+        retained = dgram.retain(ip_info, udp_info, udp_data);
+        return UdpRecvResult::AcceptStop;
+    }
+    
+    UdpListener<UdpArg> lis;
+    UdpRetainedDgram<UdpArg> dgram;
+    int num_received = 0;
+    bool retained = false;
+};
+
+static std::vector<char> makeUdpPacket (std::size_t data_len)
+{
+    std::vector<char> udp(Udp4Header::Size + data_len);
+    auto udp_header = Udp4Header::MakeRef(udp.data());
+    udp_header.set(Udp4Header::SrcPort(), RemotePort);
+    udp_header.set(Udp4Header::DstPort(), LocalPort);
+    udp_header.set(Udp4Header::Length(), std::uint16_t(udp.size()));
+    udp_header.set(Udp4Header::Checksum(), 0);
+    for (std::size_t i = 0; i < data_len; i++) {
+        udp[Udp4Header::Size + i] = char(i * 7 + 1);
+    }
+    
+    return AIpStackTests::makeIp4Packet(AIpStackTests::PeerAddr,
+        AIpStackTests::StackAddr, Ip4Protocol::Udp, udp);
+}
+
+static bool dataMatches (IpBufRef data, std::size_t data_len)
+{
+    if (data.tot_len != data_len) {
+        return false;
+    }
+    for (std::size_t i = 0; i < data_len; i++) {
+        if (ipBufTakeByteMut(data) != char(i * 7 + 1)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A datagram received into a pool buffer is retained without copying and
+// remains valid after the driver releases its reference.
+static void testRetainFromPool ()
+{
+    IpPacketBufPool pool(bufs, NumBufs, mem, BufSize);
+    
+    {
+        AIpStackTests::TestIfaceParams params;
+        params.rx_pool = &pool;
+        Stack stack(params);
+        RetainingListener lis(stack);
+        
+        // Receive the packet like a driver would.
+        std::vector<char> pkt = makeUdpPacket(300);
+        IpPacketBuf *buf = pool.alloc();
+        AIPSTACK_ASSERT_FORCE(buf != nullptr);
+        std::memcpy(buf->getNode()->ptr, pkt.data(), pkt.size());
+        stack.receiveBuf(buf->getBufRef(pkt.size()));
+        pool.unref(*buf);
+        
+        AIPSTACK_ASSERT_FORCE(lis.num_received == 1);
+        AIPSTACK_ASSERT_FORCE(lis.retained && lis.dgram.isRetained());
+        AIPSTACK_ASSERT_FORCE(buf->getRefCount() == 1);
+        AIPSTACK_ASSERT_FORCE(pool.getStats().num_free == NumBufs - 1);
+        
+        Ip4AddrPair const &addrs = lis.dgram.getAddrs();
+        AIPSTACK_ASSERT_FORCE(addrs.local_addr == AIpStackTests::StackAddr);
+        AIPSTACK_ASSERT_FORCE(addrs.remote_addr == AIpStackTests::PeerAddr);
+        AIPSTACK_ASSERT_FORCE(lis.dgram.getUdpInfo().src_port == RemotePort);
+        AIPSTACK_ASSERT_FORCE(lis.dgram.getUdpInfo().dst_port == LocalPort);
+        AIPSTACK_ASSERT_FORCE(dataMatches(lis.dgram.getData(), 300));
+        
+        // Releasing returns the buffer to the pool.
+        lis.dgram.release();
+        AIPSTACK_ASSERT_FORCE(!lis.dgram.isRetained());
+        AIPSTACK_ASSERT_FORCE(pool.getStats().num_free == NumBufs);
+        
+        // The destructor also releases it.
+        buf = pool.alloc();
+        std::memcpy(buf->getNode()->ptr, pkt.data(), pkt.size());
+        stack.receiveBuf(buf->getBufRef(pkt.size()));
+        pool.unref(*buf);
+        AIPSTACK_ASSERT_FORCE(lis.retained);
+        AIPSTACK_ASSERT_FORCE(pool.getStats().num_free == NumBufs - 1);
+    }
+    
+    AIPSTACK_ASSERT_FORCE(pool.getStats().num_free == NumBufs);
+}
+
+// A datagram which is not in a pool buffer cannot be retained.
+static void testRetainNotInPool ()
+{
+    IpPacketBufPool pool(bufs, NumBufs, mem, BufSize);
+    
+    // The interface has a pool but the packet is elsewhere.
+    {
+        AIpStackTests::TestIfaceParams params;
+        params.rx_pool = &pool;
+        Stack stack(params);
+        RetainingListener lis(stack);
+        
+        stack.receive(makeUdpPacket(300));
+        AIPSTACK_ASSERT_FORCE(lis.num_received == 1);
+        AIPSTACK_ASSERT_FORCE(!lis.retained && !lis.dgram.isRetained());
+    }
+    
+    // The interface has no pool.
+    {
+        Stack stack;
+        RetainingListener lis(stack);
+        
+        std::vector<char> pkt = makeUdpPacket(300);
+        IpPacketBuf *buf = pool.alloc();
+        std::memcpy(buf->getNode()->ptr, pkt.data(), pkt.size());
+        stack.receiveBuf(buf->getBufRef(pkt.size()));
+        pool.unref(*buf);
+        
+        AIPSTACK_ASSERT_FORCE(lis.num_received == 1);
+        AIPSTACK_ASSERT_FORCE(!lis.retained && !lis.dgram.isRetained());
+    }
+    
+    AIPSTACK_ASSERT_FORCE(pool.getStats().num_free == NumBufs);
+}
+
+}
+
+int main ()
+{
+    using namespace aipstack_udp_retained_dgram_test;
+    
+    testRetainFromPool();
+    testRetainNotInPool();
+    
+    return 0;
+}